@@ -1,25 +1,30 @@
 /*
- * This file is part of cnine, a lightweight C++ tensor library. 
- *  
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
  * Copyright (c) 2023, Imre Risi Kondor
  *
- * This source code file is subject to the terms of the noncommercial 
- * license distributed with cnine in the file LICENSE.TXT. Commercial 
- * use is prohibited. All redistributed versions of this file (in 
- * original or modified form) must retain this copyright notice and 
- * must be accompanied by a verbatim copy of the license. 
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
  *
  */
 
-#ifndef _CnineFindPlantedSubgraphs2
-#define _CnineFindPlantedSubgraphs2
-
-#include <set>
+#ifndef _CnineSortRowsUnique
+#define _CnineSortRowsUnique
 
 #include "Cnine_base.hpp"
 #include "Tensor.hpp"
-#include "tensor1_view.hpp"
+#include "ParallelFor.hpp"
+#include "CnineProfiler.hpp"
+
 
+// The distinct rows of a matrix in lexicographic order. Rows are hashed in parallel and
+// distributed to shards by the top bits of their hash, each shard is deduplicated with its own
+// open addressing table, and only the distinct rows are sorted. Optionally also returns, as in
+// numpy's unique(return_inverse, return_counts), the index of each input row in the result and
+// the multiplicity of each result row.
 
 namespace cnine{
 
@@ -28,30 +33,256 @@ namespace cnine{
   public:
 
     Tensor<TYPE> r;
+    Tensor<int> inverse; // row i of x is row inverse(i) of r
+    Tensor<int> counts; // number of rows of x equal to row j of r
 
-    SortRowsUnique(const TensorView<TYPE> x){
-      CNINE_ASSRT(x.dev==0);
+
+    SortRowsUnique(const TensorView<TYPE> x, const bool return_inverse=false, const bool return_counts=false){
+      CNINE_ASSRT(x.get_dev()==0);
       CNINE_ASSRT(x.ndims()==2);
-      int N=x.dim(0);
+      const int N=x.dim(0);
+      const int k=x.dim(1);
+      CNINE_PROFILE_OPS("SortRowsUnique",(double)N*k);
+
+      if(N==0){
+	r=Tensor<TYPE>(Gdims(0,k));
+	if(return_inverse) inverse=Tensor<int>(Gdims(0));
+	if(return_counts) counts=Tensor<int>(Gdims(0));
+	return;
+      }
+
+      const TYPE* arr=x.mem();
+      const size_t s0=x.stride(0);
+      const size_t s1=x.stride(1);
+      auto row=[&](const int i){return arr+i*s0;};
+      auto equal=[&](const int i, const int j){
+	const TYPE* a=row(i); const TYPE* b=row(j);
+	for(int c=0; c<k; c++)
+	  if(a[c*s1]!=b[c*s1]) return false;
+	return true;};
+      auto less=[&](const int i, const int j){
+	const TYPE* a=row(i); const TYPE* b=row(j);
+	for(int c=0; c<k; c++){
+	  if(a[c*s1]<b[c*s1]) return true;
+	  if(a[c*s1]>b[c*s1]) return false;
+	}
+	return false;};
+
+      vector<size_t> hash(N);
+      parallel_for(N,[&](const size_t beg, const size_t end){
+	  for(size_t i=beg; i<end; i++)
+	    hash[i]=row_hash(row(i),k,s1);
+	});
+
+      // Distribute the row indices to the shards, keeping them in increasing order within each shard
+      int shard_bits=0;
+      while(shard_bits<8 && (N>>shard_bits)>(1<<14)) shard_bits++;
+      const int nshards=1<<shard_bits;
+      auto shard=[&](const size_t h){return shard_bits==0?0:(int)(h>>(64-shard_bits));};
+
+      const size_t grain=parallel_grain;
+      const size_t nchunks=parallel_nchunks(N,grain);
+      vector<int> offs(nchunks*nshards+1,0);
+      parallel_for(nchunks,[&](const size_t b, const size_t e){
+	  for(size_t c=b; c<e; c++)
+	    for(size_t i=c*grain; i<std::min<size_t>(N,(c+1)*grain); i++)
+	      offs[c*nshards+shard(hash[i])+1]++;
+	},1);
+      vector<int> shard_beg(nshards+1,0);
+      int t=0;
+      for(int s=0; s<nshards; s++){
+	shard_beg[s]=t;
+	for(size_t c=0; c<nchunks; c++){
+	  const int n=offs[c*nshards+s+1];
+	  offs[c*nshards+s+1]=t;
+	  t+=n;
+	}
+      }
+      shard_beg[nshards]=t;
+
+      vector<int> order(N);
+      parallel_for(nchunks,[&](const size_t b, const size_t e){
+	  for(size_t c=b; c<e; c++)
+	    for(size_t i=c*grain; i<std::min<size_t>(N,(c+1)*grain); i++)
+	      order[offs[c*nshards+shard(hash[i])+1]++]=i;
+	},1);
+
+      // Deduplicate each shard. rep[i] is the first row equal to row i.
+      vector<int> rep(N);
+      vector<int> multiplicity(return_counts?N:0);
+      vector<vector<int> > shard_reps(nshards);
+      parallel_for(nshards,[&](const size_t b, const size_t e){
+	  for(size_t s=b; s<e; s++){
+	    const int n=shard_beg[s+1]-shard_beg[s];
+	    size_t tsize=1;
+	    while(tsize<2*n) tsize*=2;
+	    const size_t mask=tsize-1;
+	    vector<int> table(tsize,-1);
+	    auto& reps=shard_reps[s];
+	    for(int u=shard_beg[s]; u<shard_beg[s+1]; u++){
+	      const int i=order[u];
+	      const size_t h=hash[i];
+	      size_t slot=h&mask;
+	      int j=table[slot];
+	      while(j>=0 && (hash[j]!=h || !equal(i,j))){
+		slot=(slot+1)&mask;
+		j=table[slot];
+	      }
+	      if(j<0){
+		table[slot]=i;
+		reps.push_back(i);
+		j=i;
+	      }
+	      rep[i]=j;
+	      if(return_counts) multiplicity[j]++;
+	    }
+	  }
+	},1);
+
+      vector<int> uniq;
+      for(auto& p:shard_reps)
+	uniq.insert(uniq.end(),p.begin(),p.end());
+      const int U=uniq.size();
 
-      set<tensor1_view<TYPE> > hashmap;
-      for(int i=0; i<N; i++)
-	hashmap.insert(x.rowv(i));
+      // For integer rows as many leading columns as fit are packed into a 64 bit key, using the
+      // range of values in each column, and the keys are radix sorted
+      if constexpr(std::is_integral<TYPE>::value && sizeof(TYPE)<=4){
+	vector<int64_t> lo(k,std::numeric_limits<int64_t>::max());
+	vector<int64_t> hi(k,std::numeric_limits<int64_t>::min());
+	for(int u=0; u<U; u++){
+	  const TYPE* a=row(uniq[u]);
+	  for(int c=0; c<k; c++){
+	    lo[c]=std::min<int64_t>(lo[c],a[c*s1]);
+	    hi[c]=std::max<int64_t>(hi[c],a[c*s1]);
+	  }
+	}
+	vector<int> bits;
+	int total=0;
+	for(int c=0; c<k; c++){
+	  int b=0;
+	  while(b<33 && ((hi[c]-lo[c])>>b)>0) b++;
+	  if(total+b>64) break;
+	  bits.push_back(b);
+	  total+=b;
+	}
+	const int npacked=bits.size();
 
-      int i=0;
-      Tensor<TYPE> R(Gdims(hashmap.size(),x.dim(1)));
-      for(auto& p:hashmap)
-	R.rowv(i++)=p;
-      r=R;
+	vector<pair<uint64_t,int> > keyed(U);
+	parallel_for(U,[&](const size_t beg, const size_t end){
+	    for(size_t u=beg; u<end; u++){
+	      const TYPE* a=row(uniq[u]);
+	      uint64_t key=0;
+	      for(int c=0; c<npacked; c++)
+		if(bits[c]>0) key=(key<<bits[c])|(uint64_t)(a[c*s1]-lo[c]);
+	      keyed[u]=make_pair(key,uniq[u]);
+	    }
+	  });
+	radix_sort(keyed,total);
+	for(int u=0; u<U; u++)
+	  uniq[u]=keyed[u].second;
+
+	// Rows whose packed prefix agrees are ordered by their remaining columns
+	if(npacked<k){
+	  int beg=0;
+	  for(int u=1; u<=U; u++)
+	    if(u==U || keyed[u].first!=keyed[beg].first){
+	      if(u-beg>1) std::sort(uniq.begin()+beg,uniq.begin()+u,less);
+	      beg=u;
+	    }
+	}
+      }else{
+	parallel_sort(uniq.begin(),uniq.end(),less);
+      }
+
+      r=Tensor<TYPE>(Gdims(U,k));
+      TYPE* rarr=r.mem();
+      const size_t rs0=r.stride(0), rs1=r.stride(1);
+      parallel_for(U,[&](const size_t beg, const size_t end){
+	  for(size_t u=beg; u<end; u++){
+	    const TYPE* a=row(uniq[u]);
+	    for(int c=0; c<k; c++)
+	      rarr[u*rs0+c*rs1]=a[c*s1];
+	  }
+	});
+
+      if(return_inverse){
+	vector<int> rank(N);
+	parallel_for(U,[&](const size_t beg, const size_t end){
+	    for(size_t u=beg; u<end; u++) rank[uniq[u]]=u;});
+	inverse=Tensor<int>(Gdims(N));
+	int* iarr=inverse.mem();
+	parallel_for(N,[&](const size_t beg, const size_t end){
+	    for(size_t i=beg; i<end; i++) iarr[i]=rank[rep[i]];});
+      }
+
+      if(return_counts){
+	counts=Tensor<int>(Gdims(U));
+	int* carr=counts.mem();
+	for(int u=0; u<U; u++)
+	  carr[u]=multiplicity[uniq[u]];
+      }
     }
 
     operator Tensor<TYPE>(){
       return r;
     }
 
+
+  private:
+
+    static size_t row_hash(const TYPE* p, const int k, const size_t s){
+      size_t h=0x9E3779B97F4A7C15ull^k;
+      for(int c=0; c<k; c++){
+	h=(h^std::hash<TYPE>()(p[c*s]))*0x9E3779B97F4A7C15ull;
+	h^=h>>29;
+      }
+      h^=h>>33;
+      h*=0xff51afd7ed558ccdull;
+      h^=h>>33;
+      return h;
+    }
+
+    // Parallel LSD radix sort on the low nbits bits of the keys. Each pass histograms the chunks in
+    // parallel and then scatters them in parallel to their precomputed offsets, so it is stable.
+    static void radix_sort(vector<pair<uint64_t,int> >& v, const int nbits){
+      const int radix_bits=11;
+      const int nbuckets=1<<radix_bits;
+      const size_t n=v.size();
+      const size_t grain=std::max<size_t>(parallel_grain,nbuckets);
+      const size_t nchunks=parallel_nchunks(n,grain);
+      vector<pair<uint64_t,int> > w(n);
+      vector<size_t> offs(nchunks*nbuckets);
+
+      for(int shift=0; shift<nbits; shift+=radix_bits){
+	auto digit=[&](const pair<uint64_t,int>& p){return (p.first>>shift)&(nbuckets-1);};
+	parallel_for(nchunks,[&](const size_t b, const size_t e){
+	    for(size_t c=b; c<e; c++){
+	      size_t* count=&offs[c*nbuckets];
+	      std::fill(count,count+nbuckets,0);
+	      for(size_t i=c*grain; i<std::min(n,(c+1)*grain); i++)
+		count[digit(v[i])]++;
+	    }
+	  },1);
+	size_t t=0;
+	for(int d=0; d<nbuckets; d++)
+	  for(size_t c=0; c<nchunks; c++){
+	    const size_t m=offs[c*nbuckets+d];
+	    offs[c*nbuckets+d]=t;
+	    t+=m;
+	  }
+	parallel_for(nchunks,[&](const size_t b, const size_t e){
+	    for(size_t c=b; c<e; c++){
+	      size_t* offset=&offs[c*nbuckets];
+	      for(size_t i=c*grain; i<std::min(n,(c+1)*grain); i++)
+		w[offset[digit(v[i])]++]=v[i];
+	    }
+	  },1);
+	v.swap(w);
+      }
+    }
+
   };
 
 }
 
-#endif 
-
+#endif
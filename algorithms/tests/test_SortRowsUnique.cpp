@@ -14,12 +14,41 @@
 #include "Cnine_base.cpp"
 #include "CnineSession.hpp"
 #include "SortRowsUnique.hpp"
+#include <set>
 
 using namespace cnine;
 
+// Compare against a std::set of rows
+int check(const Tensor<int>& X){
+  int N=X.dim(0), k=X.dim(1);
+  set<vector<int> > rows;
+  for(int i=0; i<N; i++){
+    vector<int> v(k);
+    for(int j=0; j<k; j++) v[j]=X(i,j);
+    rows.insert(v);
+  }
+
+  SortRowsUnique<int> S(X,true,true);
+  int errors=(S.r.dim(0)!=rows.size());
+  int u=0;
+  for(auto& v:rows){
+    for(int j=0; j<k; j++)
+      if(S.r(u,j)!=v[j]) errors++;
+    u++;
+  }
+  int total=0;
+  for(int j=0; j<S.counts.dim(0); j++) total+=S.counts(j);
+  if(total!=N) errors++;
+  for(int i=0; i<N; i++)
+    for(int j=0; j<k; j++)
+      if(S.r(S.inverse(i),j)!=X(i,j)) errors++;
+  return errors;
+}
+
+
 int main(int argc, char** argv){
 
-  cnine_session session;
+  cnine_session session(4);
 
   Tensor<int> A({{1,2,3},{2,5,7},{1,2,3}});
   cout<<A<<endl;
@@ -27,4 +56,32 @@ int main(int argc, char** argv){
   Tensor<int> B=SortRowsUnique(A);
   cout<<B<<endl;
 
+  SortRowsUnique<int> U(A,true,true);
+  cout<<U.inverse<<endl;
+  cout<<U.counts<<endl;
+
+  Tensor<float> F({{0.5,1.0},{-1.0,2.0},{0.5,1.0},{0.5,-3.0}});
+  cout<<SortRowsUnique<float>(F).r<<endl;
+
+  // Random rows with few distinct values per column, and rows whose leading columns span
+  // the whole int range so that the packed sort keys have to be tie broken
+  int N=200000, k=5;
+  Tensor<int> X=Tensor<int>::zero({N,k});
+  Tensor<int> Y=Tensor<int>::zero({N,k});
+  uniform_int_distribution<int> distr(0,5);
+  for(int i=0; i<N; i++)
+    for(int j=0; j<k; j++){
+      X.set(i,j,distr(rndGen));
+      Y.set(i,j,j<2?(distr(rndGen)%2?-2000000000:2000000000):distr(rndGen));
+    }
+
+  for(int nt: {1,4}){
+    nthreads=nt;
+    cout<<"nthreads="<<nt<<" errors: "<<check(X)<<" "<<check(Y)<<endl;
+  }
+
+  Tensor<int> E=Tensor<int>::zero({0,3});
+  SortRowsUnique<int> Ue(E,true,true);
+  cout<<"Empty input: "<<Ue.r.dim(0)<<"x"<<Ue.r.dim(1)<<" result, errors: "<<check(E)<<endl;
+
 }
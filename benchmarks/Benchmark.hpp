@@ -0,0 +1,326 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineBenchmark
+#define _CnineBenchmark
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <unistd.h>
+
+#include "Cnine_base.hpp"
+#include "CpuGemm.hpp"
+
+
+// Minimal benchmark harness in the style of Google Benchmark. A benchmark is a function taking a
+// State, registered with CNINE_BENCHMARK and given any number of argument sets:
+//
+//   void bench_add(bench::State& state){
+//     ... setup using state.range(0) ...
+//     for(auto _: state)
+//       ... timed code ...
+//     state.set_flops(...);
+//   }
+//   CNINE_BENCHMARK(bench_add)->Args({1024,1024})->Args({4096,4096});
+//
+// The number of iterations is scaled until one repetition takes at least min_time seconds.
+
+namespace cnine{
+
+  extern thread_local int nthreads;
+
+  namespace bench{
+
+    // Keep the compiler from optimizing away the computation of x
+    template<typename TYPE>
+    inline void do_not_optimize(const TYPE& x){
+      asm volatile("" : : "r,m"(x) : "memory");
+    }
+
+
+    class State{
+    public:
+
+      vector<long long> args;
+      long long max_iterations=1;
+      double flops=0; // per iteration
+      double bytes=0; // per iteration
+      string label;
+
+      std::chrono::steady_clock::time_point t0;
+      double elapsed=0;
+
+      State(const vector<long long>& _args, const long long _max_iterations):
+        args(_args), max_iterations(_max_iterations){}
+
+      long long range(const int i) const{
+	CNINE_ASSRT(i<args.size());
+	return args[i];
+      }
+
+      void set_flops(const double x){flops=x;}
+      void set_bytes(const double x){bytes=x;}
+      void set_label(const string x){label=x;}
+
+      void pause(){elapsed+=std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();}
+      void resume(){t0=std::chrono::steady_clock::now();}
+
+
+    public: // ---- Iteration ----------------------------------------------------------------------------------
+
+
+      class iterator{
+      public:
+	State* owner;
+	long long i;
+	iterator(State* _owner, const long long _i): owner(_owner), i(_i){}
+	int operator*() const{return 0;}
+	iterator& operator++(){i++; return *this;}
+	bool operator!=(const iterator& x){
+	  if(i<x.i) return true;
+	  owner->pause();
+	  return false;
+	}
+      };
+
+      iterator begin(){
+	resume();
+	return iterator(this,0);
+      }
+
+      iterator end(){
+	return iterator(this,max_iterations);
+      }
+
+    };
+
+
+    class Benchmark{
+    public:
+
+      string name;
+      std::function<void(State&)> fn;
+      vector<vector<long long> > arg_sets;
+
+      Benchmark(const string _name, std::function<void(State&)> _fn):
+	name(_name), fn(_fn){}
+
+      Benchmark* Args(const vector<long long>& x){
+	arg_sets.push_back(x);
+	return this;
+      }
+
+      string full_name(const vector<long long>& args) const{
+	string s=name;
+	for(auto p:args) s+="/"+to_string(p);
+	return s;
+      }
+
+    };
+
+
+    inline vector<Benchmark*>& registry(){
+      static vector<Benchmark*> benchmarks;
+      return benchmarks;
+    }
+
+    inline Benchmark* register_benchmark(const string name, std::function<void(State&)> fn){
+      registry().push_back(new Benchmark(name,fn));
+      return registry().back();
+    }
+
+
+    class Result{
+    public:
+      string name;
+      string label;
+      long long iterations=0;
+      double median=0; // seconds per iteration
+      double mean=0;
+      double min=0;
+      double flops=0;
+      double bytes=0;
+
+      double gflops() const{return (median>0)?flops/median/1e9:0;}
+      double gbytes() const{return (median>0)?bytes/median/1e9:0;}
+    };
+
+
+    class Options{
+    public:
+      string filter;
+      string format="console";
+      string out;
+      double min_time=0.2;
+      int repetitions=3;
+      int threads=0;
+      bool list=false;
+    };
+
+
+    inline Result run_one(const Benchmark& b, const vector<long long>& args, const Options& opt){
+      Result r;
+      r.name=b.full_name(args);
+
+      // warm up and find the number of iterations that takes min_time
+      long long n=1;
+      while(true){
+	State s(args,n);
+	b.fn(s);
+	if(s.elapsed>=opt.min_time || n>=(1ll<<30)) break;
+	double scale=(s.elapsed>0)?1.4*opt.min_time/s.elapsed:100;
+	n=std::max(n+1,(long long)(n*std::min(scale,100.0)));
+      }
+
+      vector<double> times;
+      for(int i=0; i<opt.repetitions; i++){
+	State s(args,n);
+	b.fn(s);
+	times.push_back(s.elapsed/n);
+	r.flops=s.flops;
+	r.bytes=s.bytes;
+	r.label=s.label;
+      }
+      std::sort(times.begin(),times.end());
+      r.iterations=n;
+      r.min=times[0];
+      r.median=times[times.size()/2];
+      r.mean=0;
+      for(auto t:times) r.mean+=t/times.size();
+      return r;
+    }
+
+
+    // ---- Output -------------------------------------------------------------------------------------------
+
+
+    inline string json_escape(const string& s){
+      string r;
+      for(auto c:s){
+	if(c=='"' || c=='\\') r+='\\';
+	r+=c;
+      }
+      return r;
+    }
+
+    inline string context_json(){
+      char host[256]="";
+      gethostname(host,255);
+      std::time_t t=std::time(nullptr);
+      char date[64];
+      strftime(date,64,"%Y-%m-%dT%H:%M:%S",std::localtime(&t));
+      ostringstream oss;
+      oss<<"  \"context\": {\"date\": \""<<date<<"\", \"host\": \""<<json_escape(host)<<"\", ";
+      oss<<"\"nthreads\": "<<nthreads<<", \"hardware_threads\": "<<std::thread::hardware_concurrency()<<", ";
+      oss<<"\"gemm_isa\": \""<<gemm_isa_str()<<"\"}";
+      return oss.str();
+    }
+
+    inline void write_json(ostream& oss, const vector<Result>& results){
+      oss<<"{"<<endl<<context_json()<<","<<endl;
+      oss<<"  \"benchmarks\": ["<<endl;
+      for(int i=0; i<results.size(); i++){
+	auto& r=results[i];
+	oss<<"    {\"name\": \""<<json_escape(r.name)<<"\", \"label\": \""<<json_escape(r.label)<<"\", ";
+	oss<<"\"iterations\": "<<r.iterations<<", ";
+	oss<<"\"median_ns\": "<<r.median*1e9<<", \"mean_ns\": "<<r.mean*1e9<<", \"min_ns\": "<<r.min*1e9<<", ";
+	oss<<"\"gflops\": "<<r.gflops()<<", \"gbytes_per_second\": "<<r.gbytes()<<"}";
+	oss<<((i+1<results.size())?",":"")<<endl;
+      }
+      oss<<"  ]"<<endl<<"}"<<endl;
+    }
+
+    inline void write_csv(ostream& oss, const vector<Result>& results){
+      oss<<"name,label,iterations,median_ns,mean_ns,min_ns,gflops,gbytes_per_second"<<endl;
+      for(auto& r:results)
+	oss<<r.name<<","<<r.label<<","<<r.iterations<<","<<r.median*1e9<<","<<r.mean*1e9<<","<<r.min*1e9<<","
+	   <<r.gflops()<<","<<r.gbytes()<<endl;
+    }
+
+    inline void write_console_line(ostream& oss, const Result& r){
+      oss<<std::left<<std::setw(44)<<r.name<<std::right;
+      oss<<std::setw(14)<<std::fixed<<std::setprecision(3)<<r.median*1e6<<" us";
+      oss<<std::setw(12)<<r.iterations;
+      if(r.flops>0) oss<<std::setw(10)<<std::setprecision(2)<<r.gflops()<<" GFlop/s";
+      if(r.bytes>0) oss<<std::setw(10)<<std::setprecision(2)<<r.gbytes()<<" GB/s";
+      if(r.label.size()>0) oss<<"  "<<r.label;
+      oss<<std::defaultfloat<<endl;
+    }
+
+
+    // ---- Driver -------------------------------------------------------------------------------------------
+
+
+    inline Options parse_options(int argc, char** argv){
+      Options opt;
+      for(int i=1; i<argc; i++){
+	string a(argv[i]);
+	auto value=[&](const string key)->string{
+	  if(a.rfind(key+"=",0)==0) return a.substr(key.size()+1);
+	  return "";};
+	if(a=="--list") {opt.list=true; continue;}
+	if(value("--filter")!="") {opt.filter=value("--filter"); continue;}
+	if(value("--format")!="") {opt.format=value("--format"); continue;}
+	if(value("--out")!="") {opt.out=value("--out"); continue;}
+	if(value("--min_time")!="") {opt.min_time=std::stod(value("--min_time")); continue;}
+	if(value("--repetitions")!="") {opt.repetitions=std::max(1,std::stoi(value("--repetitions"))); continue;}
+	if(value("--threads")!="") {opt.threads=std::stoi(value("--threads")); continue;}
+	cerr<<"Usage: "<<argv[0]<<" [--list] [--filter=substring] [--format=console|json|csv] [--out=file]"
+	    <<" [--min_time=seconds] [--repetitions=n] [--threads=n]"<<endl;
+	exit(1);
+      }
+      if(opt.format!="console" && opt.format!="json" && opt.format!="csv"){
+	cerr<<"Unknown format "<<opt.format<<endl;
+	exit(1);
+      }
+      return opt;
+    }
+
+    inline int run_main(int argc, char** argv){
+      Options opt=parse_options(argc,argv);
+      if(opt.threads>0) nthreads=opt.threads;
+
+      vector<Result> results;
+      for(auto b:registry()){
+	vector<vector<long long> > arg_sets=b->arg_sets;
+	if(arg_sets.size()==0) arg_sets.push_back(vector<long long>());
+	for(auto& args:arg_sets){
+	  string name=b->full_name(args);
+	  if(opt.filter!="" && name.find(opt.filter)==string::npos) continue;
+	  if(opt.list) {cout<<name<<endl; continue;}
+	  Result r=run_one(*b,args,opt);
+	  if(opt.format=="console") write_console_line(cout,r);
+	  results.push_back(r);
+	}
+      }
+      if(opt.list || opt.format=="console") return 0;
+
+      std::ofstream ofs;
+      if(opt.out!="") ofs.open(opt.out);
+      ostream& os=(opt.out!="")?static_cast<ostream&>(ofs):cout;
+      if(opt.format=="json") write_json(os,results);
+      if(opt.format=="csv") write_csv(os,results);
+      return 0;
+    }
+
+  }
+
+}
+
+
+#define CNINE_BENCHMARK(fn) \
+  static cnine::bench::Benchmark* _cnine_benchmark_##fn=cnine::bench::register_benchmark(#fn,fn)
+
+#endif
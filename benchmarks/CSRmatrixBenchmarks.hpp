@@ -0,0 +1,96 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineCSRmatrixBenchmarks
+#define _CnineCSRmatrixBenchmarks
+
+#include "Benchmark.hpp"
+#include "RtensorA.hpp"
+#include "Tensor.hpp"
+#include "CSRmatrix.hpp"
+#include "RtensorConvolve2dSparse.hpp"
+
+
+namespace cnine{
+  namespace bench{
+
+    // Convolution of an (n x n x c) image with a k x k kernel stored as a CSRmatrix, in which
+    // a fraction density/100 of the weights are nonzero
+    inline void CSRmatrix_convolve2d(State& state){
+      const int n=state.range(0), c=state.range(1), k=state.range(2);
+      const float density=state.range(3)/100.0;
+      RtensorA w=RtensorA::gaussian({c,k,k,c});
+      uniform_real_distribution<float> distr(0,1);
+      int nnz=0;
+      for(int i=0; i<w.asize; i++){
+	if(distr(rndGen)>density) w.arr[i]=0;
+	else nnz++;
+      }
+      CSRmatrix<float> ws(w.view4().fuse23().fuse12());
+      RtensorA x=RtensorA::gaussian({n,n,c});
+      RtensorA r=RtensorA::zero({n-k+1,n-k+1,c});
+      for(auto _: state)
+	RtensorConvolve2dSparse()(r.view3(),x.view3(),ws,k,k);
+      state.set_flops(2.0*(n-k+1)*(n-k+1)*nnz);
+    }
+    CNINE_BENCHMARK(CSRmatrix_convolve2d)->Args({32,16,3,10})->Args({32,16,3,50})->Args({64,32,3,10});
+
+
+    // Random n x n sparse matrix with a fraction density/1000 of nonzeros
+    inline CSRmatrix<float> random_csr(const int n, const float density){
+      uniform_real_distribution<float> distr(0,1);
+      CSRmatrix<float> A(0,n);
+      for(int i=0; i<n; i++){
+	vector<int> ix;
+	vector<float> v;
+	for(int j=0; j<n; j++)
+	  if(distr(rndGen)<density){
+	    ix.push_back(j);
+	    v.push_back(distr(rndGen));
+	  }
+	A.push_back(ix,v);
+      }
+      A.n=n;
+      return A;
+    }
+
+    // Sparse times dense with nc columns (nc=1 is SpMV)
+    inline void CSRmatrix_mprod(State& state){
+      const int n=state.range(0), nc=state.range(1);
+      CSRmatrix<float> A=random_csr(n,state.range(2)/1000.0);
+      Tensor<float> x=Tensor<float>::gaussian({n,nc});
+      Tensor<float> r=Tensor<float>::zero({n,nc});
+      for(auto _: state)
+	add_mprod(r,A,x);
+      state.set_flops(2.0*A.nnz()*nc);
+      state.set_bytes(4.0*(2*A.nnz()+A.nnz()*nc+2*n*nc));
+    }
+    CNINE_BENCHMARK(CSRmatrix_mprod)->Args({10000,1,10})->Args({10000,16,10})->Args({10000,128,10})->Args({2000,512,10});
+
+    // The same with the cached transpose
+    inline void CSRmatrix_mprod_TA(State& state){
+      const int n=state.range(0), nc=state.range(1);
+      CSRmatrix<float> A=random_csr(n,state.range(2)/1000.0);
+      Tensor<float> x=Tensor<float>::gaussian({n,nc});
+      Tensor<float> r=Tensor<float>::zero({n,nc});
+      for(auto _: state)
+	add_mprod_TA(r,A,x);
+      state.set_flops(2.0*A.nnz()*nc);
+    }
+    CNINE_BENCHMARK(CSRmatrix_mprod_TA)->Args({10000,16,10})->Args({10000,128,10});
+
+  }
+}
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineCellMapBenchmarks
+#define _CnineCellMapBenchmarks
+
+#include "Benchmark.hpp"
+#include "CtensorArray_funs.hpp"
+#include "CtensorB_plus_cop.hpp"
+#include "CellwiseBinaryCmap.hpp"
+#include "InnerCmap.hpp"
+#include "OuterCmap.hpp"
+
+
+namespace cnine{
+  namespace bench{
+
+    // r_i=x_i+y_i over n cells of shape (c,c)
+    inline void CellMap_cellwise(State& state){
+      const int n=state.range(0), c=state.range(1);
+      CtensorArray x(dims(n),dims(c,c),fill_gaussian(),0);
+      CtensorArray y(dims(n),dims(c,c),fill_gaussian(),0);
+      CtensorArray r(dims(n),dims(c,c),fill_zero(),0);
+      for(auto _: state)
+	CellwiseBinaryCmap(CtensorB_plus_cop(),r,x,y);
+      state.set_bytes(3.0*8*n*c*c);
+    }
+    CNINE_BENCHMARK(CellMap_cellwise)->Args({20000,4})->Args({20000,16});
+
+    // r=sum_i x_i+y_i over n cells, reduced in parallel
+    inline void CellMap_inner(State& state){
+      const int n=state.range(0), c=state.range(1);
+      CtensorArray x(dims(n),dims(c,c),fill_gaussian(),0);
+      CtensorArray y(dims(n),dims(c,c),fill_gaussian(),0);
+      CtensorArray r(dims(1),dims(c,c),fill_zero(),0);
+      for(auto _: state)
+	InnerCmap(CtensorB_plus_cop(),r,x,y);
+      state.set_bytes(2.0*8*n*c*c);
+    }
+    CNINE_BENCHMARK(CellMap_inner)->Args({20000,4})->Args({20000,16});
+
+    // r_ij=x_i+y_j for n x n output cells
+    inline void CellMap_outer(State& state){
+      const int n=state.range(0), c=state.range(1);
+      CtensorArray x(dims(n),dims(c,c),fill_gaussian(),0);
+      CtensorArray r(dims(n,n),dims(c,c),fill_zero(),0);
+      for(auto _: state)
+	OuterCmap(CtensorB_plus_cop(),r,x,x);
+      state.set_bytes(8.0*n*n*c*c);
+    }
+    CNINE_BENCHMARK(CellMap_outer)->Args({150,4});
+
+  }
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineConvolveBenchmarks
+#define _CnineConvolveBenchmarks
+
+#include "Benchmark.hpp"
+#include "RtensorA.hpp"
+#include "RtensorConvolve2d.hpp"
+#include "RtensorConvolve3d.hpp"
+#include "RtensorConvolve2dSparse.hpp"
+
+
+namespace cnine{
+  namespace bench{
+
+    // (n x n x c) image, c output channels, k x k kernel with same padding. The last argument is
+    // the algorithm: 0=automatic, 1=direct, 2=im2col, 3=winograd.
+    inline void RtensorConvolve2d_image(State& state){
+      const int n=state.range(0), c=state.range(1), k=state.range(2);
+      RtensorConvolve2d conv((ConvolveAlgorithm)state.range(3));
+      RtensorA x=RtensorA::gaussian({n,n,c});
+      RtensorA w=RtensorA::gaussian({c,k,k,c});
+      RtensorA r=RtensorA::zero({n,n,c});
+      for(auto _: state)
+	conv(r.view3(),x.view3(),w.view4());
+      state.set_flops(2.0*n*n*c*c*k*k);
+      state.set_label(ConvolveAlgorithm_str(conv.algorithm));
+    }
+    CNINE_BENCHMARK(RtensorConvolve2d_image)
+    ->Args({32,16,3,1})->Args({32,16,3,2})->Args({32,16,3,3})
+      ->Args({64,32,3,1})->Args({64,32,3,2})->Args({64,32,3,3})
+      ->Args({32,16,5,1})->Args({32,16,5,2});
+
+    // (n x n x n x c) volume, c output channels, k x k x k kernel with same padding
+    inline void RtensorConvolve3d_volume(State& state){
+      const int n=state.range(0), c=state.range(1), k=state.range(2);
+      RtensorConvolve3d conv((ConvolveAlgorithm)state.range(3));
+      RtensorA x=RtensorA::gaussian({n,n,n,c});
+      RtensorA w=RtensorA::gaussian({c,k,k,k,c});
+      RtensorA r=RtensorA::zero({n,n,n,c});
+      for(auto _: state)
+	conv(r.view4(),x.view4(),w.view5());
+      state.set_flops(2.0*n*n*n*c*c*k*k*k);
+      state.set_label(ConvolveAlgorithm_str(conv.algorithm));
+    }
+    CNINE_BENCHMARK(RtensorConvolve3d_volume)->Args({16,8,3,1})->Args({16,8,3,2});
+
+    // (n x n x a x nc) image convolved with a k x k kernel of a x a weights of which pct percent
+    // are nonzero, same padding
+    inline void RtensorConvolve2dSparse_image(State& state){
+      const int n=state.range(0), a=state.range(1), nc=state.range(2), k=3, pct=state.range(3);
+      uniform_int_distribution<int> distr(0,99);
+      RtensorA wd=RtensorA::gaussian({a,k*k*a});
+      for(int i=0; i<wd.asize; i++)
+	if(distr(rndGen)>=pct) wd.arr[i]=0;
+      CSRmatrix<float> w(wd.view2());
+      RtensorA x=RtensorA::gaussian({n,n,a,nc});
+      RtensorA r=RtensorA::zero({n,n,a,nc});
+      for(auto _: state)
+	RtensorConvolve2dSparse()(r.view4(),x.view4(),w,k,k);
+      state.set_flops(2.0*w.nnz()*n*n*nc);
+    }
+    CNINE_BENCHMARK(RtensorConvolve2dSparse_image)->Args({32,16,1,10})->Args({32,16,16,10})->Args({64,32,8,5});
+
+  }
+}
+
+#endif
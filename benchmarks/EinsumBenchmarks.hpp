@@ -0,0 +1,84 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineEinsumBenchmarks
+#define _CnineEinsumBenchmarks
+
+#include "Benchmark.hpp"
+#include "RtensorA.hpp"
+#include "RtensorEinsumFn.hpp"
+#include "TensorEinsum.hpp"
+
+
+namespace cnine{
+  namespace bench{
+
+    // Matrix product written as an einsum
+    inline void RtensorEinsumFn_matmul(State& state){
+      const int n=state.range(0);
+      RtensorEinsumFn<float> fn("ij,jk->ik");
+      RtensorA x=RtensorA::gaussian({n,n});
+      RtensorA y=RtensorA::gaussian({n,n});
+      RtensorA r=RtensorA::zero({n,n});
+      for(auto _: state)
+	fn(r.viewx(),x.viewx(),y.viewx());
+      state.set_flops(2.0*n*n*n);
+    }
+    CNINE_BENCHMARK(RtensorEinsumFn_matmul)->Args({32})->Args({128});
+
+    // Matrix times vector
+    inline void RtensorEinsumFn_matvec(State& state){
+      const int n=state.range(0), m=state.range(1);
+      RtensorEinsumFn<float> fn("ij,j->i");
+      RtensorA x=RtensorA::gaussian({n,m});
+      RtensorA y=RtensorA::gaussian({m});
+      RtensorA r=RtensorA::zero({n});
+      for(auto _: state)
+	fn(r.viewx(),x.viewx(),y.viewx());
+      state.set_flops(2.0*n*m);
+    }
+    CNINE_BENCHMARK(RtensorEinsumFn_matvec)->Args({1024,64})->Args({16384,64});
+
+    // Batched matrix product with the batch index in the middle of the output
+    inline void RtensorEinsumFn_batched(State& state){
+      const int b=state.range(0), n=state.range(1);
+      RtensorEinsumFn<float> fn("bij,bjk->ibk");
+      RtensorA x=RtensorA::gaussian({b,n,n});
+      RtensorA y=RtensorA::gaussian({b,n,n});
+      RtensorA r=RtensorA::zero({n,b,n});
+      for(auto _: state)
+	fn(r.viewx(),x.viewx(),y.viewx());
+      state.set_flops(2.0*b*n*n*n);
+    }
+    CNINE_BENCHMARK(RtensorEinsumFn_batched)->Args({64,16})->Args({16,64});
+
+    // Chain of three matrices and a vector, contracted in the order chosen by EinsumContraction
+    inline void einsum_chain(State& state){
+      const int n=state.range(0);
+      Tensor<float> A=Tensor<float>::gaussian({n,n});
+      Tensor<float> B=Tensor<float>::gaussian({n,n});
+      Tensor<float> C=Tensor<float>::gaussian({n,n});
+      Tensor<float> v=Tensor<float>::gaussian({n});
+      Tensor<float> r=Tensor<float>::zero({n});
+      EinsumContraction contraction("ij,jk,kl,l->i",{A.get_dims(),B.get_dims(),C.get_dims(),v.get_dims()});
+      for(auto _: state)
+	contraction.add_to<float>(r,{A,B,C,v});
+      state.set_flops(contraction.flops);
+    }
+    CNINE_BENCHMARK(einsum_chain)->Args({256})->Args({1024});
+
+  }
+}
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineGatherRowsBenchmarks
+#define _CnineGatherRowsBenchmarks
+
+#include "Benchmark.hpp"
+#include "GatherRows.hpp"
+
+
+namespace cnine{
+  namespace bench{
+
+    // Gather with a random map of n lists, each with about deg sources, on rows of width nc
+    inline void GatherRows_random(State& state){
+      const int n=state.range(0), nc=state.range(1), deg=state.range(2);
+      GatherMapB g=GatherMapB::random(n,n,((float)deg)/n);
+      Ltensor<float> x(dims(n,nc),4,0);
+      Ltensor<float> r(dims(n,nc),0,0);
+      for(auto _: state)
+	GatherRows()(r,x,g);
+      state.set_flops(((double)g.n_ops())*nc);
+      state.set_bytes(4.0*g.n_ops()*nc);
+    }
+    CNINE_BENCHMARK(GatherRows_random)->Args({1000,32,8})->Args({10000,32,8})->Args({10000,128,32});
+
+    // The same after GatherMapB::reorder
+    inline void GatherRows_reordered(State& state){
+      const int n=state.range(0), nc=state.range(1), deg=state.range(2);
+      GatherMapB g=GatherMapB::random(n,n,((float)deg)/n);
+      g.reorder();
+      Ltensor<float> x(dims(n,nc),4,0);
+      Ltensor<float> r(dims(n,nc),0,0);
+      for(auto _: state)
+	GatherRows()(r,x,g);
+      state.set_flops(((double)g.n_ops())*nc);
+      state.set_bytes(4.0*g.n_ops()*nc);
+    }
+    CNINE_BENCHMARK(GatherRows_reordered)->Args({1000,32,8})->Args({10000,32,8})->Args({10000,128,32});
+
+  }
+}
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineSortRowsUniqueBenchmarks
+#define _CnineSortRowsUniqueBenchmarks
+
+#include "Benchmark.hpp"
+#include "SortRowsUnique.hpp"
+
+
+namespace cnine{
+  namespace bench{
+
+    // n random rows of length k with entries in [0,range), so that some rows repeat
+    inline void SortRowsUnique_random(State& state){
+      const int n=state.range(0), k=state.range(1), range=state.range(2);
+      Tensor<int> x=Tensor<int>::zero({n,k});
+      uniform_int_distribution<int> distr(0,range-1);
+      for(int i=0; i<n; i++)
+	for(int j=0; j<k; j++)
+	  x.set(i,j,distr(rndGen));
+      for(auto _: state)
+	Tensor<int> r=SortRowsUnique<int>(x);
+      state.set_bytes(4.0*n*k);
+    }
+    CNINE_BENCHMARK(SortRowsUnique_random)->Args({1000,4,10})->Args({100000,4,10})->Args({100000,16,100});
+
+    // Same, also returning the inverse indices and the counts
+    inline void SortRowsUnique_inverse(State& state){
+      const int n=state.range(0), k=state.range(1), range=state.range(2);
+      Tensor<int> x=Tensor<int>::zero({n,k});
+      uniform_int_distribution<int> distr(0,range-1);
+      for(int i=0; i<n; i++)
+	for(int j=0; j<k; j++)
+	  x.set(i,j,distr(rndGen));
+      for(auto _: state)
+	SortRowsUnique<int> r(x,true,true);
+      state.set_bytes(4.0*n*k);
+    }
+    CNINE_BENCHMARK(SortRowsUnique_inverse)->Args({100000,4,10})->Args({1000000,4,10});
+
+  }
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineSubgraphBenchmarks
+#define _CnineSubgraphBenchmarks
+
+#include "Benchmark.hpp"
+#include "sparse_graph.hpp"
+#include "frozen_graph.hpp"
+#include "FindPlantedSubgraphs.hpp"
+#include "BatchedFindPlantedSubgraphs.hpp"
+
+
+namespace cnine{
+  namespace bench{
+
+    typedef sparse_graph<int,float> Graph;
+
+    // Random graph on n vertices with n*degree/2 edges
+    inline Graph random_sparse_graph(const int n, const int degree){
+      uniform_int_distribution<int> distr(0,n-1);
+      Graph G(n);
+      for(int e=0; e<n*degree/2; e++){
+	int i=distr(rndGen), j=distr(rndGen);
+	if(i!=j) G.set(i,j,1.0);
+      }
+      return G;
+    }
+
+    // Find all cycles of length m in a random graph with n vertices and average degree 4
+    inline void FindPlantedSubgraphs_cycle(State& state){
+      const int n=state.range(0), m=state.range(1);
+      Graph G=random_sparse_graph(n,4);
+      Graph H=Graph::cycle(m);
+      for(auto _: state)
+	FindPlantedSubgraphs<int> f(G,H);
+    }
+    CNINE_BENCHMARK(FindPlantedSubgraphs_cycle)->Args({1000,5})->Args({100000,3})->Args({100000,6});
+
+    // Same, on a graph that has already been frozen
+    inline void FindPlantedSubgraphs_frozen(State& state){
+      const int n=state.range(0), m=state.range(1);
+      frozen_graph<float> G(random_sparse_graph(n,4));
+      frozen_graph<float> H(Graph::cycle(m));
+      for(auto _: state)
+	FindPlantedSubgraphs<int> f(G,H);
+    }
+    CNINE_BENCHMARK(FindPlantedSubgraphs_frozen)->Args({1000,5})->Args({100000,3})->Args({100000,6});
+
+    // Building the CSR snapshot of a graph with n vertices and average degree 4
+    inline void frozen_graph_build(State& state){
+      const int n=state.range(0);
+      Graph G=random_sparse_graph(n,4);
+      for(auto _: state)
+	frozen_graph<float> F(G);
+      state.set_bytes(8.0*G.nedges()*2);
+    }
+    CNINE_BENCHMARK(frozen_graph_build)->Args({10000})->Args({100000});
+
+    // Cycles of length 6 in a batch of 256 graphs with 30 vertices each, drawn from a pool of 32
+    // distinct graphs, with or without the result cache
+    inline void FindPlantedSubgraphs_batched(State& state){
+      const bool cached=state.range(0);
+      vector<Graph> pool;
+      for(int i=0; i<32; i++)
+	pool.push_back(random_sparse_graph(30,4));
+      vector<Graph> batch;
+      for(int i=0; i<256; i++)
+	batch.push_back(pool[(i*7)%32]);
+      Graph H=Graph::cycle(6);
+      for(auto _: state)
+	BatchedFindPlantedSubgraphs<int> f(batch,H,cached);
+    }
+    CNINE_BENCHMARK(FindPlantedSubgraphs_batched)->Args({0})->Args({1});
+
+  }
+}
+
+#endif
@@ -0,0 +1,180 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineTensorViewBenchmarks
+#define _CnineTensorViewBenchmarks
+
+#include "Benchmark.hpp"
+#include "Tensor.hpp"
+#include "TensorPack.hpp"
+
+
+namespace cnine{
+  namespace bench{
+
+    // r+=x on an (n x m) tensor
+    inline void TensorView_add(State& state){
+      const int n=state.range(0), m=state.range(1);
+      Tensor<float> x=Tensor<float>::gaussian({n,m});
+      Tensor<float> r=Tensor<float>::zero({n,m});
+      for(auto _: state)
+	r.add(x);
+      state.set_flops(((double)n)*m);
+      state.set_bytes(12.0*n*m);
+    }
+    CNINE_BENCHMARK(TensorView_add)->Args({256,256})->Args({1024,1024})->Args({4096,1024});
+
+    // r+=x where x is a transposed view, so the operands have different strides
+    inline void TensorView_add_transposed(State& state){
+      const int n=state.range(0);
+      Tensor<float> x=Tensor<float>::gaussian({n,n});
+      Tensor<float> r=Tensor<float>::zero({n,n});
+      TensorView<float> xt=x.transp();
+      for(auto _: state)
+	r.add(xt);
+      state.set_flops(((double)n)*n);
+      state.set_bytes(12.0*n*n);
+    }
+    CNINE_BENCHMARK(TensorView_add_transposed)->Args({256})->Args({1024});
+
+    // r=x where x is a transposed view
+    inline void TensorView_copy_transposed(State& state){
+      const int n=state.range(0);
+      Tensor<float> x=Tensor<float>::gaussian({n,n});
+      Tensor<float> r=Tensor<float>::zero({n,n});
+      TensorView<float> rv(r);
+      TensorView<float> xt=x.transp();
+      for(auto _: state)
+	rv=xt;
+      state.set_bytes(8.0*n*n);
+    }
+    CNINE_BENCHMARK(TensorView_copy_transposed)->Args({256})->Args({1024});
+
+    // r+=x*y where r is a block of columns of a larger tensor and x is a permuted 3D view
+    inline void TensorView_add_prod_sliced(State& state){
+      const int n=state.range(0);
+      Tensor<float> R=Tensor<float>::zero({n,n,2*n});
+      Tensor<float> x=Tensor<float>::gaussian({n,n,n});
+      Tensor<float> y=Tensor<float>::gaussian({n,n,n});
+      TensorView<float> r=R.slices(2,0,n);
+      TensorView<float> xp=x.permute_indices({1,0,2});
+      for(auto _: state)
+	r.add_prod(xp,y);
+      state.set_flops(2.0*n*n*n);
+      state.set_bytes(16.0*n*n*n);
+    }
+    CNINE_BENCHMARK(TensorView_add_prod_sliced)->Args({32})->Args({128});
+
+    // Creating small views: n slices, each transposed and sliced again
+    inline void TensorView_make_views(State& state){
+      const int n=state.range(0);
+      Tensor<float> x=Tensor<float>::gaussian({n,8,8});
+      for(auto _: state){
+	float t=0;
+	for(int i=0; i<n; i++)
+	  t+=x.slice(0,i).transp().slice(0,i%8).mem()[0];
+	do_not_optimize(t);
+      }
+    }
+    CNINE_BENCHMARK(TensorView_make_views)->Args({10000});
+
+    // Accessing the tensors of a TensorPack one by one
+    inline void TensorPackView_access(State& state){
+      const int n=state.range(0);
+      TensorPack<float> x(n,Gdims({4,4}));
+      for(auto _: state){
+	size_t t=0;
+	for(int i=0; i<n; i++)
+	  t+=x(i).dim(0);
+	do_not_optimize(t);
+      }
+    }
+    CNINE_BENCHMARK(TensorPackView_access)->Args({10000});
+
+    // Packs of small tensors of different shapes, as in a layer with one tensor per irrep
+    inline vector<Gdims> pack_dims(const int n, const bool transposed=false){
+      vector<Gdims> R;
+      for(int i=0; i<n; i++)
+	if(transposed) R.push_back(Gdims(3+i%5,2+i%7));
+	else R.push_back(Gdims(2+i%7,3+i%5));
+      return R;
+    }
+
+    // Adding a transposed (non-contiguous) pack to a contiguous one
+    inline void TensorPackView_add_transposed(State& state){
+      const int n=state.range(0);
+      TensorPackDir xdir(pack_dims(n)), rdir(pack_dims(n,true));
+      TensorPack<float> x(xdir,fill_gaussian());
+      TensorPack<float> r(rdir,fill_zero());
+      for(auto _: state){
+	r.add(x.transp());
+	r.inplace_times(0.5);
+      }
+    }
+    CNINE_BENCHMARK(TensorPackView_add_transposed)->Args({1000})->Args({10000});
+
+    // Member by member matrix products
+    inline void TensorPackView_add_mprod(State& state){
+      const int n=state.range(0);
+      vector<Gdims> xdims, ydims;
+      for(auto& d:pack_dims(n)){
+	xdims.push_back(Gdims(d[0],16));
+	ydims.push_back(Gdims(16,d[1]));
+      }
+      TensorPackDir xdir(xdims), ydir(ydims), rdir(pack_dims(n));
+      TensorPack<float> x(xdir,fill_gaussian());
+      TensorPack<float> y(ydir,fill_gaussian());
+      TensorPack<float> r(rdir,fill_zero());
+      for(auto _: state)
+	r.add_mprod(x,y);
+    }
+    CNINE_BENCHMARK(TensorPackView_add_mprod)->Args({1000})->Args({10000});
+
+    // Many tiny products, each member of shape (2l+1,c) multiplied by its own (c,c) weight matrix
+    inline void TensorPackView_add_mprod_tiny(State& state){
+      const int n=state.range(0);
+      const int c=state.range(1);
+      vector<Gdims> xdims, ydims;
+      double flops=0;
+      for(int i=0; i<n; i++){
+	xdims.push_back(Gdims(2*(i%10)+1,c));
+	ydims.push_back(Gdims(c,c));
+	flops+=2.0*(2*(i%10)+1)*c*c;
+      }
+      TensorPackDir xdir(xdims), ydir(ydims);
+      TensorPack<float> x(xdir,fill_gaussian());
+      TensorPack<float> y(ydir,fill_gaussian());
+      TensorPack<float> r(xdir,fill_zero());
+      for(auto _: state)
+	r.add_mprod(x,y);
+      state.set_flops(flops);
+    }
+    CNINE_BENCHMARK(TensorPackView_add_mprod_tiny)->Args({1000,16})->Args({1000,32});
+
+    // r+=x*y for square matrices
+    inline void TensorView_add_mprod(State& state){
+      const int n=state.range(0);
+      Tensor<float> x=Tensor<float>::gaussian({n,n});
+      Tensor<float> y=Tensor<float>::gaussian({n,n});
+      Tensor<float> r=Tensor<float>::zero({n,n});
+      for(auto _: state)
+	r.add_mprod(x,y);
+      state.set_flops(2.0*n*n*n);
+    }
+    CNINE_BENCHMARK(TensorView_add_mprod)->Args({64})->Args({256})->Args({512});
+
+  }
+}
+
+#endif
@@ -0,0 +1,35 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+
+#include "TensorViewBenchmarks.hpp"
+#include "GatherRowsBenchmarks.hpp"
+#include "ConvolveBenchmarks.hpp"
+#include "EinsumBenchmarks.hpp"
+#include "CSRmatrixBenchmarks.hpp"
+#include "SortRowsUniqueBenchmarks.hpp"
+#include "SubgraphBenchmarks.hpp"
+#include "CellMapBenchmarks.hpp"
+
+using namespace cnine;
+
+
+// Usage: cnine_benchmarks [--list] [--filter=substring] [--format=console|json|csv] [--out=file]
+//                         [--min_time=seconds] [--repetitions=n] [--threads=n]
+
+int main(int argc, char** argv){
+  return bench::run_main(argc,argv);
+}
@@ -0,0 +1,231 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#ifndef _CnineBatchedFindPlantedSubgraphs
+#define _CnineBatchedFindPlantedSubgraphs
+
+#include <mutex>
+
+#include "Cnine_base.hpp"
+#include "FindPlantedSubgraphs.hpp"
+#include "TensorPackDir.hpp"
+#include "ParallelFor.hpp"
+#include "CnineProfiler.hpp"
+
+
+// FindPlantedSubgraphs applied to each graph of a batch with the same pattern graph H. The graphs
+// are processed in parallel and the matches are concatenated into a single tensor, the matches
+// in the i'th graph being rows offsets[i]..offsets[i+1]. Results are memoized in a process wide
+// cache keyed by the canonical hashes of the frozen G and H (and the traversal of H that fixes
+// the column order), so graphs that recur across batches only cost a lookup. Entries store a copy
+// of G and H and are only used if both compare equal.
+
+namespace cnine{
+
+
+  // A pattern graph together with the traversal that fixes the order of the columns of the output
+  template<typename LABEL=int>
+  class PlantedSubgraphPattern{
+  public:
+
+    typedef frozen_graph<float,LABEL> Frozen;
+
+    Frozen H;
+    vector<pair<int,int> > traversal;
+    size_t hash;
+
+    PlantedSubgraphPattern(const Frozen& _H, const vector<pair<int,int> >& _traversal):
+      H(_H), traversal(_traversal){
+      hash=H.hash();
+      for(auto& p:traversal)
+	hash=(hash^(((size_t)p.first<<32)^(p.second+1)))*0x9E3779B97F4A7C15ull;
+    }
+
+    bool operator==(const PlantedSubgraphPattern& x) const{
+      return hash==x.hash && traversal==x.traversal && H==x.H;
+    }
+
+  };
+
+
+  template<typename LABEL=int>
+  class FindPlantedSubgraphsCache{
+  public:
+
+    typedef frozen_graph<float,LABEL> Frozen;
+    typedef PlantedSubgraphPattern<LABEL> Pattern;
+
+    static constexpr int max_entries=1<<16;
+
+    class Entry{
+    public:
+      Frozen G;
+      shared_ptr<const Pattern> P;
+      shared_ptr<const Tensor<int> > matches;
+    };
+
+    std::mutex mx;
+    unordered_map<size_t,Entry> entries;
+    size_t nhits=0;
+    size_t nmisses=0;
+
+
+    // Matches of the pattern in G, computed on a miss
+    shared_ptr<const Tensor<int> > operator()(const Frozen& G, const shared_ptr<const Pattern>& P){
+      const size_t key=(G.hash()*0x9E3779B97F4A7C15ull)^P->hash;
+      {
+	std::lock_guard<std::mutex> lock(mx);
+	auto it=entries.find(key);
+	if(it!=entries.end() && (it->second.P==P || *it->second.P==*P) && it->second.G==G){
+	  nhits++;
+	  return it->second.matches;
+	}
+	nmisses++;
+      }
+
+      auto R=make_shared<const Tensor<int> >(FindPlantedSubgraphs<LABEL>(G,P->H,P->traversal).matches);
+
+      std::lock_guard<std::mutex> lock(mx);
+      if(entries.size()>=max_entries) entries.clear();
+      auto& e=entries[key];
+      e.G=G;
+      e.P=P;
+      e.matches=R;
+      return R;
+    }
+
+    void clear(){
+      std::lock_guard<std::mutex> lock(mx);
+      entries.clear();
+      nhits=0;
+      nmisses=0;
+    }
+
+    int size(){
+      std::lock_guard<std::mutex> lock(mx);
+      return entries.size();
+    }
+
+  };
+
+  template<typename LABEL=int>
+  inline FindPlantedSubgraphsCache<LABEL>& find_planted_subgraphs_cache(){
+    static FindPlantedSubgraphsCache<LABEL> cache;
+    return cache;
+  }
+
+
+  template<typename LABEL=int>
+  class BatchedFindPlantedSubgraphs{
+  public:
+
+    typedef sparse_graph<int,float,LABEL> Graph;
+    typedef frozen_graph<float,LABEL> Frozen;
+    typedef PlantedSubgraphPattern<LABEL> Pattern;
+
+    int n=0; // number of vertices of H
+    Tensor<int> matches;
+    vector<int> offsets;
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    // Same output as FindPlantedSubgraphs(Gs[i],H) for each i
+    BatchedFindPlantedSubgraphs(const vector<Graph>& Gs, const Graph& H, const bool use_cache=true):
+      n(H.getn()){
+      CNINE_PROFILE("BatchedFindPlantedSubgraphs");
+      auto P=make_shared<const Pattern>(Frozen(H),H.greedy_spanning_tree().indexed_depth_first_traversal());
+      run(Gs.size(),[&](const int i){return Frozen(Gs[i]);},P,use_cache);
+    }
+
+    // Same output as FindPlantedSubgraphs(Gs[i],H) for each i
+    BatchedFindPlantedSubgraphs(const vector<Frozen>& Gs, const Frozen& H, const bool use_cache=true):
+      n(H.getn()){
+      CNINE_PROFILE("BatchedFindPlantedSubgraphs");
+      auto P=make_shared<const Pattern>(H,FindPlantedSubgraphs<LABEL>::traversal(H));
+      run(Gs.size(),[&](const int i)->const Frozen&{return Gs[i];},P,use_cache);
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    int size() const{
+      return offsets.size()-1;
+    }
+
+    int nmatches() const{
+      return offsets.back();
+    }
+
+    int nmatches(const int i) const{
+      CNINE_ASSRT(i<size());
+      return offsets[i+1]-offsets[i];
+    }
+
+    // The matches in the i'th graph
+    Tensor<int> operator()(const int i) const{
+      CNINE_ASSRT(i<size());
+      Tensor<int> R(Gdims(nmatches(i),n));
+      std::copy(matches.mem()+offsets[i]*n,matches.mem()+offsets[i+1]*n,R.mem());
+      return R;
+    }
+
+    // Dimensions and offsets of the per graph match tensors within matches
+    TensorPackDir dir() const{
+      vector<Gdims> dims;
+      for(int i=0; i<size(); i++)
+	dims.push_back(Gdims(nmatches(i),n));
+      return TensorPackDir(dims);
+    }
+
+    operator Tensor<int>() const{
+      return matches;
+    }
+
+
+  private:
+
+
+    template<typename FREEZE>
+    void run(const int N, FREEZE&& freeze, const shared_ptr<const Pattern>& P, const bool use_cache){
+      auto& cache=find_planted_subgraphs_cache<LABEL>();
+      vector<shared_ptr<const Tensor<int> > > results(N);
+
+      // Nested parallel_for calls within FindPlantedSubgraphs run serially
+      parallel_for(N,[&](const size_t beg, const size_t end){
+	  for(size_t i=beg; i<end; i++){
+	    decltype(auto) G=freeze(i);
+	    if(use_cache) results[i]=cache(G,P);
+	    else results[i]=make_shared<const Tensor<int> >(FindPlantedSubgraphs<LABEL>(G,P->H,P->traversal).matches);
+	  }
+	},1);
+
+      offsets.assign(N+1,0);
+      for(int i=0; i<N; i++)
+	offsets[i+1]=offsets[i]+results[i]->dim(0);
+
+      matches=Tensor<int>(Gdims(offsets[N],n));
+      int* arr=matches.mem();
+      parallel_for(N,[&](const size_t beg, const size_t end){
+	  for(size_t i=beg; i<end; i++)
+	    std::copy(results[i]->mem(),results[i]->mem()+results[i]->dim(0)*n,arr+offsets[i]*n);
+	});
+    }
+
+  };
+
+}
+
+#endif
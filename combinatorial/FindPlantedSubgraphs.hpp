@@ -1,13 +1,13 @@
 /*
- * This file is part of cnine, a lightweight C++ tensor library. 
- *  
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
  * Copyright (c) 2023, Imre Risi Kondor
  *
- * This source code file is subject to the terms of the noncommercial 
- * license distributed with cnine in the file LICENSE.TXT. Commercial 
- * use is prohibited. All redistributed versions of this file (in 
- * original or modified form) must retain this copyright notice and 
- * must be accompanied by a verbatim copy of the license. 
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
  *
  */
 
@@ -16,11 +16,25 @@
 
 #include "Cnine_base.hpp"
 #include "sparse_graph.hpp"
+#include "frozen_graph.hpp"
 #include "labeled_tree.hpp"
-#include "labeled_forest.hpp"
 #include "Tensor.hpp"
-#include "flog.hpp"
-
+#include "ParallelFor.hpp"
+#include "CnineProfiler.hpp"
+
+
+// Find every induced copy of the pattern graph H in G. Each copy is reported once, in the form of
+// the vertices of G that the vertices of H are mapped to, listed in the depth first order of
+// H's greedy spanning tree. The search runs on frozen_graph snapshots of G and H, which are made
+// on the fly if sparse_graphs are passed.
+//
+// The search first computes, for each vertex of H, the set of vertices of G that it could be
+// mapped to, based on labels, degrees and the labels of neighbors. The vertices of H are then
+// matched in order of decreasing constraint strength, each new vertex being chosen among the
+// neighbors of an already matched one. Symmetry breaking conditions derived from the
+// automorphisms of H ensure that each copy is only generated once, and the root candidates are
+// distributed over threads. With CNINE_RANGE_CHECKING it is verified that no two matches consist
+// of the same set of vertices.
 
 namespace cnine{
 
@@ -30,50 +44,65 @@ namespace cnine{
   public:
 
     typedef sparse_graph<int,float,LABEL> Graph;
+    typedef frozen_graph<float,LABEL> Frozen;
+
+  private:
+
+    shared_ptr<const Frozen> Gf;
+    shared_ptr<const Frozen> Hf;
+
+  public:
 
-    const Graph& G;
-    const Graph& H;
+    const Frozen& G;
+    const Frozen& H;
     int n;
     vector<pair<int,int> > Htraversal;
-    vector<int> assignment;
-    labeled_forest<int> matches;
+    Tensor<int> matches;
 
 
   public:
 
 
     FindPlantedSubgraphs(const Graph& _G, const Graph& _H):
-      G(_G), H(_H), n(_H.getn()){
-      labeled_tree<int> S=H.greedy_spanning_tree();
-      Htraversal=S.indexed_depth_first_traversal();
-      assignment=vector<int>(n,-1);
-
-      for(int i=0; i<G.getn(); i++){
-	labeled_tree<int>* T=new labeled_tree<int>(i);
-	matches.push_back(T);
-	if(!make_subtree(*T,0)){
-	  delete T;
-	  matches.pop_back();
-	}
+      Gf(new Frozen(_G)), Hf(new Frozen(_H)), G(*Gf), H(*Hf), n(_H.getn()){
+      CNINE_PROFILE("FindPlantedSubgraphs");
+      if(n>0){
+	labeled_tree<int> S=_H.greedy_spanning_tree();
+	Htraversal=S.indexed_depth_first_traversal();
       }
+      search();
+    }
+
+    FindPlantedSubgraphs(const Frozen& _G, const Frozen& _H):
+      FindPlantedSubgraphs(_G,_H,traversal(_H)){}
+
+    // Output the matched vertices in the order of the given traversal of H
+    FindPlantedSubgraphs(const Frozen& _G, const Frozen& _H, const vector<pair<int,int> >& _Htraversal):
+      G(_G), H(_H), n(_H.getn()), Htraversal(_Htraversal){
+      CNINE_PROFILE("FindPlantedSubgraphs");
+      search();
     }
 
     int nmatches() const{
-      int t=0;
-      for(auto p:matches)
-	p->for_each_maximal_path([&](const vector<int>& x){t++;});
-      return t;
+      return matches.dim(0);
     }
 
 
     operator cnine::Tensor<int>(){
-      int N=nmatches();
-      cnine::Tensor<int> R(cnine::Gdims(N,n));
-      int t=0;
-      for(auto p:matches)
-	p->for_each_maximal_path([&](const vector<int>& x){
-	    for(int i=0; i<n; i++) R.set(t,i,x[i]);
-	    t++;});
+      return matches;
+    }
+
+
+    // Same traversal as the depth first traversal of sparse_graph::greedy_spanning_tree(), so the
+    // sparse and the frozen constructors order the columns of the matches the same way
+    static vector<pair<int,int> > traversal(const Frozen& H){
+      vector<pair<int,int> > R;
+      vector<bool> matched(H.getn(),false);
+      if(H.getn()>0){
+	matched[0]=true;
+	R.push_back(make_pair(0,-1));
+	spanning_traversal(H,0,matched,R);
+      }
       return R;
     }
 
@@ -81,59 +110,278 @@ namespace cnine{
   private:
 
 
-    bool make_subtree(labeled_tree<int>& node, const int m){
+    static void spanning_traversal(const Frozen& H, const int v, vector<bool>& matched, vector<pair<int,int> >& R){
+      const int ix=R.size()-1;
+      for(int a=H.offs[v]; a<H.offs[v+1]; a++){
+	const int w=H.nbrs[a];
+	if(matched[w]) continue;
+	matched[w]=true;
+	R.push_back(make_pair(w,ix));
+	spanning_traversal(H,w,matched,R);
+      }
+    }
+
+
+    void search(){
+      CNINE_ASSRT(Htraversal.size()==n);
+      if(n==0){ // an empty pattern has no matches
+	matches=Tensor<int>(Gdims(0,0));
+	return;
+      }
+      make_candidates();
+      make_order();
+      make_symmetry_breaking();
+
+      // Search from each root candidate in parallel. The chunking of parallel_for only depends on
+      // the number of roots, so concatenating the per chunk results preserves the root order.
+      vector<int> roots;
+      for(int w=0; w<G.n; w++)
+	if(candidate(order[0],w)) roots.push_back(w);
+      const size_t grain=16;
+      vector<vector<int> > found(parallel_nchunks(roots.size(),grain));
+      parallel_for(roots.size(),[&](const size_t beg, const size_t end){
+	  static thread_local vector<uint64_t> mask;
+	  if(mask.size()<NG) mask.assign(NG,0);
+	  vector<int> image(n,-1);
+	  auto& out=found[beg/grain];
+	  for(size_t i=beg; i<end; i++){
+	    image[0]=roots[i];
+	    set_mask(mask.data(),roots[i],0);
+	    extend(image,1,mask.data(),out);
+	    clear_mask(mask.data(),roots[i],0);
+	  }
+	},grain);
+
+      vector<int> all;
+      for(auto& p:found)
+	all.insert(all.end(),p.begin(),p.end());
+#ifdef CNINE_RANGE_CHECKING
+      check_no_duplicates(all);
+#endif
+
+      const int N=all.size()/std::max(n,1);
+      matches=Tensor<int>(Gdims(N,n));
+      std::copy(all.begin(),all.end(),matches.mem());
+    }
+
+
+    int NG=0;
+    vector<char> cand; // cand[v*NG+w] is true if vertex v of H can be mapped to vertex w of G
+
+    vector<int> order; // the vertices of H in the order they are matched
+    vector<vector<int> > parents; // earlier positions in the order that are neighbors in H
+    vector<uint64_t> hmask; // hmask[m] has bit p set if order[p] and order[m] are neighbors in H
+    vector<vector<pair<int,bool> > > broken; // (p,true): image of m must be less than that of p
+    bool weighted=false;
+    vector<int> column; // column[i] is the position of the i'th output column in the order
 
-      CNINE_ASSRT(m<Htraversal.size());
-      const int v=Htraversal[m].first;
-      const int w=node.label;
 
-      if(G.is_labeled() && H.is_labeled() && (G.labels(w)!=H.labels(v))) return false;
-      if(H.with_degrees() && (H.degrees(v)>=0) && (G.data[w].size()!=H.degrees(v))) return false;
+    bool candidate(const int v, const int w) const{
+      return cand[v*NG+w];
+    }
+
+    void make_candidates(){
+      NG=G.n;
+      cand.assign(n*NG,0);
+      const bool labeled=G.is_labeled() && H.is_labeled();
+
+      vector<int> hdegree(n,0);
+      vector<vector<LABEL> > hsignature(n);
+      for(int v=0; v<n; v++){
+	hdegree[v]=H.degree(v);
+	if(labeled)
+	  for(int j=H.offs[v]; j<H.offs[v+1]; j++)
+	    hsignature[v].push_back(H.labels[H.nbrs[j]]);
+	std::sort(hsignature[v].begin(),hsignature[v].end());
+      }
 
-      for(auto& p:const_cast<Graph&>(H).data[v]){ // improve syntax
-	if(assignment[p.first]==-1) continue;
-	if(p.second!=G(w,assignment[p.first])){
-	  return false;
+      parallel_for(NG,[&](const size_t beg, const size_t end){
+	  vector<LABEL> signature;
+	  for(size_t w=beg; w<end; w++){
+	    const int d=G.degree(w);
+	    if(labeled){
+	      signature.clear();
+	      for(int j=G.offs[w]; j<G.offs[w+1]; j++)
+		signature.push_back(G.labels[G.nbrs[j]]);
+	      std::sort(signature.begin(),signature.end());
+	    }
+	    for(int v=0; v<n; v++){
+	      if(d<hdegree[v]) continue;
+	      if(H.with_degrees() && H.degrees[v]>=0 && d!=H.degrees[v]) continue;
+	      if(labeled){
+		if(G.labels[w]!=H.labels[v]) continue;
+		if(!std::includes(signature.begin(),signature.end(),hsignature[v].begin(),hsignature[v].end())) continue;
+	      }
+	      cand[v*NG+w]=1;
+	    }
+	  }
+	});
+    }
+
+    // Start with the most constrained vertex of H and always continue with the vertex that has the
+    // most already ordered neighbors, breaking ties by the number of candidates and the degree
+    void make_order(){
+      vector<int> ncand(n,0);
+      for(int v=0; v<n; v++)
+	for(int w=0; w<NG; w++)
+	  ncand[v]+=cand[v*NG+w];
+      vector<int> pos(n,-1);
+      vector<int> nordered(n,0);
+
+      for(int m=0; m<n; m++){
+	int best=-1;
+	for(int v=0; v<n; v++){
+	  if(pos[v]>=0 || (m>0 && nordered[v]==0)) continue;
+	  if(best<0 || std::make_tuple(nordered[v],-ncand[v],H.degree(v))>
+	    std::make_tuple(nordered[best],-ncand[best],H.degree(best))) best=v;
 	}
+	CNINE_ASSRT(best>=0); // H must be connected
+	pos[best]=m;
+	order.push_back(best);
+	for(int j=H.offs[best]; j<H.offs[best+1]; j++)
+	  nordered[H.nbrs[j]]++;
       }
 
+      CNINE_ASSRT(n<=64);
+      parents.resize(n);
+      hmask.assign(n,0);
+      for(int m=1; m<n; m++)
+	for(int p=0; p<m; p++)
+	  if(H(order[m],order[p])!=0){
+	    parents[m].push_back(p);
+	    hmask[m]|=1ull<<p;
+	  }
+      weighted=!G.is_unweighted() || !H.is_unweighted();
+
+      for(auto& p:Htraversal)
+	column.push_back(pos[p.first]);
+    }
+
 
-      for(auto& p:const_cast<Graph&>(G).data[w]){
-	auto it=std::find(assignment.begin(),assignment.end(),p.first);
-	if(it==assignment.end()) continue;
-	if(p.second!=H(v,it-assignment.begin())){
-	  return false;
+    // Symmetry breaking in the style of Grochow and Kellis: going through the vertices of H in
+    // search order, each vertex v must have a smaller image than every other vertex in its orbit
+    // under the automorphisms that fix the vertices before it.
+    void make_symmetry_breaking(){
+      broken.resize(n);
+      vector<int> pos(n);
+      for(int m=0; m<n; m++) pos[order[m]]=m;
+      vector<int> fixed;
+      for(int m=0; m<n; m++){
+	const int v=order[m];
+	for(int u=0; u<n; u++){
+	  if(u==v || !automorphism_exists(fixed,v,u)) continue;
+	  const int q=pos[u];
+	  if(q>m) broken[q].push_back(make_pair(m,false));
+	  else broken[m].push_back(make_pair(q,true));
 	}
+	fixed.push_back(v);
       }
+    }
 
-      assignment[v]=w;
-      //cout<<string(m,' ')<<"matched "<<v<<" to "<<w<<endl;
-      if(m==n-1){
-	node.label=-1;
-	//cout<<string(m,' ')<<"assignment ";
-	//for(auto p:assignment)cout<<p; cout<<endl;
-	bool is_duplicate=matches.contains_rooted_path_consisting_of(assignment);
-	node.label=w;
-	assignment[v]=-1;
-	//cout<<string(m,' ')<<"duplicate="<<is_duplicate<<endl;
-	return !is_duplicate;
+    // Is there an automorphism of H that fixes each vertex in fixed and maps v to u?
+    bool automorphism_exists(const vector<int>& fixed, const int v, const int u) const{
+      vector<int> sigma(n,-1);
+      vector<bool> used(n,false);
+      for(auto p:fixed){
+	sigma[p]=p;
+	used[p]=true;
       }
+      if(used[u]) return false;
+      sigma[v]=u;
+      used[u]=true;
+      for(int i=0; i<n; i++)
+	if(sigma[i]>=0 && !compatible(sigma,i,sigma[i])) return false;
+      return extend_automorphism(sigma,used,0);
+    }
 
-      // try to match next vertex in Htraversal to each neighbor of newparent  
-      const int newparent=assignment[Htraversal[Htraversal[m+1].second].first];
-      //cout<<string(m,' ')<<"newparent="<<newparent<<endl;
-      for(auto& w:G.neighbors(newparent)){
-	if(std::find(assignment.begin(),assignment.end(),w)!=assignment.end()) continue;
-	labeled_tree<int>* T=new labeled_tree<int>(w);
-	node.push_back(T);
-	if(!make_subtree(*T,m+1)){
-	  delete T;
-	  node.children.pop_back();
-	}
+    bool extend_automorphism(vector<int>& sigma, vector<bool>& used, int i) const{
+      while(i<n && sigma[i]>=0) i++;
+      if(i==n) return true;
+      for(int j=0; j<n; j++){
+	if(used[j] || !compatible(sigma,i,j)) continue;
+	sigma[i]=j;
+	used[j]=true;
+	if(extend_automorphism(sigma,used,i+1)) return true;
+	sigma[i]=-1;
+	used[j]=false;
+      }
+      return false;
+    }
+
+    // Can i be mapped to j given the rest of the partial map sigma?
+    bool compatible(const vector<int>& sigma, const int i, const int j) const{
+      if(H.is_labeled() && H.labels[i]!=H.labels[j]) return false;
+      if(H.with_degrees() && H.degrees[i]!=H.degrees[j]) return false;
+      if(H.degree(i)!=H.degree(j)) return false;
+      for(int k=0; k<n; k++)
+	if(k!=i && sigma[k]>=0 && H(i,k)!=H(j,sigma[k])) return false;
+      return true;
+    }
+
+
+    // Record in the neighbors of w that w is the image of position m, or remove the record
+    void set_mask(uint64_t* mask, const int w, const int m) const{
+      for(int j=G.offs[w]; j<G.offs[w+1]; j++)
+	mask[G.nbrs[j]]|=1ull<<m;
+    }
+
+    void clear_mask(uint64_t* mask, const int w, const int m) const{
+      for(int j=G.offs[w]; j<G.offs[w+1]; j++)
+	mask[G.nbrs[j]]&=~(1ull<<m);
+    }
+
+
+    // Try every way of mapping order[m] to a vertex of G given the images of order[0..m-1].
+    // Bit p of mask[w] is set if w is a neighbor of the image of position p.
+    void extend(vector<int>& image, const int m, uint64_t* mask, vector<int>& out) const{
+      if(m==n){
+	for(auto p:column)
+	  out.push_back(image[p]);
+	return;
+      }
+
+      // walk the neighbors of the matched parent with the fewest neighbors
+      int parent=image[parents[m][0]];
+      for(auto p:parents[m])
+	if(G.degree(image[p])<G.degree(parent)) parent=image[p];
+
+      const int v=order[m];
+      const uint64_t below=(1ull<<m)-1;
+      for(int j=G.offs[parent]; j<G.offs[parent+1]; j++){
+	const int w=G.nbrs[j];
+	if((mask[w]&below)!=hmask[m] || !candidate(v,w)) continue;
+	bool ok=true;
+	for(int p=0; p<m && ok; p++)
+	  if(image[p]==w) ok=false;
+	for(auto& p:broken[m])
+	  if(ok && (w<image[p.first])!=p.second) ok=false;
+	if(ok && weighted)
+	  for(auto p:parents[m])
+	    if(G(w,image[p])!=H(v,order[p])){
+	      ok=false;
+	      break;
+	    }
+	if(!ok) continue;
+	image[m]=w;
+	if(m<n-1) set_mask(mask,w,m);
+	extend(image,m+1,mask,out);
+	if(m<n-1) clear_mask(mask,w,m);
       }
+      image[m]=-1;
+    }
+
 
-      assignment[v]=-1;
-      return node.children.size()>0;
+    // Symmetry breaking should generate each copy of H exactly once
+    void check_no_duplicates(const vector<int>& all) const{
+      const int N=all.size()/std::max(n,1);
+      vector<vector<int> > sets(N);
+      for(int i=0; i<N; i++){
+	sets[i].assign(all.begin()+i*n,all.begin()+(i+1)*n);
+	std::sort(sets[i].begin(),sets[i].end());
+      }
+      std::sort(sets.begin(),sets.end());
+      if(std::adjacent_find(sets.begin(),sets.end())!=sets.end())
+	CNINE_ERROR("the same copy of H was found twice");
     }
 
   };
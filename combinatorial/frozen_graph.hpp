@@ -0,0 +1,307 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#ifndef _CnineFrozenGraph
+#define _CnineFrozenGraph
+
+#include "Cnine_base.hpp"
+#include "sparse_graph.hpp"
+#include "GatherMapB.hpp"
+#include "WeightedGatherMapB.hpp"
+#include "ParallelFor.hpp"
+#include "CnineProfiler.hpp"
+
+
+namespace cnine{
+
+  // Immutable compressed sparse row snapshot of a sparse_graph. The neighbors of vertex i are
+  // nbrs[offs[i]..offs[i+1]), sorted, with the corresponding edge weights in weights. Entries of
+  // weight zero are dropped.
+
+  template<typename TYPE=float, typename LABEL=int>
+  class frozen_graph{
+  public:
+
+    int n=0;
+    vector<int> offs;
+    vector<int> nbrs;
+    vector<TYPE> weights;
+
+    vector<LABEL> labels; // empty if the graph is not labeled
+    vector<int> degrees; // degree constraints of a pattern graph, empty if none
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    frozen_graph(){}
+
+    // O(E) and parallel over vertices
+    template<typename KEY>
+    frozen_graph(const sparse_graph<KEY,TYPE,LABEL>& x):
+      n(x.getn()), offs(x.getn()+1,0){
+      CNINE_PROFILE("frozen_graph::frozen_graph(const sparse_graph&)");
+
+      // Sizes first, using the sizes of the rows of the hash map as upper bounds
+      typedef std::unordered_map<KEY,TYPE> ROW;
+      vector<const ROW*> rows(n,nullptr);
+      for(int i=0; i<n; i++){
+	auto it=x.data.find(i);
+	if(it!=x.data.end()) rows[i]=&it->second;
+	offs[i+1]=offs[i]+(rows[i]?rows[i]->size():0);
+      }
+
+      nbrs.resize(offs[n]);
+      weights.resize(offs[n]);
+      vector<int> d(n,0);
+      parallel_for(n,[&](const size_t beg, const size_t end){
+	  vector<pair<int,TYPE> > v;
+	  for(size_t i=beg; i<end; i++){
+	    if(!rows[i]) continue;
+	    v.clear();
+	    for(auto& p:*rows[i])
+	      if(p.second!=0) v.push_back(make_pair(p.first,p.second));
+	    std::sort(v.begin(),v.end());
+	    for(int j=0; j<v.size(); j++){
+	      nbrs[offs[i]+j]=v[j].first;
+	      weights[offs[i]+j]=v[j].second;
+	    }
+	    d[i]=v.size();
+	  }
+	});
+
+      // Squeeze out the space of zero weight entries
+      bool compact=true;
+      for(int i=0; i<n; i++)
+	if(d[i]!=offs[i+1]-offs[i]) compact=false;
+      if(!compact){
+	int t=0;
+	for(int i=0; i<n; i++){
+	  std::copy(nbrs.begin()+offs[i],nbrs.begin()+offs[i]+d[i],nbrs.begin()+t);
+	  std::copy(weights.begin()+offs[i],weights.begin()+offs[i]+d[i],weights.begin()+t);
+	  offs[i]=t;
+	  t+=d[i];
+	}
+	offs[n]=t;
+	nbrs.resize(t);
+	weights.resize(t);
+      }
+
+      if(x.is_labeled()){
+	labels.resize(n);
+	for(int i=0; i<n; i++)
+	  labels[i]=x.labels(i);
+      }
+      if(x.with_degrees()){
+	degrees.resize(n);
+	for(int i=0; i<n; i++)
+	  degrees[i]=x.degrees(i);
+      }
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    int getn() const{
+      return n;
+    }
+
+    int nedges() const{
+      return offs[n]/2;
+    }
+
+    bool is_labeled() const{
+      return labels.size()>0;
+    }
+
+    bool with_degrees() const{
+      return degrees.size()>0;
+    }
+
+    bool is_unweighted() const{
+      for(auto p:weights)
+	if(p!=1) return false;
+      return true;
+    }
+
+    int degree(const int i) const{
+      return offs[i+1]-offs[i];
+    }
+
+    int nneighbors(const int i) const{
+      return offs[i+1]-offs[i];
+    }
+
+    const int* neighbors_begin(const int i) const{
+      return nbrs.data()+offs[i];
+    }
+
+    const int* neighbors_end(const int i) const{
+      return nbrs.data()+offs[i+1];
+    }
+
+    vector<int> neighbors(const int i) const{
+      return vector<int>(neighbors_begin(i),neighbors_end(i));
+    }
+
+    // Position of j in the neighbor list of i, or -1
+    int find(const int i, const int j) const{
+      auto it=std::lower_bound(neighbors_begin(i),neighbors_end(i),j);
+      if(it==neighbors_end(i) || *it!=j) return -1;
+      return it-nbrs.data();
+    }
+
+    bool is_neighbor(const int i, const int j) const{
+      return find(i,j)>=0;
+    }
+
+    TYPE operator()(const int i, const int j) const{
+      const int a=find(i,j);
+      if(a<0) return TYPE();
+      return weights[a];
+    }
+
+
+    bool operator==(const frozen_graph& x) const{
+      return n==x.n && offs==x.offs && nbrs==x.nbrs && weights==x.weights &&
+	labels==x.labels && degrees==x.degrees;
+    }
+
+    bool operator!=(const frozen_graph& x) const{
+      return !(*this==x);
+    }
+
+    // Since the neighbor lists are sorted, equal graphs hash to the same value irrespective of the
+    // order in which their edges were inserted into the original sparse_graph
+    size_t hash() const{
+      size_t h=0x9E3779B97F4A7C15ull^n;
+      auto mix=[&](const size_t x){
+	h=(h^x)*0x9E3779B97F4A7C15ull;
+	h^=h>>29;};
+      for(int i=0; i<n; i++){
+	mix(offs[i+1]);
+	if(is_labeled()) mix(std::hash<LABEL>()(labels[i]));
+	if(with_degrees()) mix(degrees[i]+1);
+      }
+      for(int a=0; a<offs[n]; a++){
+	mix(nbrs[a]);
+	mix(std::hash<TYPE>()(weights[a]));
+      }
+      return h;
+    }
+
+
+  public: // ---- Lambdas ------------------------------------------------------------------------------------
+
+
+    template<typename FN>
+    void for_each_neighbor(const int i, FN&& lambda) const{
+      for(int a=offs[i]; a<offs[i+1]; a++)
+	lambda(nbrs[a],weights[a]);
+    }
+
+    template<typename FN>
+    void for_each_edge(FN&& lambda) const{
+      for(int i=0; i<n; i++)
+	for(int a=offs[i]; a<offs[i+1]; a++)
+	  if(i<=nbrs[a]) lambda(i,nbrs[a],weights[a]);
+    }
+
+
+  public: // ---- Conversions --------------------------------------------------------------------------------
+
+
+    // Each vertex gathers from its neighbors
+    GatherMapB gather_map() const{
+      CNINE_PROFILE("frozen_graph::gather_map()");
+      vector<int> heads;
+      vector<int> lengths;
+      for(int i=0; i<n; i++)
+	if(degree(i)>0){
+	  heads.push_back(i);
+	  lengths.push_back(degree(i));
+	}
+      GatherMapB R(n);
+      R.arr=hlists<int>(heads,lengths);
+      parallel_for(heads.size(),[&](const size_t beg, const size_t end){
+	  for(size_t h=beg; h<end; h++)
+	    for(int a=offs[heads[h]]; a<offs[heads[h]+1]; a++)
+	      R.arr.push_back(h,nbrs[a]);
+	});
+      return R;
+    }
+
+    // Same, with each neighbor weighted by the weight of the edge
+    WeightedGatherMapB weighted_gather_map() const{
+      CNINE_PROFILE("frozen_graph::weighted_gather_map()");
+      vector<int> heads;
+      vector<int> lengths;
+      for(int i=0; i<n; i++)
+	if(degree(i)>0){
+	  heads.push_back(i);
+	  lengths.push_back(2*degree(i));
+	}
+      WeightedGatherMapB R(n);
+      R.arr=hlists<int>(heads,lengths);
+      parallel_for(heads.size(),[&](const size_t beg, const size_t end){
+	  for(size_t h=beg; h<end; h++)
+	    for(int a=offs[heads[h]]; a<offs[heads[h]+1]; a++)
+	      R.push_back(h,nbrs[a],(float)weights[a]);
+	});
+      return R;
+    }
+
+
+  public: // ---- I/O -----------------------------------------------------------------------------------------
+
+
+    string classname() const{
+      return "frozen_graph";
+    }
+
+    string str(const string indent="") const{
+      ostringstream oss;
+      oss<<indent<<"Frozen graph with "<<n<<" vertices and "<<nedges()<<" edges:"<<endl;
+      for(int i=0; i<n; i++){
+	oss<<indent<<"  "<<i;
+	if(is_labeled()) oss<<"["<<labels[i]<<"]";
+	oss<<":";
+	for_each_neighbor(i,[&](const int j, const TYPE w){
+	    oss<<" "<<j;
+	    if(w!=1) oss<<"("<<w<<")";});
+	oss<<endl;
+      }
+      return oss.str();
+    }
+
+    friend ostream& operator<<(ostream& stream, const frozen_graph& x){
+      stream<<x.str(); return stream;}
+
+  };
+
+}
+
+
+namespace std{
+
+  template<typename TYPE, typename LABEL>
+  struct hash<cnine::frozen_graph<TYPE,LABEL> >{
+  public:
+    size_t operator()(const cnine::frozen_graph<TYPE,LABEL>& x) const{
+      return x.hash();
+    }
+  };
+}
+
+#endif
@@ -218,7 +218,9 @@ namespace cnine{
     }
 
     int nneighbors(const int i) const{
-      return data[i].size();
+      auto it=data.find(i);
+      if(it==data.end()) return 0;
+      return it->second.size();
     }
 
     bool is_neighbor(const KEY& i, const KEY& j) const{
@@ -246,8 +248,9 @@ namespace cnine{
 
     vector<int> neighbors(const int i) const{
       vector<int> r;
-      const auto _r=data[i];
-      for(auto& p: _r)
+      auto it=data.find(i);
+      if(it==data.end()) return r;
+      for(auto& p: it->second)
 	r.push_back(p.first);
       return r;
     }
@@ -286,31 +289,45 @@ namespace cnine{
   public: // ---- Subgraphs ----------------------------------------------------------------------------------
 
 
+    // Depth first spanning tree. A vertex is claimed when the search reaches it and the neighbors
+    // of each vertex are tried in increasing order, so the tree does not depend on the hash order.
     labeled_tree<KEY> greedy_spanning_tree(const KEY root=0) const{
       //CNINE_ASSRT(root<n);
       labeled_tree<KEY> r(root);
       vector<bool> matched(n,false);
       matched[root]=true;
-      for(auto& p: BASE::data[root]){
-	if(!p.second) continue;
-	if(matched[p.first]) continue;
-	matched[p.first]=true;
-	r.children.push_back(greedy_spanning_tree(p.first,matched));
+      for(auto w: sorted_edge_targets(root)){
+	if(matched[w]) continue;
+	matched[w]=true;
+	r.children.push_back(greedy_spanning_tree(w,matched));
       }
       return r;
     }
 
     labeled_tree<KEY>* greedy_spanning_tree(const int v, vector<bool>& matched) const{
       labeled_tree<KEY>* r=new labeled_tree<KEY>(v);
-      for(auto& p: BASE::data[v]){
-	if(!p.second) continue;
-	if(matched[p.first]) continue;
-	matched[p.first]=true;
-	r->children.push_back(greedy_spanning_tree(p.first,matched));
+      for(auto w: sorted_edge_targets(v)){
+	if(matched[w]) continue;
+	matched[w]=true;
+	r->children.push_back(greedy_spanning_tree(w,matched));
       }
       return r;
     }
 
+  private:
+
+    vector<KEY> sorted_edge_targets(const KEY v) const{
+      vector<KEY> r;
+      auto it=BASE::data.find(v);
+      if(it==BASE::data.end()) return r;
+      for(auto& p: it->second)
+	if(p.second) r.push_back(p.first);
+      std::sort(r.begin(),r.end());
+      return r;
+    }
+
+  public:
+
 
     /*
     int_tree spanning_tree_as_int_tree(int root=0) const{
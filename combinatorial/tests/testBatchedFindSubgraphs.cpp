@@ -0,0 +1,66 @@
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "sparse_graph.hpp"
+#include "BatchedFindPlantedSubgraphs.hpp"
+
+using namespace cnine;
+
+typedef sparse_graph<int,float> Graph;
+
+
+bool same(const Tensor<int>& A, const Tensor<int>& B){
+  if(A.get_dims()!=B.get_dims()) return false;
+  return std::equal(A.mem(),A.mem()+A.asize(),B.mem());
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session(4);
+
+  // Two copies of the same graph with edges inserted in different orders
+  Graph G0(5,{{0,1},{1,2},{2,3},{3,0},{0,2},{3,4}});
+  Graph G1(5,{{3,4},{0,2},{3,0},{2,3},{1,2},{0,1}});
+  Graph triangle=Graph::cycle(3);
+
+  BatchedFindPlantedSubgraphs<> B({G0,G1,Graph::cycle(6)},triangle);
+  cout<<B.offsets<<endl;
+  cout<<B.matches<<endl;
+  cout<<B.dir()<<endl;
+
+  // A batch of small graphs with many repeats, processed twice
+  vector<Graph> pool;
+  for(int i=0; i<8; i++)
+    pool.push_back(Graph::random(12+i,0.3));
+  vector<Graph> batch;
+  for(int i=0; i<40; i++)
+    batch.push_back(pool[(i*5)%pool.size()]);
+
+  Graph H=Graph::cycle(4);
+  auto& cache=find_planted_subgraphs_cache<int>();
+  cache.clear();
+
+  for(int epoch=0; epoch<2; epoch++){
+    BatchedFindPlantedSubgraphs<> R(batch,H);
+    int errors=0;
+    for(int i=0; i<batch.size(); i++)
+      if(!same(R(i),FindPlantedSubgraphs<int>(batch[i],H).matches)) errors++;
+    cout<<"Epoch "<<epoch<<": "<<R.nmatches()<<" matches in "<<R.size()<<" graphs, errors: "<<errors;
+    cout<<", cache hits: "<<cache.nhits<<" misses: "<<cache.nmisses<<endl;
+  }
+
+  BatchedFindPlantedSubgraphs<> U(batch,H,false);
+  cout<<"Uncached: "<<U.nmatches()<<" matches"<<endl;
+
+  // Frozen inputs must give the same rows as the sparse ones
+  vector<frozen_graph<float> > fbatch;
+  for(auto& G:batch)
+    fbatch.push_back(frozen_graph<float>(G));
+  BatchedFindPlantedSubgraphs<> F(fbatch,frozen_graph<float>(H));
+  int ferrors=0;
+  for(int i=0; i<batch.size(); i++)
+    if(!same(F(i),U(i))) ferrors++;
+  CNINE_ASSRT(ferrors==0);
+  cout<<"Frozen: "<<F.nmatches()<<" matches, errors: "<<ferrors<<endl;
+
+}
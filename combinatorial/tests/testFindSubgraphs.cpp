@@ -4,6 +4,7 @@
 #include "sparse_graph.hpp"
 #include "FindPlantedSubgraphs.hpp"
 #include "FindPlantedSubgraphs2.hpp"
+#include "SortRowsUnique.hpp"
 
 using namespace cnine;
 
@@ -27,5 +28,39 @@ int main(int argc, char** argv){
 
   auto fd=FindPlantedSubgraphs2(Gd,Hd);
   cout<<fd.matches<<endl;
+
+  // Labeled pattern: only the second triangle has the right labels
+  Graph G3(6,{{0,1},{1,2},{2,0},{3,4},{4,5},{5,3},{2,3}});
+  Tensor<int> L3=Tensor<int>::zero({6});
+  L3.set(4,1);
+  G3.set_labels(L3);
+  Graph T3=Graph::triangle();
+  Tensor<int> LT=Tensor<int>::zero({3});
+  LT.set(0,1);
+  T3.set_labels(LT);
+  cout<<Tensor<int>(FindPlantedSubgraphs(G3,T3))<<endl;
+
+  // An empty pattern has no matches
+  Graph E(0);
+  cout<<"Empty pattern: "<<FindPlantedSubgraphs(G3,E).nmatches()<<" matches, frozen: "<<
+    FindPlantedSubgraphs(frozen_graph<float>(G3),frozen_graph<float>(E)).nmatches()<<" matches"<<endl;
+
+  // The two implementations must find the same vertex sets on a larger graph
+  Graph G2=Graph::random(150,0.05);
+  for(auto& P: {Graph::cycle(5),Graph::star(3),Graph::triangle()}){
+    Tensor<int> A=FindPlantedSubgraphs(G2,P);
+    int_pool Pd=P.as_int_pool();
+    auto B=FindPlantedSubgraphs2(G2.as_int_pool(),Pd);
+    for(int i=0; i<A.dim(0); i++){
+      vector<int> v(A.dim(1));
+      for(int j=0; j<v.size(); j++) v[j]=A(i,j);
+      std::sort(v.begin(),v.end());
+      for(int j=0; j<v.size(); j++) A.set(i,j,v[j]);
+    }
+    Tensor<int> Asorted=SortRowsUnique<int>(A);
+    Tensor<int> Bsorted=SortRowsUnique<int>(B.matches);
+    cout<<P.getn()<<" vertices: "<<A.dim(0)<<" matches, "<<Bsorted.dim(0)<<" reference, "<<
+      "same="<<(Asorted.dim(0)==A.dim(0) && Asorted==Bsorted)<<endl;
+  }
   
 }
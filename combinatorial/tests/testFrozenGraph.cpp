@@ -0,0 +1,63 @@
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "sparse_graph.hpp"
+#include "frozen_graph.hpp"
+#include "FindPlantedSubgraphs.hpp"
+
+using namespace cnine;
+
+typedef sparse_graph<int,float> Graph;
+
+
+// The rows of a match tensor in lexicographic order
+vector<vector<int> > sorted_rows(const Tensor<int>& A){
+  vector<vector<int> > R;
+  for(int i=0; i<A.dim(0); i++){
+    vector<int> row;
+    for(int j=0; j<A.dim(1); j++)
+      row.push_back(A(i,j));
+    R.push_back(row);
+  }
+  std::sort(R.begin(),R.end());
+  return R;
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session(4);
+
+  Graph G(5,{{0,1},{1,2},{2,3},{3,0},{0,2}});
+  G.set(3,4,2.0);
+  frozen_graph<float> F(G);
+  cout<<F<<endl;
+  cout<<F.gather_map()<<endl;
+  cout<<F.weighted_gather_map()<<endl;
+
+  // Neighbors, weights and matches must agree with the sparse_graph
+  Graph G2=Graph::random(300,0.03);
+  frozen_graph<float> F2(G2);
+  int errors=0;
+  for(int i=0; i<G2.getn(); i++){
+    auto v=G2.neighbors(i);
+    std::sort(v.begin(),v.end());
+    if(v!=F2.neighbors(i)) errors++;
+    for(auto j:v)
+      if(F2(i,j)!=G2(i,j)) errors++;
+  }
+  cout<<"Edges: "<<F2.nedges()<<"/"<<G2.nedges()<<" errors: "<<errors<<endl;
+
+  Graph H=Graph::cycle(5);
+  Tensor<int> A=FindPlantedSubgraphs(G2,H);
+  Tensor<int> B=FindPlantedSubgraphs(F2,frozen_graph<float>(H));
+  CNINE_ASSRT(sorted_rows(A)==sorted_rows(B));
+  cout<<"Matches: "<<A.dim(0)<<" "<<B.dim(0)<<" same rows: "<<(sorted_rows(A)==sorted_rows(B))<<endl;
+
+  // The columns must follow the same traversal of H in both constructors
+  Graph H2(4,{{0,1},{0,2},{1,2},{1,3}});
+  Tensor<int> C=FindPlantedSubgraphs(H2,H2);
+  Tensor<int> D=FindPlantedSubgraphs(frozen_graph<float>(H2),frozen_graph<float>(H2));
+  CNINE_ASSRT(sorted_rows(C)==sorted_rows(D));
+  cout<<C<<endl;
+
+}
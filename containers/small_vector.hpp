@@ -0,0 +1,296 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#ifndef _small_vector
+#define _small_vector
+
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+
+
+namespace cnine{
+
+  // Vector of trivially copyable elements that keeps up to N of them inline and only goes to the
+  // heap beyond that. Supports the parts of the std::vector interface that the index and
+  // dimension classes use, and converts to std::vector where one is required.
+
+  template<typename TYPE, int N>
+  class small_vector{
+  public:
+
+    static_assert(std::is_trivially_copyable<TYPE>::value,"small_vector requires trivially copyable elements");
+
+    typedef TYPE value_type;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef TYPE& reference;
+    typedef const TYPE& const_reference;
+    typedef TYPE* pointer;
+    typedef const TYPE* const_pointer;
+    typedef TYPE* iterator;
+    typedef const TYPE* const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+  private:
+
+    TYPE* arr;
+    size_type _size=0;
+    size_type _capacity=N;
+    TYPE buf[N];
+
+  public:
+
+    ~small_vector(){
+      if(arr!=buf) delete[] arr;
+    }
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    small_vector(): arr(buf){}
+
+    explicit small_vector(const size_type n): arr(buf){
+      resize(n);
+    }
+
+    small_vector(const size_type n, const TYPE& v): arr(buf){
+      resize(n,v);
+    }
+
+    small_vector(const std::initializer_list<TYPE>& x): arr(buf){
+      assign(x.begin(),x.end());
+    }
+
+    template<typename IT, typename=typename std::iterator_traits<IT>::iterator_category>
+    small_vector(IT first, IT last): arr(buf){
+      assign(first,last);
+    }
+
+    small_vector(const std::vector<TYPE>& x): arr(buf){
+      assign(x.begin(),x.end());
+    }
+
+
+  public: // ---- Copying ------------------------------------------------------------------------------------
+
+
+    small_vector(const small_vector& x): arr(buf){
+      assign(x.begin(),x.end());
+    }
+
+    small_vector(small_vector&& x): arr(buf){
+      take(x);
+    }
+
+    small_vector& operator=(const small_vector& x){
+      if(this!=&x) assign(x.begin(),x.end());
+      return *this;
+    }
+
+    small_vector& operator=(small_vector&& x){
+      if(this==&x) return *this;
+      if(arr!=buf) delete[] arr;
+      arr=buf;
+      _capacity=N;
+      take(x);
+      return *this;
+    }
+
+    operator std::vector<TYPE>() const{
+      return std::vector<TYPE>(begin(),end());
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    size_type size() const {return _size;}
+    size_type capacity() const {return _capacity;}
+    bool empty() const {return _size==0;}
+
+    TYPE* data() {return arr;}
+    const TYPE* data() const {return arr;}
+
+    TYPE& operator[](const size_type i) {return arr[i];}
+    const TYPE& operator[](const size_type i) const {return arr[i];}
+
+    TYPE& at(const size_type i){
+      if(i>=_size) throw std::out_of_range("small_vector::at");
+      return arr[i];
+    }
+
+    const TYPE& at(const size_type i) const{
+      if(i>=_size) throw std::out_of_range("small_vector::at");
+      return arr[i];
+    }
+
+    TYPE& front() {return arr[0];}
+    const TYPE& front() const {return arr[0];}
+    TYPE& back() {return arr[_size-1];}
+    const TYPE& back() const {return arr[_size-1];}
+
+    iterator begin() {return arr;}
+    iterator end() {return arr+_size;}
+    const_iterator begin() const {return arr;}
+    const_iterator end() const {return arr+_size;}
+    const_iterator cbegin() const {return arr;}
+    const_iterator cend() const {return arr+_size;}
+    reverse_iterator rbegin() {return reverse_iterator(end());}
+    reverse_iterator rend() {return reverse_iterator(begin());}
+    const_reverse_iterator rbegin() const {return const_reverse_iterator(end());}
+    const_reverse_iterator rend() const {return const_reverse_iterator(begin());}
+
+
+  public: // ---- Modifiers ----------------------------------------------------------------------------------
+
+
+    void reserve(const size_type n){
+      if(n<=_capacity) return;
+      TYPE* t=new TYPE[n];
+      if(_size>0) std::memcpy(t,arr,_size*sizeof(TYPE));
+      if(arr!=buf) delete[] arr;
+      arr=t;
+      _capacity=n;
+    }
+
+    void resize(const size_type n){
+      resize(n,TYPE());
+    }
+
+    void resize(const size_type n, const TYPE& v){
+      if(n>_capacity) reserve(std::max(n,2*_capacity));
+      for(size_type i=_size; i<n; i++) arr[i]=v;
+      _size=n;
+    }
+
+    void clear(){
+      _size=0;
+    }
+
+    void push_back(const TYPE& v){
+      if(_size==_capacity){
+	const TYPE t=v; // v might live in the current buffer
+	reserve(2*_capacity);
+	arr[_size++]=t;
+	return;
+      }
+      arr[_size++]=v;
+    }
+
+    template<typename... ARGS>
+    TYPE& emplace_back(ARGS&&... args){
+      push_back(TYPE(std::forward<ARGS>(args)...));
+      return back();
+    }
+
+    void pop_back(){
+      _size--;
+    }
+
+    template<typename IT>
+    void assign(IT first, IT last){
+      const size_type n=std::distance(first,last);
+      if(n>_capacity){
+	if(arr!=buf) delete[] arr;
+	arr=buf;
+	_capacity=N;
+	_size=0;
+	reserve(n);
+      }
+      std::copy(first,last,arr);
+      _size=n;
+    }
+
+    void assign(const size_type n, const TYPE& v){
+      _size=0;
+      resize(n,v);
+    }
+
+    iterator insert(const_iterator pos, const TYPE& v){
+      const size_type i=pos-arr;
+      const TYPE t=v;
+      if(_size==_capacity) reserve(2*_capacity);
+      std::memmove(arr+i+1,arr+i,(_size-i)*sizeof(TYPE));
+      arr[i]=t;
+      _size++;
+      return arr+i;
+    }
+
+    template<typename IT, typename=typename std::iterator_traits<IT>::iterator_category>
+    iterator insert(const_iterator pos, IT first, IT last){
+      const size_type i=pos-arr;
+      const small_vector t(first,last);
+      const size_type n=t.size();
+      if(_size+n>_capacity) reserve(std::max(_size+n,2*_capacity));
+      std::memmove(arr+i+n,arr+i,(_size-i)*sizeof(TYPE));
+      std::copy(t.begin(),t.end(),arr+i);
+      _size+=n;
+      return arr+i;
+    }
+
+    iterator erase(const_iterator pos){
+      return erase(pos,pos+1);
+    }
+
+    iterator erase(const_iterator first, const_iterator last){
+      const size_type i=first-arr;
+      const size_type n=last-first;
+      std::memmove(arr+i,arr+i+n,(_size-i-n)*sizeof(TYPE));
+      _size-=n;
+      return arr+i;
+    }
+
+
+  public: // ---- Comparisons --------------------------------------------------------------------------------
+
+
+    bool operator==(const small_vector& x) const{
+      return _size==x._size && std::equal(begin(),end(),x.begin());
+    }
+
+    bool operator!=(const small_vector& x) const{
+      return !(*this==x);
+    }
+
+    bool operator<(const small_vector& x) const{
+      return std::lexicographical_compare(begin(),end(),x.begin(),x.end());
+    }
+
+
+  private:
+
+    void take(small_vector& x){
+      if(x.arr==x.buf){
+	std::memcpy(buf,x.buf,x._size*sizeof(TYPE));
+	_size=x._size;
+      }else{
+	arr=x.arr;
+	_size=x._size;
+	_capacity=x._capacity;
+	x.arr=x.buf;
+	x._capacity=N;
+      }
+      x._size=0;
+    }
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+
+#include "CnineSession.hpp"
+#include "small_vector.hpp"
+#include "Gindex.hpp"
+#include "GstridesB.hpp"
+
+using namespace cnine;
+
+
+int main(int argc, char** argv){
+  cnine_session session(4);
+
+  int errors=0;
+
+  // Growing past the inline capacity and shrinking back
+  small_vector<int,4> v;
+  vector<int> w;
+  for(int i=0; i<11; i++){
+    v.push_back(i*i);
+    w.push_back(i*i);
+  }
+  v.insert(v.begin()+2,-1);
+  w.insert(w.begin()+2,-1);
+  v.erase(v.begin()+5,v.begin()+7);
+  w.erase(w.begin()+5,w.begin()+7);
+  if(vector<int>(v)!=w) errors++;
+
+  small_vector<int,4> u(std::move(v));
+  if(vector<int>(u)!=w || v.size()!=0) errors++;
+  u.resize(3);
+  small_vector<int,4> x(u);
+  if(x.size()!=3 || x.capacity()!=4 || x[2]!=-1) errors++;
+
+  // Assigning a longer range to a vector that is already on the heap
+  small_vector<int,4> y(w.begin(),w.end());
+  vector<int> z(40,7);
+  y.assign(z.begin(),z.end());
+  if(vector<int>(y)!=z) errors++;
+
+  // Dimensions and strides of up to eight indices are stored inline
+  Gdims dims({2,3,4,5});
+  GstridesB strides(dims);
+  Gindex ix(1,2,3,4);
+  if(strides.offs(ix)!=ix(dims)) errors++;
+  if(Gdims(dims.data(),dims.data()+dims.size())!=dims) errors++;
+  if(dims.capacity()!=8 || strides.capacity()!=8) errors++;
+  if(GstridesB({3,1}).size()!=2) errors++;
+
+  Gdims big(vector<int>(12,2));
+  if(big.asize()!=4096 || big.chunk(4)!=Gdims(vector<int>(8,2))) errors++;
+
+  cout<<dims<<" "<<strides<<" "<<ix<<endl;
+  cout<<"Errors: "<<errors<<endl;
+
+}
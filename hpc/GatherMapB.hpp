@@ -31,8 +31,12 @@ namespace cnine{
 
     hlists<int> arr;
     shared_ptr<GatherMapB> _inv;
+    mutable shared_ptr<GatherMapB> _reordered;
     mutable bool sorted=false;
 
+    // If nonempty, shared_target[i] flags lists whose target also has other lists
+    vector<char> shared_target;
+
     int n=0;
     int* arrg=nullptr; // unsafe!!
 
@@ -62,7 +66,7 @@ namespace cnine{
       n(_n){}
 
     GatherMapB(const vector<int>& sources, const vector<int>& targets){
-      cnine::fnlog timer("GatherMapB::GatherMapB(const vector<int>& sources, const vector<int>& targets)");
+      CNINE_PROFILE("GatherMapB::GatherMapB(const vector<int>& sources, const vector<int>& targets)");
       CNINE_ASSRT(sources.size()==targets.size());
 
       int N=sources.size();
@@ -95,7 +99,7 @@ namespace cnine{
       out_columns(_out_columns),
       in_columns_n(_in_columns_n),
       out_columns_n(_out_columns_n){
-      cnine::fnlog timer("GatherMapB::GatherMapB(const map_of_lists<int,int>& map)");
+      CNINE_PROFILE("GatherMapB::GatherMapB(const map_of_lists<int,int>& map)");
       //cout<<"make GatherMapB"<<endl;
 
       int total=0;
@@ -155,7 +159,7 @@ namespace cnine{
     }
 
     void make_arrg() const{
-      cnine::fnlog timer("GatherMapB::make_arrg()");
+      CNINE_PROFILE("GatherMapB::make_arrg()");
       //cout<<arr.dir.memsize<<"...."<<arr.get_memsize()<<endl;
       //int memsize=arr.get_memsize()+arr.dir.memsize;
       int memsize=arr.get_tail()+arr.size()*2;
@@ -200,6 +204,7 @@ namespace cnine{
     }
 
     void set_target(const int i, const int x){
+      _reordered.reset();
       arr.set_head(i,x);
     }
 
@@ -208,17 +213,20 @@ namespace cnine{
     }
 
     void set(const int i, const int j, const int x){
+      _reordered.reset();
       arr.set(i,j,x);
     }
 
     int push_back(const int len){
       sorted=false;
+      _reordered.reset();
       arr.push_back(len);
       return size()-1;
     }
 
     void push_back(const int t, const vector<int>& v){
       sorted=false;
+      _reordered.reset();
       arr.push_back(t,v);
     }
 
@@ -242,12 +250,23 @@ namespace cnine{
       return *_inv;
     }
 
+    bool is_shared_target(const int i) const{
+      return shared_target.size()>0 && shared_target[i];
+    }
+
+    // The map the CPU gather should use: the reordered copy if reorder() has been called and the
+    // map has not changed since
+    const GatherMapB& locality_map() const{
+      if(_reordered.get()) return *_reordered;
+      return *this;
+    }
+
 
   public: // ---- Operations ---------------------------------------------------------------------------------
 
 
     void make_inv() const{
-      cnine::fnlog timer("GatherMapB::make_inv()");
+      CNINE_PROFILE("GatherMapB::make_inv()");
       map<int,vector<int> > inv_map;
       int total=0;
       for_each([&](const int i, const int j){
@@ -270,7 +289,7 @@ namespace cnine{
 
     
     const GatherMapB& sort() const{
-      cnine::fnlog timer("GatherMapB::sort()");
+      CNINE_PROFILE("GatherMapB::sort()");
       if(sorted) return *this;
 
       map<int,vector<int> > lengths;
@@ -291,12 +310,13 @@ namespace cnine{
       }
       const_cast<GatherMapB&>(*this).arr=std::move(r.arr);
       sorted=true;
+      _reordered.reset();
       return *this;
     }
 
 
     const GatherMapB& grade(const int min_size=0) const{
-      cnine::fnlog timer("GatherMapB::grade()");
+      CNINE_PROFILE("GatherMapB::grade()");
       map<int,vector<int> > lengths;
       int N=size();
       for(int i=0; i<N; i++)
@@ -316,7 +336,7 @@ namespace cnine{
 	  FixedkGatherMap* g=new FixedkGatherMap(p.second.size(),K);
 	  auto gv=g->view2();
 	  for(int j=0; j<p.second.size(); j++)
-	    gv.slice0(j)=arr.array_pool<int>::view_of(p.second[j]);
+	    gv.slice0(j).set(arr.array_pool<int>::view_of(p.second[j]));
 	  const_cast<GatherMapB&>(*this).fixedk_maps.push_back(shared_ptr<FixedkGatherMap>(g));
 	}else{
 	  for(auto q:p.second){
@@ -329,10 +349,67 @@ namespace cnine{
       }
 
       const_cast<GatherMapB&>(*this).arr=std::move(r.arr);
+      _reordered.reset();
       return *this;
     }
 
 
+    // Build and cache a copy of the map laid out for source locality on the CPU. The sources
+    // within each list are sorted, lists longer than max_list are cut into chunks of similar
+    // length that share the same target, and the lists are then ordered by their smallest source,
+    // so consecutive lists read nearby rows of the input. Only for unweighted maps: the lists of a
+    // WeightedGatherMapB interleave sources with weights, which this would scramble.
+    const GatherMapB& reorder(const int max_list=256) const{
+      CNINE_PROFILE("GatherMapB::reorder()");
+      CNINE_ASSRT(typeid(*this)==typeid(GatherMapB));
+      CNINE_ASSRT(max_list>0);
+      const int N=size();
+
+      vector<vector<int> > sources(N);
+      vector<int> nchunks(N);
+      int npieces=0;
+      for(int i=0; i<N; i++){
+	const int K=size_of(i);
+	const int* row=arr.arr+arr.offset(i)+1;
+	sources[i].assign(row,row+K);
+	std::sort(sources[i].begin(),sources[i].end());
+	nchunks[i]=std::max((K+max_list-1)/max_list,1);
+	npieces+=nchunks[i];
+      }
+
+      struct Piece{int key; int list; int beg; int end;};
+      vector<Piece> pieces;
+      pieces.reserve(npieces);
+      for(int i=0; i<N; i++){
+	const int K=sources[i].size();
+	for(int c=0; c<nchunks[i]; c++){
+	  int beg=(long long)K*c/nchunks[i];
+	  int end=(long long)K*(c+1)/nchunks[i];
+	  pieces.push_back({(beg<end)?sources[i][beg]:-1,i,beg,end});
+	}
+      }
+      std::stable_sort(pieces.begin(),pieces.end(),[](const Piece& a, const Piece& b){return a.key<b.key;});
+
+      GatherMapB* r=new GatherMapB(n);
+      r->arr.reserve(arr.get_tail()+npieces);
+      if(npieces>N) r->shared_target.resize(npieces,0);
+      for(auto& p:pieces){
+	const int i=r->push_back(p.end-p.beg);
+	r->set_target(i,target(p.list));
+	for(int a=p.beg; a<p.end; a++)
+	  r->set(i,a-p.beg,sources[p.list][a]);
+	if(nchunks[p.list]>1) r->shared_target[i]=1;
+      }
+      r->in_columns=in_columns;
+      r->out_columns=out_columns;
+      r->in_columns_n=in_columns_n;
+      r->out_columns_n=out_columns_n;
+
+      _reordered.reset(r);
+      return *r;
+    }
+
+
   public: // ---- I/O ----------------------------------------------------------------------------------------
 
 
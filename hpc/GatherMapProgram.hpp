@@ -17,6 +17,7 @@
 #include "Cnine_base.hpp"
 #include "GatherMapB.hpp"
 #include "GatherMapProgramHelpers.hpp"
+#include "GatherMapProgramPlan.hpp"
 #include "GatherRows.hpp"
 
 
@@ -34,6 +35,10 @@ namespace cnine{
     vector<Instruction> instructions;
     int is_inverse=false;
 
+    mutable shared_ptr<GatherMapProgramPlan> plan;
+    mutable shared_ptr<std::mutex> plan_mx=make_shared<std::mutex>(); // guards plan
+    mutable shared_ptr<GatherMapProgramArena> arena=make_shared<GatherMapProgramArena>();
+
     
   public: // ---- Constructors -------------------------------------------------------------------------------
 
@@ -91,16 +96,19 @@ namespace cnine{
     }
 
     int add_var(const Gdims& _dims){
+      plan.reset();
       vars.push_back(Variable(vars.size(),_dims));
       return vars.size()-1;
     }
 
 
     void add_map(const GatherMapB* map, const int out=1, const int in=0){
+      plan.reset();
       instructions.push_back(Instruction(map,out,in));
     }
 
     void add_map(const GatherMapB& map, const int out=1, const int in=0){
+      plan.reset();
       instructions.push_back(Instruction(map,out,in));
     }
 
@@ -138,33 +146,86 @@ namespace cnine{
   public: // ---- Execution ----------------------------------------------------------------------------------
 
 
+    // The plan is built on the first call and reused until the program is modified. Concurrent
+    // first calls build it only once.
+    const GatherMapProgramPlan& compile() const{
+      std::lock_guard<std::mutex> lock(*plan_mx);
+      if(!plan.get()) plan.reset(new GatherMapProgramPlan(vars,instructions));
+      return *plan;
+    }
+
+
     template<typename TYPE>
     void operator()(const TensorView<TYPE>& output, const TensorView<TYPE>& arg0){
       CNINE_ASSRT(output.get_dev()==arg0.get_dev());
       CNINE_ASSRT(arg0.ndims()==2);
       CNINE_ASSRT(output.ndims()==2);
+      CNINE_PROFILE("GatherMapProgram::operator()");
       int nc=arg0.dim(1);
       int dev=output.get_dev();
-
-      vector<Ltensor<TYPE>*> v(vars.size());
-      v[0]=new Ltensor<TYPE>(arg0);
-      v[1]=new Ltensor<TYPE>(output);
-
-      for(int i=2; i<vars.size(); i++){
-	int ncols=nc*vars[i].dims[1];
-	if(is_inverse) ncols=output.dim(1)*vars[i].dims[1];
-	v[i]=new Ltensor<TYPE>(Gdims(vars[i].dims[0],ncols),0,dev); // changed!
+      int width=nc;
+      if(is_inverse) width=output.dim(1);
+      const GatherMapProgramPlan& _plan=compile();
+
+      GatherMapProgramArena* A=arena.get();
+      std::unique_lock<std::mutex> lock(A->mx,std::try_to_lock);
+      unique_ptr<GatherMapProgramArena> private_arena;
+      if(!lock.owns_lock()){
+	private_arena.reset(new GatherMapProgramArena());
+	A=private_arena.get();
       }
-
-      for(auto& p:instructions){
-	//cout<<"V"<<p.out<<":"<<v[p.out]->repr()<<" <- "<<"V"<<p.in<<":"<<v[p.in]->repr()<<endl;
-	CNINE_ASSRT(p.out<vars.size());
-	CNINE_ASSRT(p.in<vars.size());
-	GatherRows()(*v[p.out],*v[p.in],*p.map);
+      TYPE* base=reinterpret_cast<TYPE*>(A->get(_plan.arena_size*width*sizeof(TYPE),dev));
+
+      auto mem=[&](const int v){
+	if(v==0) return const_cast<TYPE*>(arg0.mem());
+	if(v==1) return const_cast<TYPE*>(output.mem());
+	return base+_plan.offset[v]*width;};
+      auto cols=[&](const int v){
+	if(v==0) return arg0.dim(1);
+	if(v==1) return output.dim(1);
+	return vars[v].dims[1]*width;};
+      auto stride0=[&](const int v){
+	if(v==0) return (size_t)arg0.stride(0);
+	if(v==1) return (size_t)output.stride(0);
+	return (size_t)cols(v);};
+      auto stride1=[&](const int v){
+	if(v==0) return (size_t)arg0.stride(1);
+	if(v==1) return (size_t)output.stride(1);
+	return (size_t)1;};
+      auto view=[&](const int v){
+	if(v==0) return Ltensor<TYPE>(arg0);
+	if(v==1) return Ltensor<TYPE>(output);
+	return Ltensor<TYPE>(mem(v),Gdims(vars[v].dims[0],cols(v)),dev);};
+
+      for(auto& step:_plan.steps){
+
+	for(auto v:step.zero){
+	  if(dev==0) std::fill(mem(v),mem(v)+((size_t)vars[v].dims[0])*cols(v),0);
+	  else view(v).set_zero();
+	}
+
+	if(dev==0 && GatherMapProgramPlan::plain(*instructions[step.instr[0]].map)){
+	  gather_rows_cpu::GatherJob<TYPE> jobs[GatherMapProgramPlan::max_fused];
+	  int njobs=step.instr.size();
+	  for(int k=0; k<njobs; k++){
+	    const Instruction& p=instructions[step.instr[k]];
+	    const GatherMapB& g=*p.map;
+	    CNINE_ASSRT(g.get_dev()==0);
+	    int ncg=cols(p.in)*g.in_columns_n/g.in_columns;
+	    CNINE_ASSRT(cols(p.out)*g.out_columns_n/g.out_columns==ncg);
+	    jobs[k]={mem(p.out),stride0(p.out)/g.out_columns,stride1(p.out),
+		     mem(p.in),stride0(p.in)/g.in_columns,stride1(p.in),ncg,&g.locality_map()};
+	  }
+	  gather_rows_cpu::gather_fused(jobs,njobs);
+	  continue;
+	}
+
+	for(auto i:step.instr){
+	  const Instruction& p=instructions[i];
+	  Ltensor<TYPE> out(view(p.out));
+	  GatherRows()(out,view(p.in),*p.map);
+	}
       }
-
-      for(auto p:v) // changed!
-	delete p;
     }
 
 
@@ -179,6 +240,12 @@ namespace cnine{
       oss<<indent<<"Instructions:"<<endl;
       for(auto& p:instructions)
 	oss<<indent<<"  "<<p<<endl;
+      shared_ptr<GatherMapProgramPlan> _plan;
+      {
+	std::lock_guard<std::mutex> lock(*plan_mx);
+	_plan=plan;
+      }
+      if(_plan.get()) oss<<_plan->str(indent);
       return oss.str();
     }
 
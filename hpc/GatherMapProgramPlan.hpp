@@ -0,0 +1,196 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#ifndef _GatherMapProgramPlan
+#define _GatherMapProgramPlan
+
+#include "Cnine_base.hpp"
+#include "MemBlob.hpp"
+#include "GatherMapProgramHelpers.hpp"
+#include "WeightedGatherMapB.hpp"
+
+
+namespace cnine{
+
+
+  // Execution plan of a GatherMapProgram. Consecutive instructions that read the same variable
+  // and write distinct ones are fused into a single step. The intermediate variables are laid out
+  // in one arena: each is live from the first to the last step that touches it, and variables
+  // whose live ranges do not overlap may share memory. Offsets and sizes are in units of one
+  // row of width 1, i.e., they get multiplied by the number of columns of the input.
+
+  class GatherMapProgramPlan{
+  public:
+
+    typedef GatherMapProgramVariable Variable;
+    typedef GatherMapProgramInstruction Instruction;
+
+    static const int max_fused=8;
+
+    struct Step{
+      vector<int> instr; // instructions executed together
+      vector<int> zero;  // intermediate variables that come to life at this step
+      bool fused=false;
+    };
+
+    vector<Step> steps;
+    vector<int> first;
+    vector<int> last;
+    vector<size_t> offset;
+    size_t arena_size=0;
+    size_t naive_size=0;
+
+
+  public: // ---- Constructors -------------------------------------------------------------------------------
+
+
+    GatherMapProgramPlan(){}
+
+    GatherMapProgramPlan(const vector<Variable>& vars, const vector<Instruction>& instructions){
+      CNINE_PROFILE("GatherMapProgramPlan::GatherMapProgramPlan()");
+      const int nvars=vars.size();
+      const int ninstr=instructions.size();
+
+      // fuse consecutive instructions reading the same variable
+      for(int i=0; i<ninstr; i++){
+	const Instruction& x=instructions[i];
+	if(steps.size()>0 && fusable(instructions,steps.back(),x)){
+	  steps.back().instr.push_back(i);
+	  steps.back().fused=true;
+	  continue;
+	}
+	Step s;
+	s.instr.push_back(i);
+	steps.push_back(s);
+      }
+
+      // live ranges, in steps
+      first.assign(nvars,-1);
+      last.assign(nvars,-1);
+      for(int s=0; s<steps.size(); s++)
+	for(auto i:steps[s].instr)
+	  for(auto v:{instructions[i].in,instructions[i].out}){
+	    CNINE_ASSRT(v<nvars);
+	    if(first[v]<0) first[v]=s;
+	    last[v]=s;
+	  }
+
+      // place each variable at the lowest offset not used by any variable live at the same time
+      offset.assign(nvars,0);
+      vector<int> order;
+      for(int v=2; v<nvars; v++)
+	if(first[v]>=0) order.push_back(v);
+      std::stable_sort(order.begin(),order.end(),[&](const int a, const int b){return first[a]<first[b];});
+
+      vector<int> placed;
+      for(auto v:order){
+	const size_t sz=var_size(vars[v]);
+	naive_size+=sz;
+	vector<pair<size_t,size_t> > busy;
+	for(auto u:placed)
+	  if(first[u]<=last[v] && first[v]<=last[u])
+	    busy.push_back(make_pair(offset[u],offset[u]+var_size(vars[u])));
+	std::sort(busy.begin(),busy.end());
+	size_t offs=0;
+	for(auto& p:busy){
+	  if(p.first>=offs+sz) break;
+	  offs=std::max(offs,p.second);
+	}
+	offset[v]=offs;
+	arena_size=std::max(arena_size,offs+sz);
+	placed.push_back(v);
+	steps[first[v]].zero.push_back(v);
+      }
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    static size_t var_size(const Variable& x){
+      return ((size_t)x.dims[0])*x.dims[1];
+    }
+
+    // Plain maps are executed directly by the fused CPU kernel
+    static bool plain(const GatherMapB& g){
+      return g.fixedk_maps.size()==0 && !dynamic_cast<const WeightedGatherMapB*>(&g);
+    }
+
+
+  private:
+
+    static bool fusable(const vector<Instruction>& instructions, const Step& s, const Instruction& x){
+      if(s.instr.size()>=max_fused) return false;
+      if(!plain(*x.map)) return false;
+      if(x.out==x.in) return false;
+      for(auto i:s.instr){
+	const Instruction& y=instructions[i];
+	if(y.in!=x.in || y.out==x.out || !plain(*y.map)) return false;
+	if(y.out==x.in || y.out==y.in) return false; // y writes the input that x reads
+      }
+      return true;
+    }
+
+
+  public: // ---- I/O ----------------------------------------------------------------------------------------
+
+
+    string str(const string indent="") const{
+      ostringstream oss;
+      oss<<indent<<"Steps:"<<endl;
+      for(int s=0; s<steps.size(); s++){
+	oss<<indent<<"  "<<s<<": instructions(";
+	for(auto i:steps[s].instr) oss<<i<<",";
+	oss<<"\b)";
+	if(steps[s].zero.size()>0){
+	  oss<<" new(";
+	  for(auto v:steps[s].zero) oss<<"v"<<v<<"@"<<offset[v]<<",";
+	  oss<<"\b)";
+	}
+	oss<<endl;
+      }
+      oss<<indent<<"Arena size: "<<arena_size<<" (without reuse: "<<naive_size<<")"<<endl;
+      return oss.str();
+    }
+
+    friend ostream& operator<<(ostream& stream, const GatherMapProgramPlan& v){
+      stream<<v.str(); return stream;}
+
+  };
+
+
+  // Arena memory of a compiled program, kept between calls. A call that finds it in use by
+  // another thread runs on a private arena instead.
+
+  class GatherMapProgramArena{
+  public:
+
+    std::mutex mx;
+    shared_ptr<MemBlob<char> > blob;
+    size_t size=0;
+    int dev=0;
+
+    char* get(const size_t nbytes, const int _dev){
+      if(!blob.get() || size<nbytes || dev!=_dev){
+	blob.reset(new MemBlob<char>(std::max(nbytes,(size_t)1),_dev));
+	size=nbytes;
+	dev=_dev;
+      }
+      return blob->arr;
+    }
+
+  };
+
+}
+
+#endif
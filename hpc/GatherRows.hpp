@@ -20,6 +20,7 @@
 #include "FixedkGatherMap.hpp"
 #include "Ltensor.hpp"
 #include "logged_timer.hpp"
+#include "ParallelFor.hpp"
 
 
 namespace cnine{
@@ -32,6 +33,169 @@ namespace cnine{
     const Ltensor<int>& out_offsets, const Ltensor<int>& in_offsets,const cudaStream_t& stream);
 #endif 
   
+
+  extern size_t parallel_grain;
+
+
+  // ---- CPU kernels ----------------------------------------------------------------------------------------
+  // Each list of a gather map has its own target row, so the lists can be split between threads
+  // without any synchronization. The exception are the chunks of long lists made by
+  // GatherMapB::reorder, which are summed into a local row first and then added to the target
+  // under a lock. The rows of the next few sources are prefetched while the current one is
+  // added in.
+
+  namespace gather_rows_cpu{
+
+    const int prefetch_distance=4;
+
+    inline std::mutex row_locks[64];
+
+    template<typename TYPE>
+    inline void prefetch_row(const TYPE* p, const int n){
+#if defined(__GNUC__)
+      const int nbytes=std::min<int>(n*sizeof(TYPE),512);
+      for(int c=0; c<nbytes; c+=64)
+	__builtin_prefetch(reinterpret_cast<const char*>(p)+c);
+#endif
+    }
+
+    template<typename TYPE>
+    inline void add_row(TYPE* __restrict r, const TYPE* __restrict x, const int n){
+      for(int c=0; c<n; c++) r[c]+=x[c];
+    }
+
+    template<typename TYPE>
+    inline void add_row(TYPE* __restrict r, const TYPE* __restrict x, const int n, const float w){
+      for(int c=0; c<n; c++) r[c]+=w*x[c];
+    }
+
+    template<typename TYPE>
+    inline void add_row(TYPE* r, const size_t rs, const TYPE* x, const size_t xs, const int n){
+      for(int c=0; c<n; c++) r[c*rs]+=x[c*xs];
+    }
+
+    template<typename TYPE>
+    inline void add_row(TYPE* r, const size_t rs, const TYPE* x, const size_t xs, const int n, const float w){
+      for(int c=0; c<n; c++) r[c*rs]+=w*x[c*xs];
+    }
+
+    // Lists per parallel chunk, aiming at parallel_grain scalar adds per chunk
+    inline size_t list_grain(const int nlists, const size_t nentries, const int nc){
+      if(nlists==0) return 1;
+      return std::max<size_t>(1,parallel_grain/std::max<size_t>(1,nentries*nc/nlists));
+    }
+
+    // r.row(target(i))+=sum_j x.row(g(i,j)) for lists beg<=i<end. If weighted, the entries of
+    // each list are interleaved (source,weight) pairs as in WeightedGatherMapB.
+    template<typename TYPE>
+    void gather_lists(TYPE* r, const size_t rs0, const size_t rs1, const TYPE* x, const size_t xs0, const size_t xs1, 
+      const int nc, const GatherMapB& g, const bool weighted, const int beg, const int end){
+      const int* arr=g.arr.arr;
+      vector<TYPE> acc;
+      for(int i=beg; i<end; i++){
+	const int* row=arr+g.arr.offset(i);
+	const int n=g.arr.size_of(i);
+
+	if(g.is_shared_target(i)){
+	  acc.assign(nc,0);
+	  for(int j=0; j<n; j++){
+	    if(j+prefetch_distance<n) prefetch_row(x+row[j+1+prefetch_distance]*xs0,nc);
+	    const TYPE* xrow=x+row[j+1]*xs0;
+	    if(xs1==1) add_row(acc.data(),xrow,nc);
+	    else add_row(acc.data(),1,xrow,xs1,nc);
+	  }
+	  std::lock_guard<std::mutex> lock(row_locks[row[0]%64]);
+	  add_row(r+row[0]*rs0,rs1,acc.data(),1,nc);
+	  continue;
+	}
+
+	TYPE* rrow=r+row[0]*rs0;
+	const int step=weighted?2:1;
+	for(int j=0; j<n; j+=step){
+	  if(j+step*prefetch_distance<n) prefetch_row(x+row[j+1+step*prefetch_distance]*xs0,nc);
+	  const TYPE* xrow=x+row[j+1]*xs0;
+	  if(weighted){
+	    const float w=reinterpret_cast<const float&>(row[j+2]);
+	    if(rs1==1 && xs1==1) add_row(rrow,xrow,nc,w);
+	    else add_row(rrow,rs1,xrow,xs1,nc,w);
+	  }else{
+	    if(rs1==1 && xs1==1) add_row(rrow,xrow,nc);
+	    else add_row(rrow,rs1,xrow,xs1,nc);
+	  }
+	}
+      }
+    }
+
+    template<typename TYPE>
+    void gather(TYPE* r, const size_t rs0, const size_t rs1, const TYPE* x, const size_t xs0, const size_t xs1, 
+      const int nc, const GatherMapB& g, const bool weighted=false){
+      const int N=g.size();
+      parallel_for(N,[&](const size_t beg, const size_t end){
+	  gather_lists(r,rs0,rs1,x,xs0,xs1,nc,g,weighted,beg,end);},
+	list_grain(N,g.arr.get_tail(),nc));
+    }
+
+    // One gather of a fused group
+    template<typename TYPE>
+    struct GatherJob{
+      TYPE* r;
+      size_t rs0,rs1;
+      const TYPE* x;
+      size_t xs0,xs1;
+      int nc;
+      const GatherMapB* g;
+    };
+
+    // Run up to 8 gathers with distinct outputs as a single parallel loop over all their lists
+    template<typename TYPE>
+    void gather_fused(const GatherJob<TYPE>* jobs, const int njobs){
+      CNINE_ASSRT(njobs<=8);
+      int offs[9];
+      offs[0]=0;
+      size_t nentries=0;
+      int nc=1;
+      for(int k=0; k<njobs; k++){
+	offs[k+1]=offs[k]+jobs[k].g->size();
+	nentries+=jobs[k].g->arr.get_tail();
+	nc=std::max(nc,jobs[k].nc);
+      }
+      const int N=offs[njobs];
+      parallel_for(N,[&](const size_t beg, const size_t end){
+	  for(int k=0; k<njobs; k++){
+	    const int b=std::max<int>(beg,offs[k]);
+	    const int e=std::min<int>(end,offs[k+1]);
+	    if(b>=e) continue;
+	    const GatherJob<TYPE>& j=jobs[k];
+	    gather_lists(j.r,j.rs0,j.rs1,j.x,j.xs0,j.xs1,j.nc,*j.g,false,b-offs[k],e-offs[k]);
+	  }},
+	list_grain(N,nentries,nc));
+    }
+
+    template<typename TYPE>
+    void gather(TYPE* r, const size_t rs0, const size_t rs1, const TYPE* x, const size_t xs0, const size_t xs1, 
+      const int nc, const FixedkGatherMap& g){
+      const int N=g.getn();
+      const int K=g.getk();
+      const int* arr=g.get_arr();
+      const size_t gs0=g.stride(0);
+      const size_t gs1=g.stride(1);
+      parallel_for(N,[&](const size_t beg, const size_t end){
+	  for(int i=beg; i<end; i++){
+	    const int* row=arr+i*gs0;
+	    TYPE* rrow=r+row[0]*rs0;
+	    for(int j=0; j<K; j++){
+	      if(j+prefetch_distance<K) prefetch_row(x+row[(j+1+prefetch_distance)*gs1]*xs0,nc);
+	      const TYPE* xrow=x+row[(j+1)*gs1]*xs0;
+	      if(rs1==1 && xs1==1) add_row(rrow,xrow,nc);
+	      else add_row(rrow,rs1,xrow,xs1,nc);
+	    }
+	  }},
+	list_grain(N,N*(K+1),nc));
+    }
+
+  }
+
+
   class GatherRows{
   public:
 
@@ -47,39 +211,37 @@ namespace cnine{
 	  (*this)(_r,_x,*p);
       }
 
-      if(dynamic_cast<const WeightedGatherMapB*>(&g)) 
+      if(dynamic_cast<const WeightedGatherMapB*>(&g)){
 	weighted(_r,_x,dynamic_cast<const WeightedGatherMapB&>(g));
+	return;
+      }
 
       if(g.size()==0) return;
 
-      auto r=_r.view2();
-      r.n0*=g.out_columns;
-      r.n1=r.n1*g.out_columns_n/g.out_columns;
-      r.s0/=g.out_columns;
-      auto x=_x.view2();
-      x.n0*=g.in_columns;
-      x.n1=x.n1*g.in_columns_n/g.in_columns;
-      x.s0/=g.in_columns;
-      CNINE_ASSRT(r.n1==x.n1);
-    
       if(_r.get_dev()==0){
-	fnlog timer("GatherRows::operator()");
-	//logged_timer ptimer("GatherRows(CPU)",r,x,((long long)g.n_ops())*x.n1);
 	CNINE_ASSRT(g.get_dev()==0);
-	int N=g.size();
-	for(int i=0; i<N; i++){
-	  auto targt=r.slice0(g.target(i));
-	  //targt.n0=x.n1; // hack // change in cu too 
-	  int M=g.size_of(i);
-	  for(int j=0; j<M; j++){
-	    targt+=x.slice0(g(i,j));
-	  }
-	}
+	int nc=_x.dim(1)*g.in_columns_n/g.in_columns;
+	CNINE_ASSRT(_r.dim(1)*g.out_columns_n/g.out_columns==nc);
+	const GatherMapB& gm=g.locality_map();
+	static const ProfileSite site("GatherRows::operator()");
+	static const ProfileSite site_reordered("GatherRows::operator()(reordered)");
+	ProfileScope timer((&gm==&g)?site:site_reordered,((long long)g.n_ops())*nc);
+	gather_rows_cpu::gather(_r.mem(),_r.stride(0)/g.out_columns,_r.stride(1),
+	  _x.mem(),_x.stride(0)/g.in_columns,_x.stride(1),nc,gm);
       }
 
       if(_r.get_dev()==1){
+	auto r=_r.view2();
+	r.n0*=g.out_columns;
+	r.n1=r.n1*g.out_columns_n/g.out_columns;
+	r.s0/=g.out_columns;
+	auto x=_x.view2();
+	x.n0*=g.in_columns;
+	x.n1=x.n1*g.in_columns_n/g.in_columns;
+	x.s0/=g.in_columns;
+	CNINE_ASSRT(r.n1==x.n1);
 	g.sort();
-	fnlog timer("GatherRows::operator()(G)");
+	CNINE_PROFILE("GatherRows::operator()(G)");
 	//logged_timer ptimer("GatherRows(GPU)",r,x,((long long)g.n_ops())*x.n1);
 	CUDA_STREAM(gatherRows_cu(r,x,g,stream));
       }
@@ -88,32 +250,27 @@ namespace cnine{
 
     template<typename TYPE>
     void weighted(TensorView<TYPE>& _r, const TensorView<TYPE>& _x, const WeightedGatherMapB& g){
-      auto r=_r.view2();
-      r.n0*=g.out_columns;
-      r.n1/=g.out_columns;
-      r.s0/=g.out_columns;
-      auto x=_x.view2();
-      x.n0*=g.in_columns;
-      x.n1/=g.in_columns;
-      x.s0/=g.in_columns;
 
       if(_r.get_dev()==0){
-	fnlog timer("GatherRows::weighted()");
+	CNINE_PROFILE("GatherRows::weighted()");
 	//logged_timer ptimer("GatherRows::weighted(CPU)",r,x,((long long)g.n_ops())*x.n1);
 	CNINE_ASSRT(g.get_dev()==0);
-	int N=g.size();
-	for(int i=0; i<N; i++){
-	  auto targt=r.slice0(g.target(i));
-	  targt.n0=x.n1; // hack
-	  int M=g.size_of(i);
-	  for(int j=0; j<M; j++)
-	    targt.add(x.slice0(g.src(i,j)),g.weight(i,j));
-	}
+	int nc=_x.dim(1)/g.in_columns;
+	gather_rows_cpu::gather(_r.mem(),_r.stride(0)/g.out_columns,_r.stride(1),
+	  _x.mem(),_x.stride(0)/g.in_columns,_x.stride(1),nc,g,true);
       }
 
       if(_r.get_dev()==1){
+	auto r=_r.view2();
+	r.n0*=g.out_columns;
+	r.n1/=g.out_columns;
+	r.s0/=g.out_columns;
+	auto x=_x.view2();
+	x.n0*=g.in_columns;
+	x.n1/=g.in_columns;
+	x.s0/=g.in_columns;
 	g.sort();
-	fnlog timer("GatherRows::weighted()(G)");
+	CNINE_PROFILE("GatherRows::weighted()(G)");
 	//logged_timer ptimer("GatherRows::weighted(GPU)",r,x,((long long)g.n_ops())*x.n1);
 	CUDA_STREAM(gatherRowsw_cu(r,x,g,stream));
       }
@@ -128,25 +285,19 @@ namespace cnine{
     CNINE_ASSRT(_x.ndims()==2);
     CNINE_ASSRT(_x.dim(0)%g.in_columns==0);
 
-    auto r=_r.view2();
-    r.n0/=g.out_columns;
-    r.n1*=g.out_columns;
-    auto x=_x.view2();
-    x.n0/=g.in_columns;
-    x.n1*=g.in_columns;
-    
     if(_r.get_dev()==0){
       CNINE_ASSRT(g.get_dev()==0);
-      int N=g.getn();
-      int K=g.getk();
-      for(int i=0; i<N; i++){
-	int targt=g.target(i);
-	for(int j=0; j<K; j++)
-	  r.slice0(targt)+=x.slice0(g(i,j));
-      }
+      gather_rows_cpu::gather(_r.mem(),_r.stride(0),_r.stride(1),
+	_x.mem(),_x.stride(0),_x.stride(1),_x.dim(1)*g.in_columns,g);
     }
 
     if(_r.get_dev()==1){
+      auto r=_r.view2();
+      r.n0/=g.out_columns;
+      r.n1*=g.out_columns;
+      auto x=_x.view2();
+      x.n0/=g.in_columns;
+      x.n1*=g.in_columns;
       CUDA_STREAM(gatherRows_cu(r,x,g,stream));
     }
   }
@@ -184,7 +335,12 @@ namespace cnine{
       CNINE_ASSRT(_r.dim(1)%g.out_columns==0);
       CNINE_ASSRT(_x.ndims()==2);
       CNINE_ASSRT(_x.dim(1)%g.in_columns==0);
-      CNINE_ASSRT(_r.get_dev()==1);
+
+      if(_r.get_dev()==0){
+	CNINE_PROFILE("GatherRowsMulti::operator()");
+	cpu(_r,_x,maps,out_offsets,in_offsets);
+	return;
+      }
 
       auto r=_r.view2();
       r.n0*=g.out_columns;
@@ -199,11 +355,61 @@ namespace cnine{
       //CUDA_SAFE(cudaDeviceSynchronize());
 
       //g.sort();
-      fnlog timer("GatherRowsMulti::operator()(G)");
+      CNINE_PROFILE("GatherRowsMulti::operator()(G)");
       //logged_timer ptimer("GatherRows(GPU)",r,x,((long long)g.n_ops())*x.n1);
       CUDA_STREAM(gatherRowsMulti_cu(r,x,maps,out_offsets,in_offsets,stream));
 
     }
+
+
+  private:
+
+    // If the target ranges of the maps are disjoint, the maps are distributed over the threads,
+    // otherwise they are done one after the other, each one in parallel over its own lists.
+    template<typename TYPE>
+    void cpu(TensorView<TYPE>& _r, const TensorView<TYPE>& _x, 
+      const vector<shared_ptr<const GatherMapB> >& maps, const Ltensor<int>& out_offsets, const Ltensor<int>& in_offsets){
+      const GatherMapB& g=*maps[0];
+      const int N=maps.size();
+      const int nc=_x.dim(1)*g.in_columns_n/g.in_columns;
+      CNINE_ASSRT(_r.dim(1)*g.out_columns_n/g.out_columns==nc);
+      const size_t rs0=_r.stride(0)/g.out_columns;
+      const size_t xs0=_x.stride(0)/g.in_columns;
+
+      vector<pair<int,int> > ranges;
+      size_t nentries=0;
+      for(int m=0; m<N; m++){
+	const GatherMapB& map=*maps[m];
+	CNINE_ASSRT(map.get_dev()==0);
+	nentries+=map.arr.get_tail();
+	if(map.size()==0) continue;
+	int lo=map.target(0), hi=lo;
+	for(int i=1; i<map.size(); i++){
+	  lo=std::min(lo,map.target(i));
+	  hi=std::max(hi,map.target(i));
+	}
+	ranges.push_back(make_pair(out_offsets(m)+lo,out_offsets(m)+hi));
+      }
+      std::sort(ranges.begin(),ranges.end());
+      bool disjoint=true;
+      for(int i=1; i<ranges.size(); i++)
+	if(ranges[i].first<=ranges[i-1].second) disjoint=false;
+
+      auto gather_map=[&](const int m){
+	gather_rows_cpu::gather(_r.mem()+out_offsets(m)*rs0,rs0,_r.stride(1),
+	  _x.mem()+in_offsets(m)*xs0,xs0,_x.stride(1),nc,*maps[m]);
+      };
+
+      if(disjoint){
+	parallel_for(N,[&](const size_t beg, const size_t end){
+	    for(int m=beg; m<end; m++) gather_map(m);},
+	  std::max<size_t>(1,parallel_grain/std::max<size_t>(1,nentries*nc/N)));
+      }else{
+	for(int m=0; m<N; m++)
+	  gather_map(m);
+      }
+    }
+
   };
 
 
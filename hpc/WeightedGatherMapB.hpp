@@ -65,7 +65,7 @@ namespace cnine{
       BASE(_n){}
 
     WeightedGatherMapB(const vector<int>& sources, const vector<int>& targets, const vector<float>& weights){
-      cnine::fnlog timer("WeightedGatherMapB::WeightedGatherMapB(const vector<int>& sources, const vector<int>& targets)");
+      CNINE_PROFILE("WeightedGatherMapB::WeightedGatherMapB(const vector<int>& sources, const vector<int>& targets)");
       CNINE_ASSRT(sources.size()==targets.size());
 
       int N=sources.size();
@@ -80,7 +80,7 @@ namespace cnine{
       int i=0;
       for(auto p:sizes){
 	heads[i]=p.first;
-	lengths[i]=p.second;
+	lengths[i]=2*p.second; // (source,weight) pairs
 	mapping[p.first]=i;
 	i++;
       }
@@ -95,7 +95,7 @@ namespace cnine{
     WeightedGatherMapB(const map_of_lists<int,int>& x, const int _out_columns=1, const int _in_columns=1){
       in_columns=_in_columns;
       out_columns=_out_columns;
-      cnine::fnlog timer("WeightedGatherMapB::WeightedGatherMapB(const map_of_lists<int,int>& map)");
+      CNINE_PROFILE("WeightedGatherMapB::WeightedGatherMapB(const map_of_lists<int,int>& map)");
       //cout<<"make WeightedGatherMapB"<<endl;
 
       int total=0;
@@ -257,7 +257,7 @@ namespace cnine{
 
 
     void make_inv() const{
-      cnine::fnlog timer("WeightedGatherMapB::make_inv()");
+      CNINE_PROFILE("WeightedGatherMapB::make_inv()");
       map<int,vector<int> > inv_map;
       int total=0;
       for_each([&](const int i, const int j, const float v){
@@ -275,7 +275,7 @@ namespace cnine{
 
     
     const WeightedGatherMapB& sort() const{
-      cnine::fnlog timer("WeightedGatherMapB::sort()");
+      CNINE_PROFILE("WeightedGatherMapB::sort()");
       if(sorted) return *this;
 
       map<int,vector<int> > lengths;
@@ -301,7 +301,7 @@ namespace cnine{
 
     /*
     const WeightedGatherMapB& grade(const int min_size=0) const{
-      cnine::fnlog timer("WeightedGatherMapB::grade()");
+      CNINE_PROFILE("WeightedGatherMapB::grade()");
       map<int,vector<int> > lengths;
       int N=size();
       for(int i=0; i<N; i++)
@@ -20,7 +20,7 @@ int main(int argc, char** argv){
   GatherMapVar v1(prog,dims(3,4));
   GatherMapVar v2(prog,dims(2,2));
 
-  prog.gather(v1,in(1,0),dummy);
+  prog.add_map(dummy,v1.id,in.id);
 
   cout<<prog<<endl;
 
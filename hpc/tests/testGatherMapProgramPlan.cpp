@@ -0,0 +1,108 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "GatherMapProgram.hpp"
+
+using namespace cnine;
+
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  const int n=1000, nc=16;
+  GatherMapB g1=GatherMapB::random(n,n,0.01);
+  GatherMapB g2=GatherMapB::random(n,n,0.01);
+  GatherMapB g3=GatherMapB::random(n,n,0.01);
+  GatherMapB g4=GatherMapB::random(n,n,0.01);
+
+  // v2 and v3 both read the input, v4 can reuse the memory of v2
+  GatherMapProgram prog(dims(n,1),dims(n,1));
+  int v2=prog.add_var(dims(n,1));
+  int v3=prog.add_var(dims(n,1));
+  int v4=prog.add_var(dims(n,1));
+  prog.add_map(g1,v2,0);
+  prog.add_map(g2,v3,0);
+  prog.add_map(g3,1,v2);
+  prog.add_map(g4,v4,v3);
+  prog.add_map(g1,1,v4);
+
+  Ltensor<float> x(dims(n,nc),4,0);
+  Ltensor<float> r(dims(n,nc),0,0);
+  prog(r,x);
+  cout<<prog.compile()<<endl;
+
+  // the same gathers with freshly allocated intermediates
+  Ltensor<float> t2(dims(n,nc),0,0), t3(dims(n,nc),0,0), t4(dims(n,nc),0,0), s(dims(n,nc),0,0);
+  GatherRows()(t2,x,g1);
+  GatherRows()(t3,x,g2);
+  GatherRows()(s,t2,g3);
+  GatherRows()(t4,t3,g4);
+  GatherRows()(s,t4,g1);
+  cout<<"Difference: "<<r.diff2(s)<<endl;
+
+  // repeated calls reuse the plan and the arena
+  for(int i=0; i<10; i++){
+    r.set_zero();
+    prog(r,x);
+  }
+  cout<<"Difference after 10 calls: "<<r.diff2(s)<<endl;
+
+  // an in-place gather must not be fused with a later gather reading the same variable
+  vector<int> src, tgt;
+  for(int i=0; i<n/2; i++)
+    for(int j=0; j<4; j++){
+      src.push_back(n/2+(i*7+j*13)%(n/2));
+      tgt.push_back(i);
+    }
+  GatherMapB g5(src,tgt);
+  g5.n=n;
+  GatherMapProgram prog2(dims(n,1),dims(n,1));
+  int w2=prog2.add_var(dims(n,1));
+  int w3=prog2.add_var(dims(n,1));
+  prog2.add_map(g1,w2,0);
+  prog2.add_map(g5,w2,w2);
+  prog2.add_map(g3,w3,w2);
+  prog2.add_map(g4,1,w3);
+  Ltensor<float> r2(dims(n,nc),0,0);
+  prog2(r2,x);
+  cout<<prog2.compile()<<endl;
+
+  Ltensor<float> u2(dims(n,nc),0,0), u3(dims(n,nc),0,0), s2(dims(n,nc),0,0);
+  GatherRows()(u2,x,g1);
+  GatherRows()(u2,u2,g5);
+  GatherRows()(u3,u2,g3);
+  GatherRows()(s2,u3,g4);
+  cout<<"Difference with in-place gather: "<<r2.diff2(s2)<<endl;
+
+  // concurrent first calls share one plan
+  GatherMapProgram prog3(dims(n,1),dims(n,1));
+  int z2=prog3.add_var(dims(n,1));
+  prog3.add_map(g1,z2,0);
+  prog3.add_map(g3,1,z2);
+  vector<Ltensor<float> > rs;
+  for(int t=0; t<4; t++) rs.push_back(Ltensor<float>(dims(n,nc),0,0));
+  vector<std::thread> threads;
+  for(int t=0; t<4; t++)
+    threads.emplace_back([&,t](){prog3(rs[t],x);});
+  for(auto& p:threads) p.join();
+  Ltensor<float> u4(dims(n,nc),0,0), s3(dims(n,nc),0,0);
+  GatherRows()(u4,x,g1);
+  GatherRows()(s3,u4,g3);
+  float d3=0;
+  for(auto& p:rs) d3+=p.diff2(s3);
+  cout<<"Difference with concurrent first calls: "<<d3<<endl;
+
+}
@@ -0,0 +1,74 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "GatherRows.hpp"
+
+using namespace cnine;
+
+
+int main(int argc, char** argv){
+
+  cnine_session session(4);
+  parallel_grain=4096;
+
+  // each target draws its sources from a window around its own position, 
+  // plus one hub target with a very long list
+  const int n=20000, nc=32, deg=8, hub=20000;
+  uniform_int_distribution<int> offs(-200,200), all(0,n-1);
+  vector<int> src, tgt;
+  for(int i=0; i<n; i++)
+    for(int j=0; j<deg; j++){
+      src.push_back(std::min(std::max(i+offs(rndGen),0),n-1));
+      tgt.push_back(i);
+    }
+  for(int j=0; j<hub; j++){
+    src.push_back(all(rndGen));
+    tgt.push_back(0);
+  }
+
+  Ltensor<float> x(dims(n,nc),4,0);
+
+  GatherMapB g(src,tgt);
+  g.n=n;
+  Ltensor<float> r(dims(n,nc),0,0);
+  GatherRows()(r,x,g);
+
+  g.reorder(256);
+  cout<<"Lists before reordering: "<<g.size()<<", after: "<<g.locality_map().size()<<endl;
+  Ltensor<float> rr(dims(n,nc),0,0);
+  GatherRows()(rr,x,g);
+  cout<<"Difference: "<<rr.diff2(r)<<endl;
+
+  // changing the map drops the reordered copy
+  g.reorder(256);
+  g.set(1,0,g(1,0));
+  cout<<"Reordered copy dropped after set: "<<(&g.locality_map()==&g)<<endl;
+  g.reorder(256);
+  g.set_target(1,g.target(1));
+  cout<<"Reordered copy dropped after set_target: "<<(&g.locality_map()==&g)<<endl;
+  g.reorder(256);
+
+  for(int i=0; i<20; i++) GatherRows()(rr,x,g);
+  GatherMapB g2(src,tgt);
+  g2.n=n;
+  for(int i=0; i<20; i++) GatherRows()(r,x,g2);
+
+  // weighted maps cannot be reordered
+  WeightedGatherMapB wg(vector<int>({0,1,2}),vector<int>({1,1,0}),vector<float>({0.5,1.0,2.0}));
+  bool thrown=false;
+  try{wg.reorder();}catch(const std::runtime_error& e){thrown=true;}
+  cout<<"Weighted map rejected: "<<thrown<<endl;
+
+}
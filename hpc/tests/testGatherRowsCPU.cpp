@@ -0,0 +1,84 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "GatherRows.hpp"
+
+using namespace cnine;
+
+
+float naive_error(const Ltensor<float>& r, const Ltensor<float>& x, const vector<int>& src, const vector<int>& tgt, const vector<float>& w){
+  Ltensor<float> s(r.get_dims(),0,0);
+  for(int i=0; i<src.size(); i++)
+    for(int c=0; c<x.dim(1); c++)
+      s.set(tgt[i],c,s(tgt[i],c)+(w.size()?w[i]:1.0)*x(src[i],c));
+  return s.diff2(r);
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session(4);
+  parallel_grain=4096;
+
+  const int n=2000, m=3000, nc=48, E=40000;
+  uniform_int_distribution<int> sdistr(0,m-1), tdistr(0,n-1);
+  vector<int> src(E), tgt(E);
+  vector<float> w(E);
+  for(int i=0; i<E; i++){
+    src[i]=sdistr(rndGen);
+    tgt[i]=tdistr(rndGen);
+    w[i]=0.5+0.001*i;
+  }
+
+  Ltensor<float> x(dims(m,nc),4,0);
+
+  GatherMapB g(src,tgt);
+  g.n=n;
+  Ltensor<float> r(dims(n,nc),0,0);
+  GatherRows()(r,x,g);
+  cout<<"GatherMapB error:         "<<naive_error(r,x,src,tgt,{})<<endl;
+
+  WeightedGatherMapB gw(src,tgt,w);
+  Ltensor<float> rw(dims(n,nc),0,0);
+  GatherRows()(rw,x,gw);
+  cout<<"WeightedGatherMapB error: "<<naive_error(rw,x,src,tgt,w)<<endl;
+
+  GatherMapB gg(src,tgt);
+  gg.grade(10);
+  Ltensor<float> rg(dims(n,nc),0,0);
+  GatherRows()(rg,x,gg);
+  cout<<"Graded map error:         "<<naive_error(rg,x,src,tgt,{})<<endl;
+
+  // three copies of the map stacked along the rows
+  vector<shared_ptr<const GatherMapB> > maps;
+  for(int i=0; i<3; i++) maps.push_back(shared_ptr<const GatherMapB>(new GatherMapB(src,tgt)));
+  Ltensor<int> out_offsets(dims(3),0,0), in_offsets(dims(3),0,0);
+  for(int i=0; i<3; i++){out_offsets.set(i,i*n); in_offsets.set(i,i*m);}
+  Ltensor<float> X(dims(3*m,nc),4,0);
+  Ltensor<float> R(dims(3*n,nc),0,0);
+  GatherRowsMulti()(R,X,maps,out_offsets,in_offsets);
+  float err=0;
+  for(int i=0; i<3; i++)
+    err+=naive_error(Ltensor<float>(R.rows(i*n,n)),Ltensor<float>(X.rows(i*m,m)),src,tgt,{});
+  cout<<"GatherRowsMulti error:    "<<err<<endl;
+
+  for(int nt: {1,4}){
+    nthreads=nt;
+    auto t0=chrono::system_clock::now();
+    for(int i=0; i<20; i++) GatherRows()(r,x,g);
+    auto t1=chrono::system_clock::now();
+    cout<<"nthreads="<<nt<<": "<<20.0*E*nc/chrono::duration<double>(t1-t0).count()/1e9<<" Gflops"<<endl;
+  }
+}
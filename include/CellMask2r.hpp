@@ -27,6 +27,7 @@ namespace cnine{
   class CellTlist2: public vector<pair<int,int> >{
   public:
     //vector<pair<int,int> > lst;
+    CellTlist2(){}
     CellTlist2(const CellTlist2& x):
       vector<pair<int,int> >(x){}
   };
@@ -99,8 +100,8 @@ namespace cnine{
       auto it=lists.find(r);
       if(it!=lists.end()) lst=it->second;
       else{
-	//lst=new CellTlist2();
-	//lists[r]=lst;
+	lst=new CellTlist2();
+	lists[r]=lst;
       }
       lst->push_back(pair<int,int>(xix(xstrides),yix(ystrides)));
     }
@@ -16,6 +16,8 @@
 #define _Cnine_Cmaps2
 
 #include "Cnine_base.hpp"
+#include "Gdims.hpp"
+#include "ParallelFor.hpp"
 
 #ifdef _WITH_CUDA
 #include <cuda.h>
@@ -61,6 +63,53 @@ namespace cnine{
   };
 
 
+  // ---- CPU backend ----------------------------------------------------------------------------------------
+  // On the CPU the cell maps spread their output cells over the thread pool, each output cell being
+  // computed by a single thread. work is the approximate cost of computing one output cell, in
+  // scalar operations, and sets how many cells are handed to a thread at a time.
+
+
+  inline size_t cmap_grain(const size_t work){
+    return std::max<size_t>(1,parallel_grain/std::max<size_t>(work,1));
+  }
+
+  // fn(b) for each output cell b in [0,n)
+  template<typename FN>
+  void cmap_for_each_cell(const int n, const size_t work, FN&& fn){
+    parallel_for(n,[&](const size_t beg, const size_t end){
+	for(size_t b=beg; b<end; b++) fn(b);
+      },cmap_grain(work));
+  }
+
+  // Reduce n contributions, each costing about work, into the single output cell t. Chunks of
+  // contributions are accumulated by fn(part,beg,end,add_flag) into zero cells of dimensions cdims,
+  // and the partial sums are added to t in chunk order, so the result does not depend on the
+  // number of threads. There are at most cmap_max_parts chunks, and with a single chunk fn writes
+  // to t directly.
+  constexpr size_t cmap_max_parts=64;
+
+  template<typename CELL, typename FN>
+  void cmap_reduce(CELL& t, const Gdims& cdims, const int n, const size_t work, const int add_flag, FN&& fn){
+    const size_t grain=std::max(cmap_grain(work),parallel_nchunks(n,cmap_max_parts));
+    const size_t nchunks=parallel_nchunks(n,grain);
+    if(nchunks<=1){
+      fn(t,0,n,add_flag);
+      return;
+    }
+    vector<CELL> parts;
+    parts.reserve(nchunks);
+    for(size_t c=0; c<nchunks; c++)
+      parts.emplace_back(cdims,fill_zero());
+    parallel_for(nchunks,[&](const size_t beg, const size_t end){
+	for(size_t c=beg; c<end; c++)
+	  fn(parts[c],c*grain,std::min<size_t>(n,(c+1)*grain),1);
+      },1);
+    if(!add_flag) t.set_zero();
+    for(auto& p:parts)
+      t.add(p);
+  }
+
+
   class Direct_cmap: public Cmap_base{
   public:
 
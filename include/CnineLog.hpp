@@ -19,39 +19,15 @@
 #include <chrono>
 #include <ctime>
 
-namespace cnine{
-
-
-  class FnLogEntry{
-  public:
-
-    int n=0;
-    double t=0;
-    string name;
-
-    FnLogEntry(){}
-
-    FnLogEntry(const string _name):
-      name(_name){
-    }
-
-    void log(const double dt){
-      t+=dt;
-      n++;
-    }
+#include "CnineProfiler.hpp"
 
-    string str() const{
-      return name+" n="+to_string(n)+" total_time="+to_string(t)+"ms";
-    }
-    
-  };
+namespace cnine{
 
 
   class CnineLog{
   public:
 
     ofstream ofs;
-    map<string,FnLogEntry> call_log;
 
     chrono::time_point<chrono::system_clock> topen;
 
@@ -66,19 +42,12 @@ namespace cnine{
 
     ~CnineLog(){
 
-      if(call_log.size()>0){
-	cout<<"Logged functions:"<<endl;
-	ofs<<endl;
-      }
-
-      for(auto& p: call_log){
-	cout<<"  "<<p.second.str()<<endl;
-	ofs<<p.second.str()<<endl;
+      string report=cnine_profiler.str("  ");
+      if(report.size()>0){
+	cout<<"Profiled functions:"<<endl<<report<<endl;
+	ofs<<endl<<report;
       }
 
-      if(call_log.size()>0)
-	cout<<endl;
-
       auto elapsed=chrono::duration<double>(chrono::system_clock::now()-topen).count();
       ofs<<endl<<"Cnine log closed after "<<to_string(elapsed)<<" seconds."<<endl;
       ofs<<"----------------------------------------------------------------------"<<endl<<endl;
@@ -115,14 +84,18 @@ namespace cnine{
 
     void operator()(){}
 
-    void log_call(const string name, const double t){
-      auto it=call_log.find(name);
-      if(it!=call_log.end()){
-	it->second.log(t);
-	return;
-      }
-      call_log.emplace(name,name);
-      call_log[name].log(t);
+    // Timings logged by name go to the profiler. Fixed names should be interned once in a
+    // static ProfileSite, the string version looks the name up in a per-thread cache.
+    void log_call(const ProfileSite& site, const double t, const long long ops=0){
+      #ifndef CNINE_NO_PROFILING
+      cnine_profiler.record(site.id,t*1e6,ops);
+      #endif
+    }
+
+    void log_call(const string name, const double t, const long long ops=0){
+      #ifndef CNINE_NO_PROFILING
+      cnine_profiler.record(name,t*1e6,ops);
+      #endif
     }
     
 
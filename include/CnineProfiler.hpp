@@ -0,0 +1,624 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineProfiler
+#define _CnineProfiler
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <fstream>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "Cnine_base.hpp"
+
+
+// Low overhead profiler for hot functions. Each profiled site is interned once into a small integer
+// id (the first time control passes through it), and every thread accumulates its timings into its
+// own buffer, so recording a call takes no lock and builds no strings. The buffers are merged only
+// when a report is requested or when a thread exits. On x86-64 calls are timed with the (invariant)
+// time stamp counter, which is calibrated against steady_clock when the report is made. Latencies
+// are kept in a log-linear histogram with eight buckets per power of two, from which p50 and p99
+// are read off to within about 6%.
+//
+//   void f(){
+//     CNINE_PROFILE("f");                // or CNINE_PROFILE_OPS("f",n_flops)
+//     ...
+//   }
+//
+// Compiling with -DCNINE_NO_PROFILING removes all of this.
+//
+// The profiler can also record a timeline of every timed scope, which is written out in Chrome's
+// trace event format and can be opened in chrome://tracing or Perfetto. Running a program with the
+// environment variable CNINE_TRACE=<file> records the whole run and writes <file> on exit;
+// start_trace(), stop_trace() and write_trace(file) do the same under program control.
+
+#define CNINE_PROFILE_CAT_(a,b) a##b
+#define CNINE_PROFILE_CAT(a,b) CNINE_PROFILE_CAT_(a,b)
+
+#ifdef CNINE_NO_PROFILING
+#define CNINE_PROFILE(name)
+#define CNINE_PROFILE_OPS(name,ops)
+#else
+#define CNINE_PROFILE(name) CNINE_PROFILE_OPS(name,0)
+#define CNINE_PROFILE_OPS(name,ops)					\
+  static const cnine::ProfileSite CNINE_PROFILE_CAT(_cnine_site_,__LINE__)(name); \
+  cnine::ProfileScope CNINE_PROFILE_CAT(_cnine_scope_,__LINE__)(CNINE_PROFILE_CAT(_cnine_site_,__LINE__),ops)
+#endif
+
+
+namespace cnine{
+
+
+  // Time stamp in profiler ticks
+  inline uint64_t profiler_ticks(){
+#if defined(__x86_64__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
+
+
+  // Merged statistics of one site
+  class ProfileSummary{
+  public:
+
+    static const int NBUCKETS=496;
+
+    string name;
+    uint64_t count=0;
+    uint64_t ticks=0;
+    uint64_t ops=0;
+    vector<uint64_t> hist;
+    double tick_ns=1;
+
+    ProfileSummary(): hist(NBUCKETS,0){}
+
+    ProfileSummary(const string& _name): name(_name), hist(NBUCKETS,0){}
+
+    // Values below 16 ticks get their own bucket, above that there are eight buckets per power of two
+    static int bucket(const uint64_t t){
+      if(t<16) return t;
+      int e=63-__builtin_clzll(t);
+      return 16+(e-4)*8+((t>>(e-3))&7);
+    }
+
+    static double bucket_value(const int b){
+      if(b<16) return b;
+      int e=(b-16)/8+4;
+      int sub=(b-16)%8;
+      return ((double)(8+sub)+0.5)*((uint64_t)1<<(e-3));
+    }
+
+    double total_ns() const{
+      return ticks*tick_ns;
+    }
+
+    double mean_ns() const{
+      return count?total_ns()/count:0;
+    }
+
+    // Latency below which a fraction q of the calls fall
+    double quantile_ns(const double q) const{
+      if(count==0) return 0;
+      uint64_t target=std::max<uint64_t>(1,std::ceil(q*count));
+      uint64_t t=0;
+      for(int b=0; b<NBUCKETS; b++){
+	t+=hist[b];
+	if(t>=target) return bucket_value(b)*tick_ns;
+      }
+      return bucket_value(NBUCKETS-1)*tick_ns;
+    }
+
+    double mflops() const{
+      return (ops>0 && ticks>0)?((double)ops)*1000.0/total_ns():0;
+    }
+
+  };
+
+
+  // One thread's accumulator for one site. Only the owning thread writes it, so the updates
+  // are plain relaxed loads and stores; the atomics only make concurrent reports well defined.
+  class ProfilerStats{
+  public:
+
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> ticks{0};
+    std::atomic<uint64_t> ops{0};
+    std::atomic<uint32_t> hist[ProfileSummary::NBUCKETS];
+
+    ProfilerStats(){
+      for(auto& p:hist) p.store(0,std::memory_order_relaxed);
+    }
+
+    void add(const uint64_t t, const uint64_t _ops){
+      bump(count,1);
+      bump(ticks,t);
+      if(_ops) bump(ops,_ops);
+      auto& h=hist[ProfileSummary::bucket(t)];
+      h.store(h.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+    }
+
+    void merge_into(ProfileSummary& r) const{
+      r.count+=count.load(std::memory_order_relaxed);
+      r.ticks+=ticks.load(std::memory_order_relaxed);
+      r.ops+=ops.load(std::memory_order_relaxed);
+      for(int b=0; b<ProfileSummary::NBUCKETS; b++)
+	r.hist[b]+=hist[b].load(std::memory_order_relaxed);
+    }
+
+    void reset(){
+      count.store(0,std::memory_order_relaxed);
+      ticks.store(0,std::memory_order_relaxed);
+      ops.store(0,std::memory_order_relaxed);
+      for(auto& p:hist) p.store(0,std::memory_order_relaxed);
+    }
+
+  private:
+
+    static void bump(std::atomic<uint64_t>& x, const uint64_t v){
+      x.store(x.load(std::memory_order_relaxed)+v,std::memory_order_relaxed);
+    }
+
+  };
+
+
+  // One timed call on the timeline
+  class TraceEvent{
+  public:
+    int tid;
+    int id;
+    uint64_t t0;
+    uint64_t t1;
+    long long ops;
+    string args;
+  };
+
+
+  class ProfilerBuffer;
+
+
+  class CnineProfiler{
+  public:
+
+    static const int max_sites=1024;
+
+    mutable std::mutex mx;
+    vector<string> names;
+    unordered_map<string,int> ids;
+#ifndef CNINE_NO_PROFILING
+    set<ProfilerBuffer*> buffers;
+#endif
+    vector<ProfileSummary> retired; // statistics of threads that have exited
+
+    uint64_t ticks0;
+    std::chrono::steady_clock::time_point time0;
+
+    std::atomic<bool> tracing{false};
+    size_t max_trace_events=size_t(1)<<20; // per thread
+    string trace_file;
+    vector<TraceEvent> retired_events;
+    size_t dropped_events=0;
+    size_t dropped_sites=0; // names that fell into the shared overflow site
+    std::atomic<int> other_site{-1};
+    int next_tid=0;
+
+    mutable std::atomic<double> record_tick_ns{0}; // calibration for record(), measured once
+
+    CnineProfiler():
+      ticks0(profiler_ticks()), time0(std::chrono::steady_clock::now()){
+      if(const char* f=std::getenv("CNINE_TRACE")){
+	trace_file=f;
+	tracing=true;
+      }
+    }
+
+    // Runs at exit, so a trace that cannot be written is only reported
+    ~CnineProfiler(){
+      if(trace_file=="") return;
+      try{
+	write_trace(trace_file);
+      }catch(const std::exception& e){
+	std::cerr<<"cnine warning: "<<e.what()<<std::endl;
+      }
+    }
+
+    CnineProfiler(const CnineProfiler& x)=delete;
+
+
+  public: // ---- Sites --------------------------------------------------------------------------------------
+
+
+    // Once max_sites-1 names are interned, further names share the last site, so a program that
+    // makes up many names at run time loses their breakdown but never fails
+    int site_id(const string& name){
+      std::lock_guard<std::mutex> lock(mx);
+      auto it=ids.find(name);
+      if(it!=ids.end()) return it->second;
+      if(names.size()>=max_sites-1){
+	dropped_sites++;
+	if(other_site<0){
+	  other_site=names.size();
+	  names.push_back("(other sites)");
+	  retired.push_back(ProfileSummary(names.back()));
+	}
+	return other_site;
+      }
+      int id=names.size();
+      names.push_back(name);
+      ids[name]=id;
+      retired.push_back(ProfileSummary(name));
+      return id;
+    }
+
+    int nsites() const{
+      std::lock_guard<std::mutex> lock(mx);
+      return names.size();
+    }
+
+    // Length of a tick in nanoseconds, measured over the lifetime of the profiler
+    double tick_ns() const{
+#if defined(__x86_64__)
+      double ns=0;
+      uint64_t ticks=0;
+      while(ns<1e6){
+	ticks=profiler_ticks()-ticks0;
+	ns=std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-time0).count();
+      }
+      return ns/ticks;
+#else
+      return 1;
+#endif
+    }
+
+    // Record a call timed in nanoseconds under an interned site id, without taking a lock
+    inline void record(const int id, const double ns, const uint64_t ops=0);
+
+    // Record a call under a name that is only known at run time. The name is interned through the
+    // calling thread's cache of site ids.
+    inline void record(const string& name, const double ns, const uint64_t ops=0);
+
+
+  public: // ---- Reports ------------------------------------------------------------------------------------
+
+
+    inline vector<ProfileSummary> summary() const;
+
+    // Clear all statistics. Calls in progress on other threads may or may not be counted.
+    inline void reset();
+
+    string str(const string indent="") const{
+      vector<ProfileSummary> v=summary();
+      std::sort(v.begin(),v.end(),[](const ProfileSummary& a, const ProfileSummary& b){
+	  return a.ticks>b.ticks;});
+      if(v.size()==0) return "";
+
+      int w=8;
+      for(auto& p:v) w=std::max<int>(w,p.name.size());
+      ostringstream oss;
+      oss<<indent<<std::left<<std::setw(w)<<"Function"<<std::right
+	 <<std::setw(10)<<"calls"<<std::setw(14)<<"total(ms)"<<std::setw(12)<<"mean(us)"
+	 <<std::setw(12)<<"p50(us)"<<std::setw(12)<<"p99(us)"<<std::setw(10)<<"Mflops"<<endl;
+      oss<<std::fixed;
+      for(auto& p:v){
+	oss<<indent<<std::left<<std::setw(w)<<p.name<<std::right<<std::setw(10)<<p.count;
+	oss<<std::setprecision(3)<<std::setw(14)<<p.total_ns()/1e6;
+	oss<<std::setw(12)<<p.mean_ns()/1e3<<std::setw(12)<<p.quantile_ns(0.5)/1e3<<std::setw(12)<<p.quantile_ns(0.99)/1e3;
+	if(p.ops>0) oss<<std::setprecision(0)<<std::setw(10)<<p.mflops();
+	oss<<endl;
+      }
+      std::lock_guard<std::mutex> lock(mx);
+      if(dropped_sites>0)
+	oss<<indent<<dropped_sites<<" lookups of names beyond the first "<<max_sites-1<<" went to (other sites)"<<endl;
+      return oss.str();
+    }
+
+    friend ostream& operator<<(ostream& stream, const CnineProfiler& x){
+      stream<<x.str(); return stream;
+    }
+
+
+  public: // ---- Tracing ------------------------------------------------------------------------------------
+
+
+    void start_trace(){
+      tracing=true;
+    }
+
+    void stop_trace(){
+      tracing=false;
+    }
+
+    inline void clear_trace();
+
+    inline vector<TraceEvent> trace_events() const;
+
+    // Number of events that did not fit in the per-thread limit
+    inline size_t trace_dropped() const;
+
+    // Write the recorded events as a Chrome trace (JSON object format)
+    void write_trace(const string& filename) const{
+      std::ofstream ofs(filename);
+      if(!ofs) throw std::runtime_error("CnineProfiler: cannot open trace file "+filename+".");
+      write_trace(ofs);
+    }
+
+    void write_trace(ostream& oss) const{
+      vector<TraceEvent> events=trace_events();
+      const double _tick_ns=tick_ns();
+      vector<string> _names;
+      int ntids=0;
+      size_t _dropped=trace_dropped();
+      {
+	std::lock_guard<std::mutex> lock(mx);
+	_names=names;
+	ntids=next_tid;
+      }
+      for(auto& e:events) ntids=std::max(ntids,e.tid+1);
+
+      oss<<"{\"traceEvents\":["<<endl;
+      oss<<std::fixed<<std::setprecision(3);
+      for(int t=0; t<ntids; t++)
+	oss<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"<<t
+	   <<",\"args\":{\"name\":\"cnine thread "<<t<<"\"}},"<<endl;
+      for(int i=0; i<events.size(); i++){
+	const TraceEvent& e=events[i];
+	oss<<"{\"name\":\""<<json_escape(_names[e.id])<<"\",\"cat\":\"cnine\",\"ph\":\"X\",\"pid\":1,\"tid\":"<<e.tid;
+	oss<<",\"ts\":"<<(e.t0-ticks0)*_tick_ns/1000.0<<",\"dur\":"<<(e.t1-e.t0)*_tick_ns/1000.0;
+	if(e.ops>0 || e.args.size()>0){
+	  oss<<",\"args\":{";
+	  if(e.args.size()>0) oss<<"\"call\":\""<<json_escape(e.args)<<"\"";
+	  if(e.ops>0) oss<<((e.args.size()>0)?",":"")<<"\"flops\":"<<e.ops;
+	  oss<<"}";
+	}
+	oss<<"}"<<((i+1<events.size())?",":"")<<endl;
+      }
+      oss<<"],"<<endl<<"\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":"<<_dropped<<"}}"<<endl;
+    }
+
+  private:
+
+    static string json_escape(const string& s){
+      string r;
+      for(auto c:s){
+	if(c=='"' || c=='\\') {r+='\\'; r+=c; continue;}
+	if((unsigned char)c<0x20) {r+=' '; continue;}
+	r+=c;
+      }
+      return r;
+    }
+
+  };
+
+
+  extern CnineProfiler cnine_profiler;
+
+
+#ifndef CNINE_NO_PROFILING
+
+  // The per-thread buffer, registered with the profiler for the lifetime of the thread.
+  // Stats for each site are allocated on the thread's first call to it.
+  class ProfilerBuffer{
+  public:
+
+    std::atomic<ProfilerStats*> sites[CnineProfiler::max_sites];
+
+    int tid;
+    std::mutex events_mx;
+    vector<TraceEvent> events;
+    size_t dropped=0;
+
+    ProfilerBuffer(){
+      for(auto& p:sites) p.store(nullptr,std::memory_order_relaxed);
+      std::lock_guard<std::mutex> lock(cnine_profiler.mx);
+      cnine_profiler.buffers.insert(this);
+      tid=cnine_profiler.next_tid++;
+    }
+
+    ~ProfilerBuffer(){
+      std::lock_guard<std::mutex> lock(cnine_profiler.mx);
+      cnine_profiler.buffers.erase(this);
+      for(int i=0; i<CnineProfiler::max_sites; i++){
+	ProfilerStats* p=sites[i].load(std::memory_order_relaxed);
+	if(!p) continue;
+	p->merge_into(cnine_profiler.retired[i]);
+	delete p;
+      }
+      std::lock_guard<std::mutex> lock2(events_mx);
+      cnine_profiler.retired_events.insert(cnine_profiler.retired_events.end(),events.begin(),events.end());
+      cnine_profiler.dropped_events+=dropped;
+    }
+
+    ProfilerBuffer(const ProfilerBuffer& x)=delete;
+
+    void add(const int id, const uint64_t ticks, const uint64_t ops){
+      ProfilerStats* p=sites[id].load(std::memory_order_relaxed);
+      if(!p){
+	p=new ProfilerStats();
+	sites[id].store(p,std::memory_order_release);
+      }
+      p->add(ticks,ops);
+    }
+
+    void add_event(const int id, const uint64_t t0, const uint64_t t1, const long long ops, const string& args=""){
+      std::lock_guard<std::mutex> lock(events_mx);
+      if(events.size()>=cnine_profiler.max_trace_events){
+	dropped++;
+	return;
+      }
+      events.push_back(TraceEvent{tid,id,t0,t1,ops,args});
+    }
+
+  };
+
+
+  extern thread_local ProfilerBuffer profiler_buffer;
+
+
+  // Site id of a name that is only known at run time. Each thread caches the ids of the names it
+  // has looked up, so only its first lookup of a name takes the profiler lock. Names past the site
+  // limit are not cached, so that they keep being counted as dropped.
+  inline int cached_site_id(const string& name){
+    thread_local unordered_map<string,int> cache;
+    auto it=cache.find(name);
+    if(it!=cache.end()) return it->second;
+    const int id=cnine_profiler.site_id(name);
+    if(id!=cnine_profiler.other_site) cache[name]=id;
+    return id;
+  }
+
+#endif
+
+
+  inline void CnineProfiler::record(const int id, const double ns, const uint64_t ops){
+#ifndef CNINE_NO_PROFILING
+    double t=record_tick_ns.load(std::memory_order_relaxed);
+    if(t==0){
+      t=tick_ns();
+      record_tick_ns.store(t,std::memory_order_relaxed);
+    }
+    profiler_buffer.add(id,ns/t,ops);
+#endif
+  }
+
+  inline void CnineProfiler::record(const string& name, const double ns, const uint64_t ops){
+#ifndef CNINE_NO_PROFILING
+    record(cached_site_id(name),ns,ops);
+#endif
+  }
+
+  inline vector<ProfileSummary> CnineProfiler::summary() const{
+    const double _tick_ns=tick_ns();
+    std::lock_guard<std::mutex> lock(mx);
+    vector<ProfileSummary> r=retired;
+#ifndef CNINE_NO_PROFILING
+    for(auto b:buffers)
+      for(int i=0; i<r.size(); i++){
+	ProfilerStats* p=b->sites[i].load(std::memory_order_acquire);
+	if(p) p->merge_into(r[i]);
+      }
+#endif
+    vector<ProfileSummary> v;
+    for(auto& p:r)
+      if(p.count>0){
+	p.tick_ns=_tick_ns;
+	v.push_back(p);
+      }
+    return v;
+  }
+
+  inline vector<TraceEvent> CnineProfiler::trace_events() const{
+    std::lock_guard<std::mutex> lock(mx);
+    vector<TraceEvent> r=retired_events;
+#ifndef CNINE_NO_PROFILING
+    for(auto b:buffers){
+      std::lock_guard<std::mutex> lock2(b->events_mx);
+      r.insert(r.end(),b->events.begin(),b->events.end());
+    }
+#endif
+    std::sort(r.begin(),r.end(),[](const TraceEvent& a, const TraceEvent& b){return a.t0<b.t0;});
+    return r;
+  }
+
+  inline size_t CnineProfiler::trace_dropped() const{
+    std::lock_guard<std::mutex> lock(mx);
+    size_t t=dropped_events;
+#ifndef CNINE_NO_PROFILING
+    for(auto b:buffers){
+      std::lock_guard<std::mutex> lock2(b->events_mx);
+      t+=b->dropped;
+    }
+#endif
+    return t;
+  }
+
+  inline void CnineProfiler::clear_trace(){
+    std::lock_guard<std::mutex> lock(mx);
+    retired_events.clear();
+    dropped_events=0;
+#ifndef CNINE_NO_PROFILING
+    for(auto b:buffers){
+      std::lock_guard<std::mutex> lock2(b->events_mx);
+      b->events.clear();
+      b->dropped=0;
+    }
+#endif
+  }
+
+  inline void CnineProfiler::reset(){
+    std::lock_guard<std::mutex> lock(mx);
+    for(auto& p:retired) p=ProfileSummary(p.name);
+#ifndef CNINE_NO_PROFILING
+    for(auto b:buffers)
+      for(int i=0; i<names.size(); i++){
+	ProfilerStats* p=b->sites[i].load(std::memory_order_acquire);
+	if(p) p->reset();
+      }
+#endif
+  }
+
+
+  // ---- Sites and scopes ------------------------------------------------------------------------------------
+
+
+#ifdef CNINE_NO_PROFILING
+
+  class ProfileSite{
+  public:
+    constexpr ProfileSite(const char* name){}
+  };
+
+  class ProfileScope{
+  public:
+    ProfileScope(const ProfileSite& site, const long long ops=0){}
+  };
+
+#else
+
+  class ProfileSite{
+  public:
+    int id;
+    ProfileSite(const char* name):
+      id(cnine_profiler.site_id(name)){}
+  };
+
+  class ProfileScope{
+  public:
+
+    int id;
+    long long ops;
+    uint64_t t0;
+
+    ProfileScope(const ProfileSite& site, const long long _ops=0):
+      id(site.id), ops(_ops), t0(profiler_ticks()){}
+
+    ~ProfileScope(){
+      uint64_t t1=profiler_ticks();
+      profiler_buffer.add(id,t1-t0,ops);
+      if(cnine_profiler.tracing.load(std::memory_order_relaxed))
+	profiler_buffer.add_event(id,t0,t1,ops);
+    }
+
+    ProfileScope(const ProfileScope& x)=delete;
+
+  };
+
+#endif
+
+}
+
+#endif
@@ -40,6 +40,7 @@ namespace cnine{
   extern float* cuda_oneS;
 
   extern thread_local int nthreads;
+  extern size_t parallel_grain;
 
 
   class cnine_session{
@@ -90,6 +91,7 @@ namespace cnine{
       ostringstream oss;
       cout<<indent<<"cnine session started "<<std::ctime(&start_time);
       cout<<indent<<"Number of CPU threads: "<<nthreads<<endl;
+      cout<<indent<<"Parallel grain size: "<<parallel_grain<<endl;
       cout<<indent<<"GPU footprint for streaming operations: "<<streaming_footprint<<" MB"<<endl;
       return oss.str();
     }
@@ -19,11 +19,14 @@
 #include "Factorial.hpp"
 #include "FFactorial.hpp"
 #include "DeltaFactor.hpp"
+#include "CnineProfiler.hpp"
 #include "CnineLog.hpp"
 #include "CnineCallStack.hpp"
 #include "GPUbuffer.hpp"
 #include "AsyncGPUbuffer.hpp"
 #include "MemoryManager.hpp"
+#include "HostMemoryManager.hpp"
+#include "ThreadPool.hpp"
 
 #ifdef _WITH_CENGINE
 #include "Cengine_base.cpp"
@@ -31,13 +34,22 @@
 
 namespace cnine{
 
+  // constructed before and destroyed after anything that may run profiled code
+  CnineProfiler cnine_profiler;
+  #ifndef CNINE_NO_PROFILING
+  thread_local ProfilerBuffer profiler_buffer;
+  #endif
+
   thread_local int nthreads=1;
+  size_t parallel_grain=32768;
+  ThreadPool thread_pool;
   float* cuda_oneS=nullptr;
 
   int streaming_footprint=1024;
   thread_local DeviceSelector dev_selector;
 
   thread_local MemoryManager* vram_manager=nullptr;
+  thread_local HostMemoryManager* host_manager=nullptr;
 
   Primes primes;
   Factorial factorial;
@@ -17,6 +17,7 @@
 
 #include "Cnine_base.hpp"
 #include "GindexSet.hpp"
+#include "small_vector.hpp"
 //#include "Bifstream.hpp"
 //#include "Bofstream.hpp"
 
@@ -24,10 +25,12 @@
 namespace cnine{
 
 
-  class Gdims: public vector<int>{
+  // Dimensions are stored inline up to 8 of them, so creating views does not touch the heap
+
+  class Gdims: public small_vector<int,8>{
   public:
 
-    typedef vector<int> BASE;
+    typedef small_vector<int,8> BASE;
     typedef std::size_t size_t;
 
 
@@ -41,26 +44,29 @@ namespace cnine{
       for(auto p:x) if(p>=0) BASE::push_back(p);
     }
 
+    Gdims(const int* beg, const int* end):
+      BASE(beg,end){}
+
     Gdims(const int i0): 
-      vector<int>(1){
+      BASE(1){
       (*this)[0]=i0;
     }
 
     Gdims(const int i0, const int i1): 
-      vector<int>(2){
+      BASE(2){
       (*this)[0]=i0;
       (*this)[1]=i1;
     }
 
     Gdims(const int i0, const int i1, const int i2): 
-      vector<int>(3){
+      BASE(3){
       (*this)[0]=i0;
       (*this)[1]=i1;
       (*this)[2]=i2;
     }
 
     Gdims(const int i0, const int i1, const int i2, const int i3): 
-      vector<int>(4){
+      BASE(4){
       (*this)[0]=i0;
       (*this)[1]=i1;
       (*this)[2]=i2;
@@ -68,7 +74,7 @@ namespace cnine{
     }
 
     Gdims(const int i0, const int i1, const int i2, const int i3, const int i4): 
-      vector<int>(5){
+      BASE(5){
       (*this)[0]=i0;
       (*this)[1]=i1;
       (*this)[2]=i2;
@@ -77,7 +83,7 @@ namespace cnine{
     }
 
     Gdims(const int i0, const int i1, const int i2, const int i3, const int i4, const int i5): 
-      vector<int>(6){
+      BASE(6){
       (*this)[0]=i0;
       (*this)[1]=i1;
       (*this)[2]=i2;
@@ -87,7 +93,7 @@ namespace cnine{
     }
 
     Gdims(const int i0, const int i1, const int i2, const int i3, const int i4, const int i5, const int i6): 
-      vector<int>(7){
+      BASE(7){
       (*this)[0]=i0;
       (*this)[1]=i1;
       (*this)[2]=i2;
@@ -98,13 +104,13 @@ namespace cnine{
     }
 
     Gdims(const Gdims& d1, const Gdims& d2): 
-      vector<int>(d1.size()+d2.size()){
+      BASE(d1.size()+d2.size()){
       for(int i=0; i<d1.size(); i++) (*this)[i]=d1[i];
       for(int i=0; i<d2.size(); i++) (*this)[i+d1.size()]=d2[i];
     }
 
     Gdims(const int b, const Gdims& d1, const Gdims& d2): 
-      vector<int>((b>0)+d1.size()+d2.size()){
+      BASE((b>0)+d1.size()+d2.size()){
       if(b>0){
 	(*this)[0]=b;
 	for(int i=0; i<d1.size(); i++) (*this)[1+i]=d1[i];
@@ -126,10 +132,10 @@ namespace cnine{
     }
 
     Gdims(const int k, const fill_raw& dummy): 
-      vector<int>(k){}
+      BASE(k){}
 
     Gdims(const int k, const fill_zero& dummy): 
-      vector<int>(k,0){}
+      BASE(k,0){}
 
 
   public: // ---- Named constructors -------------------------------------------------------------------------
@@ -471,19 +477,17 @@ namespace cnine{
     void foreach_index(const std::function<void(const vector<int>&)>& lambda) const{
       int k=size();
       if(k==0) return;
-      vector<int> strides(k);
-      strides[k-1]=1;
-      for(int i=k-2; i>=0; i--) 
-	strides[i]=strides[i+1]*(*this)[i+1];
-      int tot=strides[0]*(*this)[0];
-      for(int i=0; i<tot; i++){
-	vector<int> ix(k);
-	int t=i;
-	for(int j=0; j<k; j++){
-	  ix[j]=t/strides[j];
-	  t-=ix[j]*strides[j];
-	}
+      for(int j=0; j<k; j++)
+	if((*this)[j]==0) return;
+      vector<int> ix(k,0);
+      while(true){
 	lambda(ix);
+	int j=k-1;
+	for(; j>=0; j--){
+	  if(++ix[j]<(*this)[j]) break;
+	  ix[j]=0;
+	}
+	if(j<0) break;
       }
     }
 
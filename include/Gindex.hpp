@@ -22,19 +22,20 @@
 namespace cnine{
     
 
-  class Gindex: public vector<int>{
+  class Gindex: public small_vector<int,8>{
   public:
 
+    typedef small_vector<int,8> BASE;
     typedef std::size_t size_t;
 
 
     Gindex(){}
 
     Gindex(const int k, const fill_zero& dummy): 
-      vector<int>(k,0){}
+      BASE(k,0){}
 
     Gindex(const int k, const fill_raw& dummy): 
-      vector<int>(k){}
+      BASE(k){}
 
     Gindex(const fill_zero& dummy){
     }
@@ -43,30 +44,30 @@ namespace cnine{
       for(auto p:x) if(p>=0) push_back(p);
     }
 
-    Gindex(const initializer_list<int>& list): vector<int>(list){}
+    Gindex(const initializer_list<int>& list): BASE(list){}
 
     Gindex(const int i0):
       Gindex({i0}){}
 
-    Gindex(const int i0, const int i1): vector<int>(2){
+    Gindex(const int i0, const int i1): BASE(2){
       (*this)[0]=i0;
       (*this)[1]=i1;
     }
 
-    Gindex(const int i0, const int i1, const int i2): vector<int>(3){
+    Gindex(const int i0, const int i1, const int i2): BASE(3){
       (*this)[0]=i0;
       (*this)[1]=i1;
       (*this)[2]=i2;
     }
 
-    Gindex(const int i0, const int i1, const int i2, const int i3): vector<int>(4){
+    Gindex(const int i0, const int i1, const int i2, const int i3): BASE(4){
       (*this)[0]=i0;
       (*this)[1]=i1;
       (*this)[2]=i2;
       (*this)[3]=i3;
     }
 
-    Gindex(const int i0, const int i1, const int i2, const int i3, const int i4): vector<int>(5){
+    Gindex(const int i0, const int i1, const int i2, const int i3, const int i4): BASE(5){
       (*this)[0]=i0;
       (*this)[1]=i1;
       (*this)[2]=i2;
@@ -75,7 +76,7 @@ namespace cnine{
     }
 
     Gindex(size_t a, const Gdims& dims): 
-      vector<int>(dims.size()){
+      BASE(dims.size()){
       for(int i=size()-1; i>=0; i--){
 	(*this)[i]=a%dims[i];
 	a=a/dims[i];
@@ -83,7 +84,7 @@ namespace cnine{
     }
 
     Gindex(size_t a, vector<int> strides): 
-      vector<int>(strides.size()){
+      BASE(strides.size()){
       for(int i=size()-1; i>=1; i--){
 	(*this)[i]=(a%strides[i-1])/strides[i];
       }
@@ -74,7 +74,7 @@ namespace cnine{
     void foreach(const function<void(const Gindex&)>& fn) const{
       int as=asize();
       for(int i=0; i<as; i++)
-	fn(Gindex(i,static_cast<const Gindex&>(*this)));
+	fn(Gindex(i,vector<int>(*this)));
     }
 
 
@@ -25,9 +25,10 @@ namespace cnine{
   class TensorPackDir;
 
 
-  class GstridesB: public vector<std::size_t>{
+  class GstridesB: public small_vector<std::size_t,8>{
   public:
 
+    typedef small_vector<std::size_t,8> BASE;
     friend class TensorPackDir;
 
     typedef std::size_t size_t;
@@ -35,43 +36,42 @@ namespace cnine{
     GstridesB(){}
 
     GstridesB(const int k, const fill_raw& dummy): 
-      vector<size_t>(k){}
+      BASE(k){}
 
     GstridesB(const int k, const fill_zero& dummy): 
-      vector<size_t>(k,0){}
+      BASE(k,0){}
 
     GstridesB(const initializer_list<size_t>& lst):
-      vector<size_t>(lst){}
+      BASE(lst){}
 
-    GstridesB(const initializer_list<int>& lst):
-      vector<size_t>(lst.size()){
+    GstridesB(const initializer_list<int>& lst){
       for(auto p:lst)
 	push_back(p);
     }
 
-    GstridesB(const int i0): vector<size_t>(1){
+    GstridesB(const int i0): BASE(1){
       (*this)[0]=i0;
     }
 
-    GstridesB(const int i0, const int i1): vector<size_t>(2){
+    GstridesB(const int i0, const int i1): BASE(2){
       (*this)[0]=i0;
       (*this)[1]=i1;
     }
 
-    GstridesB(const int i0, const int i1, const int i2): vector<size_t>(3){
+    GstridesB(const int i0, const int i1, const int i2): BASE(3){
       (*this)[0]=i0;
       (*this)[1]=i1;
       (*this)[2]=i2;
     }
 
-    GstridesB(const int i0, const int i1, const int i2, const int i3): vector<size_t>(4){
+    GstridesB(const int i0, const int i1, const int i2, const int i3): BASE(4){
       (*this)[0]=i0;
       (*this)[1]=i1;
       (*this)[2]=i2;
       (*this)[3]=i3;
     }
 
-    GstridesB(const int i0, const int i1, const int i2, const int i3, const int i4): vector<size_t>(5){
+    GstridesB(const int i0, const int i1, const int i2, const int i3, const int i4): BASE(5){
       (*this)[0]=i0;
       (*this)[1]=i1;
       (*this)[2]=i2;
@@ -81,7 +81,7 @@ namespace cnine{
 
 
     GstridesB(const Gdims& dims, const int s0=1): 
-      vector<size_t>(dims.size()){
+      BASE(dims.size()){
       int k=dims.size();
       assert(k>0);
       (*this)[k-1]=s0;
@@ -91,11 +91,14 @@ namespace cnine{
     }
 
     GstridesB(const vector<int>& x):
-      vector<size_t>(x.size()){
+      BASE(x.size()){
       for(int i=0; i<x.size(); i++)
 	(*this)[i]=x[i];
     }
 
+    GstridesB(const int* beg, const int* end):
+      BASE(beg,end){}
+
 
 #ifdef _WITH_ATEN
     GstridesB(const at::Tensor& T):
@@ -132,7 +135,7 @@ namespace cnine{
       CNINE_ASSRT(size()==dims.size());
       if(is_regular(dims)) return true;
 
-      vector<size_t> v(*this);
+      BASE v(*this);
       int nz=0; 
       for(int i=0; i<size(); i++) 
 	if(v[i]>0) nz++;
@@ -199,6 +202,19 @@ namespace cnine{
       return t;
     }
 
+    // Same for Gindex and Gdims, without converting them to vector<int>
+    size_t operator()(const small_vector<int,8>& ix) const{
+      return offs(ix);
+    }
+
+    size_t offs(const small_vector<int,8>& ix) const{
+      CNINE_ASSRT(ix.size()<=size());
+      size_t t=0;
+      for(int i=0; i<ix.size(); i++)
+	t+=(*this)[i]*ix[i];
+      return t;
+    }
+
     size_t offs(const int i, const vector<int>& ix) const{
       CNINE_ASSRT(ix.size()<=size()-1);
       size_t t=((*this)[0]);
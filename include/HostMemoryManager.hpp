@@ -0,0 +1,271 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineHostMemoryManager
+#define _CnineHostMemoryManager
+
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+
+#include "Cnine_base.hpp"
+#include "MemoryManager.hpp"
+
+namespace cnine{
+
+
+  // Caching allocator for host memory. Requests are rounded up to one of four size classes
+  // per power of two and freed blocks are kept in per-class free lists for reuse, up to
+  // max_cached bytes in total. Every block is 64-byte aligned. Blocks of at least mmap_threshold
+  // bytes are mapped directly from the OS, so zeroed requests for them come for free.
+  // The state lives in a HostMemoryPool shared with every MemBlob allocated from it, so blobs
+  // that outlive the manager can still hand their blocks back.
+
+  class HostMemoryPool{
+  public:
+
+    static const int SL_LOG=2;
+    static const int NCLASSES=64<<SL_LOG;
+    static const size_t alignment=64;
+
+    struct BlockInfo{
+      int cls;
+      size_t size;
+      bool mapped;
+    };
+
+    size_t max_cached;
+    size_t mmap_threshold=size_t(1)<<20;
+    string name;
+    bool orphaned=false;
+
+    std::mutex mx;
+    vector<void*> cache[NCLASSES];
+    std::unordered_map<void*,BlockInfo> blocks;
+
+    size_t in_use=0;
+    size_t cached=0;
+    size_t high_water=0;
+    size_t nallocs=0;
+    size_t nhits=0;
+
+
+    HostMemoryPool(const string _name, const size_t _max_cached):
+      max_cached(_max_cached), name(_name){}
+
+    ~HostMemoryPool(){
+      clear();
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    void* allocate(const size_t _n, const bool zero){
+      int cls;
+      size_t n;
+      size_class(std::max(_n,alignment),cls,n);
+
+      std::unique_lock<std::mutex> lock(mx);
+      nallocs++;
+      in_use+=n;
+      if(cache[cls].size()>0){
+	void* p=cache[cls].back();
+	cache[cls].pop_back();
+	cached-=n;
+	nhits++;
+	high_water=std::max(high_water,in_use+cached);
+	lock.unlock();
+	if(zero) std::memset(p,0,n);
+	return p;
+      }
+      lock.unlock();
+
+      BlockInfo info{cls,n,n>=mmap_threshold};
+      void* p=nullptr;
+      if(info.mapped){
+	p=mmap(nullptr,n,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+	if(p==MAP_FAILED) p=nullptr;
+      }else{
+	p=std::aligned_alloc(alignment,(n+alignment-1)/alignment*alignment);
+	if(p && zero) std::memset(p,0,n);
+      }
+      if(!p){
+	lock.lock();
+	in_use-=n;
+	throw std::runtime_error("Memory manager "+name+": failed to allocate "+to_string(n)+" bytes.");
+      }
+
+      lock.lock();
+      blocks[p]=info;
+      high_water=std::max(high_water,in_use+cached);
+      return p;
+    }
+
+    // Returns false if p is not a live block of this pool. Once the manager is gone blocks
+    // go straight back to the OS instead of being cached.
+    bool deallocate(void* p) noexcept{
+      std::lock_guard<std::mutex> lock(mx);
+      auto it=blocks.find(p);
+      if(it==blocks.end()) return false;
+      BlockInfo& info=it->second;
+      in_use-=info.size;
+      if(!orphaned && cached+info.size<=max_cached){
+	cache[info.cls].push_back(p);
+	cached+=info.size;
+	return true;
+      }
+      release(p,info);
+      blocks.erase(it);
+      return true;
+    }
+
+    // Called when the manager goes away: drop the cache and stop caching from now on
+    void orphan(){
+      {std::lock_guard<std::mutex> lock(mx); orphaned=true;}
+      clear();
+    }
+
+    void clear(){
+      std::lock_guard<std::mutex> lock(mx);
+      for(int i=0; i<NCLASSES; i++){
+	for(auto p:cache[i]){
+	  auto it=blocks.find(p);
+	  release(p,it->second);
+	  blocks.erase(it);
+	}
+	cache[i].clear();
+      }
+      cached=0;
+    }
+
+
+  private: // ---- Internals ---------------------------------------------------------------------------------
+
+
+    static void release(void* p, const BlockInfo& info){
+      if(info.mapped) munmap(p,info.size);
+      else std::free(p);
+    }
+
+    // Round n up to the next size class: four classes per power of two
+    static void size_class(const size_t n, int& cls, size_t& size){
+      int fl=63-__builtin_clzll(n);
+      if(fl<SL_LOG){cls=0; size=size_t(1)<<SL_LOG; return;}
+      size_t step=size_t(1)<<(fl-SL_LOG);
+      size=(n+step-1)/step*step;
+      fl=63-__builtin_clzll(size);
+      cls=(fl<<SL_LOG)+(size>>(fl-SL_LOG))-(1<<SL_LOG);
+    }
+
+  };
+
+
+  class HostMemoryManager: public MemoryManager{
+  public:
+
+    shared_ptr<HostMemoryPool> pool;
+
+
+    HostMemoryManager(const size_t _max_cached=size_t(1)<<30):
+      pool(new HostMemoryPool("",_max_cached)){}
+
+    HostMemoryManager(const string _name, const size_t _max_cached=size_t(1)<<30):
+      pool(new HostMemoryPool(_name,_max_cached)){}
+
+    // Blocks still owned by live objects keep the pool alive and are returned to the OS
+    // when their owners free them
+    ~HostMemoryManager(){
+      pool->orphan();
+    }
+
+
+  public: // ---- Copying ------------------------------------------------------------------------------------
+
+
+    HostMemoryManager(const HostMemoryManager& x)=delete;
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    // Bytes currently held from the OS, in use or cached
+    size_t size() const{
+      std::lock_guard<std::mutex> lock(pool->mx);
+      return pool->in_use+pool->cached;
+    }
+
+    size_t high_water() const{
+      std::lock_guard<std::mutex> lock(pool->mx);
+      return pool->high_water;
+    }
+
+    void* malloc(const size_t n) const{
+      return pool->allocate(n,false);
+    }
+
+    // Allocate zeroed memory
+    void* calloc(const size_t n) const{
+      return pool->allocate(n,true);
+    }
+
+    void free(void* p) const{
+      if(!pool->deallocate(p))
+	throw std::runtime_error("Memory manager "+pool->name+" in free(void*): not a managed object or already deallocated.");
+    }
+
+    // Return all cached blocks to the OS
+    void clear() const{
+      pool->clear();
+    }
+
+
+  public: // ---- I/O ---------------------------------------------------------------------------------------
+
+
+    string str(const string indent="") const{
+      ostringstream oss;
+      std::lock_guard<std::mutex> lock(pool->mx);
+      oss<<indent<<"Host memory manager "<<pool->name<<":"<<endl;
+      oss<<indent<<"  In use:      "<<pool->in_use<<" bytes"<<endl;
+      oss<<indent<<"  Cached:      "<<pool->cached<<" bytes (limit "<<pool->max_cached<<")"<<endl;
+      oss<<indent<<"  High water:  "<<pool->high_water<<" bytes"<<endl;
+      oss<<indent<<"  Allocations: "<<pool->nallocs<<" ("<<pool->nhits<<" served from cache)"<<endl;
+      return oss.str();
+    }
+
+    friend ostream& operator<<(ostream& stream, const HostMemoryManager& x){
+      stream<<x.str(); return stream;
+    }
+
+  };
+
+
+  extern thread_local HostMemoryManager* host_manager;
+
+  class using_host_manager{
+  public:
+    HostMemoryManager* old;
+    using_host_manager(HostMemoryManager* mm){
+      old=host_manager;
+      host_manager=mm;
+    }
+    ~using_host_manager(){
+      host_manager=old;
+    }
+  };
+
+}
+
+#endif
@@ -52,10 +52,7 @@ namespace cnine{
       blob(new MemBlob<TYPE>(_memsize,_dev)){}
 
     MemArr(const size_t _memsize, const fill_zero& dummy, const int _dev=0):
-      MemArr(_memsize,_dev){
-      if(device()==0) std::fill(blob->arr,blob->arr+_memsize,0);
-      if(device()==1) CUDA_SAFE(cudaMemset(blob->arr,0,_memsize*sizeof(TYPE)));
-    }
+      blob(new MemBlob<TYPE>(_memsize,dummy,_dev)){}
 
     MemArr(const MemoryManager& manager, const size_t _memsize, const int _dev=0):
       blob(new MemBlob<TYPE>(manager,_memsize,_dev)){}
@@ -18,6 +18,7 @@
 #include "Cnine_base.hpp"
 #include "CnineCallStack.hpp"
 #include "MemoryManager.hpp"
+#include "HostMemoryManager.hpp"
 #include "fnlog.hpp"
 
 #ifdef _WITH_CUDA
@@ -35,6 +36,7 @@ namespace cnine{
 
   extern CallStack call_stack;
   extern thread_local MemoryManager* vram_manager;
+  extern thread_local HostMemoryManager* host_manager;
   extern CnineLog cnine_log;
 
 
@@ -48,9 +50,15 @@ namespace cnine{
     int dev=0;
     bool is_view=false;
     const MemoryManager* manager=nullptr;
+    shared_ptr<HostMemoryPool> host_pool;
 
     ~MemBlob(){
       if(is_view) return;
+      if(host_pool){
+	if(!host_pool->deallocate(static_cast<void*>(arr)))
+	  std::cerr<<"cnine warning: blob not owned by host memory manager "<<host_pool->name<<"."<<std::endl;
+	return;
+      }
       if(manager){
 	manager->free(static_cast<void*>(arr));
 	return;
@@ -75,19 +83,71 @@ namespace cnine{
 	return;
       }
 
+      if(host_manager && _dev==0 && host_manageable()){
+	host_pool=host_manager->pool;
+	arr=static_cast<TYPE*>(host_pool->allocate(_memsize*sizeof(TYPE),false));
+	std::uninitialized_default_construct_n(arr,_memsize);
+	return;
+      }
+
       //fnlog timer("MemBlob not managed");
       CPUCODE(arr=new TYPE[_memsize];);
       GPUCODE(CUDA_SAFE(cudaMalloc((void **)&arr, _memsize*sizeof(TYPE))););
     }
 
+    MemBlob(size_t _memsize, const fill_zero& dummy, const int _dev=0):
+      dev(_dev){
+      if(_memsize<1) _memsize=1;
+
+      if(host_manager && _dev==0 && host_manageable()){
+	host_pool=host_manager->pool;
+	arr=static_cast<TYPE*>(host_pool->allocate(_memsize*sizeof(TYPE),true));
+	return;
+      }
+
+      if(vram_manager && _dev>0){
+	manager=vram_manager;
+	arr=static_cast<TYPE*>(manager->malloc(_memsize*sizeof(TYPE)));
+      }else{
+	CPUCODE(arr=new TYPE[_memsize];);
+	GPUCODE(CUDA_SAFE(cudaMalloc((void **)&arr, _memsize*sizeof(TYPE))););
+      }
+      CPUCODE(std::fill(arr,arr+_memsize,0));
+      GPUCODE(CUDA_SAFE(cudaMemset(arr,0,_memsize*sizeof(TYPE))));
+    }
+
     MemBlob(const MemoryManager& _manager, size_t _memsize, const int _dev=0):
       dev(_dev),
       manager(&_manager){
       //fnlog timer("MemBlob explicitly managed");
+      // a host manager only serves host blobs of types it can manage, anything else is
+      // allocated the usual way
+      if(auto hm=dynamic_cast<const HostMemoryManager*>(&_manager)){
+	manager=nullptr;
+	if(_memsize<1) _memsize=1;
+	if(_dev==0 && host_manageable()){
+	  host_pool=hm->pool;
+	  arr=static_cast<TYPE*>(host_pool->allocate(_memsize*sizeof(TYPE),false));
+	  std::uninitialized_default_construct_n(arr,_memsize);
+	  return;
+	}
+	CPUCODE(arr=new TYPE[_memsize];);
+	GPUCODE(CUDA_SAFE(cudaMalloc((void **)&arr, _memsize*sizeof(TYPE))););
+	return;
+      }
       arr=static_cast<TYPE*>(manager->malloc(_memsize*sizeof(TYPE)));
     }
 
 
+  private:
+
+    // The host manager hands out raw memory, so only take types that need no destructor
+    // and for which all-zero bytes are a zero value
+    static constexpr bool host_manageable(){
+      return std::is_arithmetic<TYPE>::value || is_complex<TYPE>::value;
+    }
+
+
   public: // ---- Views --------------------------------------------------------------------------------------
 
 
@@ -24,7 +24,7 @@ namespace cnine{
 
     virtual ~MemoryManager(){};
     virtual size_t size() const=0;
-    virtual void* malloc(const int n) const=0;
+    virtual void* malloc(const size_t n) const=0;
     virtual void free(void* p) const=0;
     virtual void clear() const=0;
 
@@ -15,7 +15,7 @@
 
 #ifndef _MultiLoop
 #define _MultiLoop
-#include "ThreadGroup.hpp"
+#include "ThreadPool.hpp"
 
 namespace cnine{
 
@@ -25,6 +25,8 @@ namespace cnine{
   class MultiLoop{
   public:
     
+    // Run lambda(0),...,lambda(n-1) on the thread pool, at most nthreads at a time. Each
+    // iteration gets a budget of nthreads/n threads for its own nested loops.
     MultiLoop(const int n, std::function<void(int)> lambda){
 
       if(nthreads<=1){
@@ -32,9 +34,8 @@ namespace cnine{
 	return;
       }
       
-      ThreadGroup threads(nthreads);
-      for(int i=0; i<n; i++)
-	threads.add(std::max(1,nthreads/n),lambda,i);
+      thread_pool.parallel_for(n,[&](const size_t beg, const size_t end){
+	  for(size_t i=beg; i<end; i++) lambda(i);},1,std::max(1,nthreads/n));
 
     }
 
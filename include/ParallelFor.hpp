@@ -0,0 +1,86 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineParallelFor
+#define _CnineParallelFor
+
+#include "ThreadPool.hpp"
+
+namespace cnine{
+
+  extern thread_local int nthreads;
+  extern size_t parallel_grain;
+
+
+  // [0,n) is cut into chunks of at most grain elements. The chunking depends only on n and grain,
+  // never on the number of threads, so reductions are reproducible across thread counts.
+
+  inline size_t parallel_nchunks(const size_t n, const size_t grain){
+    if(n==0) return 0;
+    const size_t g=std::max<size_t>(grain,1);
+    return (n+g-1)/g;
+  }
+
+
+  // Call lambda(beg,end) on each chunk of [0,n), using up to nthreads threads of the pool. Inside
+  // the lambda nthreads is 1, so nested calls run serially.
+
+  template<typename FN>
+  void parallel_for(const size_t n, FN&& lambda, const size_t grain=parallel_grain){
+    if(nthreads<=1 || n<=grain){
+      if(n>0) lambda(size_t(0),n);
+      return;
+    }
+    thread_pool.parallel_for(n,lambda,grain);
+  }
+
+
+  // Reduce lambda(beg,end) over the chunks of [0,n). Partial results are combined in chunk order
+  // on the calling thread.
+
+  template<typename TYPE, typename FN, typename COMBINE>
+  TYPE parallel_reduce(const size_t n, const TYPE init, FN&& lambda, COMBINE&& combine, const size_t grain=parallel_grain){
+    return thread_pool.parallel_reduce(n,init,lambda,combine,grain);
+  }
+
+
+  // Sort [beg,end) by sorting chunks of grain elements in parallel and then merging neighbouring
+  // runs pairwise. Not stable across chunk boundaries.
+
+  template<typename IT, typename CMP>
+  void parallel_sort(IT beg, IT end, CMP&& cmp, const size_t grain=parallel_grain){
+    const size_t n=end-beg;
+    if(nthreads<=1 || n<=grain){
+      std::sort(beg,end,cmp);
+      return;
+    }
+    const size_t nchunks=parallel_nchunks(n,grain);
+    parallel_for(nchunks,[&](const size_t b, const size_t e){
+	for(size_t c=b; c<e; c++)
+	  std::sort(beg+c*grain,beg+std::min(n,(c+1)*grain),cmp);
+      },1);
+    for(size_t w=grain; w<n; w*=2){
+      const size_t npairs=(n+2*w-1)/(2*w);
+      parallel_for(npairs,[&](const size_t b, const size_t e){
+	  for(size_t c=b; c<e; c++){
+	    const size_t mid=std::min(n,c*2*w+w);
+	    std::inplace_merge(beg+c*2*w,beg+mid,beg+std::min(n,(c+1)*2*w),cmp);
+	  }
+	},1);
+    }
+  }
+
+}
+
+#endif
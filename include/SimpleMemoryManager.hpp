@@ -45,6 +45,7 @@ namespace cnine{
     int granularity=128;
     string name;
 
+    mutable std::mutex mx;
     mutable std::list<SimpleMemoryBlock> blocks;
     mutable std::unordered_map<void*,block_it> block_map;
 
@@ -90,9 +91,10 @@ namespace cnine{
     }
 
 
-    void* malloc(const int _n) const{
+    void* malloc(const size_t _n) const{
 
-      int n=roundup(_n,granularity);
+      std::lock_guard<std::mutex> lock(mx);
+      size_t n=(_n+granularity-1)/granularity*granularity;
       block_it it=blocks.begin();
       while(it!=blocks.end() && (it->used || it->size<n)){
 	//cout<<it->size<<endl;
@@ -114,6 +116,7 @@ namespace cnine{
 
 
     void free(void* _p) const{
+      std::lock_guard<std::mutex> lock(mx);
 
       void* p=static_cast<void*>(_p);
       auto itt=block_map.find(p);
@@ -124,8 +127,8 @@ namespace cnine{
       block_it it=itt->second;
       it->used=false;
       
-      if(it!=blocks.end()){
-	block_it next=std::next(it);
+      block_it next=std::next(it);
+      if(next!=blocks.end()){
 	if(!next->used){
 	  it->size+=next->size;
 	  blocks.erase(next);
@@ -143,6 +146,7 @@ namespace cnine{
     }
 
     void clear() const{
+      std::lock_guard<std::mutex> lock(mx);
       blocks.clear();
       block_map.clear();
       blocks.push_back(SimpleMemoryBlock(0,_size));
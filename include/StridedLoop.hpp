@@ -0,0 +1,257 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineStridedLoop
+#define _CnineStridedLoop
+
+#include "Cnine_base.hpp"
+#include "Gdims.hpp"
+#include "GstridesB.hpp"
+#include "ParallelFor.hpp"
+
+
+// Elementwise iteration over N operands that share the same dimensions but have arbitrary
+// strides. Dimensions of extent one are dropped, the rest are ordered by decreasing stride and
+// neighbouring dimensions that are laid out contiguously in every operand are fused, so most
+// views reduce to one or two loops. The last dimension is walked as a tight pointer loop, the
+// outer ones by an odometer that only adds and subtracts strides. No memory is allocated.
+
+namespace cnine{
+
+
+  template<int N>
+  class StridedLoop{
+  public:
+
+    static constexpr int max_dims=16;
+
+    int k=0; // number of loops after fusing
+    int n[max_dims];
+    size_t s[N][max_dims];
+    size_t outer=1; // number of runs of the innermost loop
+    bool empty=false;
+    int tiled=-1; // if >=0, this loop and the innermost one are traversed in tiles
+
+    static constexpr int tile=32;
+
+
+    StridedLoop(const Gdims& dims, const std::array<const GstridesB*,N>& strides){
+      int perm[max_dims];
+      for(int i=0; i<dims.size(); i++){
+	if(dims[i]==0) empty=true;
+	if(dims[i]<=1) continue;
+	CNINE_ASSRT(k<max_dims);
+	perm[k++]=i;
+      }
+
+      // Innermost loop over the smallest strides of the first operand, ties broken by the others
+      std::stable_sort(perm,perm+k,[&](const int a, const int b){
+	  for(int o=0; o<N; o++)
+	    if((*strides[o])[a]!=(*strides[o])[b]) return (*strides[o])[a]>(*strides[o])[b];
+	  return false;});
+
+      int m=0;
+      for(int j=0; j<k; j++){
+	const int i=perm[j];
+	bool fuse=(m>0);
+	for(int o=0; o<N && fuse; o++)
+	  if(s[o][m-1]!=dims[i]*(*strides[o])[i]) fuse=false;
+	if(fuse){
+	  n[m-1]*=dims[i];
+	  for(int o=0; o<N; o++) s[o][m-1]=(*strides[o])[i];
+	  continue;
+	}
+	n[m]=dims[i];
+	for(int o=0; o<N; o++) s[o][m]=(*strides[o])[i];
+	m++;
+      }
+      k=m;
+
+      if(k==0){
+	k=1;
+	n[0]=1;
+	for(int o=0; o<N; o++) s[o][0]=0;
+      }
+      for(int j=0; j<k-1; j++)
+	outer*=n[j];
+
+      // If an operand is accessed with a large stride in the innermost loop but has a smaller
+      // stride in one of the outer loops, as in copying a transposed matrix, the two loops are
+      // traversed in tiles so that the cache lines of both operands are reused
+      int worst=-1;
+      for(int o=1; o<N; o++)
+	if(s[o][k-1]>1 && (worst<0 || s[o][k-1]>s[worst][k-1])) worst=o;
+      if(worst>=0 && n[k-1]>tile){
+	int t=-1;
+	for(int j=0; j<k-1; j++)
+	  if(n[j]>tile && s[worst][j]<s[worst][k-1] && (t<0 || s[worst][j]<s[worst][t])) t=j;
+	tiled=t;
+      }
+    }
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    int inner() const{
+      return n[k-1];
+    }
+
+    size_t inner_stride(const int o) const{
+      return s[o][k-1];
+    }
+
+    // Runs can be processed in parallel if the first operand, which is written to, has no
+    // broadcast dimensions
+    bool disjoint() const{
+      for(int j=0; j<k; j++)
+	if(s[0][j]==0 && n[j]>1) return false;
+      return true;
+    }
+
+
+  public: // ---- Iteration ----------------------------------------------------------------------------------
+
+
+    // Call fn(offs,inner()) at the start of each run of the innermost loop, where offs[o] is the
+    // offset of the run in operand o
+    template<typename FN>
+    void for_each_run(FN&& fn, const bool parallel=true) const{
+      if(empty) return;
+      if(tiled>=0){
+	const size_t ntiles=outer/n[tiled]*((n[tiled]+tile-1)/tile);
+	if(!parallel || !disjoint()){
+	  tiled_runs(0,ntiles,fn);
+	  return;
+	}
+	const size_t grain=std::max<size_t>(1,parallel_grain/((size_t)tile*inner()));
+	parallel_for(ntiles,[&](const size_t beg, const size_t end){
+	    tiled_runs(beg,end,fn);},grain);
+	return;
+      }
+      if(!parallel || !disjoint()){
+	runs(0,outer,fn);
+	return;
+      }
+      const size_t grain=std::max<size_t>(1,parallel_grain/std::max(inner(),1));
+      parallel_for(outer,[&](const size_t beg, const size_t end){
+	  runs(beg,end,fn);},grain);
+    }
+
+
+  private:
+
+    // Each unit of work is a band of tile rows of the tiled loop, for one value of the other outer
+    // loops. Within the band the innermost loop is cut into runs of at most tile elements.
+    template<typename FN>
+    void tiled_runs(const size_t beg, const size_t end, FN& fn) const{
+      const int nb=(n[tiled]+tile-1)/tile;
+      size_t base[N];
+      size_t offs[N];
+      for(size_t u=beg; u<end; u++){
+	size_t t=u/nb;
+	const int i0=(u%nb)*tile;
+	const int i1=std::min(n[tiled],i0+tile);
+	for(int o=0; o<N; o++) base[o]=0;
+	for(int j=k-2; j>=0; j--){
+	  if(j==tiled) continue;
+	  const int ix=t%n[j];
+	  t/=n[j];
+	  for(int o=0; o<N; o++) base[o]+=ix*s[o][j];
+	}
+	for(int jb=0; jb<inner(); jb+=tile){
+	  const int m=std::min(tile,inner()-jb);
+	  for(int i=i0; i<i1; i++){
+	    for(int o=0; o<N; o++) offs[o]=base[o]+i*s[o][tiled]+jb*s[o][k-1];
+	    fn(static_cast<const size_t*>(offs),m);
+	  }
+	}
+      }
+    }
+
+    template<typename FN>
+    void runs(const size_t beg, const size_t end, FN& fn) const{
+      int ix[max_dims];
+      size_t offs[N];
+      for(int o=0; o<N; o++) offs[o]=0;
+      size_t t=beg;
+      for(int j=k-2; j>=0; j--){
+	ix[j]=t%n[j];
+	t/=n[j];
+	for(int o=0; o<N; o++) offs[o]+=ix[j]*s[o][j];
+      }
+      for(size_t r=beg; r<end; r++){
+	fn(static_cast<const size_t*>(offs),inner());
+	for(int j=k-2; j>=0; j--){
+	  for(int o=0; o<N; o++) offs[o]+=s[o][j];
+	  if(++ix[j]<n[j]) break;
+	  for(int o=0; o<N; o++) offs[o]-=n[j]*s[o][j];
+	  ix[j]=0;
+	}
+      }
+    }
+
+  };
+
+
+  // ---- Elementwise functions ------------------------------------------------------------------------------
+
+
+  // fn(x) for each element x of a strided array
+  template<typename T0, typename FN>
+  void strided_for_each(const Gdims& dims, T0* p0, const GstridesB& s0, FN&& fn, const bool parallel=true){
+    StridedLoop<1> loop(dims,{&s0});
+    const size_t i0=loop.inner_stride(0);
+    loop.for_each_run([&](const size_t* offs, const int m){
+	T0* a=p0+offs[0];
+	if(i0==1) for(int j=0; j<m; j++) fn(a[j]);
+	else for(int j=0; j<m; j++) fn(a[j*i0]);
+      },parallel);
+  }
+
+  // fn(r,x) for each pair of corresponding elements
+  template<typename T0, typename T1, typename FN>
+  void strided_for_each(const Gdims& dims, T0* p0, const GstridesB& s0, T1* p1, const GstridesB& s1,
+    FN&& fn, const bool parallel=true){
+    StridedLoop<2> loop(dims,{&s0,&s1});
+    const size_t i0=loop.inner_stride(0);
+    const size_t i1=loop.inner_stride(1);
+    loop.for_each_run([&](const size_t* offs, const int m){
+	T0* a=p0+offs[0];
+	T1* b=p1+offs[1];
+	if(i0==1 && i1==1) for(int j=0; j<m; j++) fn(a[j],b[j]);
+	else for(int j=0; j<m; j++) fn(a[j*i0],b[j*i1]);
+      },parallel);
+  }
+
+  // fn(r,x,y) for each triple of corresponding elements
+  template<typename T0, typename T1, typename T2, typename FN>
+  void strided_for_each(const Gdims& dims, T0* p0, const GstridesB& s0, T1* p1, const GstridesB& s1,
+    T2* p2, const GstridesB& s2, FN&& fn, const bool parallel=true){
+    StridedLoop<3> loop(dims,{&s0,&s1,&s2});
+    const size_t i0=loop.inner_stride(0);
+    const size_t i1=loop.inner_stride(1);
+    const size_t i2=loop.inner_stride(2);
+    loop.for_each_run([&](const size_t* offs, const int m){
+	T0* a=p0+offs[0];
+	T1* b=p1+offs[1];
+	T2* c=p2+offs[2];
+	if(i0==1 && i1==1 && i2==1) for(int j=0; j<m; j++) fn(a[j],b[j],c[j]);
+	else for(int j=0; j<m; j++) fn(a[j*i0],b[j*i1],c[j*i2]);
+      },parallel);
+  }
+
+}
+
+#endif
@@ -0,0 +1,339 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineTLSFmemoryManager
+#define _CnineTLSFmemoryManager
+
+#include "Cnine_base.hpp"
+#include "MemoryManager.hpp"
+
+namespace cnine{
+
+
+  // Two-level segregated fit allocator over a single arena. Free blocks are kept in size
+  // classes indexed by the position of the leading bit of their size (first level) and the
+  // next SL_LOG bits (second level). Two levels of bitmaps locate a large enough free block
+  // in O(1), and freed blocks are merged with their free physical neighbours in O(1).
+  // The block records live on the host, so the arena can equally be device memory.
+
+  class TLSFmemoryManager: public MemoryManager{
+  public:
+
+    static const int SL_LOG=4;
+    static const int SL_COUNT=1<<SL_LOG;
+    static const int FL_COUNT=64;
+
+    struct Block{
+      size_t beg;
+      size_t size;
+      bool free=true;
+      int prev_phys=-1;
+      int next_phys=-1;
+      int prev_free=-1;
+      int next_free=-1;
+    };
+
+    size_t _size;
+    int dev=0;
+    void* arr=nullptr;
+    size_t granularity=256;
+    string name;
+
+    mutable std::mutex mx;
+    mutable vector<Block> blocks;
+    mutable vector<int> spare_blocks;
+    mutable std::unordered_map<size_t,int> live;
+
+    mutable uint64_t fl_bitmap=0;
+    mutable uint32_t sl_bitmap[FL_COUNT];
+    mutable int heads[FL_COUNT][SL_COUNT];
+
+    mutable size_t used=0;
+    mutable size_t high_water=0;
+    mutable size_t nallocs=0;
+    mutable size_t nfailed=0;
+
+
+    TLSFmemoryManager(const size_t __size, const int _dev=0):
+      dev(_dev){
+      _size=(__size/granularity)*granularity;
+      if(_size==0) _size=granularity;
+      if(dev==0) arr=::malloc(_size);
+      if(dev==1) CUDA_SAFE(cudaMalloc((void **)&arr,_size));
+      reset();
+    }
+
+    TLSFmemoryManager(const string _name, const size_t __size, const int _dev=0):
+      TLSFmemoryManager(__size,_dev){
+      name=_name;
+    }
+
+    ~TLSFmemoryManager(){
+      if(dev==0 && arr) {::free(arr);}
+      if(dev==1 && arr) {CUDA_SAFE(cudaFree(arr));}
+    }
+
+
+  public: // ---- Copying ------------------------------------------------------------------------------------
+
+
+    TLSFmemoryManager(const TLSFmemoryManager& x)=delete;
+
+
+  public: // ---- Access -------------------------------------------------------------------------------------
+
+
+    size_t size() const{
+      return _size;
+    }
+
+    size_t get_used() const{
+      std::lock_guard<std::mutex> lock(mx);
+      return used;
+    }
+
+    size_t get_high_water() const{
+      std::lock_guard<std::mutex> lock(mx);
+      return high_water;
+    }
+
+    template<typename TYPE>
+    TYPE* alloc(const size_t n) const{
+      return static_cast<TYPE*>(malloc(n*sizeof(TYPE)));
+    }
+
+
+    void* malloc(const size_t _n) const{
+      std::lock_guard<std::mutex> lock(mx);
+      size_t n=std::max((_n+granularity-1)/granularity*granularity,granularity);
+
+      int fl,sl;
+      mapping_search(n,fl,sl);
+      int b=find_free(fl,sl);
+      if(b<0){
+	nfailed++;
+	throw std::runtime_error("Memory manager "+name+": out of space.");
+      }
+      remove_free(b);
+
+      if(blocks[b].size>=n+granularity){
+	int r=new_block();
+	Block& block=blocks[b];
+	Block& rest=blocks[r];
+	rest.beg=block.beg+n;
+	rest.size=block.size-n;
+	rest.prev_phys=b;
+	rest.next_phys=block.next_phys;
+	if(block.next_phys>=0) blocks[block.next_phys].prev_phys=r;
+	block.next_phys=r;
+	block.size=n;
+	insert_free(r);
+      }
+
+      Block& block=blocks[b];
+      block.free=false;
+      live[block.beg]=b;
+      used+=block.size;
+      high_water=std::max(high_water,used);
+      nallocs++;
+      return static_cast<void*>(static_cast<char*>(arr)+block.beg);
+    }
+
+
+    void free(void* p) const{
+      std::lock_guard<std::mutex> lock(mx);
+      size_t offs=static_cast<char*>(p)-static_cast<char*>(arr);
+      auto it=live.find(offs);
+      if(it==live.end())
+	throw std::runtime_error("Memory manager "+name+" in free(void*): not a managed object or already deallocated.");
+      int b=it->second;
+      live.erase(it);
+      used-=blocks[b].size;
+      blocks[b].free=true;
+
+      int next=blocks[b].next_phys;
+      if(next>=0 && blocks[next].free){
+	remove_free(next);
+	absorb_next(b);
+      }
+      int prev=blocks[b].prev_phys;
+      if(prev>=0 && blocks[prev].free){
+	remove_free(prev);
+	absorb_next(prev);
+	b=prev;
+      }
+      insert_free(b);
+    }
+
+
+    void clear() const{
+      std::lock_guard<std::mutex> lock(mx);
+      reset();
+    }
+
+
+  public: // ---- Statistics ---------------------------------------------------------------------------------
+
+
+    // Largest single allocation that would currently succeed
+    size_t largest_free() const{
+      std::lock_guard<std::mutex> lock(mx);
+      size_t t=0;
+      for(int b=0; b>=0; b=blocks[b].next_phys)
+	if(blocks[b].free) t=std::max(t,blocks[b].size);
+      return t;
+    }
+
+    // 1 - (largest free block)/(total free memory): 0 means the free memory is in one piece
+    float fragmentation() const{
+      size_t free_total=_size-get_used();
+      if(free_total==0) return 0;
+      return 1.0-((float)largest_free())/free_total;
+    }
+
+
+  private: // ---- Internals ---------------------------------------------------------------------------------
+
+
+    void reset() const{
+      blocks.clear();
+      spare_blocks.clear();
+      live.clear();
+      fl_bitmap=0;
+      for(int i=0; i<FL_COUNT; i++){
+	sl_bitmap[i]=0;
+	for(int j=0; j<SL_COUNT; j++)
+	  heads[i][j]=-1;
+      }
+      used=0;
+      Block block;
+      block.beg=0;
+      block.size=_size;
+      blocks.push_back(block);
+      insert_free(0);
+    }
+
+    static int fls(const size_t x){
+      return 63-__builtin_clzll(x);
+    }
+
+    static int ffs(const uint64_t x){
+      return __builtin_ctzll(x);
+    }
+
+    // Size class containing n
+    static void mapping(const size_t n, int& fl, int& sl){
+      fl=fls(n);
+      if(fl<SL_LOG) {sl=n; fl=0; return;}
+      sl=(n>>(fl-SL_LOG))-SL_COUNT;
+    }
+
+    // Smallest size class all of whose blocks can hold n
+    static void mapping_search(const size_t n, int& fl, int& sl){
+      size_t m=n;
+      int f=fls(n);
+      if(f>=SL_LOG) m+=(size_t(1)<<(f-SL_LOG))-1;
+      mapping(m,fl,sl);
+    }
+
+    int find_free(int fl, int sl) const{
+      uint32_t sl_map=sl_bitmap[fl]&(~uint32_t(0)<<sl);
+      if(sl_map==0){
+	if(fl+1>=FL_COUNT) return -1;
+	uint64_t fl_map=fl_bitmap&(~uint64_t(0)<<(fl+1));
+	if(fl_map==0) return -1;
+	fl=ffs(fl_map);
+	sl_map=sl_bitmap[fl];
+      }
+      sl=ffs(sl_map);
+      return heads[fl][sl];
+    }
+
+    void insert_free(const int b) const{
+      Block& block=blocks[b];
+      int fl,sl;
+      mapping(block.size,fl,sl);
+      block.free=true;
+      block.prev_free=-1;
+      block.next_free=heads[fl][sl];
+      if(block.next_free>=0) blocks[block.next_free].prev_free=b;
+      heads[fl][sl]=b;
+      fl_bitmap|=uint64_t(1)<<fl;
+      sl_bitmap[fl]|=uint32_t(1)<<sl;
+    }
+
+    void remove_free(const int b) const{
+      Block& block=blocks[b];
+      int fl,sl;
+      mapping(block.size,fl,sl);
+      if(block.prev_free>=0) blocks[block.prev_free].next_free=block.next_free;
+      else heads[fl][sl]=block.next_free;
+      if(block.next_free>=0) blocks[block.next_free].prev_free=block.prev_free;
+      if(heads[fl][sl]<0){
+	sl_bitmap[fl]&=~(uint32_t(1)<<sl);
+	if(sl_bitmap[fl]==0) fl_bitmap&=~(uint64_t(1)<<fl);
+      }
+      block.free=false;
+      block.prev_free=block.next_free=-1;
+    }
+
+    // Merge the physical successor of b into b
+    void absorb_next(const int b) const{
+      int next=blocks[b].next_phys;
+      blocks[b].size+=blocks[next].size;
+      blocks[b].next_phys=blocks[next].next_phys;
+      if(blocks[next].next_phys>=0) blocks[blocks[next].next_phys].prev_phys=b;
+      spare_blocks.push_back(next);
+    }
+
+    int new_block() const{
+      if(spare_blocks.size()>0){
+	int b=spare_blocks.back();
+	spare_blocks.pop_back();
+	blocks[b]=Block();
+	return b;
+      }
+      blocks.push_back(Block());
+      return blocks.size()-1;
+    }
+
+
+  public: // ---- I/O ---------------------------------------------------------------------------------------
+
+
+    string str(const string indent="") const{
+      ostringstream oss;
+      size_t _used=get_used();
+      size_t _largest=largest_free();
+      oss<<indent<<"TLSF memory manager "<<name<<" (size="<<size()<<"):"<<endl;
+      {
+	std::lock_guard<std::mutex> lock(mx);
+	oss<<indent<<"  Used:          "<<_used<<" bytes in "<<live.size()<<" blocks"<<endl;
+	oss<<indent<<"  High water:    "<<high_water<<" bytes"<<endl;
+	oss<<indent<<"  Largest free:  "<<_largest<<" bytes"<<endl;
+	oss<<indent<<"  Fragmentation: "<<((_size>_used)?1.0-((float)_largest)/(_size-_used):0)<<endl;
+	oss<<indent<<"  Allocations:   "<<nallocs<<" ("<<nfailed<<" failed)"<<endl;
+      }
+      return oss.str();
+    }
+
+    friend ostream& operator<<(ostream& stream, const TLSFmemoryManager& x){
+      stream<<x.str(); return stream;
+    }
+
+  };
+
+}
+
+#endif
@@ -16,21 +16,20 @@
 #ifndef _ThreadGroup
 #define _ThreadGroup
 
-#include <thread>
-#include <condition_variable>
-#include <atomic>
+#include <iostream>
+#include "ThreadPool.hpp"
 
 namespace cnine{
 
+  // A batch of jobs run on the shared thread pool, at most maxthreads of them at a time. wait()
+  // rethrows the first exception thrown by any of the jobs. The destructor waits for all of them
+  // too, but can only report such an exception on cerr.
+
   class ThreadGroup{
   public:
 
     int maxthreads=4;
-    mutex mx;
-    condition_variable start_thread_cv;
-    mutex start_thread_mx;
-    atomic<int> nrunning;
-    vector<thread> threads;
+    ThreadPoolTaskGroup group;
 
 
   public:
@@ -39,39 +38,40 @@ namespace cnine{
     ThreadGroup()=delete;
   
     ThreadGroup(const int _maxthreads=4): 
-      maxthreads(_maxthreads){
-      nrunning=0;
+      maxthreads(std::max(_maxthreads,1)){
+      thread_pool.ensure_workers(maxthreads);
     }
 
     ~ThreadGroup(){
-      for(auto& p:threads)
-	p.join();
+      try{
+	wait();
+      }catch(const std::exception& e){
+	std::cerr<<"cnine error: exception in ThreadGroup job: "<<e.what()<<std::endl;
+      }catch(...){
+	std::cerr<<"cnine error: exception in ThreadGroup job."<<std::endl;
+      }
     }
 
 
   public:
 
+    // Blocks while maxthreads jobs of the group are still pending
     template<typename FUNCTION, typename OBJ>
     void add(const int nsubthreads, FUNCTION lambda, OBJ arg0){
-      lock_guard<mutex> guard(mx);
-
-      if(nrunning>=maxthreads){
-	unique_lock<mutex> lock(start_thread_mx);
-	start_thread_cv.wait(lock,[this](){return nrunning<maxthreads;});
-      }
-
-      nrunning++;
-      threads.push_back(thread([this,nsubthreads,lambda,arg0](){
-	    nthreads=nsubthreads;
-	    lambda(arg0);
-	    this->done();
-	  }));
+      thread_pool.wait_below(group,maxthreads);
+      thread_pool.submit(group,[lambda,arg0](){lambda(arg0);},nsubthreads);
     }	 
 
-
-    void done(){
-      nrunning--;
-      start_thread_cv.notify_one();
+    void wait(){
+      std::exception_ptr e;
+      try{
+	thread_pool.wait(group);
+      }catch(...){
+	e=std::current_exception();
+	std::lock_guard<std::mutex> lock(group.err_mx);
+	group.err=nullptr; // reported once
+      }
+      if(e) std::rethrow_exception(e);
     }
 
   };
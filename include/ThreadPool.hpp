@@ -1,14 +1,13 @@
-
 /*
- * This file is part of cnine, a lightweight C++ tensor library. 
- *  
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
  * Copyright (c) 2021, Imre Risi Kondor
  *
- * This source code file is subject to the terms of the noncommercial 
- * license distributed with cnine in the file LICENSE.TXT. Commercial 
- * use is prohibited. All redistributed versions of this file (in 
- * original or modified form) must retain this copyright notice and 
- * must be accompanied by a verbatim copy of the license. 
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
  *
  */
 
@@ -16,65 +15,305 @@
 #ifndef _ThreadPool
 #define _ThreadPool
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <exception>
+#include <algorithm>
+
 namespace cnine{
 
+  extern thread_local int nthreads;
+
+
+  // A set of tasks that can be waited on together. The first exception thrown by any of
+  // the tasks is rethrown by ThreadPool::wait.
+
+  class ThreadPoolTaskGroup{
+  public:
+
+    std::atomic<int> pending;
+    std::exception_ptr err=nullptr;
+    std::mutex err_mx;
+    std::mutex mx; // guards the wakeup of threads waiting on the group
+    std::condition_variable cv;
+
+    ThreadPoolTaskGroup(){
+      pending=0;
+    }
+
+    void set_error(std::exception_ptr e){
+      std::lock_guard<std::mutex> lock(err_mx);
+      if(!err) err=e;
+    }
+
+    // Called by the thread that finished a task. The group may be destroyed as soon as
+    // pending drops, so the decrement and the notification both happen under mx.
+    void task_done(){
+      std::lock_guard<std::mutex> lock(mx);
+      pending--;
+      cv.notify_all();
+    }
+
+  };
+
+
+  // Persistent work-stealing pool. Each worker owns a deque: tasks spawned from inside a
+  // worker go to the back of its own deque and are popped LIFO, idle workers steal from
+  // the front of the others' deques. Threads waiting on a task group execute queued tasks
+  // in the meantime, so tasks can spawn and wait on nested tasks without deadlocking.
+  // Workers are only started when a parallel region first asks for them.
+
   class ThreadPool{
   public:
 
-    mutex mx;
-    mutex gate;
-    atomic<int> nthreads;
-    int maxthreads=4;
-    vector<thread> threads;
+    static const int max_workers=256;
+
+    struct Task{
+      std::function<void()> fn;
+      ThreadPoolTaskGroup* group=nullptr;
+      int nsub=1;
+    };
+
+    struct Worker{
+      std::mutex mx;
+      std::deque<Task> queue;
+      std::thread thread;
+    };
+
+    Worker* workers[max_workers];
+    std::atomic<int> nworkers;
+    std::atomic<int> nqueued;
+    std::atomic<unsigned> next_queue;
+    std::mutex grow_mx;
+
+    std::mutex sleep_mx;
+    std::condition_variable sleep_cv;
+    bool shutting_down=false;
+
+    inline static thread_local int worker_id=-1;
 
 
   public:
 
-    ThreadPool()=delete;
-  
-    ThreadPool(const int _maxthreads=4): 
-      maxthreads(_maxthreads){}
+    ThreadPool(){
+      nworkers=0;
+      nqueued=0;
+      next_queue=0;
+    }
+
+    ThreadPool(const ThreadPool& x)=delete;
+    ThreadPool& operator=(const ThreadPool& x)=delete;
 
     ~ThreadPool(){
-      while(nrunning>0){
-	running_cv.wait();
+      {
+	std::lock_guard<std::mutex> lock(sleep_mx);
+	shutting_down=true;
+      }
+      sleep_cv.notify_all();
+      for(int i=0; i<nworkers; i++){
+	workers[i]->thread.join();
+	delete workers[i];
       }
     }
 
 
-  public:
+  public: // ---- Access -------------------------------------------------------------------------------------
+
 
-    template<class FUNCTION>
-    launch(FUNCTION lambda){
-      
+    int get_nworkers() const{
+      return nworkers;
     }
 
+    // Make sure there are at least n worker threads
+    void ensure_workers(const int n){
+      if(nworkers>=n) return;
+      std::lock_guard<std::mutex> lock(grow_mx);
+      int k=nworkers;
+      const int target=std::min(n,(int)max_workers);
+      for(; k<target; k++){
+	Worker* w=new Worker();
+	workers[k]=w;
+	w->thread=std::thread([this,k](){worker_loop(k);});
+	nworkers=k+1;
+      }
+    }
 
-    template<class FUNCTION, class OBJ>
-    inline void ThreadPool::add(FUNCTION lambda, const OBJ x){
-      lock_guard<mutex> lock(mx); //                                   unnecessary if called from a single thread
-      threadManager.enqueue(this);
-      gate.lock(); //                                                  gate can only be unlocked by threadManager
-      nthreads++;
-      threads.push_back(thread([this,lambda](OBJ _x){
-	    lambda(_x); 
-	    nthreads--; threadManager.release(this);},x));
-      #ifdef _THREADBANKVERBOSE
-      printinfo();
-      #endif
- }
 
+  public: // ---- Tasks --------------------------------------------------------------------------------------
 
 
-    bool is_ready(){return nthreads<maxthreads;}
+    // Queue lambda as part of group. The task runs with nthreads set to nsub.
+    void submit(ThreadPoolTaskGroup& group, std::function<void()> lambda, const int nsub=1){
+      if(nworkers==0) ensure_workers(1);
+      group.pending++;
+      int q=worker_id;
+      if(q<0) q=(next_queue++)%unsigned(nworkers);
+      {
+	Worker& w=*workers[q];
+	std::lock_guard<std::mutex> lock(w.mx);
+	Task task;
+	task.fn=std::move(lambda);
+	task.group=&group;
+	task.nsub=nsub;
+	w.queue.push_back(std::move(task));
+      }
+      nqueued++;
+      {std::lock_guard<std::mutex> lock(sleep_mx);}
+      sleep_cv.notify_one();
+    }
 
-    void printinfo();
+    // Block until every task in group has finished, running queued tasks in the meantime
+    void wait(ThreadPoolTaskGroup& group){
+      wait_below(group,1);
+      if(group.err) std::rethrow_exception(group.err);
+    }
+
+    // Block until fewer than n tasks of group are pending, running queued tasks in the meantime.
+    // When there is nothing to run the thread sleeps on the group's condition variable. Tasks
+    // queued while it sleeps go to the workers; the timeout only guards against the case where
+    // every worker is itself blocked in a wait.
+    void wait_below(ThreadPoolTaskGroup& group, const int n){
+      while(group.pending>=n){
+	if(run_one()) continue;
+	std::unique_lock<std::mutex> lock(group.mx);
+	group.cv.wait_for(lock,std::chrono::milliseconds(1),[&](){return group.pending<n || nqueued>0;});
+      }
+      std::lock_guard<std::mutex> lock(group.mx); // the last task_done() has let go of the group
+    }
+
+
+  public: // ---- Parallel loops -----------------------------------------------------------------------------
+
+
+    // Call lambda(beg,end) on chunks of [0,n) of size at most grain. At most nthreads chunks
+    // are processed concurrently, the calling thread being one of them. Inside the lambda
+    // nthreads is set to nsub.
+    template<typename FN>
+    void parallel_for(const size_t n, FN&& lambda, const size_t grain, const int nsub=1){
+      const size_t g=std::max<size_t>(grain,1);
+      const size_t nchunks=(n+g-1)/g;
+      if(nchunks==0) return;
+
+      const int nrunners=std::min<size_t>(std::max(nthreads,1),nchunks);
+      if(nrunners<=1){
+	lambda(size_t(0),n);
+	return;
+      }
+      ensure_workers(nthreads-1); // nested loops share the caller's budget
+
+      std::atomic<size_t> next(0);
+      ThreadPoolTaskGroup group;
+      auto runner=[&](){
+	for(size_t c=next++; c<nchunks; c=next++)
+	  lambda(c*g,std::min(n,(c+1)*g));
+      };
+
+      for(int i=1; i<nrunners; i++)
+	submit(group,runner,nsub);
+
+      const int _nthreads=nthreads;
+      nthreads=nsub;
+      try{
+	runner();
+      }catch(...){
+	group.set_error(std::current_exception());
+      }
+      nthreads=_nthreads;
+
+      wait(group);
+    }
+
+    // Reduce lambda(beg,end) over the chunks of [0,n). The partials are combined in chunk
+    // order, so the result does not depend on the number of threads.
+    template<typename TYPE, typename FN, typename COMBINE>
+    TYPE parallel_reduce(const size_t n, const TYPE init, FN&& lambda, COMBINE&& combine, const size_t grain){
+      const size_t g=std::max<size_t>(grain,1);
+      const size_t nchunks=(n+g-1)/g;
+      if(nchunks==0) return init;
+      if(nchunks==1) return combine(init,lambda(size_t(0),n));
+
+      std::vector<TYPE> partials(nchunks,init);
+      parallel_for(nchunks,[&](const size_t beg, const size_t end){
+	  for(size_t c=beg; c<end; c++)
+	    partials[c]=lambda(c*g,std::min(n,(c+1)*g));
+	},1);
+
+      TYPE t=init;
+      for(auto& p:partials)
+	t=combine(t,p);
+      return t;
+    }
+
+
+  private: // ---- Internals ---------------------------------------------------------------------------------
+
+
+    bool pop(const int q, Task& task, const bool back){
+      Worker& w=*workers[q];
+      std::lock_guard<std::mutex> lock(w.mx);
+      if(w.queue.empty()) return false;
+      if(back){
+	task=std::move(w.queue.back());
+	w.queue.pop_back();
+      }else{
+	task=std::move(w.queue.front());
+	w.queue.pop_front();
+      }
+      nqueued--;
+      return true;
+    }
+
+    // Take a task from this thread's own deque, failing that steal one, and run it
+    bool run_one(){
+      if(nqueued==0) return false;
+      const int n=nworkers;
+      Task task;
+      bool found=false;
+      if(worker_id>=0) found=pop(worker_id,task,true);
+      for(int i=0; !found && i<n; i++){
+	const int q=(std::max(worker_id,0)+i)%n;
+	if(q!=worker_id) found=pop(q,task,false);
+      }
+      if(!found) return false;
+      execute(task);
+      return true;
+    }
+
+    void execute(Task& task){
+      const int _nthreads=nthreads;
+      nthreads=task.nsub;
+      try{
+	task.fn();
+      }catch(...){
+	task.group->set_error(std::current_exception());
+      }
+      nthreads=_nthreads;
+      task.group->task_done();
+    }
+
+    void worker_loop(const int id){
+      worker_id=id;
+      nthreads=1;
+      while(true){
+	if(run_one()) continue;
+	std::unique_lock<std::mutex> lock(sleep_mx);
+	sleep_cv.wait(lock,[this](){return nqueued>0 || shutting_down;});
+	if(shutting_down && nqueued==0) return;
+      }
+    }
 
-  
   };
 
 
+  extern ThreadPool thread_pool;
+
 }
 
 
-#endif 
+#endif
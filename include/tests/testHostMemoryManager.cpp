@@ -0,0 +1,81 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+
+#include "CnineSession.hpp"
+#include "Tensor.hpp"
+#include "HostMemoryManager.hpp"
+
+
+using namespace cnine;
+
+
+double step(const int niter){
+  auto t0=chrono::system_clock::now();
+  for(int i=0; i<niter; i++){
+    Tensor<float> A=Tensor<float>::zero({64,128});
+    Tensor<float> B=Tensor<float>::zero({128,32});
+    Tensor<float> C(Gdims({64,32}),0,0);
+    Tensor<complex<float> > D=Tensor<complex<float> >::zero({1000});
+  }
+  auto t1=chrono::system_clock::now();
+  return chrono::duration<double,micro>(t1-t0).count()/niter;
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  cout<<"Unmanaged:     "<<step(10000)<<" us/step"<<endl;
+
+  HostMemoryManager mm("host");
+  {
+    using_host_manager guard(&mm);
+    cout<<"Host manager:  "<<step(10000)<<" us/step"<<endl<<endl;
+
+    Tensor<float> A=Tensor<float>::sequential({100,100});
+    A.arr.blob.reset();
+    Tensor<float> B=Tensor<float>::zero({100,100});
+    Tensor<float> C=Tensor<float>::zero({1000,1000});
+    cout<<"Reused block zeroed: "<<(B.norm()==0)<<", mapped block zeroed: "<<(C.norm()==0)<<endl;
+    cout<<"64-byte aligned: "<<(reinterpret_cast<size_t>(B.get_arr())%64==0)<<endl<<endl;
+  }
+  cout<<mm<<endl;
+
+  mm.clear();
+  cout<<"Held after clear: "<<mm.size()<<" bytes"<<endl;
+
+  // reusing a cached block does not raise the high water mark
+  HostMemoryManager mm2("reuse");
+  for(int i=0; i<3; i++) mm2.free(mm2.malloc(4096));
+  cout<<"High water after 3 reuses of 4096 bytes: "<<mm2.high_water()<<endl;
+
+  // a tensor that outlives its manager frees its block through the shared pool
+  Tensor<float>* T;
+  {
+    HostMemoryManager mm3("scoped");
+    using_host_manager guard(&mm3);
+    T=new Tensor<float>(Tensor<float>::sequential({100,100}));
+  }
+  cout<<"Outlived manager: "<<T->norm()<<endl;
+  delete T;
+
+  // an explicitly given host manager only serves types it can manage
+  HostMemoryManager mm4("explicit");
+  MemBlob<float> b1(mm4,100);
+  MemBlob<string> b2(mm4,100);
+  cout<<"Explicit manager, float pooled: "<<(b1.host_pool!=nullptr)<<", string pooled: "<<(b2.host_pool!=nullptr)<<endl;
+
+}
@@ -28,9 +28,9 @@ int main(int argc, char** argv){
   SimpleMemoryManager mm(Mbytes(2));
   cout<<mm<<endl;
 
-  Ltensor<float> A(mm,{2,2},0);
-  Ltensor<float>* B=new Ltensor<float>(mm,{2,2},0);
-  Ltensor<float> C(mm,{2,2},0);
+  Ltensor<float> A(mm,{2,2},0,0);
+  Ltensor<float>* B=new Ltensor<float>(mm,{2,2},0,0);
+  Ltensor<float> C(mm,{2,2},0,0);
   cout<<mm<<endl;
 
   delete B;
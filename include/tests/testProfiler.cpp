@@ -0,0 +1,87 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+
+#include "CnineSession.hpp"
+#include "CnineProfiler.hpp"
+#include "fnlog.hpp"
+
+
+using namespace cnine;
+
+
+float work(const int n){
+  CNINE_PROFILE_OPS("work",2*n);
+  float t=0;
+  for(int i=0; i<n; i++) t+=0.5f*i;
+  return t;
+}
+
+void empty(){
+  CNINE_PROFILE("empty");
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  const int nthreads=4;
+  const int ncalls=100000;
+
+  // every thread calls the same sites
+  vector<std::thread> threads;
+  std::atomic<float> sink(0);
+  for(int t=0; t<nthreads; t++)
+    threads.emplace_back([&](){
+	float s=0;
+	for(int i=0; i<ncalls; i++){
+	  s+=work(100+(i%10)*100);
+	  empty();
+	}
+	sink=sink+s;
+      });
+  for(auto& p:threads) p.join();
+
+  for(auto& p:cnine_profiler.summary())
+    cout<<p.name<<": "<<p.count<<" calls"<<endl;
+  cout<<endl;
+
+  // the cost of an empty profiled scope
+  auto t0=chrono::steady_clock::now();
+  for(int i=0; i<ncalls; i++) empty();
+  auto t1=chrono::steady_clock::now();
+  for(int i=0; i<ncalls; i++){CNINE_FNLOG(timer,"empty(fnlog)");}
+  auto t2=chrono::steady_clock::now();
+  const string name="empty(fnlog, run time name)";
+  for(int i=0; i<ncalls; i++) fnlog timer(name);
+  auto t3=chrono::steady_clock::now();
+  cout<<"CNINE_PROFILE overhead: "<<chrono::duration<double,std::nano>(t1-t0).count()/ncalls<<" ns"<<endl;
+  cout<<"CNINE_FNLOG overhead:   "<<chrono::duration<double,std::nano>(t2-t1).count()/ncalls<<" ns"<<endl;
+  cout<<"fnlog(string) overhead: "<<chrono::duration<double,std::nano>(t3-t2).count()/ncalls<<" ns"<<endl;
+  cout<<endl;
+
+  cout<<cnine_profiler<<endl;
+
+  cnine_profiler.reset();
+  work(1000);
+  cout<<cnine_profiler<<endl;
+
+  // names beyond the site limit share one overflow site instead of failing
+  for(int i=0; i<CnineProfiler::max_sites+10; i++){
+    fnlog timer("dynamic"+to_string(i));
+  }
+  cout<<"Sites: "<<cnine_profiler.nsites()<<", overflow lookups: "<<cnine_profiler.dropped_sites<<endl;
+
+}
@@ -0,0 +1,97 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+
+#include "CnineSession.hpp"
+#include "StridedLoop.hpp"
+#include "Tensor.hpp"
+
+using namespace cnine;
+
+
+template<int N>
+void print_loop(const string name, const Gdims& dims, const std::array<const GstridesB*,N>& strides){
+  StridedLoop<N> loop(dims,strides);
+  cout<<name<<": "<<loop.k<<" loops (";
+  for(int j=0; j<loop.k; j++) cout<<(j>0?",":"")<<loop.n[j];
+  cout<<") disjoint="<<loop.disjoint();
+  if(loop.tiled>=0) cout<<" tiled="<<loop.tiled;
+  cout<<endl;
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session(4);
+
+  Tensor<float> A=Tensor<float>::gaussian({6,5,4});
+  Tensor<float> B=Tensor<float>::gaussian({4,5,6});
+  Tensor<float> C=Tensor<float>::gaussian({6,8});
+
+  // Contiguous dimensions are fused, transposed ones are not
+  TensorView<float> Bp=B.permute_indices({2,1,0});
+  TensorView<float> Cc=C.cols(2,4);
+  GstridesB As=A.get_strides(), Bs=Bp.get_strides(), Cs=Cc.get_strides();
+  GstridesB bcast(0,1);
+  print_loop<2>("contiguous",A.get_dims(),{&As,&As});
+  print_loop<2>("permuted",A.get_dims(),{&As,&Bs});
+  print_loop<1>("columns",Cc.get_dims(),{&Cs});
+  print_loop<2>("broadcast",Gdims({6,4}),{&bcast,&Cs});
+
+  int errors=0;
+
+  Tensor<float> R=Tensor<float>::zero({6,5,4});
+  R.add(Bp);
+  R.add_prod(A,Bp);
+  for(int i=0; i<6; i++)
+    for(int j=0; j<5; j++)
+      for(int k=0; k<4; k++)
+	if(fabs(R(i,j,k)-B(k,j,i)*(1+A(i,j,k)))>1e-5) errors++;
+
+  Tensor<float> S=Tensor<float>::zero({6,4});
+  TensorView<float> Sv(S);
+  Sv=Cc;
+  S.add(Cc,2.0);
+  S.inplace_times(0.5);
+  TensorView<float> St=S.transp();
+  St.subtract(Cc.transp());
+  for(int i=0; i<6; i++)
+    for(int j=0; j<4; j++)
+      if(fabs(S(i,j)-0.5*C(i,j+2))>1e-5) errors++;
+
+  int count=0;
+  Cc.for_each([&](const Gindex& ix, float& v){
+      if(v!=C(ix[0],ix[1]+2)) errors++;
+      count++;});
+
+  if(fabs(St.diff2(Cc.transp())-0.25*Cc.norm2())>1e-3) errors++;
+
+  // Large enough for the transposed loops to be tiled
+  Tensor<float> X=Tensor<float>::gaussian({70,3,100});
+  Tensor<float> Y=Tensor<float>::zero({100,3,70});
+  TensorView<float> Xp=X.permute_indices({2,1,0});
+  GstridesB Ys=Y.get_strides(), Xs=Xp.get_strides();
+  print_loop<2>("transposed",Y.get_dims(),{&Ys,&Xs});
+  Y.add(Xp);
+  Y.add(Xp,2.0);
+  for(int i=0; i<100; i++)
+    for(int j=0; j<3; j++)
+      for(int k=0; k<70; k++)
+	if(fabs(Y(i,j,k)-3.0*X(k,j,i))>1e-5) errors++;
+  if(St.max_abs()!=S.max_abs()) errors++;
+  if(!(St==S.transp())) errors++;
+
+  cout<<"Elements visited: "<<count<<", errors: "<<errors<<endl;
+
+}
@@ -0,0 +1,74 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+
+#include "CnineSession.hpp"
+#include "MultiLoop.hpp"
+#include "Ltensor.hpp"
+#include "TLSFmemoryManager.hpp"
+#include "SimpleMemoryManager.hpp"
+
+
+using namespace cnine;
+
+
+template<typename MANAGER>
+double churn(const MANAGER& mm, const int nlive, const int niter){
+  std::mt19937 gen(1);
+  uniform_int_distribution<int> size_distr(1,40000);
+  uniform_int_distribution<int> slot_distr(0,nlive-1);
+  vector<void*> live(nlive,nullptr);
+  auto t0=chrono::system_clock::now();
+  for(int i=0; i<niter; i++){
+    int j=slot_distr(gen);
+    if(live[j]) mm.free(live[j]);
+    live[j]=mm.malloc(size_distr(gen));
+  }
+  auto t1=chrono::system_clock::now();
+  for(auto p:live) if(p) mm.free(p);
+  return chrono::duration<double,micro>(t1-t0).count()/niter;
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session(4);
+
+  TLSFmemoryManager mm("host",Mbytes(512));
+  {
+    Ltensor<float> A(mm,{200,200},0,0);
+    Ltensor<float>* B=new Ltensor<float>(mm,{300,300},0,0);
+    Ltensor<float> C(mm,{200,200},0,0);
+    delete B;
+    cout<<mm<<endl;
+  }
+  cout<<"After releasing all tensors: used="<<mm.get_used()<<" fragmentation="<<mm.fragmentation()<<endl<<endl;
+
+  for(int nlive: {100,3000}){
+    TLSFmemoryManager tlsf(Mbytes(512));
+    SimpleMemoryManager simple(Mbytes(512));
+    cout<<nlive<<" live blocks: TLSF "<<churn(tlsf,nlive,20000)<<" us/op, first-fit "<<churn(simple,nlive,20000)<<" us/op"<<endl;
+  }
+  cout<<endl;
+
+  // concurrent allocation from several threads
+  TLSFmemoryManager shared("shared",Mbytes(256));
+  MultiLoop(4,[&](const int i){
+      vector<void*> v;
+      for(int j=0; j<2000; j++) v.push_back(shared.malloc(1000+j));
+      for(auto p:v) shared.free(p);
+    });
+  cout<<shared<<endl;
+
+}
@@ -0,0 +1,81 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+
+#include "CnineSession.hpp"
+#include "MultiLoop.hpp"
+#include "ParallelFor.hpp"
+#include "ThreadGroup.hpp"
+
+using namespace cnine;
+
+
+int main(int argc, char** argv){
+
+  cnine_session session(4);
+
+  const int N=1000000;
+  vector<double> v(N);
+  parallel_for(N,[&](const size_t beg, const size_t end){
+      for(size_t i=beg; i<end; i++) v[i]=1.0/(i+1);},1000);
+
+  auto sum=[&](const size_t beg, const size_t end){
+    double t=0; for(size_t i=beg; i<end; i++) t+=v[i]; return t;};
+  auto plus=[](const double a, const double b){return a+b;};
+  double s4=parallel_reduce(N,0.0,sum,plus,1000);
+  nthreads=1;
+  double s1=parallel_reduce(N,0.0,sum,plus,1000);
+  nthreads=4;
+  cout<<"Harmonic sum with 4 threads: "<<s4<<", with 1 thread: "<<s1<<", equal: "<<(s4==s1)<<endl;
+
+  // nested loops: each of the 2 outer jobs gets a budget of 2 threads
+  atomic<int> count(0);
+  MultiLoop(2,[&](const int i){
+      MultiLoop(nthreads*100,[&](const int j){count++;});
+    });
+  cout<<"Nested loop iterations: "<<count<<endl;
+
+  try{
+    parallel_for(100,[&](const size_t beg, const size_t end){
+	if(beg==50) throw std::runtime_error("error in chunk 50");},10);
+  }catch(std::exception& e){
+    cout<<"Caught: "<<e.what()<<endl;
+  }
+
+  // at most 2 jobs of a ThreadGroup run at a time, and wait() rethrows their errors
+  atomic<int> running(0), peak(0);
+  try{
+    ThreadGroup group(2);
+    for(int i=0; i<8; i++)
+      group.add(1,[&](const int j){
+	  int r=++running;
+	  for(int p=peak; r>p && !peak.compare_exchange_weak(p,r);){}
+	  this_thread::sleep_for(chrono::milliseconds(2));
+	  running--;
+	  if(j==5) throw std::runtime_error("error in job 5");
+	},i);
+    group.wait();
+  }catch(std::exception& e){
+    cout<<"Caught: "<<e.what()<<endl;
+  }
+  cout<<"ThreadGroup peak concurrency: "<<peak<<endl;
+
+  auto t0=chrono::system_clock::now();
+  for(int i=0; i<1000; i++)
+    MultiLoop(8,[&](const int j){count++;});
+  auto t1=chrono::system_clock::now();
+  cout<<"1000 MultiLoops of 8 jobs: "<<chrono::duration<double,milli>(t1-t0).count()<<" ms"<<endl;
+  cout<<"Pool workers: "<<thread_pool.get_nworkers()<<endl;
+
+}
@@ -0,0 +1,68 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+
+#include "CnineSession.hpp"
+#include "CnineProfiler.hpp"
+#include "fnlog.hpp"
+#include "logged_timer.hpp"
+#include "Ltensor.hpp"
+
+
+using namespace cnine;
+
+
+void inner(const int n){
+  CNINE_PROFILE_OPS("inner",n);
+  volatile float t=0;
+  for(int i=0; i<n; i++) t=t+0.5f*i;
+}
+
+void outer(const Ltensor<float>& x){
+  logged_timer timer("outer",x,(long long)x.asize());
+  for(int i=0; i<3; i++) inner(10000);
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  Ltensor<float> A(LtensorSpec<float>().batch(2).dims({10,10}).sequential());
+
+  cnine_profiler.start_trace();
+  outer(A);
+
+  vector<std::thread> threads;
+  for(int t=0; t<2; t++)
+    threads.emplace_back([&](){
+	CNINE_FNLOG(timer,"worker");
+	outer(A);
+      });
+  for(auto& p:threads) p.join();
+  cnine_profiler.stop_trace();
+
+  outer(A); // not traced
+
+  auto events=cnine_profiler.trace_events();
+  cout<<events.size()<<" events recorded"<<endl<<endl;
+
+  ostringstream oss;
+  cnine_profiler.write_trace(oss);
+  cout<<oss.str().substr(0,1200)<<"..."<<endl<<endl;
+
+  cnine_profiler.write_trace("testTrace.json");
+  cout<<"Trace written to testTrace.json"<<endl;
+
+}
@@ -338,7 +338,7 @@ namespace cnine{
       cellstride=x.cellstride;
     }
 
-    CtensorArrayA& move_to(const device& _dev){
+    CtensorArrayA& move_to(const struct device& _dev){
       CtensorA::move_to_device(_dev.id());
       return *this;
     }
@@ -348,7 +348,7 @@ namespace cnine{
       return *this;
     }
     
-    CtensorArrayA to(const device& _dev) const{
+    CtensorArrayA to(const struct device& _dev) const{
       return CtensorArrayA(*this,_dev.id());
     }
 
@@ -488,6 +488,10 @@ namespace cnine{
       return adims[i];
     }
 
+    int get_aasize() const{
+      return aasize;
+    }
+
     int get_ncdims() const{
       return cdims.size();
     }
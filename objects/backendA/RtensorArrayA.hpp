@@ -344,7 +344,7 @@ namespace cnine{
       cellstride=x.cellstride;
     }
 
-    RtensorArrayA& move_to(const device& _dev){
+    RtensorArrayA& move_to(const struct device& _dev){
       RtensorA::move_to_device(_dev.id());
       return *this;
     }
@@ -354,7 +354,7 @@ namespace cnine{
       return *this;
     }
     
-    RtensorArrayA to(const device& _dev) const{
+    RtensorArrayA to(const struct device& _dev) const{
       return RtensorArrayA(*this,_dev.id());
     }
 
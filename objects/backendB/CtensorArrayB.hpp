@@ -266,7 +266,8 @@ namespace cnine{
 
 
     int get_cellstride() const{
-      return strides[ak];
+      if(ak==0) return memsize;
+      return strides[ak-1];
     }
 
 
@@ -517,11 +517,11 @@ namespace cnine{
       return *this;
     }
     
-    CtensorB& move_to(const device& _dev){
+    CtensorB& move_to(const struct device& _dev){
       return move_to_device(_dev.id());
     }
     
-    CtensorB to(const device& _dev) const{
+    CtensorB to(const struct device& _dev) const{
       return CtensorB(*this,_dev.id());
     }
 
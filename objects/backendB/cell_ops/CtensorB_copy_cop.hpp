@@ -0,0 +1,47 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library. 
+ *  
+ * Copyright (c) 2021, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial 
+ * license distributed with cnine in the file LICENSE.TXT. Commercial 
+ * use is prohibited. All redistributed versions of this file (in 
+ * original or modified form) must retain this copyright notice and 
+ * must be accompanied by a verbatim copy of the license. 
+ *
+ */
+
+
+#ifndef _CtensorB_copy_cop
+#define _CtensorB_copy_cop
+
+#include "GenericCop.hpp"
+#include "Cmaps2.hpp"
+
+
+namespace cnine{
+
+
+  class CtensorB_copy_cop{
+  public:
+
+    CtensorB_copy_cop(){}
+
+    void apply(CtensorB& r, const CtensorB& x) const{
+      r.set(x);
+    }
+
+    void add(CtensorB& r, const CtensorB& x) const{
+      r.add(x);
+    }
+
+    template<typename CMAP>
+    void apply(const CMAP& map, CtensorArrayB& r, const CtensorArrayB& x, const int add_flag=0) const{
+      // CUDA_STREAM(CtensorB_copy_cu(map,r,x,stream,add_flag));
+    }
+
+  };
+
+}
+
+#endif
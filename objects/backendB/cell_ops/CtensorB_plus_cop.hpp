@@ -55,7 +55,7 @@ namespace cnine{
     }
 
     template<typename CMAP, typename = typename std::enable_if<std::is_base_of<Masked2_cmap,CMAP>::value, CMAP>::type>
-    void accumulate(const CMAP& map, CtensorArrayA& r, const CtensorArrayA& x, const CtensorArrayA& y, const int add_flag=0) const{
+    void accumulate(const CMAP& map, CtensorArrayB& r, const CtensorArrayB& x, const CtensorArrayB& y, const int add_flag=0) const{
       // CUDA_STREAM(CtensorA_plus_accumulator_cu(map,r,x,y,stream));
     }
 
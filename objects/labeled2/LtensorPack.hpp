@@ -17,6 +17,7 @@
 
 #include "Ltensor.hpp"
 #include "LtensorPackSpec.hpp"
+#include "GroupedGemm.hpp"
 
 
 namespace cnine{
@@ -58,9 +59,11 @@ namespace cnine{
     LtensorPack(const LtensorPackSpec<TYPE>& x):
       LtensorPack(x.get_nbatch(), x.get_gdims(), x.get_labels(), x.get_dev()){
       parts.resize(x.ddims.size());
-      for(int i=0; i<x.ddims.size(); i++)
-	parts[i]=new Ltensor<TYPE>(x.gdims.cat(x.ddims[i]).prepend(x.nbatch),
-	  x.get_labels(),x.get_fcode(), x.get_dev()); 
+      for(int i=0; i<x.ddims.size(); i++){
+	Gdims dims=x.gdims.cat(x.ddims[i]);
+	if(x.nbatch>0) dims=dims.prepend(x.nbatch);
+	parts[i]=new Ltensor<TYPE>(dims,x.get_labels(),x.get_fcode(),x.get_dev());
+      }
     }
 
     static LtensorPackSpec<TYPE> make() {return LtensorPackSpec<TYPE>();}
@@ -70,7 +73,10 @@ namespace cnine{
     static LtensorPackSpec<TYPE> gaussian() {return LtensorPackSpec<TYPE>().gaussian();}
     
     LtensorPackSpec<TYPE> spec() const{
-      return LtensorPackSpec<TYPE>(dims,labels,dev);
+      GdimsPack ddims;
+      for(auto p:parts)
+	ddims.push_back(p->get_dims().chunk(labels._batched+labels._narray));
+      return LtensorPackSpec<TYPE>().batch(_nbatch).grid(_gdims).dims(ddims);
     }
 
 
@@ -82,8 +88,8 @@ namespace cnine{
       _gdims(x._gdims),
       dev(x.dev),
       labels(x.labels){
-      for(auto& p:x.parts)
-	parts[p.first]=new Ltensor<TYPE>(*p.second);
+      for(auto p:x.parts)
+	parts.push_back(new Ltensor<TYPE>(*p));
     }
     
     LtensorPack(LtensorPack&& x):
@@ -95,18 +101,18 @@ namespace cnine{
     }
       
     LtensorPack& operator=(const LtensorPack& x){
-      GELIB_ASSRT(_nbatch==x._nbatch);
-      GELIB_ASSRT(_gdims==x._gdims);
-      GELIB_ASSRT(labels==x.labels);
-      for(auto& p:parts)
-	(*p.second)=(*x.parts[p.first]);
+      CNINE_ASSRT(_nbatch==x._nbatch);
+      CNINE_ASSRT(_gdims==x._gdims);
+      CNINE_ASSRT(size()==x.size());
+      for(int i=0; i<size(); i++)
+	(*parts[i])=(*x.parts[i]);
       return *this;
     }
 
     LtensorPack copy() const{
       LtensorPack r(_nbatch,_gdims,labels,dev);
-      for(auto& p:parts)
-	r.parts(p.first)=new Ltensor<TYPE>(p.second->copy());
+      for(auto p:parts)
+	r.parts.push_back(new Ltensor<TYPE>(p->copy()));
       return r;
     }
 
@@ -139,7 +145,7 @@ namespace cnine{
 
     Ltensor<TYPE> operator[](const int i) const{
       CNINE_ASSRT(i<parts.size());
-      return parts[i];
+      return *parts[i];
     }
 
     void for_each(const std::function<void(const int, const Ltensor<TYPE>&)>& lambda) const{
@@ -211,6 +217,56 @@ namespace cnine{
     }
 
 
+  public: // ---- Matrix products ----------------------------------------------------------------------------
+
+
+    // Multiply the last index of each part by its own matrix, r_i(...,a,c)+=x_i(...,a,b)*w_i(b,c).
+    // The batch, grid and leading tensor indices are folded into rows wherever the strides allow it,
+    // and the products of all the parts are executed together as a grouped GEMM.
+    void add_mprod(const LtensorPack& x, const LtensorPack& w){
+      CNINE_CPUONLY();
+      CNINE_ASSRT(x.size()==size());
+      CNINE_ASSRT(w.size()==size());
+      vector<GemmProblem<TYPE> > problems;
+      for(int i=0; i<size(); i++)
+	mprod_problems(problems,*parts[i],*x.parts[i],*w.parts[i]);
+      cpu_grouped_gemm(problems);
+    }
+
+
+  private:
+
+    static void mprod_problems(vector<GemmProblem<TYPE> >& problems, const TensorView<TYPE>& r,
+      const TensorView<TYPE>& x, const TensorView<TYPE>& w){
+      const Gdims xdims=x.get_dims();
+      const GstridesB xs=x.get_strides();
+      const GstridesB rs=r.get_strides();
+      const int k=xdims.size();
+      CNINE_ASSRT(w.ndims()==2);
+      CNINE_ASSRT(k>=2 && r.ndims()==k);
+      CNINE_ASSRT(xdims.chunk(0,k-1)==r.get_dims().chunk(0,k-1));
+      CNINE_ASSRT(xdims[k-1]==w.dim(0));
+      CNINE_ASSRT(r.dim(k-1)==w.dim(1));
+      const int N=w.dim(1);
+      const int K=w.dim(0);
+
+      // indices j..k-2 are fused into a single row index of length M
+      int j=k-2;
+      int M=xdims[k-2];
+      while(j>0 && xs[j-1]==xs[j]*xdims[j] && rs[j-1]==rs[j]*xdims[j])
+	M*=xdims[--j];
+      if(M==0) return;
+
+      auto push=[&](const size_t xoffs, const size_t roffs){
+	problems.push_back(GemmProblem<TYPE>(M,N,K,x.mem()+xoffs,xs[k-2],xs[k-1],
+	    w.mem(),w.stride(0),w.stride(1),r.mem()+roffs,rs[k-2],rs[k-1]));};
+
+      if(j==0) push(0,0);
+      else xdims.chunk(0,j).for_each_index([&](const vector<int>& ix){
+	  push(xs.offs(ix),rs.offs(ix));});
+    }
+
+
   public: // ---- Operations ---------------------------------------------------------------------------------
 
 
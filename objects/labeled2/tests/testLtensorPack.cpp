@@ -15,6 +15,7 @@
 #include "Cnine_base.cpp"
 #include "CnineSession.hpp"
 #include "LtensorPack.hpp"
+#include "Tensor.hpp"
 
 using namespace cnine;
 
@@ -29,6 +30,21 @@ int main(int argc, char** argv){
 
   auto C=LtensorPack<float>::zero().batch(2).dims({{2,2}})();
   cout<<C<<endl;
+
+  // Each part multiplied by its own weight matrix in one grouped GEMM
+  LtensorPack<float> X=LtensorPack<float>::gaussian().batch(3).grid({2}).dims({{1,4},{3,5},{5,6}});
+  LtensorPack<float> W=LtensorPack<float>::gaussian().dims({{4,7},{5,7},{6,7}});
+  LtensorPack<float> R=LtensorPack<float>::zero().batch(3).grid({2}).dims({{1,7},{3,7},{5,7}});
+  R.add_mprod(X,W);
+
+  float err=0;
+  for(int i=0; i<R.size(); i++){
+    const int a=X[i].dim(2), b=X[i].dim(3);
+    Tensor<float> T=Tensor<float>::zero({6*a,7});
+    T.add_mprod(X[i].reshape({6*a,b}),W[i]);
+    err+=T.diff2(R[i].reshape({6*a,7}));
+  }
+  cout<<"add_mprod error: "<<err<<endl;
   
 
 }
@@ -16,8 +16,11 @@
 
 #include "Cnine_base.hpp"
 #include "RtensorA.hpp"
+#include "TensorView.hpp"
 #include "array_pool.hpp"
 #include "CSRvector.hpp"
+#include "ParallelFor.hpp"
+#include "CnineProfiler.hpp"
 
 
 namespace cnine{
@@ -46,6 +49,7 @@ namespace cnine{
     int m=0;
 
     mutable CSRmatrix<TYPE>* transpp=nullptr;
+    mutable std::mutex transp_mx;
 
     ~CSRmatrix(){
       if(is_view) return;
@@ -82,6 +86,8 @@ namespace cnine{
       array_pool<TYPE>::operator=(x);
       n=x.n;
       m=x.m;
+      if(transpp) delete transpp;
+      transpp=nullptr;
       return *this;
     }
 
@@ -166,6 +172,10 @@ namespace cnine{
       return n;
     }
 
+    int nnz() const{
+      return tail/2;
+    }
+
     int size_of(const int i) const{
       CNINE_CHECK_RANGE(if(i>=n) throw std::out_of_range("In CSRmatrix::size_of(): index "+to_string(i)+" out of range (0,"+to_string(n-1)+")."));
       return array_pool<TYPE>::size_of(i)/2;
@@ -228,7 +238,7 @@ namespace cnine{
       if(tail+2*len>memsize)
 	reserve(std::max(2*memsize,tail+2*len));
       for(int i=0; i<len; i++){
-	arr[tail+2*i]=ix[i];
+	*reinterpret_cast<int*>(arr+tail+2*i)=ix[i];
 	arr[tail+2*i+1]=v[i];
       }
       dir.push_back(tail,2*len);
@@ -247,7 +257,9 @@ namespace cnine{
   public: // ---- Transposes ---------------------------------------------------------------------------------
 
 
+    // The transpose is computed on first use and cached
     const CSRmatrix& transp() const{
+      std::lock_guard<std::mutex> lock(transp_mx);
       if(!transpp) make_transp();
       return *transpp;
     }
@@ -279,6 +291,63 @@ namespace cnine{
     }
 
 
+  public: // ---- Products -----------------------------------------------------------------------------------
+
+
+    // r(i,c) += sum_j A(i,j) x(j,c) for the rows i of this matrix, where r and x are given by
+    // pointers and strides. Blocks of rows go to different threads, and each row is accumulated
+    // in a tile of up to 256 columns, so that the inner loop is a contiguous axpy that the
+    // compiler can vectorize.
+    void apply(TYPE* r, const int rs0, const int rs1, const TYPE* x, const int xs0, const int xs1, const int nc) const{
+      CNINE_ASSRT(dev==0);
+      if(n==0 || nc==0) return;
+      CNINE_PROFILE_OPS("CSRmatrix::apply",2ll*nnz()*nc);
+      const int TILE=256;
+      const size_t grain=std::max<size_t>(1,(1<<15)/std::max<size_t>(1,(2ll*nnz()*nc)/n));
+      const int* _dir=dir.arr;
+      const int dirs=dir.strides[0];
+      const int dircs=dir.strides[1];
+      const TYPE* _arr=arr;
+
+      parallel_for(n,[&](const size_t beg, const size_t end){
+	  TYPE acc[TILE];
+	  for(size_t i=beg; i<end; i++){
+	    const int offs=_dir[i*dirs];
+	    const int len=_dir[i*dirs+dircs]/2;
+	    const TYPE* row=_arr+offs;
+	    TYPE* rrow=r+i*rs0;
+	    if(nc==1){
+	      TYPE t=0;
+	      for(int k=0; k<len; k++)
+		t+=row[2*k+1]*x[((size_t)*reinterpret_cast<const int*>(row+2*k))*xs0];
+	      *rrow+=t;
+	      continue;
+	    }
+	    for(int c0=0; c0<nc; c0+=TILE){
+	      const int w=std::min(TILE,nc-c0);
+	      for(int c=0; c<w; c++) acc[c]=0;
+	      for(int k=0; k<len; k++){
+		const int j=*reinterpret_cast<const int*>(row+2*k);
+		const TYPE v=row[2*k+1];
+		const TYPE* xrow=x+((size_t)j)*xs0+((size_t)c0)*xs1;
+		if(xs1==1){
+		  for(int c=0; c<w; c++) acc[c]+=v*xrow[c];
+		}else{
+		  for(int c=0; c<w; c++) acc[c]+=v*xrow[c*xs1];
+		}
+	      }
+	      TYPE* dest=rrow+((size_t)c0)*rs1;
+	      if(rs1==1){
+		for(int c=0; c<w; c++) dest[c]+=acc[c];
+	      }else{
+		for(int c=0; c<w; c++) dest[c*rs1]+=acc[c];
+	      }
+	    }
+	  }
+	},grain);
+    }
+
+
   public: // ---- I/O ----------------------------------------------------------------------------------------
 
 
@@ -301,6 +370,50 @@ namespace cnine{
 
   };
 
+
+  // ---- Sparse-dense products ------------------------------------------------------------------------------
+
+  // Vectors are treated as matrices with a single column
+
+
+  // r+=A*x
+  template<typename TYPE>
+  void add_mprod(const TensorView<TYPE>& r, const CSRmatrix<TYPE>& A, const TensorView<TYPE>& x){
+    CNINE_ASSRT(r.get_dev()==0 && x.get_dev()==0);
+    CNINE_ASSRT(r.ndims()==x.ndims() && (r.ndims()==1 || r.ndims()==2));
+    CNINE_ASSRT(r.dim(0)==A.n && x.dim(0)==A.m);
+    if(r.ndims()==1){
+      A.apply(r.mem(),r.stride(0),0,x.mem(),x.stride(0),0,1);
+      return;
+    }
+    CNINE_ASSRT(r.dim(1)==x.dim(1));
+    A.apply(r.mem(),r.stride(0),r.stride(1),x.mem(),x.stride(0),x.stride(1),x.dim(1));
+  }
+
+  // r+=A^T*x
+  template<typename TYPE>
+  void add_mprod_TA(const TensorView<TYPE>& r, const CSRmatrix<TYPE>& A, const TensorView<TYPE>& x){
+    add_mprod(r,A.transp(),x);
+  }
+
+  // r+=x*A, computed as r^T+=A^T*x^T
+  template<typename TYPE>
+  void add_mprod(const TensorView<TYPE>& r, const TensorView<TYPE>& x, const CSRmatrix<TYPE>& A){
+    CNINE_ASSRT(r.get_dev()==0 && x.get_dev()==0);
+    CNINE_ASSRT(r.ndims()==2 && x.ndims()==2);
+    CNINE_ASSRT(r.dim(0)==x.dim(0) && x.dim(1)==A.n && r.dim(1)==A.m);
+    A.transp().apply(r.mem(),r.stride(1),r.stride(0),x.mem(),x.stride(1),x.stride(0),x.dim(0));
+  }
+
+  // r+=x*A^T, computed as r^T+=A*x^T
+  template<typename TYPE>
+  void add_mprod_AT(const TensorView<TYPE>& r, const TensorView<TYPE>& x, const CSRmatrix<TYPE>& A){
+    CNINE_ASSRT(r.get_dev()==0 && x.get_dev()==0);
+    CNINE_ASSRT(r.ndims()==2 && x.ndims()==2);
+    CNINE_ASSRT(r.dim(0)==x.dim(0) && x.dim(1)==A.m && r.dim(1)==A.n);
+    A.apply(r.mem(),r.stride(1),r.stride(0),x.mem(),x.stride(1),x.stride(0),x.dim(0));
+  }
+
 }
 
 
@@ -0,0 +1,105 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "Tensor.hpp"
+#include "CSRmatrix.hpp"
+#include "InterpolBilinear.hpp"
+
+using namespace cnine;
+
+
+// Random sparse matrix with about density*m nonzeros per row, and its dense counterpart
+CSRmatrix<float> random_csr(const int n, const int m, const float density, Tensor<float>& D){
+  uniform_real_distribution<float> distr(0,1);
+  normal_distribution<float> gauss(0,1);
+  CSRmatrix<float> A(0,m);
+  D=Tensor<float>::zero({n,m});
+  for(int i=0; i<n; i++){
+    vector<int> ix;
+    vector<float> v;
+    for(int j=0; j<m; j++)
+      if(distr(rndGen)<density){
+	ix.push_back(j);
+	v.push_back(gauss(rndGen));
+	D.set(i,j,v.back());
+      }
+    A.push_back(ix,v);
+  }
+  A.n=n;
+  return A;
+}
+
+float maxdiff(const TensorView<float>& a, const TensorView<float>& b){
+  return sqrt(a.diff2(b));
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session(4);
+
+  for(int nc: {1,7,64,300}){
+    Tensor<float> D;
+    CSRmatrix<float> A=random_csr(200,150,0.05,D);
+
+    Tensor<float> x=Tensor<float>::gaussian({150,nc});
+    Tensor<float> r=Tensor<float>::zero({200,nc});
+    Tensor<float> r0=Tensor<float>::zero({200,nc});
+    add_mprod(r,A,x);
+    r0.add_mprod(D,x);
+    cout<<"nc="<<nc<<" A*x error="<<maxdiff(r,r0);
+
+    Tensor<float> y=Tensor<float>::gaussian({200,nc});
+    Tensor<float> s=Tensor<float>::zero({150,nc});
+    Tensor<float> s0=Tensor<float>::zero({150,nc});
+    add_mprod_TA(s,A,y);
+    s0.add_mprod(D.transp(),y);
+    cout<<" A^T*y error="<<maxdiff(s,s0);
+
+    Tensor<float> u=Tensor<float>::gaussian({nc,200});
+    Tensor<float> t=Tensor<float>::zero({nc,150});
+    Tensor<float> t0=Tensor<float>::zero({nc,150});
+    add_mprod(t,u,A);
+    t0.add_mprod(u,D);
+    cout<<" u*A error="<<maxdiff(t,t0);
+
+    Tensor<float> q=Tensor<float>::zero({nc,200});
+    Tensor<float> q0=Tensor<float>::zero({nc,200});
+    add_mprod_AT(q,x.transp(),A);
+    q0.add_mprod(x.transp(),D.transp());
+    cout<<" x^T*A^T error="<<maxdiff(q,q0)<<endl;
+  }
+
+  // matrix times vector
+  Tensor<float> D;
+  CSRmatrix<float> A=random_csr(1000,1000,0.01,D);
+  Tensor<float> x=Tensor<float>::gaussian({1000});
+  Tensor<float> r=Tensor<float>::zero({1000});
+  add_mprod(r,A,x);
+  Tensor<float> r0=Tensor<float>::zero({1000,1});
+  r0.add_mprod(D,x.unsqueeze(1));
+  cout<<"SpMV error="<<maxdiff(r.unsqueeze(1),r0)<<endl<<endl;
+
+  // interpolation of a 6x6 grid
+  RtensorA X=RtensorA::zero({1,2});
+  X.set(0,0,0.4);
+  X.set(0,1,0.5);
+  InterpolBilinear<float> M(X,6,6);
+  Tensor<float> f=Tensor<float>::sequential({36,1});
+  Tensor<float> g=Tensor<float>::zero({1,1});
+  add_mprod(g,M,f);
+  cout<<"Interpolated value: "<<g<<endl;
+
+}
@@ -172,15 +172,21 @@ namespace cnine{
 
     Gdims dims(const int i) const{
       CNINE_ASSRT(i<size());
-      return Gdims(vector<int>(arr+dir(i,0),arr+dir(i,0)+ndims(i)));
+      return Gdims(arr+dir(i,0),arr+dir(i,0)+ndims(i));
     }
 
     GstridesB strides(const int i) const{
       CNINE_ASSRT(i<size());
       const int m=ndims(i);
-      return GstridesB(vector<int>(arr+dir(i,0)+m,arr+dir(i,0)+2*m)); //.set_offset(arr[dir(i,0)+2*m]);
+      return GstridesB(arr+dir(i,0)+m,arr+dir(i,0)+2*m); //.set_offset(arr[dir(i,0)+2*m]);
     }
     
+    // The dimensions of the i'th tensor, followed by its strides and its offset
+    const int* layout(const int i) const{
+      CNINE_ASSRT(i<size());
+      return arr+dir(i,0);
+    }
+
     int offset(const int i) const{
       CNINE_ASSRT(i<size());
       return arr[dir(i,0)+2*ndims(i)];
@@ -205,6 +211,26 @@ namespace cnine{
     }
   
 
+  public: // ---- Transformations ----------------------------------------------------------------------------
+
+
+    // Each tensor with its last two dimensions swapped. The result describes views into the same
+    // memory, so it is no longer contiguous.
+    TensorPackDir transp() const{
+      TensorPackDir R(*this);
+      for(int i=0; i<size(); i++){
+	const int m=ndims(i);
+	if(m<2) continue;
+	int* p=R.arr+R.dir(i,0);
+	std::swap(p[m-2],p[m-1]);
+	std::swap(p[2*m-2],p[2*m-1]);
+	R.contiguous=false;
+	R.uniform_last=0;
+      }
+      return R;
+    }
+
+
   public: // ---- Checks -------------------------------------------------------------------------------------
 
 
@@ -0,0 +1,207 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineTensorPackLoop
+#define _CnineTensorPackLoop
+
+#include "Cnine_base.hpp"
+#include "TensorPackDir.hpp"
+#include "StridedLoop.hpp"
+#include "ParallelFor.hpp"
+
+
+// Elementwise iteration over the corresponding tensors of N packs that need not be contiguous.
+// Tensors whose dimensions and strides agree in every operand form a group that shares a single
+// StridedLoop, so the loop is planned once per distinct shape and the members of a group only
+// differ in their base offsets. Small tensors are spread across threads in group order, tensors
+// that are large enough to be split up themselves are processed one at a time by a parallel loop.
+// The tensors of the first operand, which is written to, are assumed not to overlap.
+
+namespace cnine{
+
+
+  template<int N>
+  class TensorPackLoop{
+  public:
+
+    class Group{
+    public:
+
+      Gdims dims;
+      std::array<GstridesB,N> strides;
+      StridedLoop<N> loop;
+      vector<std::array<size_t,N> > offsets; // base offset of each member in each operand
+
+      Group(const Gdims& _dims, const std::array<GstridesB,N>& _strides):
+	dims(_dims), strides(_strides), loop(dims,pointers(strides)){}
+
+    private:
+
+      static std::array<const GstridesB*,N> pointers(const std::array<GstridesB,N>& s){
+	std::array<const GstridesB*,N> R;
+	for(int o=0; o<N; o++) R[o]=&s[o];
+	return R;
+      }
+
+    };
+
+
+    vector<Group> groups;
+    vector<pair<int,int> > small; // (group,member) pairs, processed in parallel
+    vector<pair<int,int> > large; // (group,member) pairs, each processed by a parallel loop
+    size_t small_total=0;
+
+
+    TensorPackLoop(const std::array<const TensorPackDir*,N>& dirs){
+      const int n=dirs[0]->size();
+      for(int o=1; o<N; o++)
+	if(dirs[o]->size()!=n)
+	  throw std::out_of_range("cnine::TensorPackLoop: packs of "+to_string(n)+" and "+to_string(dirs[o]->size())+" tensors.");
+
+      // Groups are looked up by a hash of the dimensions and strides of the tensor in each operand
+      unordered_map<size_t,vector<int> > index;
+      std::array<const int*,N> p;
+      std::array<size_t,N> offs;
+      int g=-1;
+
+      for(int i=0; i<n; i++){
+	const int m=dirs[0]->ndims(i);
+	for(int o=0; o<N; o++){
+	  p[o]=dirs[o]->layout(i);
+	  if(o>0 && (dirs[o]->ndims(i)!=m || !std::equal(p[o],p[o]+m,p[0])))
+	    throw std::out_of_range("cnine::TensorPackLoop: dimensions "+dirs[o]->dims(i).str()+" of tensor "+to_string(i)+" do not match "+dirs[0]->dims(i).str()+".");
+	  offs[o]=p[o][2*m];
+	}
+
+	if(g<0 || !matches(groups[g],p,m)){ // consecutive tensors often have the same shape
+	  size_t h=m;
+	  for(int o=0; o<N; o++)
+	    for(int j=0; j<2*m; j++)
+	      h=(h^p[o][j])*0x9E3779B97F4A7C15ull;
+	  auto& candidates=index[h];
+	  g=-1;
+	  for(auto c:candidates)
+	    if(matches(groups[c],p,m)){g=c; break;}
+	  if(g<0){
+	    g=groups.size();
+	    std::array<GstridesB,N> strides;
+	    for(int o=0; o<N; o++)
+	      strides[o]=GstridesB(p[o]+m,p[o]+2*m);
+	    groups.emplace_back(Gdims(p[0],p[0]+m),strides);
+	    candidates.push_back(g);
+	  }
+	}
+	groups[g].offsets.push_back(offs);
+      }
+
+      for(int g=0; g<groups.size(); g++){
+	const size_t m=groups[g].dims.asize();
+	for(int j=0; j<groups[g].offsets.size(); j++){
+	  if(m>=parallel_grain) large.push_back({g,j});
+	  else{
+	    small.push_back({g,j});
+	    small_total+=m;
+	  }
+	}
+      }
+    }
+
+
+  public: // ---- Iteration ----------------------------------------------------------------------------------
+
+
+    // Call fn(offs,m,inc) at the start of each run of the innermost loop of each tensor, where
+    // offs[o] is the offset of the run in operand o and inc[o] is its stride along the run
+    template<typename FN>
+    void for_each_run(FN&& fn) const{
+      if(small.size()>0){
+	const size_t grain=std::max<size_t>(1,parallel_grain*small.size()/std::max<size_t>(small_total,1));
+	parallel_for(small.size(),[&](const size_t beg, const size_t end){
+	    for(size_t u=beg; u<end; u++)
+	      run(small[u],fn,false);
+	  },grain);
+      }
+      for(auto& p:large)
+	run(p,fn,true);
+    }
+
+
+  private:
+
+    static bool matches(const Group& G, const std::array<const int*,N>& p, const int m){
+      if(G.dims.size()!=m || !std::equal(p[0],p[0]+m,G.dims.begin())) return false;
+      for(int o=0; o<N; o++)
+	if(!std::equal(p[o]+m,p[o]+2*m,G.strides[o].begin())) return false;
+      return true;
+    }
+
+    template<typename FN>
+    void run(const pair<int,int>& p, FN& fn, const bool parallel) const{
+      const Group& G=groups[p.first];
+      const std::array<size_t,N>& base=G.offsets[p.second];
+      size_t inc[N];
+      for(int o=0; o<N; o++) inc[o]=G.loop.inner_stride(o);
+      G.loop.for_each_run([&](const size_t* offs, const int m){
+	  size_t t[N];
+	  for(int o=0; o<N; o++) t[o]=base[o]+offs[o];
+	  fn(static_cast<const size_t*>(t),m,static_cast<const size_t*>(inc));
+	},parallel);
+    }
+
+  };
+
+
+  // ---- Elementwise functions ------------------------------------------------------------------------------
+
+
+  // fn(x) for each element x of each tensor of a pack
+  template<typename T0, typename FN>
+  void pack_for_each(const TensorPackDir& d0, T0* p0, FN&& fn){
+    TensorPackLoop<1> loop({&d0});
+    loop.for_each_run([&](const size_t* offs, const int m, const size_t* inc){
+	T0* a=p0+offs[0];
+	if(inc[0]==1) for(int j=0; j<m; j++) fn(a[j]);
+	else for(int j=0; j<m; j++) fn(a[j*inc[0]]);
+      });
+  }
+
+  // fn(r,x) for each pair of corresponding elements of two packs
+  template<typename T0, typename T1, typename FN>
+  void pack_for_each(const TensorPackDir& d0, T0* p0, const TensorPackDir& d1, T1* p1, FN&& fn){
+    TensorPackLoop<2> loop({&d0,&d1});
+    loop.for_each_run([&](const size_t* offs, const int m, const size_t* inc){
+	T0* a=p0+offs[0];
+	T1* b=p1+offs[1];
+	if(inc[0]==1 && inc[1]==1) for(int j=0; j<m; j++) fn(a[j],b[j]);
+	else for(int j=0; j<m; j++) fn(a[j*inc[0]],b[j*inc[1]]);
+      });
+  }
+
+  // fn(r,x,y) for each triple of corresponding elements of three packs
+  template<typename T0, typename T1, typename T2, typename FN>
+  void pack_for_each(const TensorPackDir& d0, T0* p0, const TensorPackDir& d1, T1* p1,
+    const TensorPackDir& d2, T2* p2, FN&& fn){
+    TensorPackLoop<3> loop({&d0,&d1,&d2});
+    loop.for_each_run([&](const size_t* offs, const int m, const size_t* inc){
+	T0* a=p0+offs[0];
+	T1* b=p1+offs[1];
+	T2* c=p2+offs[2];
+	if(inc[0]==1 && inc[1]==1 && inc[2]==1) for(int j=0; j<m; j++) fn(a[j],b[j],c[j]);
+	else for(int j=0; j<m; j++) fn(a[j*inc[0]],b[j*inc[1]],c[j*inc[2]]);
+      });
+  }
+
+}
+
+#endif
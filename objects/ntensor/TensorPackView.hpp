@@ -22,6 +22,8 @@
 #include "MemArr.hpp"
 #include "TensorPackDir.hpp"
 #include "TensorView.hpp"
+#include "TensorPackLoop.hpp"
+#include "GroupedGemm.hpp"
 #include "device_helpers.hpp"
 
 #ifdef _WITH_CUDA
@@ -78,8 +80,10 @@ namespace cnine{
 
     TensorPackView& operator=(const TensorPackView& x){
       CNINE_ASSRT(size()==x.size());
-      for(int i=0; i<size(); i++)
-	(*this)[i]=x[i];
+      CNINE_CHECK_SIZE(dir.check_dims_equal(x.dir));
+      if(is_contiguous() && x.is_contiguous()) fuse()=x.fuse();
+      else if(dev==0 && x.dev==0) pack_for_each(dir,base(),x.dir,x.base(),[](TYPE& r, const TYPE& x){r=x;});
+      else for(int i=0; i<size(); i++) (*this)[i]=x[i];
       return *this;
     }
 
@@ -136,6 +140,11 @@ namespace cnine{
       return const_cast<TYPE*>(arr.get_arr())+offset(0);
     }
 
+    // The start of the memory that the offsets of the individual tensors are relative to
+    TYPE* base() const{
+      return const_cast<TYPE*>(arr.get_arr());
+    }
+
 
   public: // individual tensors
 
@@ -161,6 +170,14 @@ namespace cnine{
     }
 
 
+  public: // ---- Views --------------------------------------------------------------------------------------
+
+
+    TensorPackView transp() const{
+      return TensorPackView(dir.transp(),arr);
+    }
+
+
   public: // ---- Fusing ------------------------------------------------------------------------------------
 
     
@@ -180,37 +197,72 @@ namespace cnine{
   public: // ---- Lambdas -----------------------------------------------------------------------------------
 
 
-    void for_each(const std::function<void(const int i, const TensorView<TYPE>&)>& lambda) const{
+    template<typename FN>
+    void for_each(FN&& lambda) const{
       for(int i=0; i<size(); i++)
 	lambda(i,(*this)[i]);
     }
 
-    void zip(const TensorPackView& x, const std::function<void(const TensorView<TYPE>&, const TensorView<TYPE>&, const int i)>& lambda) const{
+    template<typename FN>
+    void zip(const TensorPackView& x, FN&& lambda) const{
       CNINE_ASSRT(x.size()==size());
       for(int i=0; i<size(); i++)
 	lambda((*this)[i],x[i],i);
     }
 
-    void zip(const TensorPackView& x, const TensorPackView& y, 
-      const std::function<void(const TensorView<TYPE>&, const TensorView<TYPE>&, const TensorView<TYPE>&, const int i)>& lambda) const{
+    template<typename FN>
+    void zip(const TensorPackView& x, const TensorPackView& y, FN&& lambda) const{
       CNINE_ASSRT(x.size()==size());
       CNINE_ASSRT(y.size()==size());
       for(int i=0; i<size(); i++)
 	lambda((*this)[i],x[i],y[i],i);
     }
 
+    // Like zip, but different tensors may be processed concurrently, so lambda must only write to
+    // its first argument. Tensors are handed out one at a time in order of decreasing work,
+    // estimated as the size of the output times the last dimension of x.
+    template<typename FN>
+    void parallel_zip(const TensorPackView& x, const TensorPackView& y, FN&& lambda) const{
+      CNINE_ASSRT(x.size()==size());
+      CNINE_ASSRT(y.size()==size());
+      const int n=size();
+      if(dev!=0 || nthreads<=1 || n<2){
+	zip(x,y,lambda);
+	return;
+      }
+
+      vector<pair<size_t,int> > work(n);
+      for(int i=0; i<n; i++){
+	const Gdims xdims=x.dims(i);
+	work[i]=make_pair(dims(i).asize()*(xdims.size()>0?xdims.back():1),i);
+      }
+      std::sort(work.begin(),work.end(),std::greater<pair<size_t,int> >());
+
+      parallel_for(n,[&](const size_t beg, const size_t end){
+	  for(size_t u=beg; u<end; u++){
+	    const int i=work[u].second;
+	    lambda((*this)[i],x[i],y[i],i);
+	  }
+	},1);
+    }
+
 
   public: // ---- In-place Operations ------------------------------------------------------------------------
 
 
+    // Packs that are not contiguous are processed by a TensorPackLoop, which groups the tensors by
+    // shape and strides and runs the groups in parallel
+
     void set_zero() const{
       if(is_contiguous()) fuse().set_zero();
-      else for_each([&](const int i, const TensorView<TYPE>& x){x.set_zero();});
+      else if(dev==0) pack_for_each(dir,base(),[](TYPE& r){r=0;});
+      else for(int i=0; i<size(); i++) (*this)[i].set_zero();
     }
 
     void inplace_times(const TYPE c) const{
       if(is_contiguous()) fuse().inplace_times(c);
-      else for_each([&](const int i, const TensorView<TYPE>& x){x.inplace_times(c);});
+      else if(dev==0) pack_for_each(dir,base(),[&](TYPE& r){r*=c;});
+      else for(int i=0; i<size(); i++) (*this)[i].inplace_times(c);
     }
 
 
@@ -219,16 +271,18 @@ namespace cnine{
 
     void add(const TensorPackView& x){
       CNINE_DEVICE_SAME(x);
-      //CNINE_CHECK_SIZE(dims.check_dims_equal(x.dims));
+      CNINE_CHECK_SIZE(dir.check_dims_equal(x.dir));
       if(is_contiguous() && x.is_contiguous()) fuse().add(x.fuse());
-      else zip(x,[&](const TensorView<TYPE>& x, const TensorView<TYPE>& y, const int i){x.add(y);});
+      else if(dev==0) pack_for_each(dir,base(),x.dir,x.base(),[](TYPE& r, const TYPE& x){r+=x;});
+      else for(int i=0; i<size(); i++) (*this)[i].add(x[i]);
     }
 
     void add(const TensorPackView& x, const TYPE c){
       CNINE_DEVICE_SAME(x);
-      //CNINE_CHECK_SIZE(dims.check_dims_equal(x.dims));
+      CNINE_CHECK_SIZE(dir.check_dims_equal(x.dir));
       if(is_contiguous() && x.is_contiguous()) fuse().add(x.fuse(),c);
-      else zip(x,[&](const TensorView<TYPE>& x, const TensorView<TYPE>& y, const int i){x.add(y,c);});
+      else if(dev==0) pack_for_each(dir,base(),x.dir,x.base(),[&](TYPE& r, const TYPE& x){r+=c*x;});
+      else for(int i=0; i<size(); i++) (*this)[i].add(x[i],c);
     }
 
 
@@ -238,21 +292,43 @@ namespace cnine{
     void add_mvprod(const TensorPackView& x, const TensorPackView& y) const{
       CNINE_DEVICE_SAME(x);
       CNINE_DEVICE_SAME(y);
-      zip(x,y,[&](const TensorView<TYPE>& r, const TensorView<TYPE>& x, const TensorView<TYPE>& y, const int i){
+      parallel_zip(x,y,[&](const TensorView<TYPE>& r, const TensorView<TYPE>& x, const TensorView<TYPE>& y, const int i){
 	  r.add_mvprod(x,y);});
     }
 
     void add_mvprod_T(const TensorPackView& x, const TensorPackView& y) const{
       CNINE_DEVICE_SAME(x);
       CNINE_DEVICE_SAME(y);
-      zip(x,y,[&](const TensorView<TYPE>& r, const TensorView<TYPE>& x, const TensorView<TYPE>& y, const int i){
+      parallel_zip(x,y,[&](const TensorView<TYPE>& r, const TensorView<TYPE>& x, const TensorView<TYPE>& y, const int i){
 	  r.add_mvprod_T(x,y);});
     }
 
+    // On the CPU the products of real packs are executed as one grouped GEMM, see GroupedGemm.hpp
     void add_mprod(const TensorPackView& x, const TensorPackView& y) const{
       CNINE_DEVICE_SAME(x);
       CNINE_DEVICE_SAME(y);
-      zip(x,y,[&](const TensorView<TYPE>& r, const TensorView<TYPE>& x, const TensorView<TYPE>& y, const int i){
+      if constexpr(std::is_same<TYPE,float>::value || std::is_same<TYPE,double>::value){
+	if(dev==0){
+	  CNINE_ASSRT(x.size()==size());
+	  CNINE_ASSRT(y.size()==size());
+	  vector<GemmProblem<TYPE> > problems;
+	  problems.reserve(size());
+	  for(int i=0; i<size(); i++){
+	    CNINE_ASSRT(dir.ndims(i)==2 && x.dir.ndims(i)==2 && y.dir.ndims(i)==2);
+	    const int* r=dir.layout(i); // dims, strides, offset
+	    const int* a=x.dir.layout(i);
+	    const int* b=y.dir.layout(i);
+	    CNINE_ASSRT(a[0]==r[0]);
+	    CNINE_ASSRT(b[1]==r[1]);
+	    CNINE_ASSRT(a[1]==b[0]);
+	    problems.push_back(GemmProblem<TYPE>(r[0],r[1],a[1],x.base()+a[4],a[2],a[3],
+		y.base()+b[4],b[2],b[3],base()+r[4],r[2],r[3]));
+	  }
+	  cpu_grouped_gemm(problems);
+	  return;
+	}
+      }
+      parallel_zip(x,y,[&](const TensorView<TYPE>& r, const TensorView<TYPE>& x, const TensorView<TYPE>& y, const int i){
 	  r.add_mprod(x,y);});
     }
 
@@ -21,7 +21,10 @@
 #include "GstridesB.hpp"
 #include "Gindex.hpp"
 #include "MemArr.hpp"
+#include "ParallelFor.hpp"
+#include "StridedLoop.hpp"
 #include "device_helpers.hpp"
+#include "CpuGemm.hpp"
 //#include "GatherMapB.hpp"
 
 #include "Rtensor1_view.hpp"
@@ -276,7 +279,7 @@ namespace cnine{
 
       if(device()==0){
 	CNINE_ASSRT(x.device()==0);
-	for_each([&](const Gindex& ix, TYPE& v) {v=x(ix);});
+	strided_for_each(dims,mem(),strides,x.mem(),x.strides,[](TYPE& r, const TYPE v){r=v;});
       }
 
       if(device()==1){
@@ -726,9 +729,10 @@ namespace cnine{
 	for(int i=0; i<N; i++)
 	  if(arr[i]!=x.arr[i]) return false;
       }else{
-	CNINE_UNIMPL();
-	//for_each([&x](const Gindex& ix, const TYPE v){
-	//  if(x(ix)!=v) return false;});
+	bool equal=true;
+	strided_for_each(dims,mem(),strides,x.mem(),x.strides,[&](const TYPE a, const TYPE b){
+	    if(a!=b) equal=false;},false);
+	return equal;
       }
       return true;
     }
@@ -892,9 +896,25 @@ namespace cnine{
   public: // ---- Lambdas -----------------------------------------------------------------------------------
 
 
-    void for_each(const std::function<void(const Gindex&, TYPE& x)>& lambda) const{
-      dims.for_each_index([&](const Gindex& ix){
-	  lambda(ix,const_cast<MemArr<TYPE>&>(arr)[strides.offs(ix)]);});
+    // Call lambda(ix,x) for each element in row major order of the indices
+    template<typename FN>
+    void for_each(FN&& lambda) const{
+      const int k=dims.size();
+      if(asize()==0) return;
+      Gindex ix(k,fill_zero());
+      TYPE* ptr=mem();
+      size_t offs=0;
+      while(true){
+	lambda(static_cast<const Gindex&>(ix),ptr[offs]);
+	int j=k-1;
+	for(; j>=0; j--){
+	  offs+=strides[j];
+	  if(++ix[j]<dims[j]) break;
+	  offs-=dims[j]*strides[j];
+	  ix[j]=0;
+	}
+	if(j<0) break;
+      }
     }
 
     //void for_each(const std::function<void(const Gindex&, TYPE x)>& lambda) const{
@@ -902,6 +922,31 @@ namespace cnine{
     //  lambda(ix,arr[strides.offs(ix)]);});
     //}
 
+    // Call lambda(i) for each slice along the first dimension, in parallel on the CPU.
+    // This is how elementwise operations on non-regular tensors are split up.
+    template<typename FN>
+    void for_each_outer(FN&& lambda) const{
+      CNINE_ASSRT(dims.size()>0);
+      parallel_for(dims[0],[&](const size_t beg, const size_t end){
+	  for(size_t i=beg; i<end; i++) lambda(i);},outer_grain());
+    }
+
+    // Reduce lambda(i) over the slices along the first dimension, combining the partials in order.
+    template<typename TYPE2, typename FN, typename COMBINE>
+    TYPE2 reduce_outer(const TYPE2 init, FN&& lambda, COMBINE&& combine) const{
+      CNINE_ASSRT(dims.size()>0);
+      return parallel_reduce(dims[0],init,[&](const size_t beg, const size_t end){
+	  TYPE2 t=lambda(beg);
+	  for(size_t i=beg+1; i<end; i++) t=combine(t,lambda(i));
+	  return t;},combine,outer_grain());
+    }
+
+    // Number of first-dimension slices that make up one parallel chunk
+    size_t outer_grain() const{
+      if(dims.size()==0 || dims[0]==0) return 1;
+      return std::max<size_t>(1,parallel_grain/std::max<size_t>(1,asize()/dims[0]));
+    }
+
 
   public: // ---- Index changes ------------------------------------------------------------------------------
 
@@ -1034,10 +1079,12 @@ namespace cnine{
 
     void inplace_times(const TYPE c){
       if(dev==0){
-	if(is_contiguous())
-	  for(int i=0; i<asize(); i++) arr[i]*=c;
-	else
-	  for_each([&](const Gindex& ix, TYPE& x){x*=c;});
+	if(is_contiguous()){
+	  TYPE* ptr=mem();
+	  parallel_for(asize(),[&](const size_t beg, const size_t end){
+	      for(size_t i=beg; i<end; i++) ptr[i]*=c;});
+	}else
+	  strided_for_each(dims,mem(),strides,[&](TYPE& v){v*=c;});
       }
       if(dev==1){
 	if(is_contiguous()){
@@ -1062,11 +1109,12 @@ namespace cnine{
       assert(asize()==x.asize());
       if(dev==0){
 	if(is_regular() && x.is_regular() && strides==x.strides){
-	  TYPE* ptr=const_cast<MemArr<TYPE>&>(arr).get_arr();
-	  TYPE* xptr=const_cast<MemArr<TYPE>&>(x.arr).get_arr();
-	  for(size_t i=0; i<asize(); i++) ptr[i]+=xptr[i];
+	  TYPE* ptr=mem();
+	  const TYPE* xptr=x.mem();
+	  parallel_for(asize(),[&](const size_t beg, const size_t end){
+	      for(size_t i=beg; i<end; i++) ptr[i]+=xptr[i];});
 	}else
-	  for_each([&](const Gindex& ix, TYPE& v){v+=x(ix);});
+	  strided_for_each(dims,mem(),strides,x.mem(),x.strides,[](TYPE& r, const TYPE v){r+=v;});
       }
       if(dev==1){
 	if(is_regular() && x.is_regular() && strides==x.strides){
@@ -1096,11 +1144,12 @@ namespace cnine{
       assert(asize()==x.asize());
       if(dev==0){
 	if(is_regular() && x.is_regular() && strides==x.strides){
-	  TYPE* ptr=const_cast<MemArr<TYPE>&>(arr).get_arr();
-	  TYPE* xptr=const_cast<MemArr<TYPE>&>(x.arr).get_arr();
-	  for(size_t i=0; i<asize(); i++) ptr[i]-=xptr[i];
+	  TYPE* ptr=mem();
+	  const TYPE* xptr=x.mem();
+	  parallel_for(asize(),[&](const size_t beg, const size_t end){
+	      for(size_t i=beg; i<end; i++) ptr[i]-=xptr[i];});
 	}else
-	  for_each([&](const Gindex& ix, TYPE& v){v-=x(ix);});
+	  strided_for_each(dims,mem(),strides,x.mem(),x.strides,[](TYPE& r, const TYPE v){r-=v;});
       }
       if(dev==1){
 	if(is_contiguous() && x.is_contiguous() && strides==x.strides){
@@ -1122,12 +1171,12 @@ namespace cnine{
       assert(asize()==x.asize());
       if(dev==0){
 	if(is_regular() && x.is_regular() && strides==x.strides){
-	  TYPE* ptr=const_cast<MemArr<TYPE>&>(arr).get_arr();/*+strides.offset*/
-	  TYPE* xptr=const_cast<MemArr<TYPE>&>(x.arr).get_arr()/*+x.strides.offset*/;
-	  for(size_t i=0; i<asize(); i++) ptr[i]+=c*xptr[i];
-	}else{
-	  for_each([&](const Gindex& ix, TYPE& v){v+=c*x(ix);});
-	}
+	  TYPE* ptr=mem();
+	  const TYPE* xptr=x.mem();
+	  parallel_for(asize(),[&](const size_t beg, const size_t end){
+	      for(size_t i=beg; i<end; i++) ptr[i]+=c*xptr[i];});
+	}else
+	  strided_for_each(dims,mem(),strides,x.mem(),x.strides,[&](TYPE& r, const TYPE v){r+=c*v;});
       }
       if(dev==1){
 	if(is_regular() && x.is_regular() && strides==x.strides){
@@ -1151,12 +1200,12 @@ namespace cnine{
       assert(asize()==x.asize());
       if(dev==0){
 	if(is_regular() && x.is_regular() && strides==x.strides){
-	  TYPE* ptr=const_cast<MemArr<TYPE>&>(arr).get_arr();/*+strides.offset*/
-	  TYPE* xptr=const_cast<MemArr<TYPE>&>(x.arr).get_arr()/*+x.strides.offset*/;
-	  for(size_t i=0; i<asize(); i++) ptr[i]-=c*xptr[i];
-	}else{
-	  for_each([&](const Gindex& ix, TYPE& v){v-=c*x(ix);});
-	}
+	  TYPE* ptr=mem();
+	  const TYPE* xptr=x.mem();
+	  parallel_for(asize(),[&](const size_t beg, const size_t end){
+	      for(size_t i=beg; i<end; i++) ptr[i]-=c*xptr[i];});
+	}else
+	  strided_for_each(dims,mem(),strides,x.mem(),x.strides,[&](TYPE& r, const TYPE v){r-=c*v;});
       }
       if(dev==1){
 	if(is_regular() && x.is_regular() && strides==x.strides){
@@ -1174,12 +1223,14 @@ namespace cnine{
       CNINE_DIMS_SAME(y);
       if(dev==0){
 	if(is_regular() && x.is_regular() && y.is_regular() && strides==x.strides&& strides==y.strides){
-	  TYPE* ptr=const_cast<MemArr<TYPE>&>(arr).get_arr();
-	  TYPE* xptr=const_cast<MemArr<TYPE>&>(x.arr).get_arr();
-	  TYPE* yptr=const_cast<MemArr<TYPE>&>(y.arr).get_arr();
-	  for(int i=0; i<asize(); i++) ptr[i]+=xptr[i]*yptr[i];
+	  TYPE* ptr=mem();
+	  const TYPE* xptr=x.mem();
+	  const TYPE* yptr=y.mem();
+	  parallel_for(asize(),[&](const size_t beg, const size_t end){
+	      for(size_t i=beg; i<end; i++) ptr[i]+=xptr[i]*yptr[i];});
 	}else
-	  for_each([&](const Gindex& ix, TYPE& v){v+=x(ix)*y(ix);});
+	  strided_for_each(dims,mem(),strides,x.mem(),x.strides,y.mem(),y.strides,
+	    [](TYPE& r, const TYPE a, const TYPE b){r+=a*b;});
       }
       if(dev==1){
 	CNINE_UNIMPL();
@@ -1197,10 +1248,16 @@ namespace cnine{
     void add_ReLU(const TensorView& x, const float alpha){
       CNINE_CHECK_SIZE(dims.check_eq(x.dims));
       assert(x.get_dev()==get_dev());
-      int N=asize();
       if(dev==0){
-	for(int i=0; i<N; i++) 
-	  arr[i]+=((x.arr[i]>0)+alpha*(x.arr[i]<0))*x.arr[i];
+	if(is_regular() && x.is_regular()){
+	  TYPE* ptr=mem();
+	  const TYPE* xptr=x.mem();
+	  parallel_for(asize(),[&](const size_t beg, const size_t end){
+	      for(size_t i=beg; i<end; i++) 
+		ptr[i]+=((xptr[i]>0)+alpha*(xptr[i]<0))*xptr[i];});
+	}else
+	  strided_for_each(dims,mem(),strides,x.mem(),x.strides,[&](TYPE& r, const TYPE v){
+	      r+=((v>0)+alpha*(v<0))*v;});
       }
       if(dev==1){
 	flat_view().add_ReLU(x.flat_view(),alpha);
@@ -1280,6 +1337,16 @@ namespace cnine{
 	  CNINE_ASSRT(y.dims[1]==r.dims[1]);
 	  CNINE_ASSRT(x.dims[1]==y.dims[0]);
 
+	  if(r.dev==0){
+	    if constexpr(std::is_same<TYPE,complex<float> >::value)
+	      cpu_gemm(r.dims[0],r.dims[1],x.dims[1],x.mem(),x.strides[0],x.strides[1],
+		y.mem(),y.strides[0],y.strides[1],r.mem(),r.strides[0],r.strides[1]);
+	    else
+	      cpu_gemm<TYPE>(r.dims[0],r.dims[1],x.dims[1],1,x.mem(),x.strides[0],x.strides[1],
+		y.mem(),y.strides[0],y.strides[1],r.mem(),r.strides[0],r.strides[1]);
+	    return;
+	  }
+
 	  r.view2().add_mprod(x.view2(),y.view2());
 
 	  /*
@@ -1379,28 +1446,44 @@ namespace cnine{
 
     TYPE max() const{
       if(asize()==0) return 0;
-      TYPE t=arr[0];
+      auto combine=[](const TYPE a, const TYPE b){return (b>a)?b:a;};
       if(is_contiguous()){
-	for(size_t i=0; i<asize(); i++)
-	  if(arr[i]>t) t=arr[i];
-      }else{
-	for_each([&](const Gindex& ix, TYPE& v){
-	    if(v>t) t=v;});
+	const TYPE* ptr=mem();
+	return parallel_reduce(asize(),ptr[0],[&](const size_t beg, const size_t end){
+	    TYPE t=ptr[beg];
+	    for(size_t i=beg+1; i<end; i++)
+	      if(ptr[i]>t) t=ptr[i];
+	    return t;},combine);
       }
-      return t; 
+      if(ndims()==1){
+	const TYPE* ptr=mem(); size_t s=strides[0];
+	TYPE t=ptr[0];
+	for(size_t i=1; i<dims[0]; i++)
+	  if(ptr[i*s]>t) t=ptr[i*s];
+	return t;
+      }
+      return reduce_outer(arr[0],[&](const int i){return slice(0,i).max();},combine);
     }
 
     TYPE min() const{
       if(asize()==0) return 0;
-      TYPE t=arr[0];
+      auto combine=[](const TYPE a, const TYPE b){return (b<a)?b:a;};
       if(is_contiguous()){
-	for(size_t i=0; i<asize(); i++)
-	  if(arr[i]<t) t=arr[i];
-      }else{
-	for_each([&](const Gindex& ix, TYPE& v){
-	    if(v<t) t=v;});
+	const TYPE* ptr=mem();
+	return parallel_reduce(asize(),ptr[0],[&](const size_t beg, const size_t end){
+	    TYPE t=ptr[beg];
+	    for(size_t i=beg+1; i<end; i++)
+	      if(ptr[i]<t) t=ptr[i];
+	    return t;},combine);
       }
-      return t; 
+      if(ndims()==1){
+	const TYPE* ptr=mem(); size_t s=strides[0];
+	TYPE t=ptr[0];
+	for(size_t i=1; i<dims[0]; i++)
+	  if(ptr[i*s]<t) t=ptr[i*s];
+	return t;
+      }
+      return reduce_outer(arr[0],[&](const int i){return slice(0,i).min();},combine);
     }
 
     auto max_abs() const -> decltype(std::real(min())){
@@ -1410,9 +1493,8 @@ namespace cnine{
 	for(int i=0; i<asize(); i++)
 	  if(abs(arr[i])>t) t=abs(arr[i]);
       }else{
-	CNINE_UNIMPL()
-	//for_each([&](const Gindex& ix, TYPE& v){
-	//  if(abs(v)>t) t=abs(v);});
+	strided_for_each(dims,mem(),strides,[&](const TYPE v){
+	    if(abs(v)>t) t=abs(v);},false);
       }
       return t; 
     }
@@ -1422,15 +1504,25 @@ namespace cnine{
       CNINE_ASSRT(dims==y.dims);
       TYPE t=0;
       if(dev==0){
+	auto combine=[](const TYPE a, const TYPE b){return a+b;};
 	if(is_regular() && y.is_regular()){
-	  for(size_t i=0; i<asize(); i++)
-	    t+=arr[i]*y.arr[i];
-	  //t+=std::conj(arr[i])*y.arr[i];
-	}else{
-	  for_each([&](const Gindex& ix, TYPE& v){
-	      t+=v*y(ix);});
-	  //t+=std::conj(v)*y(ix);});
+	  const TYPE* ptr=mem();
+	  const TYPE* yptr=y.mem();
+	  return parallel_reduce(asize(),t,[&](const size_t beg, const size_t end){
+	      TYPE s=0;
+	      for(size_t i=beg; i<end; i++)
+		s+=ptr[i]*yptr[i];
+	      //s+=std::conj(ptr[i])*yptr[i];
+	      return s;},combine);
+	}
+	if(ndims()==1){
+	  const TYPE* ptr=mem(); size_t s=strides[0];
+	  const TYPE* yptr=y.mem(); size_t ys=y.strides[0];
+	  for(size_t i=0; i<dims[0]; i++)
+	    t+=ptr[i*s]*yptr[i*ys];
+	  return t;
 	}
+	return reduce_outer(t,[&](const int i){return slice(0,i).inp(y.slice(0,i));},combine);
       }
       return t;
     }
@@ -1439,15 +1531,23 @@ namespace cnine{
       CNINE_CPUONLY();
       TYPE t=0;
       if(dev==0){
+	auto combine=[](const TYPE a, const TYPE b){return a+b;};
 	if(is_contiguous()){
-	  for(size_t i=0; i<asize(); i++)
-	    t+=arr[i]*arr[i];
-	  //t+=std::conj(arr[i])*arr[i];
-	}else{
-	  for_each([&](const Gindex& ix, TYPE& v){
-	      t+=v*v;});
-	  //t+=std::conj(v)*v;});
+	  const TYPE* ptr=mem();
+	  return parallel_reduce(asize(),t,[&](const size_t beg, const size_t end){
+	      TYPE s=0;
+	      for(size_t i=beg; i<end; i++)
+		s+=ptr[i]*ptr[i];
+	      //s+=std::conj(ptr[i])*ptr[i];
+	      return s;},combine);
 	}
+	if(ndims()==1){
+	  const TYPE* ptr=mem(); size_t s=strides[0];
+	  for(size_t i=0; i<dims[0]; i++)
+	    t+=ptr[i*s]*ptr[i*s];
+	  return t;
+	}
+	return reduce_outer(t,[&](const int i){return slice(0,i).norm2();},combine);
       }
       return t;
     }
@@ -1470,13 +1570,13 @@ namespace cnine{
 	    t+=a*a;
 	}
       }else{
-	for_each([&](const Gindex& ix, TYPE& v){
-	    const TYPE a=x(ix)-(*this)(ix);
+	strided_for_each(dims,mem(),strides,x.mem(),x.strides,[&](const TYPE v, const TYPE w){
+	    const TYPE a=w-v;
 	    if constexpr(is_complex<TYPE>())
 	      t+=a*std::conj(a);
 	    else
 	      t+=a*a;
-	  });
+	  },false);
       }
       return t;
     }
@@ -0,0 +1,424 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineTensorEinsum
+#define _CnineTensorEinsum
+
+#include "Tensor.hpp"
+#include "EinsumPlan.hpp"
+#include "CnineProfiler.hpp"
+
+
+// Einsum with any number of operands, e.g.
+//
+//   auto R=einsum<float>("ij,jk,kl->il",{A,B,C});
+//
+// The operands are contracted two at a time. The order of the pairwise contractions is chosen from
+// the index extents, either by exhaustive search over all contraction trees (optimal) or by
+// repeatedly performing the cheapest available contraction (greedy). Each pairwise step is lowered
+// to batched GEMM by EinsumPlan, and intermediates live in a small set of buffers that are reused
+// once the intermediates stored in them have been consumed.
+
+namespace cnine{
+
+
+  enum class EinsumStrategy{automatic,optimal,greedy};
+
+
+  class EinsumStep{
+  public:
+    int a=0; // positions of the operands in the current operand list
+    int b=-1; // -1 for a single operand einsum
+    string xstr, ystr, rstr;
+    Gdims rdims;
+    double flops=0;
+    int slot=-1; // buffer holding the result, -1 for the final output
+  };
+
+
+  class EinsumContraction{
+  public:
+
+    static constexpr int max_optimal=8;
+
+    vector<string> inputs;
+    string output;
+    map<char,int> extent;
+
+    vector<EinsumStep> steps;
+    vector<size_t> slot_size;
+    double flops=0;
+
+
+    EinsumContraction(const string& str, const vector<Gdims>& dims, const EinsumStrategy strategy=EinsumStrategy::automatic){
+      auto d=str.find("->");
+      if(d==string::npos) CNINE_ERROR("malformed einsum string \""+str+"\"");
+      output=str.substr(d+2);
+      string lhs=str.substr(0,d);
+      size_t p=0;
+      while(true){
+	auto q=lhs.find(',',p);
+	inputs.push_back(lhs.substr(p,q==string::npos?string::npos:q-p));
+	if(q==string::npos) break;
+	p=q+1;
+      }
+      const int N=inputs.size();
+      if(N>31) CNINE_ERROR("einsum with more than 31 operands"); // subsets of operands are bitmasks
+      if(dims.size()!=N) CNINE_ERROR("einsum string \""+str+"\" has "+to_string(N)+" operands but "+to_string(dims.size())+" were given");
+
+      for(int i=0; i<N; i++){
+	if(inputs[i].size()!=dims[i].size())
+	  CNINE_ERROR("operand "+to_string(i)+" has "+to_string(dims[i].size())+" dimensions but einsum string \""+str+"\" has "+to_string(inputs[i].size())+" indices");
+	for(int j=0; j<inputs[i].size(); j++){
+	  char c=inputs[i][j];
+	  if(extent.count(c) && extent[c]!=dims[i][j])
+	    CNINE_ERROR("inconsistent extents for index '"+string(1,c)+"' in \""+str+"\"");
+	  extent[c]=dims[i][j];
+	}
+      }
+      for(auto c:output)
+	if(!extent.count(c)) CNINE_ERROR("output index '"+string(1,c)+"' of \""+str+"\" does not appear in any operand");
+
+      if(N==1){
+	EinsumStep step;
+	step.xstr=inputs[0];
+	step.rstr=output;
+	step.rdims=dims_of(output);
+	step.flops=2*volume(inputs[0]+output);
+	flops=step.flops;
+	steps.push_back(step);
+	return;
+      }
+
+      // the exhaustive search takes 2^N memory and 3^N time
+      if(strategy==EinsumStrategy::optimal && N>max_optimal)
+	CNINE_ERROR("optimal contraction order requested for "+to_string(N)+" operands, the limit is "+to_string(max_optimal)+"; use EinsumStrategy::greedy");
+
+      vector<pair<int,int> > tree;
+      if(strategy==EinsumStrategy::optimal || (strategy==EinsumStrategy::automatic && N<=max_optimal))
+	tree=optimal_order();
+      else
+	tree=greedy_order();
+      make_steps(tree);
+    }
+
+
+  public: // ---- Access ---------------------------------------------------------------------------------------
+
+
+    int noperands() const{
+      return inputs.size();
+    }
+
+    // Pairs of positions in the operand list contracted at each step. The result of each step is
+    // appended to the end of the list, as in numpy.einsum_path.
+    vector<pair<int,int> > path() const{
+      vector<pair<int,int> > R;
+      for(auto& p:steps)
+	R.push_back(make_pair(p.a,p.b));
+      return R;
+    }
+
+    Gdims output_dims() const{
+      return dims_of(output);
+    }
+
+    // Flops of evaluating the whole einsum as a single nested loop
+    double naive_flops() const{
+      string all=output;
+      for(auto& p:inputs) all+=p;
+      return 2*volume(all)*std::max<int>(1,noperands()-1);
+    }
+
+
+  public: // ---- Execution ------------------------------------------------------------------------------------
+
+
+    template<typename TYPE>
+    void add_to(const TensorView<TYPE>& r, const vector<TensorView<TYPE> >& args) const{
+      CNINE_ASSRT(args.size()==inputs.size());
+      CNINE_ASSRT(r.get_dims()==output_dims());
+      CNINE_ASSRT(r.get_dev()==0);
+      for(int i=0; i<args.size(); i++){
+	CNINE_ASSRT(args[i].get_dev()==0);
+	CNINE_ASSRT(args[i].get_dims()==dims_of(inputs[i]));
+      }
+      CNINE_PROFILE_OPS("einsum",(long long)flops);
+
+      vector<MemArr<TYPE> > buffers;
+      for(auto s:slot_size)
+	buffers.push_back(MemArr<TYPE>(s));
+
+      // views of the results are kept in a reserved vector so that they never have to be assigned
+      vector<TensorView<TYPE> > results;
+      results.reserve(steps.size());
+      vector<const TensorView<TYPE>*> ops;
+      for(auto& p:args) ops.push_back(&p);
+      Tensor<TYPE> one({1},fill_constant<TYPE>(1));
+
+      for(auto& step:steps){
+	const TensorView<TYPE>& x=*ops[step.a];
+	const TensorView<TYPE>& y=(step.b>=0)?*ops[step.b]:one;
+	if(step.slot>=0){
+	  results.emplace_back(buffers[step.slot],step.rdims,GstridesB(step.rdims));
+	  results.back().set_zero();
+	}else
+	  results.push_back(r);
+	const TensorView<TYPE>& R=results.back();
+
+	auto plan=einsum_plan_cache()(step.xstr+","+step.ystr+"->"+step.rstr,indices(step,R,x,y));
+	(*plan)(R.mem(),x.mem(),y.mem());
+
+	if(step.b>=0){
+	  ops.erase(ops.begin()+std::max(step.a,step.b));
+	  ops.erase(ops.begin()+std::min(step.a,step.b));
+	}else
+	  ops.erase(ops.begin()+step.a);
+	ops.push_back(&R);
+      }
+    }
+
+
+  public: // ---- I/O ------------------------------------------------------------------------------------------
+
+
+    string str(const string indent="") const{
+      ostringstream oss;
+      for(int i=0; i<steps.size(); i++){
+	auto& p=steps[i];
+	oss<<indent<<"Step "<<i<<": ("<<p.a;
+	if(p.b>=0) oss<<","<<p.b;
+	oss<<") "<<p.xstr;
+	if(p.b>=0) oss<<","<<p.ystr;
+	oss<<"->"<<p.rstr<<"  flops="<<p.flops<<endl;
+      }
+      oss<<indent<<"Estimated flops: "<<flops<<" (naive: "<<naive_flops()<<")"<<endl;
+      return oss.str();
+    }
+
+    friend ostream& operator<<(ostream& stream, const EinsumContraction& x){
+      stream<<x.str(); return stream;
+    }
+
+
+  private: // ---- Contraction order ----------------------------------------------------------------------------
+
+
+    double volume(const string& s) const{
+      double t=1;
+      set<char> seen;
+      for(auto c:s)
+	if(seen.insert(c).second) t*=extent.at(c);
+      return t;
+    }
+
+    Gdims dims_of(const string& s) const{
+      vector<int> v;
+      for(auto c:s) v.push_back(extent.at(c));
+      return Gdims(v);
+    }
+
+    // Indices of the intermediate formed from the operands in the subset S that are still needed
+    // by the output or by operands outside S. The output's indices come first, in output order.
+    string indices_of(const unsigned int S) const{
+      string in;
+      string out;
+      for(int i=0; i<inputs.size(); i++)
+	if(S&(1u<<i)) in+=inputs[i];
+	else out+=inputs[i];
+      string R;
+      for(auto c:output)
+	if(in.find(c)!=string::npos && R.find(c)==string::npos) R+=c;
+      for(auto c:in)
+	if(out.find(c)!=string::npos && R.find(c)==string::npos) R+=c;
+      return R;
+    }
+
+    double pair_cost(const unsigned int S1, const unsigned int S2) const{
+      return 2*volume(subset_str(S1)+subset_str(S2));
+    }
+
+    // Dynamic programming over subsets of operands
+    vector<pair<int,int> > optimal_order() const{
+      const int N=inputs.size();
+      const unsigned int full=(1u<<N)-1;
+      vector<double> cost(full+1,std::numeric_limits<double>::infinity());
+      vector<unsigned int> split(full+1,0);
+      for(int i=0; i<N; i++) cost[1u<<i]=0;
+
+      for(unsigned int S=1; S<=full; S++){
+	if((S&(S-1))==0) continue;
+	const unsigned int low=S&(~S+1);
+	for(unsigned int S1=(S-1)&S; S1>0; S1=(S1-1)&S){
+	  if(!(S1&low)) continue;
+	  const unsigned int S2=S^S1;
+	  double c=cost[S1]+cost[S2]+pair_cost(S1,S2);
+	  if(c<cost[S]){
+	    cost[S]=c;
+	    split[S]=S1;
+	  }
+	}
+      }
+
+      vector<pair<int,int> > R;
+      std::function<void(unsigned int)> emit=[&](unsigned int S){
+	if((S&(S-1))==0) return;
+	emit(split[S]);
+	emit(S^split[S]);
+	R.push_back(make_pair((int)split[S],(int)(S^split[S])));
+      };
+      emit(full);
+      return R;
+    }
+
+    // Repeatedly contract the pair of current operands that is cheapest to contract
+    vector<pair<int,int> > greedy_order() const{
+      vector<unsigned int> current;
+      for(int i=0; i<inputs.size(); i++)
+	current.push_back(1u<<i);
+      vector<pair<int,int> > R;
+      while(current.size()>1){
+	int besti=0, bestj=1;
+	double best=std::numeric_limits<double>::infinity();
+	double best_size=0;
+	for(int i=0; i<current.size(); i++)
+	  for(int j=i+1; j<current.size(); j++){
+	    double c=pair_cost(current[i],current[j]);
+	    double s=volume(indices_of(current[i]|current[j]));
+	    if(c<best || (c==best && s<best_size)){
+	      best=c; best_size=s; besti=i; bestj=j;
+	    }
+	  }
+	R.push_back(make_pair((int)current[besti],(int)current[bestj]));
+	unsigned int S=current[besti]|current[bestj];
+	current.erase(current.begin()+bestj);
+	current.erase(current.begin()+besti);
+	current.push_back(S);
+      }
+      return R;
+    }
+
+    // Translate a sequence of subset merges into steps on the operand list and assign buffers to
+    // the intermediates. A buffer is released when its intermediate is consumed, but not reused by
+    // the step consuming it.
+    void make_steps(const vector<pair<int,int> >& tree){
+      const unsigned int full=(1u<<inputs.size())-1;
+      vector<unsigned int> current;
+      vector<int> slot_of;
+      for(int i=0; i<inputs.size(); i++){
+	current.push_back(1u<<i);
+	slot_of.push_back(-1);
+      }
+      vector<bool> slot_free;
+
+      for(auto& p:tree){
+	const unsigned int S1=p.first, S2=p.second, S=S1|S2;
+	EinsumStep step;
+	step.a=std::find(current.begin(),current.end(),S1)-current.begin();
+	step.b=std::find(current.begin(),current.end(),S2)-current.begin();
+	step.xstr=subset_str(S1);
+	step.ystr=subset_str(S2);
+	if(step.a>step.b){
+	  std::swap(step.a,step.b);
+	  std::swap(step.xstr,step.ystr);
+	}
+	step.rstr=(S==full)?output:indices_of(S);
+	step.rdims=dims_of(step.rstr);
+	step.flops=2*volume(step.xstr+step.ystr+step.rstr);
+	flops+=step.flops;
+
+	if(S!=full){
+	  const size_t size=std::max<size_t>(1,volume(step.rstr));
+	  int s=0;
+	  for(; s<slot_free.size(); s++)
+	    if(slot_free[s]) break;
+	  if(s==slot_free.size()){
+	    slot_free.push_back(false);
+	    slot_size.push_back(0);
+	  }
+	  slot_free[s]=false;
+	  slot_size[s]=std::max(slot_size[s],size);
+	  step.slot=s;
+	}
+
+	for(int i: {step.a,step.b})
+	  if(slot_of[i]>=0) slot_free[slot_of[i]]=true;
+	const int hi=std::max(step.a,step.b), lo=std::min(step.a,step.b);
+	current.erase(current.begin()+hi); slot_of.erase(slot_of.begin()+hi);
+	current.erase(current.begin()+lo); slot_of.erase(slot_of.begin()+lo);
+	current.push_back(S);
+	slot_of.push_back(step.slot);
+	steps.push_back(step);
+      }
+    }
+
+    // Index string of the operand formed from the subset S: an input itself or an intermediate
+    string subset_str(const unsigned int S) const{
+      if((S&(S-1))==0){
+	int i=0;
+	while(!(S&(1u<<i))) i++;
+	return inputs[i];
+      }
+      return indices_of(S);
+    }
+
+
+    template<typename TYPE>
+    static vector<EinsumIndex> indices(const EinsumStep& step, const TensorView<TYPE>& r, const TensorView<TYPE>& x, const TensorView<TYPE>& y){
+      map<char,EinsumIndex> R;
+      for(int i=0; i<step.rstr.size(); i++){
+	auto& p=R[step.rstr[i]];
+	p.n=r.dim(i); p.inr=true; p.rs+=r.stride(i);
+      }
+      for(int i=0; i<step.xstr.size(); i++){
+	auto& p=R[step.xstr[i]];
+	p.n=x.dim(i); p.inx=true; p.xs+=x.stride(i);
+      }
+      for(int i=0; i<step.ystr.size(); i++){
+	auto& p=R[step.ystr[i]];
+	p.n=y.dim(i); p.iny=true; p.ys+=y.stride(i);
+      }
+      vector<EinsumIndex> v;
+      for(auto& p:R) v.push_back(p.second);
+      return v;
+    }
+
+  };
+
+
+  // ---- Functions ----------------------------------------------------------------------------------------------
+
+
+  template<typename TYPE>
+  inline void add_einsum(const TensorView<TYPE>& r, const string& str, const vector<TensorView<TYPE> >& args,
+    const EinsumStrategy strategy=EinsumStrategy::automatic){
+    vector<Gdims> dims;
+    for(auto& p:args) dims.push_back(p.get_dims());
+    EinsumContraction(str,dims,strategy).add_to(r,args);
+  }
+
+  template<typename TYPE>
+  inline Tensor<TYPE> einsum(const string& str, const vector<TensorView<TYPE> >& args,
+    const EinsumStrategy strategy=EinsumStrategy::automatic){
+    vector<Gdims> dims;
+    for(auto& p:args) dims.push_back(p.get_dims());
+    EinsumContraction contraction(str,dims,strategy);
+    Tensor<TYPE> R(contraction.output_dims(),fill_zero(),args.size()>0?args[0].get_dev():0);
+    contraction.add_to(R,args);
+    return R;
+  }
+
+}
+
+#endif
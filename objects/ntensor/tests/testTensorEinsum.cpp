@@ -0,0 +1,119 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+#include "CnineSession.hpp"
+#include "TensorEinsum.hpp"
+
+using namespace cnine;
+
+
+// Brute force evaluation by running over every assignment of the index letters
+Tensor<float> reference(const string& str, const vector<TensorView<float> >& args){
+  auto d=str.find("->");
+  string output=str.substr(d+2);
+  vector<string> inputs;
+  stringstream ss(str.substr(0,d));
+  string s;
+  while(getline(ss,s,',')) inputs.push_back(s);
+
+  map<char,int> extent;
+  for(int i=0; i<args.size(); i++)
+    for(int j=0; j<inputs[i].size(); j++)
+      extent[inputs[i][j]]=args[i].dim(j);
+  vector<char> letters;
+  for(auto& p:extent) letters.push_back(p.first);
+
+  vector<int> rdims;
+  for(auto c:output) rdims.push_back(extent[c]);
+  Tensor<float> R=Tensor<float>::zero(Gdims(rdims));
+
+  map<char,int> ix;
+  for(auto c:letters) ix[c]=0;
+  auto offset=[&](const string& s, const TensorView<float>& x){
+    int t=0;
+    for(int i=0; i<s.size(); i++) t+=ix[s[i]]*x.stride(i);
+    return t;};
+  while(true){
+    float t=1;
+    for(int i=0; i<args.size(); i++)
+      t*=args[i].mem()[offset(inputs[i],args[i])];
+    R.mem()[offset(output,R)]+=t;
+    int i=letters.size()-1;
+    for(; i>=0; i--){
+      if(++ix[letters[i]]<extent[letters[i]]) break;
+      ix[letters[i]]=0;
+    }
+    if(i<0) break;
+  }
+  return R;
+}
+
+
+void test(const string& str, const vector<Gdims>& dims, const EinsumStrategy strategy=EinsumStrategy::automatic){
+  vector<Tensor<float> > T;
+  vector<TensorView<float> > args;
+  for(auto& p:dims) T.push_back(Tensor<float>::gaussian(p));
+  for(auto& p:T) args.push_back(p);
+
+  vector<Gdims> shapes;
+  for(auto& p:args) shapes.push_back(p.get_dims());
+  EinsumContraction contraction(str,shapes,strategy);
+  cout<<str<<endl<<contraction.str("  ");
+
+  Tensor<float> R=einsum(str,args,strategy);
+  Tensor<float> R0=reference(str,args);
+  cout<<"  error="<<sqrt(R.diff2(R0))<<endl<<endl;
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session(4);
+
+  test("ij,jk,kl->il",{{10,20},{20,30},{30,5}});
+  test("ij,jk,k->i",{{30,30},{30,30},{30}});
+  test("ij,jk,k->i",{{30,30},{30,30},{30}},EinsumStrategy::greedy);
+  test("bij,bjk,bkl->bil",{{3,8,9},{3,9,10},{3,10,2}});
+  test("ai,bi,ci->abc",{{4,20},{5,20},{6,20}});
+  test("ij,jk,kl,lm->im",{{40,2},{2,40},{40,2},{2,40}});
+  test("ij,jk,kl,lm->im",{{40,2},{2,40},{40,2},{2,40}},EinsumStrategy::greedy);
+  test("ijk,jl,km->ilm",{{5,6,7},{6,8},{7,9}});
+  test("ij,j->i",{{20,30},{30}});
+  test("iij->ij",{{6,6,4}});
+  test("ij,kl->ijkl",{{3,4},{5,6}});
+
+  // operand subsets are 32 bit masks
+  string many="a";
+  for(int i=1; i<32; i++) many+=",a";
+  try{
+    EinsumContraction contraction(many+"->a",vector<Gdims>(32,Gdims(2)));
+  }catch(std::exception& e){
+    cout<<"32 operands: "<<e.what()<<endl;
+  }
+
+  // the exhaustive order search is only available up to max_optimal operands
+  string chain="ab";
+  vector<Gdims> chain_dims(1,Gdims(2,2));
+  for(int i=1; i<=EinsumContraction::max_optimal; i++){
+    chain+=string(",")+char('a'+i)+char('a'+i+1);
+    chain_dims.push_back(Gdims(2,2));
+  }
+  try{
+    EinsumContraction contraction(chain+"->a"+char('a'+EinsumContraction::max_optimal+1),chain_dims,EinsumStrategy::optimal);
+  }catch(std::exception& e){
+    cout<<EinsumContraction::max_optimal+1<<" operands, optimal: "<<e.what()<<endl;
+  }
+  test(chain+"->a"+char('a'+EinsumContraction::max_optimal+1),chain_dims);
+
+}
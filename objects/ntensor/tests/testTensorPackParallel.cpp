@@ -0,0 +1,89 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#include "Cnine_base.cpp"
+#include "TensorPack.hpp"
+#include "CnineSession.hpp"
+
+using namespace cnine;
+
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+  parallel_grain=1000;
+
+  // Many small tensors of a few different shapes and one large one
+  vector<Gdims> xdims, rdims, ydims;
+  for(int i=0; i<300; i++){
+    xdims.push_back(Gdims(2+i%5,3+i%4));
+    rdims.push_back(Gdims(3+i%4,2+i%5));
+    ydims.push_back(Gdims(3+i%4,4));
+  }
+  xdims.push_back(Gdims(60,70));
+  rdims.push_back(Gdims(70,60));
+  ydims.push_back(Gdims(70,4));
+
+  TensorPackDir xdir(xdims), rdir(rdims), ydir(ydims);
+  TensorPack<float> X(xdir,fill_gaussian());
+  TensorPack<float> Y(ydir,fill_gaussian());
+  TensorPackView<float> Xt=X.transp();
+  cout<<"Transposed pack contiguous: "<<Xt.is_contiguous()<<endl;
+
+  TensorPackLoop<2> loop({&rdir,&Xt.dir});
+  cout<<"Groups: "<<loop.groups.size()<<", small: "<<loop.small.size()<<", large: "<<loop.large.size()<<endl;
+
+  int errors=0;
+  for(int n: {1,2,4}){
+    nthreads=n;
+    TensorPack<float> R(rdir,fill_zero());
+    R.add(Xt);
+    R.add(Xt,2.0);
+    R.inplace_times(0.5);
+    TensorPackView<float> Rt=R.transp();
+    Rt.add(X,-1.5);
+
+    TensorPack<float> S(rdir,fill_zero());
+    S.view()=Xt;
+
+    int e=0;
+    for(int i=0; i<R.size(); i++){
+      if(R(i).max_abs()>1e-4) e++;
+      for(int a=0; a<S(i).dim(0); a++)
+	for(int b=0; b<S(i).dim(1); b++)
+	  if(S(i)(a,b)!=X(i)(b,a)) e++;
+    }
+
+    // Member by member products, largest first
+    vector<Gdims> pdims;
+    for(int i=0; i<xdims.size(); i++) pdims.push_back(Gdims(xdims[i][0],4));
+    TensorPackDir pdir(pdims);
+    TensorPack<float> Pk(pdir,fill_zero());
+    Pk.add_mprod(X,Y);
+    for(int i=0; i<Pk.size(); i++){
+      Tensor<float> T=Tensor<float>::zero(pdims[i]);
+      T.add_mprod(X(i),Y(i));
+      if(T.diff2(Pk(i))>1e-6) e++;
+    }
+
+    cout<<"  nthreads="<<n<<": errors="<<e<<endl;
+    errors+=e;
+  }
+
+  nthreads=4;
+  Xt.set_zero();
+  if(X.view().fuse().max_abs()!=0) errors++;
+  cout<<"Errors: "<<errors<<endl;
+
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#include "Cnine_base.cpp"
+#include "Tensor.hpp"
+#include "CnineSession.hpp"
+
+using namespace cnine;
+
+
+template<typename TYPE>
+void run_ops(const TensorView<TYPE>& x, const TensorView<TYPE>& y, const int n){
+  nthreads=n;
+
+  Tensor<TYPE> R=Tensor<TYPE>::zero({x.dim(2),x.dim(0),x.dim(1)});
+  TensorView<TYPE> r=R.permute_indices({1,2,0});
+  r.add(x);
+  r.subtract(y,0.5);
+  r.add_prod(x,y);
+  r.add_ReLU(y,0.1);
+  r.inplace_times(2.0);
+
+  cout<<"  nthreads="<<n<<": norm="<<r.norm()<<" max="<<r.max()<<" min="<<r.min()
+      <<" inp="<<x.inp(y)<<endl;
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+  parallel_grain=1000;
+
+  Tensor<float> A=Tensor<float>::gaussian({40,50,60});
+  Tensor<float> B=Tensor<float>::gaussian({60,40,50});
+  TensorView<float> Bp=B.permute_indices({1,2,0});
+
+  cout<<"Regular:"<<endl;
+  for(int n: {1,2,4})
+    run_ops<float>(A,A,n);
+
+  cout<<"Permuted:"<<endl;
+  for(int n: {1,2,4})
+    run_ops<float>(A,Bp,n);
+
+  nthreads=4;
+  Tensor<float> C=Tensor<float>::zero({40,50,60});
+  C.add(A);
+  C.add(Bp);
+  C.subtract(Bp);
+  cout<<"A+B-B vs A: "<<C.diff2(A)<<endl;
+
+}
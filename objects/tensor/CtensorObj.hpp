@@ -70,7 +70,7 @@ namespace cnine{
 
     //static CtensorObj raw(const Gdims& _dims, const int nbd=-1, const int _dev=0){
     //return CtensorObj(_dims,nbd,fill::raw,_dev);}
-    //static CtensorObj raw(const Gdims& _dims, const int nbd, const device& _dev){
+    //static CtensorObj raw(const Gdims& _dims, const int nbd, const struct device& _dev){
     //return CtensorObj(_dims,nbd,fill::raw,_dev.id());}
     static CtensorObj raw(const Gdims& _dims, const int _dev=0){
       return CtensorObj(_dims,fill::raw,_dev);}
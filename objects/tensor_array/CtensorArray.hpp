@@ -42,7 +42,7 @@ namespace cnine{
 
     template<typename FILLTYPE, typename = typename 
 	     std::enable_if<std::is_base_of<fill_pattern, FILLTYPE>::value, FILLTYPE>::type>
-    CtensorArray(const Gdims& _adims, const Gdims& _cdims, const FILLTYPE& dummy, const device& _dev):
+    CtensorArray(const Gdims& _adims, const Gdims& _cdims, const FILLTYPE& dummy, const struct device& _dev):
       CNINE_CTENSORARRAY_IMPL(_adims,_cdims,dummy,_dev.id()){}
 
 
@@ -51,35 +51,35 @@ namespace cnine{
 
     static CtensorArray raw(const Gdims& _adims, const Gdims& _dims, const int _dev=0){
       return CtensorArray(_adims,_dims,fill::raw,_dev);}
-    static CtensorArray raw(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    static CtensorArray raw(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
       return CtensorArray(_adims,_dims,fill::raw,_dev.id());}
 
     static CtensorArray zero(const Gdims& _adims, const Gdims& _dims, const int _dev=0){
       return CtensorArray(_adims,_dims,fill::zero,_dev);}
-    static CtensorArray zero(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    static CtensorArray zero(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
       return CtensorArray(_adims,_dims,fill::zero,_dev.id());}
 
     static CtensorArray ones(const Gdims& _adims, const Gdims& _dims, const int _dev=0){
       return CtensorArray(_adims,_dims,fill::ones,_dev);}
-    static CtensorArray ones(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    static CtensorArray ones(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
       return CtensorArray(_adims,_dims,fill::ones,_dev.id());}
 
     //static CtensorArray identity(const Gdims& _adims, const Gdims& _dims=-1, const int _dev=0){
     //return CtensorArray(_adims,_dims,CtensorA_setIdentity_cop(),_dev);}
-    //static CtensorArray identity(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    //static CtensorArray identity(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
     //return CtensorArray(_adims,_dims,CtensorA_setIdentity_cop(),_dev.id());}
-    //static CtensorArray identity(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    //static CtensorArray identity(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
     //return CtensorArray(_adims,_dims,-1,CtensorA_setIdentity_cop(),_dev.id());}
 
 
     static CtensorArray sequential(const Gdims& _adims, const Gdims& _dims=-1, const int _dev=0){
       return CtensorArray(_adims,_dims,fill::sequential,_dev);}
-    static CtensorArray sequential(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    static CtensorArray sequential(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
       return CtensorArray(_adims,_dims,fill::sequential,_dev.id());}
 
     static CtensorArray gaussian(const Gdims& _adims, const Gdims& _dims=-1, const int _dev=0){
       return CtensorArray(_adims,_dims,fill::gaussian,_dev);}
-    static CtensorArray gaussian(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    static CtensorArray gaussian(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
       return CtensorArray(_adims,_dims,fill::gaussian,_dev.id());}
     
 
@@ -106,7 +106,7 @@ namespace cnine{
     CtensorArray(const CtensorArray& x, const int _dev):
       CNINE_CTENSORARRAY_IMPL(x,_dev){};
       
-    CtensorArray(const CtensorArray& x, const device& _dev):
+    CtensorArray(const CtensorArray& x, const struct device& _dev):
       CNINE_CTENSORARRAY_IMPL(x,_dev.id()){};
       
     CtensorArray(CtensorArray&& x):
@@ -169,7 +169,7 @@ namespace cnine{
   public: // ---- Transport -----------------------------------------------------------------------------------
 
 
-    CtensorArray to(const device& _dev) const{
+    CtensorArray to(const struct device& _dev) const{
       return CtensorArray(*this,_dev);
     }
 
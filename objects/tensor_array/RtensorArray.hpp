@@ -43,7 +43,7 @@ namespace cnine{
 
     template<typename FILLTYPE, typename = typename 
 	     std::enable_if<std::is_base_of<fill_pattern, FILLTYPE>::value, FILLTYPE>::type>
-    RtensorArray(const Gdims& _adims, const Gdims& _cdims, const FILLTYPE& dummy, const device& _dev):
+    RtensorArray(const Gdims& _adims, const Gdims& _cdims, const FILLTYPE& dummy, const struct device& _dev):
       CNINE_RTENSORARRAY_IMPL(_adims,_cdims,dummy,_dev.id()){}
 
 
@@ -52,35 +52,35 @@ namespace cnine{
 
     static RtensorArray zero(const Gdims& _adims, const Gdims& _dims, const int _dev=0){
       return RtensorArray(_adims,_dims,fill::zero,_dev);}
-    static RtensorArray zero(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    static RtensorArray zero(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
       return RtensorArray(_adims,_dims,fill::zero,_dev.id());}
 
     static RtensorArray raw(const Gdims& _adims, const Gdims& _dims, const int _dev=0){
       return RtensorArray(_adims,_dims,fill::raw,_dev);}
-    static RtensorArray raw(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    static RtensorArray raw(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
       return RtensorArray(_adims,_dims,fill::raw,_dev.id());}
 
     static RtensorArray ones(const Gdims& _adims, const Gdims& _dims, const int _dev=0){
       return RtensorArray(_adims,_dims,fill::ones,_dev);}
-    static RtensorArray ones(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    static RtensorArray ones(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
       return RtensorArray(_adims,_dims,fill::ones,_dev.id());}
 
     //static RtensorArray identity(const Gdims& _adims, const Gdims& _dims=-1, const int _dev=0){
     //return RtensorArray(_adims,_dims,RtensorA_setIdentity_cop(),_dev);}
-    //static RtensorArray identity(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    //static RtensorArray identity(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
     //return RtensorArray(_adims,_dims,RtensorA_setIdentity_cop(),_dev.id());}
-    //static RtensorArray identity(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    //static RtensorArray identity(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
     //return RtensorArray(_adims,_dims,-1,RtensorA_setIdentity_cop(),_dev.id());}
 
 
     static RtensorArray sequential(const Gdims& _adims, const Gdims& _dims, const int _dev=0){
       return RtensorArray(_adims,_dims,fill::sequential,_dev);}
-    static RtensorArray sequential(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    static RtensorArray sequential(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
       return RtensorArray(_adims,_dims,fill::sequential,_dev.id());}
 
     static RtensorArray gaussian(const Gdims& _adims, const Gdims& _dims, const int _dev=0){
       return RtensorArray(_adims,_dims,fill::gaussian,_dev);}
-    static RtensorArray gaussian(const Gdims& _adims, const Gdims& _dims, const device& _dev){
+    static RtensorArray gaussian(const Gdims& _adims, const Gdims& _dims, const struct device& _dev){
       return RtensorArray(_adims,_dims,fill::gaussian,_dev.id());}
     
 
@@ -93,7 +93,7 @@ namespace cnine{
     RtensorArray(const RtensorArray& x, const int _dev):
       CNINE_RTENSORARRAY_IMPL(x,_dev){};
       
-    RtensorArray(const RtensorArray& x, const device& _dev):
+    RtensorArray(const RtensorArray& x, const struct device& _dev):
       CNINE_RTENSORARRAY_IMPL(x,_dev.id()){};
       
     RtensorArray(RtensorArray&& x):
@@ -139,7 +139,7 @@ namespace cnine{
   public: // ---- Transport -----------------------------------------------------------------------------------
 
 
-   RtensorArray to(const device& _dev) const{
+   RtensorArray to(const struct device& _dev) const{
       return RtensorArray(*this,_dev);
     }
 
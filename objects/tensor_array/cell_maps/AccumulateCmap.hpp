@@ -36,14 +36,22 @@ namespace cnine{
 
       if(r.dev==0){
 	assert(x.dev==0);
-	for(auto it: mask.lists){
-	  auto t=r.slice0(it.first);
-	  auto& lst=it.second;
-	  if(lst.size()>0) 
-	    op.apply(t,x.slice0(lst[0].first),lst[0].second,add_flag);
-	  for(int i=1; i<lst.size(); i++)
-	    op.apply(t,x.slice0(lst[i].first),lst[i].second);
+	// each list has its own target row, so the lists can be processed in parallel
+	vector<const pair<const int,vector<pair<int,float> > >*> lists;
+	size_t total=0;
+	for(auto& it: mask.lists){
+	  lists.push_back(&it);
+	  total+=it.second.size();
 	}
+	const size_t work=r.n1*std::max<size_t>(1,total/std::max<size_t>(1,lists.size()));
+	cmap_for_each_cell(lists.size(),work,[&](const int b){
+	    auto t=r.slice0(lists[b]->first);
+	    auto& lst=lists[b]->second;
+	    if(lst.size()>0) 
+	      op.apply(t,x.slice0(lst[0].first),lst[0].second,add_flag);
+	    for(int i=1; i<lst.size(); i++)
+	      op.apply(t,x.slice0(lst[i].first),lst[i].second);
+	  });
       }
 
       if(r.dev==1){
@@ -26,13 +26,13 @@ namespace cnine{
     
     template<typename OP, typename ARR>
     BroadcastBinaryCmap(const OP& op, ARR& r, const decltype(r.get_cell(0))& x, const ARR& y, const int add_flag=0){
-      r.get_aasize();
+      I=r.get_aasize();
       assert(y.get_aasize()==I);
       if(r.dev==0){
-	for(int i=0; i<I; i++){
-	  decltype(r.get_cell(0)) t=r.cell(i);
-	  op.apply(t,x,y.cell(i),add_flag);
-	}
+	cmap_for_each_cell(I,r.get_cdims().asize(),[&](const int i){
+	    decltype(r.get_cell(0)) t=r.cell(i);
+	    op.apply(t,x,y.cell(i),add_flag);
+	  });
       }
       if(r.dev==1){
 	//op.apply(*this,r,ARR(x),y,add_flag);
@@ -35,10 +35,10 @@ namespace cnine{
       assert(x.get_aasize()==I);
       assert(y.get_aasize()==I);
       if(r.dev==0){
-	for(int i=0; i<I; i++){
-	  decltype(x.get_cell(0)) t=r.cell(i);
-	  op.apply(t,x.cell(i),y.cell(i),add_flag);
-	}
+	cmap_for_each_cell(I,r.get_cdims().asize(),[&](const int i){
+	    decltype(x.get_cell(0)) t=r.cell(i);
+	    op.apply(t,x.cell(i),y.cell(i),add_flag);
+	  });
       }
       if(r.dev==1){
 	op.apply(*this,r,x,y,add_flag);
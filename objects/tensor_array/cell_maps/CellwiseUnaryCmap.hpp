@@ -27,14 +27,14 @@ namespace cnine{
 
     template<typename OP, typename ARR>
     CellwiseUnaryCmap(const OP& op, ARR& r, const ARR& x, const int add_flag=0){
-      I=r.aasize;
-      assert(x.aasize==I);
+      I=r.get_aasize();
+      assert(x.get_aasize()==I);
       if(r.dev==0){
-	for(int i=0; i<I; i++){
-	  decltype(x.get_cell(0)) t=r.cell(i);
-	  if(add_flag==0) op.apply(t,x.cell(i));
-	  else op.add(t,x.cell(i));
-	}
+	cmap_for_each_cell(I,r.get_cdims().asize(),[&](const int i){
+	    decltype(x.get_cell(0)) t=r.cell(i);
+	    if(add_flag==0) op.apply(t,x.cell(i));
+	    else op.add(t,x.cell(i));
+	  });
       }
       if(r.dev==1){
 	op.apply(*this,r,x,add_flag);
@@ -43,15 +43,15 @@ namespace cnine{
       ys=J1;
 
       if(r.dev==0){
-       	for(int i0=0; i0<I0; i0++){
-	  for(int i1=0; i1<I1; i1++){
+	cmap_for_each_cell(I0*I1,J0*J1*r.get_cdims().asize(),[&](const int b){
+	    const int i0=b/I1;
+	    const int i1=b%I1;
 	    decltype(r.get_cell(0)) t=r.cell({i0,i1});
 	    for(int j0=0; j0<J0; j0++)
 	      for(int j1=0; j1<J1; j1++){
 		op.apply(t,x.cell({i0+j0,i1+j1}),y.cell({j0,j1}),true);
 	      }
-	  }
-	}
+	  });
       }
       if(r.dev==1){
 	//op.accumulate(*this,r,x,y);
@@ -31,8 +31,10 @@ namespace cnine{
       assert(y.get_aasize()==I);
       if(r.dev==0){
 	decltype(r.get_cell(0)) t=r.cell(0);
-       	for(int i=0; i<I; i++)
-	  op.apply(t,x.cell(i),y.cell(i),add_flag);
+	cmap_reduce(t,r.get_cdims(),I,r.get_cdims().asize(),add_flag,[&](auto& part, const int beg, const int end, const int flag){
+	    for(int i=beg; i<end; i++)
+	      op.apply(part,x.cell(i),y.cell(i),i>beg || flag);
+	  });
       }
       if(r.dev==1){
 	// op.accumulate(*this,r,x,y,add_flag);
@@ -34,13 +34,13 @@ namespace cnine{
       assert(y.get_aasize()==J);
       if(r.dev==0){
 	if(J==0) return;
-	for(int i=0; i<I; i++){
-	  decltype(r.get_cell(0)) t=r.cell(i);
-	  if(add_flag==0) op.apply(t,x.cell({i,0}),y.cell(0),false);
-	  for(int j=1-add_flag; j<J; j++){
-	    op.apply(t,x.cell({i,j}),y.cell(j),true);
-	  }
-	}
+	cmap_for_each_cell(I,J*r.get_cdims().asize(),[&](const int i){
+	    decltype(r.get_cell(0)) t=r.cell(i);
+	    if(add_flag==0) op.apply(t,x.cell({i,0}),y.cell(0),false);
+	    for(int j=1-add_flag; j<J; j++){
+	      op.apply(t,x.cell({i,j}),y.cell(j),true);
+	    }
+	  });
       }
       if(r.dev==1){
 	//op.accumulate(*this,r,x,y);
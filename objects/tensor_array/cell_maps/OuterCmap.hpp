@@ -34,11 +34,12 @@ namespace cnine{
       assert(r.get_aasize()==I*J);
 
       if(r.dev==0){
-       	for(int i=0; i<I; i++)
-	  for(int j=0; j<J; j++){
-	    decltype(x.get_cell(0)) t=r.cell(i*J+j);
-	    op.apply(t,x.cell(i),y.cell(j),add_flag);
-	  }
+	cmap_for_each_cell(I,J*r.get_cdims().asize(),[&](const int i){
+	    for(int j=0; j<J; j++){
+	      decltype(x.get_cell(0)) t=r.cell(i*J+j);
+	      op.apply(t,x.cell(i),y.cell(j),add_flag);
+	    }
+	  });
       }
       if(r.dev==1){
 	op.apply(*this,r,x,y,add_flag);
@@ -34,17 +34,22 @@ namespace cnine{
       mask(_mask){
       assert(add_flag);
       if(r.dev==0){
-	for(auto it: mask.lists){
-	  decltype(x.get_cell(0)) t=r.cell(it.first);
-	  const CellTlist2& lst=*it.second;
-	  if(lst.size()>0) 
-	    op.apply(t,x.cell(lst[0].first),y.cell(lst[0].second),add_flag);
-	  for(int i=1; i<lst.size(); i++)
-	    op.apply(t,x.cell(lst[i].first),y.cell(lst[i].second),true);
-	  //for(auto p:lst){
-	  //op.apply(t,x.cell(p.first),y.cell(p.second));
-	  //}
+	// each list has its own target cell, so the lists can be processed in parallel
+	vector<pair<int,const CellTlist2*> > lists;
+	size_t total=0;
+	for(auto& it: mask.lists){
+	  lists.push_back(make_pair(it.first,it.second));
+	  total+=it.second->size();
 	}
+	const size_t work=r.get_cdims().asize()*std::max<size_t>(1,total/std::max<size_t>(1,lists.size()));
+	cmap_for_each_cell(lists.size(),work,[&](const int b){
+	    decltype(x.get_cell(0)) t=r.cell(lists[b].first);
+	    const CellTlist2& lst=*lists[b].second;
+	    if(lst.size()>0) 
+	      op.apply(t,x.cell(lst[0].first),y.cell(lst[0].second),add_flag);
+	    for(int i=1; i<lst.size(); i++)
+	      op.apply(t,x.cell(lst[i].first),y.cell(lst[i].second),true);
+	  });
       }
       if(r.dev==1){
 	mask.prepare(1);
@@ -0,0 +1,151 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+#include "CtensorObj_funs.hpp"
+#include "CtensorArray_funs.hpp"
+
+#include "CtensorB_plus_cop.hpp"
+#include "CtensorB_copy_cop.hpp"
+#include "Ctensor1view_add.hpp"
+
+#include "CellwiseBinaryCmap.hpp"
+#include "InnerCmap.hpp"
+#include "OuterCmap.hpp"
+#include "MVprodCmap.hpp"
+#include "Convolve2Cmap.hpp"
+#include "VMprodCmap.hpp"
+#include "BroadcastBinaryCmap.hpp"
+#include "CellwiseUnaryCmap.hpp"
+#include "accumulate_cmap.hpp"
+#include "AccumulateCmap.hpp"
+#include "RtensorObj.hpp"
+
+#include "CnineSession.hpp"
+
+
+using namespace cnine;
+
+typedef CtensorB_plus_cop Ctensor_plus;
+typedef CtensorB_copy_cop Ctensor_copy;
+
+
+int main(int argc, char** argv){
+  cnine_session session;
+  parallel_grain=64;
+
+  CtensorArray A(dims(300),dims(2,2),[](const Gindex& aix, const Gindex& cix){return complex<float>(aix(0),cix(0));});
+  CtensorArray B(dims(300),dims(2,2),[](const Gindex& aix, const Gindex& cix){return complex<float>(cix(1),-aix(0));});
+  CtensorArray C(dims(30,20),dims(2,2),[](const Gindex& aix, const Gindex& cix){return complex<float>(aix(0),aix(1)*cix(1));});
+  CtensorArray D(dims(20),dims(2,2),[](const Gindex& aix, const Gindex& cix){return complex<float>(aix(0)-cix(0),1);});
+  CtensorArray E(dims(25,25),dims(2,2),[](const Gindex& aix, const Gindex& cix){return complex<float>(aix(0),aix(1)+cix(0));});
+  CtensorArray F(dims(3,3),dims(2,2),[](const Gindex& aix, const Gindex& cix){return complex<float>(aix(1),cix(1));});
+  CtensorArray G(dims(20,30),dims(2,2),[](const Gindex& aix, const Gindex& cix){return complex<float>(aix(1)-aix(0),cix(0));});
+  CtensorB c=CtensorB::sequential(dims(2,2));
+
+  // Each target cell of the mask gets a list of (x,y) pairs, some of them empty
+  CellMask2r mask(dims(300),dims(300),dims(300));
+  for(int i=0; i<300; i+=3)
+    for(int j=0; j<i%7; j++)
+      mask.push(Gindex(i),Gindex((i*j+5)%300),Gindex((i+j*11)%300));
+
+  // Row i of the target gathers the rows j of the source with weight M(i,j)
+  RtensorObj M=RtensorObj::zero({200,150});
+  for(int i=0; i<200; i+=2)
+    for(int j=0; j<i%5; j++)
+      M.set(i,(i+j*37)%150,j+1);
+  Rmask1 rmask=Rmask1::matrix(M.view2());
+  CtensorB X=CtensorB::sequential({150,8});
+
+  float errors=0;
+  for(int n: {1,4}){
+    nthreads=n;
+
+    CtensorArray R=cellwise<Ctensor_plus>(A,B);
+    for(int i=0; i<300; i++)
+      errors+=R.get_cell(i).diff2(A.get_cell(i)+B.get_cell(i));
+
+    CtensorArray S=inner<Ctensor_plus>(A,B);
+    CtensorB s=CtensorB::zero(dims(2,2));
+    for(int i=0; i<300; i++)
+      s=s+A.get_cell(i)+B.get_cell(i);
+    errors+=S.get_cell(0).diff2(s)/s.norm2();
+
+    CtensorArray T=outer<Ctensor_plus>(D,D);
+    for(int i=0; i<20; i++)
+      for(int j=0; j<20; j++)
+	errors+=T.get_cell(i*20+j).diff2(D.get_cell(i)+D.get_cell(j));
+
+    CtensorArray U=MVprod<Ctensor_plus>(C,D);
+    for(int i=0; i<30; i++){
+      CtensorB u=CtensorB::zero(dims(2,2));
+      for(int j=0; j<20; j++)
+	u=u+C.get_cell({i,j})+D.get_cell(j);
+      errors+=U.get_cell(i).diff2(u);
+    }
+
+    CtensorArray V=convolve2<Ctensor_plus>(E,F);
+    for(int i0=0; i0<23; i0++)
+      for(int i1=0; i1<23; i1++){
+	CtensorB v=CtensorB::zero(dims(2,2));
+	for(int j0=0; j0<3; j0++)
+	  for(int j1=0; j1<3; j1++)
+	    v=v+E.get_cell({i0+j0,i1+j1})+F.get_cell({j0,j1});
+	errors+=V.get_cell({i0,i1}).diff2(v);
+      }
+
+    add_inner<Ctensor_plus>(S,A,B);
+    errors+=S.get_cell(0).diff2(s+s)/s.norm2();
+
+    CtensorArray W=VMprod<Ctensor_plus>(D,G);
+    for(int i=0; i<30; i++){
+      CtensorB w=CtensorB::zero(dims(2,2));
+      for(int j=0; j<20; j++)
+	w=w+D.get_cell(j)+G.get_cell({j,i});
+      errors+=W.get_cell(i).diff2(w);
+    }
+
+    CtensorArray Y=broadcast<Ctensor_plus>(c,A);
+    for(int i=0; i<300; i++)
+      errors+=Y.get_cell(i).diff2(c+A.get_cell(i));
+
+    CtensorArray Z(dims(300),dims(2,2),fill::zero);
+    CellwiseUnaryCmap(Ctensor_copy(),Z,A);
+    add_cellwise<Ctensor_copy>(Z,B);
+    for(int i=0; i<300; i++)
+      errors+=Z.get_cell(i).diff2(A.get_cell(i)+B.get_cell(i));
+
+    CtensorArray Q(dims(300),dims(2,2),fill::zero);
+    add_accumulate<Ctensor_plus>(mask,Q,A,B);
+    for(int i=0; i<300; i++){
+      CtensorB q=CtensorB::zero(dims(2,2));
+      if(i%3==0)
+	for(int j=0; j<i%7; j++)
+	  q=q+A.get_cell((i*j+5)%300)+B.get_cell((i+j*11)%300);
+      errors+=Q.get_cell(i).diff2(q);
+    }
+
+    CtensorB P=CtensorB::zero({200,8});
+    AccumulateCmap(Ctensor1view_add(),P.view2(),X.view2(),rmask);
+    for(int i=0; i<200; i++)
+      for(int k=0; k<8; k++){
+	complex<float> p=0;
+	for(int j=0; j<150; j++)
+	  p+=M.get_value(i,j)*X.get_value(j,k);
+	errors+=std::norm(P(i,k)-p);
+      }
+
+    cout<<"nthreads="<<n<<": error="<<errors<<endl;
+  }
+
+}
@@ -0,0 +1,443 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineCpuGemm
+#define _CnineCpuGemm
+
+#include "Cnine_base.hpp"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(__CUDACC__) && !defined(CNINE_NO_SIMD)
+#define _CNINE_GEMM_X86
+#include <immintrin.h>
+#endif
+
+
+// Packed, register tiled CPU matrix multiplication used by the CPU paths of
+// Rtensor2_view, Ctensor2_view and TensorView::add_mprod.
+// The computation is C+=alpha*A*B where each matrix is given by a pointer and a pair of strides,
+// so transposed operands are just operands with swapped strides. Blocks of A and B are copied
+// into contiguous panels, so the micro-kernels never see the original strides.
+// The micro-kernel is selected at runtime from the instruction sets the CPU supports.
+
+
+namespace cnine{
+
+
+  enum class cpu_isa{generic,avx2,avx512};
+
+  inline cpu_isa detect_cpu_isa(){
+#ifdef _CNINE_GEMM_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) return cpu_isa::avx512;
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return cpu_isa::avx2;
+#endif
+    return cpu_isa::generic;
+  }
+
+  inline cpu_isa gemm_isa(){
+    static const cpu_isa isa=detect_cpu_isa();
+    return isa;
+  }
+
+  inline string gemm_isa_str(){
+    switch(gemm_isa()){
+    case cpu_isa::avx512: return "avx512";
+    case cpu_isa::avx2: return "avx2";
+    default: return "generic";
+    }
+  }
+
+
+  // ---- Micro-kernels --------------------------------------------------------------------------------------
+  // Each kernel computes an MRxNR tile of A*B from packed panels and writes it to tile (row major, ld=NR).
+
+
+  template<typename TYPE>
+  class GemmKernelGeneric{
+  public:
+
+    static constexpr int MR=4;
+    static constexpr int NR=8;
+
+    static void run(const int kc, const TYPE* A, const TYPE* B, TYPE* tile){
+      TYPE c[MR][NR];
+      for(int i=0; i<MR; i++)
+	for(int j=0; j<NR; j++)
+	  c[i][j]=0;
+      for(int k=0; k<kc; k++){
+	for(int i=0; i<MR; i++){
+	  const TYPE a=A[i];
+	  for(int j=0; j<NR; j++)
+	    c[i][j]+=a*B[j];
+	}
+	A+=MR;
+	B+=NR;
+      }
+      for(int i=0; i<MR; i++)
+	for(int j=0; j<NR; j++)
+	  tile[i*NR+j]=c[i][j];
+    }
+
+  };
+
+
+#ifdef _CNINE_GEMM_X86
+
+  class GemmKernelAVX2f{
+  public:
+
+    static constexpr int MR=6;
+    static constexpr int NR=16;
+
+    __attribute__((target("avx2,fma")))
+    static void run(const int kc, const float* A, const float* B, float* tile){
+      __m256 c00=_mm256_setzero_ps(), c01=_mm256_setzero_ps();
+      __m256 c10=_mm256_setzero_ps(), c11=_mm256_setzero_ps();
+      __m256 c20=_mm256_setzero_ps(), c21=_mm256_setzero_ps();
+      __m256 c30=_mm256_setzero_ps(), c31=_mm256_setzero_ps();
+      __m256 c40=_mm256_setzero_ps(), c41=_mm256_setzero_ps();
+      __m256 c50=_mm256_setzero_ps(), c51=_mm256_setzero_ps();
+      for(int k=0; k<kc; k++){
+	const __m256 b0=_mm256_loadu_ps(B);
+	const __m256 b1=_mm256_loadu_ps(B+8);
+	__m256 a;
+	a=_mm256_broadcast_ss(A+0); c00=_mm256_fmadd_ps(a,b0,c00); c01=_mm256_fmadd_ps(a,b1,c01);
+	a=_mm256_broadcast_ss(A+1); c10=_mm256_fmadd_ps(a,b0,c10); c11=_mm256_fmadd_ps(a,b1,c11);
+	a=_mm256_broadcast_ss(A+2); c20=_mm256_fmadd_ps(a,b0,c20); c21=_mm256_fmadd_ps(a,b1,c21);
+	a=_mm256_broadcast_ss(A+3); c30=_mm256_fmadd_ps(a,b0,c30); c31=_mm256_fmadd_ps(a,b1,c31);
+	a=_mm256_broadcast_ss(A+4); c40=_mm256_fmadd_ps(a,b0,c40); c41=_mm256_fmadd_ps(a,b1,c41);
+	a=_mm256_broadcast_ss(A+5); c50=_mm256_fmadd_ps(a,b0,c50); c51=_mm256_fmadd_ps(a,b1,c51);
+	A+=MR;
+	B+=NR;
+      }
+      _mm256_storeu_ps(tile+0*NR,c00); _mm256_storeu_ps(tile+0*NR+8,c01);
+      _mm256_storeu_ps(tile+1*NR,c10); _mm256_storeu_ps(tile+1*NR+8,c11);
+      _mm256_storeu_ps(tile+2*NR,c20); _mm256_storeu_ps(tile+2*NR+8,c21);
+      _mm256_storeu_ps(tile+3*NR,c30); _mm256_storeu_ps(tile+3*NR+8,c31);
+      _mm256_storeu_ps(tile+4*NR,c40); _mm256_storeu_ps(tile+4*NR+8,c41);
+      _mm256_storeu_ps(tile+5*NR,c50); _mm256_storeu_ps(tile+5*NR+8,c51);
+    }
+
+  };
+
+
+  class GemmKernelAVX2d{
+  public:
+
+    static constexpr int MR=6;
+    static constexpr int NR=8;
+
+    __attribute__((target("avx2,fma")))
+    static void run(const int kc, const double* A, const double* B, double* tile){
+      __m256d c00=_mm256_setzero_pd(), c01=_mm256_setzero_pd();
+      __m256d c10=_mm256_setzero_pd(), c11=_mm256_setzero_pd();
+      __m256d c20=_mm256_setzero_pd(), c21=_mm256_setzero_pd();
+      __m256d c30=_mm256_setzero_pd(), c31=_mm256_setzero_pd();
+      __m256d c40=_mm256_setzero_pd(), c41=_mm256_setzero_pd();
+      __m256d c50=_mm256_setzero_pd(), c51=_mm256_setzero_pd();
+      for(int k=0; k<kc; k++){
+	const __m256d b0=_mm256_loadu_pd(B);
+	const __m256d b1=_mm256_loadu_pd(B+4);
+	__m256d a;
+	a=_mm256_broadcast_sd(A+0); c00=_mm256_fmadd_pd(a,b0,c00); c01=_mm256_fmadd_pd(a,b1,c01);
+	a=_mm256_broadcast_sd(A+1); c10=_mm256_fmadd_pd(a,b0,c10); c11=_mm256_fmadd_pd(a,b1,c11);
+	a=_mm256_broadcast_sd(A+2); c20=_mm256_fmadd_pd(a,b0,c20); c21=_mm256_fmadd_pd(a,b1,c21);
+	a=_mm256_broadcast_sd(A+3); c30=_mm256_fmadd_pd(a,b0,c30); c31=_mm256_fmadd_pd(a,b1,c31);
+	a=_mm256_broadcast_sd(A+4); c40=_mm256_fmadd_pd(a,b0,c40); c41=_mm256_fmadd_pd(a,b1,c41);
+	a=_mm256_broadcast_sd(A+5); c50=_mm256_fmadd_pd(a,b0,c50); c51=_mm256_fmadd_pd(a,b1,c51);
+	A+=MR;
+	B+=NR;
+      }
+      _mm256_storeu_pd(tile+0*NR,c00); _mm256_storeu_pd(tile+0*NR+4,c01);
+      _mm256_storeu_pd(tile+1*NR,c10); _mm256_storeu_pd(tile+1*NR+4,c11);
+      _mm256_storeu_pd(tile+2*NR,c20); _mm256_storeu_pd(tile+2*NR+4,c21);
+      _mm256_storeu_pd(tile+3*NR,c30); _mm256_storeu_pd(tile+3*NR+4,c31);
+      _mm256_storeu_pd(tile+4*NR,c40); _mm256_storeu_pd(tile+4*NR+4,c41);
+      _mm256_storeu_pd(tile+5*NR,c50); _mm256_storeu_pd(tile+5*NR+4,c51);
+    }
+
+  };
+
+
+  class GemmKernelAVX512f{
+  public:
+
+    static constexpr int MR=6;
+    static constexpr int NR=32;
+
+    __attribute__((target("avx512f")))
+    static void run(const int kc, const float* A, const float* B, float* tile){
+      __m512 c[MR][2];
+      for(int i=0; i<MR; i++){
+	c[i][0]=_mm512_setzero_ps();
+	c[i][1]=_mm512_setzero_ps();
+      }
+      for(int k=0; k<kc; k++){
+	const __m512 b0=_mm512_loadu_ps(B);
+	const __m512 b1=_mm512_loadu_ps(B+16);
+	for(int i=0; i<MR; i++){
+	  const __m512 a=_mm512_set1_ps(A[i]);
+	  c[i][0]=_mm512_fmadd_ps(a,b0,c[i][0]);
+	  c[i][1]=_mm512_fmadd_ps(a,b1,c[i][1]);
+	}
+	A+=MR;
+	B+=NR;
+      }
+      for(int i=0; i<MR; i++){
+	_mm512_storeu_ps(tile+i*NR,c[i][0]);
+	_mm512_storeu_ps(tile+i*NR+16,c[i][1]);
+      }
+    }
+
+  };
+
+
+  class GemmKernelAVX512d{
+  public:
+
+    static constexpr int MR=6;
+    static constexpr int NR=16;
+
+    __attribute__((target("avx512f")))
+    static void run(const int kc, const double* A, const double* B, double* tile){
+      __m512d c[MR][2];
+      for(int i=0; i<MR; i++){
+	c[i][0]=_mm512_setzero_pd();
+	c[i][1]=_mm512_setzero_pd();
+      }
+      for(int k=0; k<kc; k++){
+	const __m512d b0=_mm512_loadu_pd(B);
+	const __m512d b1=_mm512_loadu_pd(B+8);
+	for(int i=0; i<MR; i++){
+	  const __m512d a=_mm512_set1_pd(A[i]);
+	  c[i][0]=_mm512_fmadd_pd(a,b0,c[i][0]);
+	  c[i][1]=_mm512_fmadd_pd(a,b1,c[i][1]);
+	}
+	A+=MR;
+	B+=NR;
+      }
+      for(int i=0; i<MR; i++){
+	_mm512_storeu_pd(tile+i*NR,c[i][0]);
+	_mm512_storeu_pd(tile+i*NR+8,c[i][1]);
+      }
+    }
+
+  };
+
+#endif
+
+
+  // ---- Blocked driver -------------------------------------------------------------------------------------
+
+
+  template<typename TYPE>
+  class GemmBuffers{
+  public:
+    vector<TYPE> Abuf;
+    vector<TYPE> Bbuf;
+  };
+
+  template<typename TYPE>
+  inline GemmBuffers<TYPE>& gemm_buffers(){
+    static thread_local GemmBuffers<TYPE> buffers;
+    return buffers;
+  }
+
+
+  template<typename TYPE, typename KERNEL>
+  void cpu_gemm_blocked(const int M, const int N, const int K, const TYPE alpha,
+    const TYPE* A, const int as0, const int as1,
+    const TYPE* B, const int bs0, const int bs1,
+    TYPE* C, const int cs0, const int cs1){
+
+    constexpr int MR=KERNEL::MR;
+    constexpr int NR=KERNEL::NR;
+    constexpr int KC=256;
+    constexpr int MC=MR*24;
+    constexpr int NC=NR*128;
+
+    auto& buffers=gemm_buffers<TYPE>();
+    auto& Abuf=buffers.Abuf;
+    auto& Bbuf=buffers.Bbuf;
+    if(Abuf.size()<MC*KC) Abuf.resize(MC*KC);
+    if(Bbuf.size()<KC*std::min(NC,roundup(N,NR))) Bbuf.resize(KC*std::min(NC,roundup(N,NR)));
+    alignas(64) TYPE tile[MR*NR];
+
+    for(int jc=0; jc<N; jc+=NC){
+      const int nc=std::min(NC,N-jc);
+
+      for(int pc=0; pc<K; pc+=KC){
+	const int kc=std::min(KC,K-pc);
+
+	// pack B[pc:pc+kc,jc:jc+nc] into column panels of width NR
+	for(int jr=0; jr<nc; jr+=NR){
+	  TYPE* dest=Bbuf.data()+jr*kc;
+	  const int nr=std::min(NR,nc-jr);
+	  const TYPE* src=B+pc*bs0+(jc+jr)*bs1;
+	  for(int k=0; k<kc; k++){
+	    const TYPE* s=src+k*bs0;
+	    for(int j=0; j<nr; j++) dest[j]=s[j*bs1];
+	    for(int j=nr; j<NR; j++) dest[j]=0;
+	    dest+=NR;
+	  }
+	}
+
+	for(int ic=0; ic<M; ic+=MC){
+	  const int mc=std::min(MC,M-ic);
+
+	  // pack A[ic:ic+mc,pc:pc+kc] into row panels of height MR
+	  for(int ir=0; ir<mc; ir+=MR){
+	    TYPE* dest=Abuf.data()+ir*kc;
+	    const int mr=std::min(MR,mc-ir);
+	    const TYPE* src=A+(ic+ir)*as0+pc*as1;
+	    for(int k=0; k<kc; k++){
+	      const TYPE* s=src+k*as1;
+	      for(int i=0; i<mr; i++) dest[i]=s[i*as0];
+	      for(int i=mr; i<MR; i++) dest[i]=0;
+	      dest+=MR;
+	    }
+	  }
+
+	  for(int jr=0; jr<nc; jr+=NR){
+	    const int nr=std::min(NR,nc-jr);
+	    for(int ir=0; ir<mc; ir+=MR){
+	      const int mr=std::min(MR,mc-ir);
+	      KERNEL::run(kc,Abuf.data()+ir*kc,Bbuf.data()+jr*kc,tile);
+	      TYPE* c=C+(ic+ir)*cs0+(jc+jr)*cs1;
+	      if(cs1==1){
+		for(int i=0; i<mr; i++){
+		  TYPE* ci=c+i*cs0;
+		  for(int j=0; j<nr; j++) ci[j]+=alpha*tile[i*NR+j];
+		}
+	      }else{
+		for(int i=0; i<mr; i++)
+		  for(int j=0; j<nr; j++)
+		    c[i*cs0+j*cs1]+=alpha*tile[i*NR+j];
+	      }
+	    }
+	  }
+	}
+      }
+    }
+  }
+
+
+  // Reference triple loop. Used for small products, where packing does not pay off,
+  // and for types without a packed kernel.
+
+  template<typename TYPE>
+  void cpu_gemm_loops(const int M, const int N, const int K, const TYPE alpha,
+    const TYPE* A, const int as0, const int as1,
+    const TYPE* B, const int bs0, const int bs1,
+    TYPE* C, const int cs0, const int cs1){
+    for(int i=0; i<M; i++)
+      for(int j=0; j<N; j++){
+	TYPE t=0;
+	for(int k=0; k<K; k++)
+	  t+=A[i*as0+k*as1]*B[k*bs0+j*bs1];
+	C[i*cs0+j*cs1]+=alpha*t;
+      }
+  }
+
+
+  // ---- Entry points ---------------------------------------------------------------------------------------
+
+
+  // C(M,N)+=alpha*A(M,K)*B(K,N) with the packed kernels, regardless of size (float and double only)
+  template<typename TYPE>
+  void cpu_gemm_packed(const int M, const int N, const int K, const TYPE alpha,
+    const TYPE* A, const int as0, const int as1,
+    const TYPE* B, const int bs0, const int bs1,
+    TYPE* C, const int cs0, const int cs1){
+    static_assert(std::is_same<TYPE,float>::value || std::is_same<TYPE,double>::value,"cpu_gemm_packed requires float or double");
+
+    if(M<=0 || N<=0 || K<=0) return;
+
+#ifdef _CNINE_GEMM_X86
+    if constexpr(std::is_same<TYPE,float>::value){
+      if(gemm_isa()==cpu_isa::avx512)
+	return cpu_gemm_blocked<TYPE,GemmKernelAVX512f>(M,N,K,alpha,A,as0,as1,B,bs0,bs1,C,cs0,cs1);
+      if(gemm_isa()==cpu_isa::avx2)
+	return cpu_gemm_blocked<TYPE,GemmKernelAVX2f>(M,N,K,alpha,A,as0,as1,B,bs0,bs1,C,cs0,cs1);
+    }
+    if constexpr(std::is_same<TYPE,double>::value){
+      if(gemm_isa()==cpu_isa::avx512)
+	return cpu_gemm_blocked<TYPE,GemmKernelAVX512d>(M,N,K,alpha,A,as0,as1,B,bs0,bs1,C,cs0,cs1);
+      if(gemm_isa()==cpu_isa::avx2)
+	return cpu_gemm_blocked<TYPE,GemmKernelAVX2d>(M,N,K,alpha,A,as0,as1,B,bs0,bs1,C,cs0,cs1);
+    }
+#endif
+    cpu_gemm_blocked<TYPE,GemmKernelGeneric<TYPE> >(M,N,K,alpha,A,as0,as1,B,bs0,bs1,C,cs0,cs1);
+  }
+
+
+  // C(M,N)+=alpha*A(M,K)*B(K,N)
+  template<typename TYPE>
+  void cpu_gemm(const int M, const int N, const int K, const TYPE alpha,
+    const TYPE* A, const int as0, const int as1,
+    const TYPE* B, const int bs0, const int bs1,
+    TYPE* C, const int cs0, const int cs1){
+
+    if(M<=0 || N<=0 || K<=0) return;
+
+    if constexpr(std::is_same<TYPE,float>::value || std::is_same<TYPE,double>::value){
+      if(((long long)M)*N*K<4096 || M<2 || N<2){
+	cpu_gemm_loops(M,N,K,alpha,A,as0,as1,B,bs0,bs1,C,cs0,cs1);
+	return;
+      }
+      cpu_gemm_packed(M,N,K,alpha,A,as0,as1,B,bs0,bs1,C,cs0,cs1);
+      return;
+    }
+
+    cpu_gemm_loops(M,N,K,alpha,A,as0,as1,B,bs0,bs1,C,cs0,cs1);
+  }
+
+
+  // Complex product on split real/imaginary storage, as in Ctensor2_view.
+  // The product is evaluated as four real products; conjA/conjB conjugate the corresponding operand.
+  inline void cpu_cgemm(const int M, const int N, const int K,
+    const float* Ar, const float* Ai, const int as0, const int as1, const bool conjA,
+    const float* Br, const float* Bi, const int bs0, const int bs1, const bool conjB,
+    float* Cr, float* Ci, const int cs0, const int cs1){
+    const float sa=conjA?-1.0:1.0;
+    const float sb=conjB?-1.0:1.0;
+    cpu_gemm<float>(M,N,K,1.0,Ar,as0,as1,Br,bs0,bs1,Cr,cs0,cs1);
+    cpu_gemm<float>(M,N,K,-sa*sb,Ai,as0,as1,Bi,bs0,bs1,Cr,cs0,cs1);
+    cpu_gemm<float>(M,N,K,sb,Ar,as0,as1,Bi,bs0,bs1,Ci,cs0,cs1);
+    cpu_gemm<float>(M,N,K,sa,Ai,as0,as1,Br,bs0,bs1,Ci,cs0,cs1);
+  }
+
+  // Real matrix times complex matrix
+  inline void cpu_rcgemm(const int M, const int N, const int K,
+    const float* A, const int as0, const int as1,
+    const float* Br, const float* Bi, const int bs0, const int bs1,
+    float* Cr, float* Ci, const int cs0, const int cs1){
+    cpu_gemm<float>(M,N,K,1.0,A,as0,as1,Br,bs0,bs1,Cr,cs0,cs1);
+    cpu_gemm<float>(M,N,K,1.0,A,as0,as1,Bi,bs0,bs1,Ci,cs0,cs1);
+  }
+
+  // complex<float> matrices stored interleaved, as in TensorView<complex<float> >
+  inline void cpu_gemm(const int M, const int N, const int K,
+    const complex<float>* A, const int as0, const int as1,
+    const complex<float>* B, const int bs0, const int bs1,
+    complex<float>* C, const int cs0, const int cs1){
+    const float* a=reinterpret_cast<const float*>(A);
+    const float* b=reinterpret_cast<const float*>(B);
+    float* c=reinterpret_cast<float*>(C);
+    cpu_cgemm(M,N,K,a,a+1,2*as0,2*as1,false,b,b+1,2*bs0,2*bs1,false,c,c+1,2*cs0,2*cs1);
+  }
+
+}
+
+#endif
@@ -22,6 +22,7 @@
 
 #include "Ctensor1_view.hpp"
 #include "Rtensor2_view.hpp"
+#include "CpuGemm.hpp"
 //#include "TensorView.hpp"
 
 #ifdef _WITH_CUBLAS
@@ -155,19 +156,17 @@ namespace cnine{
       add_matmul_AA(x,y);
     }
 
+    void add_mprod(const Ctensor2_view& x, const Ctensor2_view& y){
+      add_matmul_AA(x,y);
+    }
+
     void add_matmul_AA(const Ctensor2_view& x, const Ctensor2_view& y){
       CNINE_DEVICE_SAME(x);
       CNINE_DEVICE_SAME(y);
       const int I=x.n1;
 
       if(dev==0){
-	for(int a=0; a<n0; a++)
-	  for(int b=0; b<n1; b++){
-	    complex<float> t=0;
-	    for(int i=0; i<I; i++)
-	      t+=x(a,i)*y(i,b);
-	    inc(a,b,t);
-	  }
+	cpu_cgemm(n0,n1,I,x.arr,x.arrc,x.s0,x.s1,false,y.arr,y.arrc,y.s0,y.s1,false,arr,arrc,s0,s1);
       }
 
       if(dev==1){
@@ -196,13 +195,7 @@ namespace cnine{
 
 
       if(dev==0){
-	for(int a=0; a<n0; a++)
-	  for(int b=0; b<n1; b++){
-	    complex<float> t=0;
-	    for(int i=0; i<I; i++)
-	      t+=x(a,i)*std::conj(y(b,i));
-	    inc(a,b,t);
-	  }
+	cpu_cgemm(n0,n1,I,x.arr,x.arrc,x.s0,x.s1,false,y.arr,y.arrc,y.s1,y.s0,true,arr,arrc,s0,s1);
       }
 
       if(dev==1){
@@ -230,13 +223,7 @@ namespace cnine{
 
 
       if(dev==0){
-	for(int a=0; a<n0; a++)
-	  for(int b=0; b<n1; b++){
-	    complex<float> t=0;
-	    for(int i=0; i<I; i++)
-	      t+=std::conj(x(i,a))*y(i,b);
-	    inc(a,b,t);
-	  }
+	cpu_cgemm(n0,n1,I,x.arr,x.arrc,x.s1,x.s0,true,y.arr,y.arrc,y.s0,y.s1,false,arr,arrc,s0,s1);
       }
 
       if(dev==1){
@@ -264,13 +251,7 @@ namespace cnine{
 
 
       if(dev==0){
-	for(int a=0; a<n0; a++)
-	  for(int b=0; b<n1; b++){
-	    complex<float> t=0;
-	    for(int i=0; i<I; i++)
-	      t+=x(a,i)*y(i,b);
-	    inc(a,b,t);
-	  }
+	cpu_rcgemm(n0,n1,I,x.arr,x.s0,x.s1,y.arr,y.arrc,y.s0,y.s1,arr,arrc,s0,s1);
       }
 
       if(dev==1){
@@ -0,0 +1,201 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineGroupedGemm
+#define _CnineGroupedGemm
+
+#include "Cnine_base.hpp"
+#include "CpuGemm.hpp"
+#include "ParallelFor.hpp"
+
+
+// Many independent products C_i+=alpha*A_i*B_i of different sizes, such as multiplying each tensor
+// of a pack by its own weight matrix. The products fall into two size buckets. Tiny ones, and those
+// with fewer than four rows, are computed by a kernel that accumulates each row of C as a sum of
+// rows of B, without copying anything. All the others go to the packed kernels of cpu_gemm, even
+// below the size where cpu_gemm itself would fall back to plain loops, and large ones are split into
+// blocks of rows first. The resulting tasks are cut into chunks of roughly equal work, the largest
+// scheduled first, and the chunks are spread over the thread pool, so a pack of many small matrices
+// is processed in a single parallel loop rather than one product at a time.
+
+
+namespace cnine{
+
+
+  template<typename TYPE>
+  class GemmProblem{
+  public:
+
+    int M=0, N=0, K=0;
+    const TYPE* A=nullptr; int as0=0, as1=0;
+    const TYPE* B=nullptr; int bs0=0, bs1=0;
+    TYPE* C=nullptr; int cs0=0, cs1=0;
+
+    GemmProblem(){}
+
+    // C(M,N)+=A(M,K)*B(K,N)
+    GemmProblem(const int _M, const int _N, const int _K,
+      const TYPE* _A, const int _as0, const int _as1,
+      const TYPE* _B, const int _bs0, const int _bs1,
+      TYPE* _C, const int _cs0, const int _cs1):
+      M(_M), N(_N), K(_K), A(_A), as0(_as0), as1(_as1), B(_B), bs0(_bs0), bs1(_bs1), C(_C), cs0(_cs0), cs1(_cs1){}
+
+    size_t flops() const{
+      return ((size_t)M)*N*K;
+    }
+
+    // The same product with the roles of rows and columns exchanged, C^T+=B^T*A^T
+    GemmProblem transp() const{
+      return GemmProblem(N,M,K,B,bs1,bs0,A,as1,as0,C,cs1,cs0);
+    }
+
+  };
+
+
+  // ---- Small products -------------------------------------------------------------------------------------
+
+
+  // C(M,N)+=alpha*A(M,K)*B(K,N) for N<=NMAX and rows of B that are contiguous (bs1==1). Each row of
+  // C is accumulated in a buffer as a sum of rows of B, so the inner loop is a contiguous axpy.
+  template<typename TYPE, int NMAX>
+  void cpu_gemm_small(const int M, const int N, const int K, const TYPE alpha,
+    const TYPE* A, const int as0, const int as1,
+    const TYPE* B, const int bs0,
+    TYPE* C, const int cs0, const int cs1){
+    TYPE row[NMAX];
+    for(int i=0; i<M; i++){
+      for(int j=0; j<N; j++) row[j]=0;
+      const TYPE* a=A+i*as0;
+      for(int k=0; k<K; k++){
+	const TYPE aik=a[k*as1];
+	const TYPE* b=B+k*bs0;
+	for(int j=0; j<N; j++) row[j]+=aik*b[j];
+      }
+      TYPE* c=C+i*cs0;
+      if(cs1==1) for(int j=0; j<N; j++) c[j]+=alpha*row[j];
+      else for(int j=0; j<N; j++) c[j*cs1]+=alpha*row[j];
+    }
+  }
+
+
+  // ---- Grouped products -----------------------------------------------------------------------------------
+
+
+  template<typename TYPE>
+  class GroupedGemm{
+  public:
+
+    static constexpr int small_maxN=64; // widest output for the small kernel
+    static constexpr int small_maxM=4; // products with fewer rows always use the small kernel
+    static constexpr size_t small_flops=512; // as do products of at most this many flops
+    static constexpr size_t task_flops=1<<21; // larger products are split into blocks of rows
+    static constexpr size_t chunk_flops=1<<16; // work per unit of the parallel loop
+
+    vector<GemmProblem<TYPE> > tasks;
+    vector<int> chunks; // tasks[chunks[c]..chunks[c+1]) are processed together
+
+
+    GroupedGemm(const vector<GemmProblem<TYPE> >& problems){
+      for(auto& p:problems){
+	if(p.M<=0 || p.N<=0 || p.K<=0) continue;
+	const size_t f=p.flops();
+	if(f<=task_flops || p.M<2*rows_step){
+	  tasks.push_back(p);
+	  continue;
+	}
+	const int rows=roundup(std::max<int>(rows_step,task_flops/((size_t)p.N*p.K)),rows_step);
+	for(int i=0; i<p.M; i+=rows){
+	  GemmProblem<TYPE> q(p);
+	  q.M=std::min(rows,p.M-i);
+	  q.A=p.A+((size_t)i)*p.as0;
+	  q.C=p.C+((size_t)i)*p.cs0;
+	  tasks.push_back(q);
+	}
+      }
+
+      // Tasks that make up a chunk by themselves go first, largest first. The rest keep their
+      // order, which is usually the order of the operands in memory.
+      auto big=std::stable_partition(tasks.begin(),tasks.end(),[](const GemmProblem<TYPE>& x){
+	  return x.flops()>=chunk_flops;});
+      std::stable_sort(tasks.begin(),big,[](const GemmProblem<TYPE>& x, const GemmProblem<TYPE>& y){
+	  return x.flops()>y.flops();});
+
+      chunks.push_back(0);
+      size_t t=0;
+      for(int i=0; i<tasks.size(); i++){
+	t+=tasks[i].flops();
+	if(t>=chunk_flops){
+	  chunks.push_back(i+1);
+	  t=0;
+	}
+      }
+      if(chunks.back()<tasks.size()) chunks.push_back(tasks.size());
+    }
+
+
+  public: // ---- Execution ----------------------------------------------------------------------------------
+
+
+    int nchunks() const{
+      return chunks.size()-1;
+    }
+
+    void operator()(const TYPE alpha=1) const{
+      parallel_for(nchunks(),[&](const size_t beg, const size_t end){
+	  for(size_t c=beg; c<end; c++)
+	    for(int i=chunks[c]; i<chunks[c+1]; i++)
+	      run(tasks[i],alpha);
+	},1);
+    }
+
+
+  private:
+
+    static constexpr int rows_step=16;
+
+    static bool is_small(const GemmProblem<TYPE>& p){
+      return p.M<small_maxM || p.flops()<=small_flops;
+    }
+
+    static void run(const GemmProblem<TYPE>& p, const TYPE alpha){
+      if(is_small(p)){
+	if(p.N<=small_maxN && p.bs1==1){
+	  cpu_gemm_small<TYPE,small_maxN>(p.M,p.N,p.K,alpha,p.A,p.as0,p.as1,p.B,p.bs0,p.C,p.cs0,p.cs1);
+	  return;
+	}
+	if(p.M<=small_maxN && p.as0==1){
+	  const GemmProblem<TYPE> q=p.transp();
+	  cpu_gemm_small<TYPE,small_maxN>(q.M,q.N,q.K,alpha,q.A,q.as0,q.as1,q.B,q.bs0,q.C,q.cs0,q.cs1);
+	  return;
+	}
+      }
+      if constexpr(std::is_same<TYPE,float>::value || std::is_same<TYPE,double>::value)
+	cpu_gemm_packed<TYPE>(p.M,p.N,p.K,alpha,p.A,p.as0,p.as1,p.B,p.bs0,p.bs1,p.C,p.cs0,p.cs1);
+      else
+	cpu_gemm<TYPE>(p.M,p.N,p.K,alpha,p.A,p.as0,p.as1,p.B,p.bs0,p.bs1,p.C,p.cs0,p.cs1);
+    }
+
+  };
+
+
+  // C_i+=alpha*A_i*B_i for each problem
+  template<typename TYPE>
+  void cpu_grouped_gemm(const vector<GemmProblem<TYPE> >& problems, const TYPE alpha=1){
+    GroupedGemm<TYPE> gemm(problems);
+    gemm(alpha);
+  }
+
+}
+
+#endif
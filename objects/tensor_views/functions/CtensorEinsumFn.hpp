@@ -17,6 +17,8 @@
 
 #include "EinsumFnBase.hpp"
 #include "CtensorView.hpp"
+#include "EinsumPlan.hpp"
+#include "CnineProfiler.hpp"
 
 
 namespace cnine{
@@ -36,6 +38,14 @@ namespace cnine{
 
     void operator()(const CtensorView& r, const CtensorView& x, const CtensorView& y){
 
+      // contractions with at least one free index of x or y are lowered to GEMM
+      auto plan=einsum_plan_cache()(str,einsum_indices(dstrides,sstrides,bstrides,r,x,y),r.dev==0);
+      if(plan->gemm){
+	CNINE_PROFILE_OPS("CtensorEinsumFn(gemm)",4*plan->n_ops());
+	(*plan)(r.arr,r.arrc,x.arr,x.arrc,xconj,y.arr,y.arrc,yconj);
+	return;
+      }
+
       if(dstrides.size()==0){
 	sloops(r,x,y,0,0,0);
 	return;
@@ -161,7 +171,7 @@ namespace cnine{
       }
 
       if(sstrides.size()==1){
-	int I0=x.dims[sstrides[0].first[0]];
+	int I0=sdim(x,y,0);
 	int x0=x.strides.combine(sstrides[0].first);
 	int y0=y.strides.combine(sstrides[0].second);
 
@@ -200,11 +210,11 @@ namespace cnine{
 
 
       if(sstrides.size()==2){
-	int I0=x.dims[sstrides[0].first[0]];
+	int I0=sdim(x,y,0);
 	int x0=x.strides.combine(sstrides[0].first);
 	int y0=y.strides.combine(sstrides[0].second);
 
-	int I1=x.dims[sstrides[1].first[0]];
+	int I1=sdim(x,y,1);
 	int x1=x.strides.combine(sstrides[1].first);
 	int y1=y.strides.combine(sstrides[1].second);
 
@@ -245,15 +255,15 @@ namespace cnine{
       }
 
       if(sstrides.size()==3){
-	int I0=x.dims[sstrides[0].first[0]];
+	int I0=sdim(x,y,0);
 	int x0=x.strides.combine(sstrides[0].first);
 	int y0=y.strides.combine(sstrides[0].second);
 
-	int I1=x.dims[sstrides[1].first[0]];
+	int I1=sdim(x,y,1);
 	int x1=x.strides.combine(sstrides[1].first);
 	int y1=y.strides.combine(sstrides[1].second);
 
-	int I2=x.dims[sstrides[2].first[0]];
+	int I2=sdim(x,y,2);
 	int x2=x.strides.combine(sstrides[2].first);
 	int y2=y.strides.combine(sstrides[2].second);
 
@@ -301,6 +311,12 @@ namespace cnine{
       
 
 
+    int sdim(const CtensorView& x, const CtensorView& y, const int i) const{
+      if(sstrides[i].first.size()>0) return x.dims[sstrides[i].first[0]];
+      return y.dims[sstrides[i].second[0]];
+    }
+
+
     inline void bloops(const CtensorView& r, int roffs, complex<TYPE> t){
 
       if(bstrides.size()==0){
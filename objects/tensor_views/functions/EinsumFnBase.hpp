@@ -24,6 +24,7 @@ namespace cnine{
   class EinsumFnBase{
   public:
 
+    string str;
     vector<pair<vector<int>,vector<int> > > sstrides;
     vector<triple<vector<int> > > dstrides;
     vector<vector<int> > bstrides;
@@ -32,7 +33,8 @@ namespace cnine{
     bool xconj;
     bool yconj;
 
-    EinsumFnBase(const string str){
+    EinsumFnBase(const string _str):
+      str(_str){
       auto d0=str.find(",");
       auto d1=str.find("->");
       if(d0==string::npos || d1==string::npos || d0>d1){
@@ -73,6 +75,13 @@ namespace cnine{
 	char c=xstr[p];
 	sstrides.push_back(pair<vector<int>,vector<int> >(find_all(xstr,c),find_all(ystr,c)));
       }
+
+      while(true){ // indices summed over that only appear in y
+	auto p=ystr.find_first_not_of('x');
+	if(p==string::npos) break;
+	char c=ystr[p];
+	sstrides.push_back(pair<vector<int>,vector<int> >(vector<int>(),find_all(ystr,c)));
+      }
       
       if(false){
 	if(xconj) cout<<"*"; else cout<<"x";
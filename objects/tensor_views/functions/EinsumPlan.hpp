@@ -0,0 +1,289 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineEinsumPlan
+#define _CnineEinsumPlan
+
+#include <mutex>
+#include <unordered_map>
+
+#include "Cnine_base.hpp"
+#include "ParallelFor.hpp"
+#include "CpuGemm.hpp"
+
+
+// Lowering of a two operand einsum r+=x*y to a sequence of strided GEMMs. Every index of the einsum
+// is classified by the operands it appears in:
+//
+//   r,x,y  batch     r,x  M     r,y  N     x,y  K     r only  batch (broadcast)     x or y only  K
+//
+// Within the M, N and K groups indices whose strides nest (s_a=n_b*s_b in both operands involved)
+// are fused into a single GEMM dimension, so permuted and reshaped views need no copying. The
+// longest fused run of each group becomes the GEMM dimension; everything else becomes an outer
+// loop. Batch loops write disjoint parts of r and are run in parallel, leftover contraction
+// loops accumulate into the same block of r one after the other.
+
+namespace cnine{
+
+
+  class EinsumIndex{
+  public:
+    int n=1;
+    int rs=0, xs=0, ys=0;
+    bool inr=false, inx=false, iny=false;
+  };
+
+
+  class EinsumPlan{
+  public:
+
+    bool gemm=false;
+
+    int M=1, N=1, K=1;
+    int rsM=0, rsN=0;
+    int xsM=0, xsK=0;
+    int ysK=0, ysN=0;
+
+    vector<int> bdims, brs, bxs, bys; // batch loops
+    vector<int> kdims, kxs, kys; // contraction loops
+
+
+    EinsumPlan(const vector<EinsumIndex>& indices, const bool cpu=true){
+      vector<EinsumIndex> m,n,k;
+      for(auto& p:indices){
+	if(p.n==1) continue;
+	if(p.inr && p.inx && !p.iny) {m.push_back(p); continue;}
+	if(p.inr && p.iny && !p.inx) {n.push_back(p); continue;}
+	if(!p.inr) {k.push_back(p); continue;}
+	add_batch(p);
+      }
+
+      auto mrun=longest_run(m,[](const EinsumIndex& p){return p.rs;},[](const EinsumIndex& p){return p.xs;});
+      auto nrun=longest_run(n,[](const EinsumIndex& p){return p.rs;},[](const EinsumIndex& p){return p.ys;});
+      auto krun=longest_run(k,[](const EinsumIndex& p){return p.xs;},[](const EinsumIndex& p){return p.ys;});
+
+      if(mrun.size()>0){
+	M=run_size(mrun); rsM=mrun.back().rs; xsM=mrun.back().xs;
+      }
+      if(nrun.size()>0){
+	N=run_size(nrun); rsN=nrun.back().rs; ysN=nrun.back().ys;
+      }
+      if(krun.size()>0){
+	K=run_size(krun); xsK=krun.back().xs; ysK=krun.back().ys;
+      }
+      for(auto& p:m) add_batch(p);
+      for(auto& p:n) add_batch(p);
+      for(auto& p:k){
+	kdims.push_back(p.n);
+	kxs.push_back(p.xs);
+	kys.push_back(p.ys);
+      }
+
+      gemm=cpu && (M>1 || N>1);
+    }
+
+
+  public: // ---- Access ---------------------------------------------------------------------------------------
+
+
+    long long nbatch() const{
+      long long t=1;
+      for(auto p:bdims) t*=p;
+      return t;
+    }
+
+    long long ncontract() const{
+      long long t=1;
+      for(auto p:kdims) t*=p;
+      return t;
+    }
+
+    long long n_ops() const{
+      return 2ll*M*N*K*nbatch()*ncontract();
+    }
+
+
+  public: // ---- Execution ------------------------------------------------------------------------------------
+
+
+    // Call fn(roffs,xoffs,yoffs) for each GEMM block
+    template<typename FN>
+    void for_each_block(FN&& fn) const{
+      const size_t nb=nbatch();
+      const int nk=ncontract();
+      bool disjoint=true;
+      for(int i=0; i<bdims.size(); i++)
+	if(brs[i]==0) disjoint=false;
+      const size_t grain=disjoint?std::max<long long>(1,(1<<16)/std::max<long long>(1,2ll*M*N*K*nk)):nb;
+
+      parallel_for(nb,[&](const size_t beg, const size_t end){
+	  for(size_t b=beg; b<end; b++){
+	    int ro=0, xo=0, yo=0;
+	    size_t t=b;
+	    for(int i=bdims.size()-1; i>=0; i--){
+	      const int ix=t%bdims[i]; t/=bdims[i];
+	      ro+=ix*brs[i]; xo+=ix*bxs[i]; yo+=ix*bys[i];
+	    }
+	    for(int c=0; c<nk; c++){
+	      int xk=xo, yk=yo;
+	      int u=c;
+	      for(int i=kdims.size()-1; i>=0; i--){
+		const int ix=u%kdims[i]; u/=kdims[i];
+		xk+=ix*kxs[i]; yk+=ix*kys[i];
+	      }
+	      fn(ro,xk,yk);
+	    }
+	  }
+	},grain);
+    }
+
+
+    // r+=x*y for operands with a single array each
+    template<typename TYPE>
+    void operator()(TYPE* r, const TYPE* x, const TYPE* y) const{
+      for_each_block([&](const int ro, const int xo, const int yo){
+	  if constexpr(std::is_same<TYPE,complex<float> >::value)
+	    cpu_gemm(M,N,K,x+xo,xsM,xsK,y+yo,ysK,ysN,r+ro,rsM,rsN);
+	  else
+	    cpu_gemm<TYPE>(M,N,K,1,x+xo,xsM,xsK,y+yo,ysK,ysN,r+ro,rsM,rsN);});
+    }
+
+    // r+=x*y for complex operands in split real/imaginary storage
+    void operator()(float* r, float* rc, const float* x, const float* xc, const bool xconj,
+      const float* y, const float* yc, const bool yconj) const{
+      for_each_block([&](const int ro, const int xo, const int yo){
+	  cpu_cgemm(M,N,K,x+xo,xc+xo,xsM,xsK,xconj,y+yo,yc+yo,ysK,ysN,yconj,r+ro,rc+ro,rsM,rsN);});
+    }
+
+
+  private:
+
+    void add_batch(const EinsumIndex& p){
+      bdims.push_back(p.n);
+      brs.push_back(p.rs);
+      bxs.push_back(p.xs);
+      bys.push_back(p.ys);
+    }
+
+    static int run_size(const vector<EinsumIndex>& run){
+      int t=1;
+      for(auto& p:run) t*=p.n;
+      return t;
+    }
+
+    // Remove and return the longest sequence of indices that can be fused into one dimension
+    template<typename S1, typename S2>
+    static vector<EinsumIndex> longest_run(vector<EinsumIndex>& v, S1 s1, S2 s2){
+      if(v.size()==0) return vector<EinsumIndex>();
+      std::stable_sort(v.begin(),v.end(),[&](const EinsumIndex& a, const EinsumIndex& b){
+	  return s1(a)>s1(b);});
+
+      int best=0, best_end=0, best_size=0;
+      int beg=0, size=v[0].n;
+      for(int i=1; i<=v.size(); i++){
+	if(i<v.size() && s1(v[i-1])==v[i].n*s1(v[i]) && s2(v[i-1])==v[i].n*s2(v[i])){
+	  size*=v[i].n;
+	  continue;
+	}
+	if(size>best_size){
+	  best=beg; best_end=i; best_size=size;
+	}
+	if(i<v.size()){
+	  beg=i;
+	  size=v[i].n;
+	}
+      }
+
+      vector<EinsumIndex> run(v.begin()+best,v.begin()+best_end);
+      v.erase(v.begin()+best,v.begin()+best_end);
+      return run;
+    }
+
+  };
+
+
+  // ---- Plan construction and caching ---------------------------------------------------------------------
+
+
+  // Collect the extents and combined strides of the indices of an einsum from its parsed direct,
+  // summed and broadcast stride groups.
+  template<typename VIEW>
+  vector<EinsumIndex> einsum_indices(const vector<triple<vector<int> > >& dstrides,
+    const vector<pair<vector<int>,vector<int> > >& sstrides, const vector<vector<int> >& bstrides,
+    const VIEW& r, const VIEW& x, const VIEW& y){
+    vector<EinsumIndex> R;
+    for(auto& p:dstrides){
+      EinsumIndex ix;
+      ix.n=r.dims[p.first[0]];
+      ix.inr=true;
+      ix.inx=(p.second.size()>0);
+      ix.iny=(p.third.size()>0);
+      ix.rs=r.strides.combine(p.first);
+      ix.xs=x.strides.combine(p.second);
+      ix.ys=y.strides.combine(p.third);
+      R.push_back(ix);
+    }
+    for(auto& p:sstrides){
+      EinsumIndex ix;
+      ix.n=(p.first.size()>0)?x.dims[p.first[0]]:y.dims[p.second[0]];
+      ix.inx=(p.first.size()>0);
+      ix.iny=(p.second.size()>0);
+      ix.xs=x.strides.combine(p.first);
+      ix.ys=y.strides.combine(p.second);
+      R.push_back(ix);
+    }
+    for(auto& p:bstrides){
+      EinsumIndex ix;
+      ix.n=r.dims[p[0]];
+      ix.inr=true;
+      ix.rs=r.strides.combine(p);
+      R.push_back(ix);
+    }
+    return R;
+  }
+
+
+  // Process wide cache of plans keyed by the einsum string and the extents and strides of its indices
+  class EinsumPlanCache{
+  public:
+
+    static constexpr int max_plans=1024;
+
+    std::mutex mx;
+    unordered_map<string,shared_ptr<EinsumPlan> > plans;
+
+    shared_ptr<EinsumPlan> operator()(const string& str, const vector<EinsumIndex>& indices, const bool cpu=true){
+      string key=str+(cpu?"|":"|g");
+      for(auto& p:indices)
+	key+=to_string(p.n)+":"+to_string(p.rs)+":"+to_string(p.xs)+":"+to_string(p.ys)+
+	  ":"+to_string(4*p.inr+2*p.inx+p.iny)+",";
+      std::lock_guard<std::mutex> lock(mx);
+      auto it=plans.find(key);
+      if(it!=plans.end()) return it->second;
+      if(plans.size()>=max_plans) plans.clear();
+      auto plan=make_shared<EinsumPlan>(indices,cpu);
+      plans[key]=plan;
+      return plan;
+    }
+
+  };
+
+  inline EinsumPlanCache& einsum_plan_cache(){
+    static EinsumPlanCache cache;
+    return cache;
+  }
+
+}
+
+#endif
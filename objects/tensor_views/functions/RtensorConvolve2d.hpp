@@ -17,6 +17,8 @@
 
 #include "Rtensor5_view.hpp"
 #include "CSRmatrix.hpp"
+#include "RtensorConvolveCPU.hpp"
+#include "fnlog.hpp"
 
 namespace cnine{
 
@@ -29,6 +31,13 @@ namespace cnine{
   class RtensorConvolve2d{
   public:
 
+    ConvolveAlgorithm algorithm=ConvolveAlgorithm::automatic;
+
+    RtensorConvolve2d(){}
+
+    RtensorConvolve2d(const ConvolveAlgorithm _algorithm):
+      algorithm(_algorithm){}
+
 
     // (i0,i1,a)*(a',j0,j1,a) -> (i0+j0,i1+j1,a') 
     void operator()(const Rtensor3_view& r, const Rtensor3_view& x, const Rtensor4_view& w){
@@ -39,6 +48,8 @@ namespace cnine{
       int padding1=(r.n1-x.n1+w.n2-1)/2;
 
       if(r.dev==0){
+	auto g=args(r.arr,r.n0,r.n1,r.s0,r.s1,r.s2,x.arr,x.n0,x.n1,x.s0,x.s1,x.s2,w,padding0,padding1);
+	if(fast_cpu(g)) return;
 	for(int i0=0; i0<r.n0; i0++){
 	  for(int i1=0; i1<r.n1; i1++){
 	    Rtensor1_view R(r.arr+i0*r.s0+i1*r.s1, r.n2, r.s2, r.dev);
@@ -75,6 +86,11 @@ namespace cnine{
       int padding1=(r.n1-x.n1+w.n2-1)/2;
 
       if(r.dev==0){
+	auto g=args(r.arr,r.n0,r.n1,r.s0,r.s1,r.s2,x.arr,x.n0,x.n1,x.s0,x.s1,x.s2,w,padding0,padding1);
+	g.nc=r.n3;
+	g.rs_c=r.s3;
+	g.xs_c=x.s3;
+	if(fast_cpu(g)) return;
 	for(int i0=0; i0<r.n0; i0++){
 	  for(int i1=0; i1<r.n1; i1++){
 	    Rtensor2_view R(r.arr+i0*r.s0+i1*r.s1, r.n2,r.n3, r.s2,r.s3, r.dev);
@@ -145,6 +161,41 @@ namespace cnine{
       }
     }
 
+
+  private: // ---- CPU algorithms ----------------------------------------------------------------------------
+
+
+    convolve_cpu::ConvolveArgs<2> args(float* r, const int rn0, const int rn1, const int rs0, const int rs1, const int rs_a,
+      const float* x, const int xn0, const int xn1, const int xs0, const int xs1, const int xs_a,
+      const Rtensor4_view& w, const int padding0, const int padding1) const{
+      convolve_cpu::ConvolveArgs<2> g;
+      g.nout=w.n0; g.nin=w.n3;
+      g.rn[0]=rn0; g.rn[1]=rn1; g.xn[0]=xn0; g.xn[1]=xn1;
+      g.kn[0]=w.n1; g.kn[1]=w.n2; g.pad[0]=padding0; g.pad[1]=padding1;
+      g.r=r; g.rs[0]=rs0; g.rs[1]=rs1; g.rs_a=rs_a;
+      g.x=x; g.xs[0]=xs0; g.xs[1]=xs1; g.xs_a=xs_a;
+      g.w=w.arr; g.ws_o=w.s0; g.ws[0]=w.s1; g.ws[1]=w.s2; g.ws_a=w.s3;
+      return g;
+    }
+
+    // Run the problem with im2col or Winograd if the heuristic (or algorithm) says so
+    bool fast_cpu(const convolve_cpu::ConvolveArgs<2>& g) const{
+      ConvolveAlgorithm alg=algorithm;
+      if(alg==ConvolveAlgorithm::automatic) alg=convolve_cpu::choose(g);
+      if(alg==ConvolveAlgorithm::winograd && (g.kn[0]!=3 || g.kn[1]!=3)) alg=ConvolveAlgorithm::im2col;
+      if(alg==ConvolveAlgorithm::im2col){
+	CNINE_PROFILE_OPS("RtensorConvolve2d(im2col)",g.n_ops());
+	convolve_cpu::im2col(g);
+	return true;
+      }
+      if(alg==ConvolveAlgorithm::winograd){
+	CNINE_PROFILE_OPS("RtensorConvolve2d(winograd)",g.n_ops());
+	convolve_cpu::winograd_f2x2_3x3(g);
+	return true;
+      }
+      return false;
+    }
+
   };
 
 
@@ -16,7 +16,10 @@
 #define _CnineRtensorConvolve2dSparse
 
 #include "Rtensor5_view.hpp"
+#include "Rtensor6_view.hpp"
 #include "CSRmatrix.hpp"
+#include "RtensorConvolveSparseCPU.hpp"
+#include "CnineProfiler.hpp"
 
 namespace cnine{
 
@@ -34,23 +37,10 @@ namespace cnine{
       CNINE_ASSRT(r.n2==w.n);
       int padding0=(r.n0-x.n0+J0-1)/2;
       int padding1=(r.n1-x.n1+J1-1)/2;
-      //const int J1=r.n1-x.n1+1-2*padding1;
-      const int A=x.n2;
-
-      if(r.dev==0){
-	for(int i0=0; i0<r.n0; i0++)
-	  for(int i1=0; i1<r.n1; i1++){
-	    Rtensor1_view R(r.arr+i0*r.s0+i1*r.s1, r.n2, r.s2, r.dev);
-	      w.for_each([&](const int aout, const int s, const float v){
-		  int j0=s/(J1*A);
-		  int j1=(s/A)%J1;
-		  if(i0+j0-padding0<0 || i0+j0-padding0>=x.n0) return;
-		  if(i1+j1-padding1<0 || i1+j1-padding1>=x.n1) return;
-		  int a=s%A;
-		  R.inc(aout,v*x(i0+j0-padding0,i1+j1-padding1,a));
-		});
-	  }
-	}
+
+      if(r.dev==0)
+	cpu(Rtensor6_view(r.arr,1,r.n0,r.n1,1,r.n2,1,0,r.s0,r.s1,0,r.s2,0),
+	  Rtensor6_view(x.arr,1,x.n0,x.n1,1,x.n2,1,0,x.s0,x.s1,0,x.s2,0),w,J0,J1);
       if(r.dev==1){
 	int dev=r.dev; CNINE_CPUONLY();
 	//CUDA_STREAM(RtensorConvolve2d_cu(r,x,w,padding0,padding1,stream));
@@ -64,26 +54,10 @@ namespace cnine{
       CNINE_ASSRT(r.n3==x.n3);
       int padding0=(r.n0-x.n0+J0-1)/2;
       int padding1=(r.n1-x.n1+J1-1)/2;
-      //const int J0=r.n0-x.n0+1-2*padding0;
-      //const int J1=r.n1-x.n1+1-2*padding1;
-      const int A=x.n2;
-      const int C=x.n3;
-
-      if(r.dev==0){
-	for(int i0=0; i0<r.n0; i0++)
-	  for(int i1=0; i1<r.n1; i1++){
-	    Rtensor2_view R(r.arr+i0*r.s0+i1*r.s1, r.n2, r.n3, r.s2, r.s3, r.dev);
-	      w.for_each([&](const int aout, const int s, const float v){
-		  int j0=s/(J1*A);
-		  int j1=(s/A)%J1;
-		  if(i0+j0-padding0<0 || i0+j0-padding0>=x.n0) return;
-		  if(i1+j1-padding1<0 || i1+j1-padding1>=x.n1) return;
-		  int a=s%A;
-		  for(int c=0; c<C; c++)
-		    R.inc(aout,c,v*x(i0+j0-padding0,i1+j1-padding1,a,c));
-		});
-	  }
-      }
+
+      if(r.dev==0)
+	cpu(Rtensor6_view(r.arr,1,r.n0,r.n1,1,r.n2,r.n3,0,r.s0,r.s1,0,r.s2,r.s3),
+	  Rtensor6_view(x.arr,1,x.n0,x.n1,1,x.n2,x.n3,0,x.s0,x.s1,0,x.s2,x.s3),w,J0,J1);
       if(r.dev==1){
 	int dev=r.dev; CNINE_CPUONLY();
 	//CUDA_STREAM(RtensorConvolve2d_cu(r,x,w,padding0,padding1,stream));
@@ -99,10 +73,9 @@ namespace cnine{
       int padding0=(r.n1-x.n1+J0-1)/2;
       int padding1=(r.n2-x.n2+J1-1)/2;
 
-      if(r.dev==0){
-	for(int b=0; b<x.n0; b++)
-	  (*this)(r.slice0(b),x.slice0(b),w,J0,J1);
-      }
+      if(r.dev==0)
+	cpu(Rtensor6_view(r.arr,r.n0,r.n1,r.n2,1,r.n3,r.n4,r.s0,r.s1,r.s2,0,r.s3,r.s4),
+	  Rtensor6_view(x.arr,x.n0,x.n1,x.n2,1,x.n3,x.n4,x.s0,x.s1,x.s2,0,x.s3,x.s4),w,J0,J1);
       if(r.dev==1){
 	int dev=r.dev; CNINE_CPUONLY();
 	//CUDA_STREAM(RtensorConvolve2d_cu(r,x,w,padding0,padding1,stream));
@@ -119,11 +92,8 @@ namespace cnine{
       int padding0=(r.n1-x.n1+J0-1)/2;
       int padding1=(r.n2-x.n2+J1-1)/2;
 
-      if(r.dev==0){
-	for(int b=0; b<x.n0; b++)
-	  for(int d=0; d<x.n3; d++)
-	    (*this)(r.slice0(b).slice2(d),x.slice0(b).slice2(d),w,J0,J1);
-      }
+      if(r.dev==0)
+	cpu(r,x,w,J0,J1);
       if(r.dev==1){
 	int dev=r.dev; CNINE_CPUONLY();
 	//CUDA_STREAM(RtensorConvolve2d_cu(r,x,w,padding0,padding1,stream));
@@ -131,6 +101,31 @@ namespace cnine{
     }
 
 
+  private:
+
+    // r(b,i0,i1,d,aout,c) += sum_s w(aout,s) x(b,i0+j0-padding0,i1+j1-padding1,d,a,c)
+    // The stencil is built once and the block index d is folded into the batch.
+    void cpu(const Rtensor6_view& r, const Rtensor6_view& x, const CSRmatrix<float>& w, const int J0, const int J1){
+      CNINE_ASSRT(r.n0==x.n0);
+      CNINE_ASSRT(r.n3==x.n3);
+      CNINE_ASSRT(r.n5==x.n5);
+      const int J[2]={J0,J1};
+      convolve_cpu::SparseStencil<2> stencil(w,J,x.n4);
+
+      convolve_cpu::SparseConvolveArgs<2> g;
+      g.nb=r.n0; g.nd=r.n3; g.nout=r.n4; g.nin=x.n4; g.nc=r.n5;
+      g.rn[0]=r.n1; g.rn[1]=r.n2;
+      g.xn[0]=x.n1; g.xn[1]=x.n2;
+      g.J[0]=J0; g.J[1]=J1;
+      g.pad[0]=(r.n1-x.n1+J0-1)/2;
+      g.pad[1]=(r.n2-x.n2+J1-1)/2;
+      g.r=r.arr; g.rs_b=r.s0; g.rs[0]=r.s1; g.rs[1]=r.s2; g.rs_d=r.s3; g.rs_a=r.s4; g.rs_c=r.s5;
+      g.x=x.arr; g.xs_b=x.s0; g.xs[0]=x.s1; g.xs[1]=x.s2; g.xs_d=x.s3; g.xs_a=x.s4; g.xs_c=x.s5;
+
+      CNINE_PROFILE_OPS("RtensorConvolve2dSparse",2ll*stencil.nnz()*g.npositions()*g.nb*g.nd*g.nc);
+      stencil(g);
+    }
+
   };
 
 
@@ -17,6 +17,8 @@
 
 #include "Rtensor6_view.hpp"
 #include "LoggedOp.hpp"
+#include "RtensorConvolveCPU.hpp"
+#include "fnlog.hpp"
 
 namespace cnine{
 
@@ -30,6 +32,13 @@ namespace cnine{
   class RtensorConvolve3d{
   public:
 
+    ConvolveAlgorithm algorithm=ConvolveAlgorithm::automatic;
+
+    RtensorConvolve3d(){}
+
+    RtensorConvolve3d(const ConvolveAlgorithm _algorithm):
+      algorithm(_algorithm){}
+
 
     // (i0,i1,i2,a)*(a',j0,j1,j2,a) -> (i0+j0,i1+j1,i2+j2,a') 
     void operator()(const Rtensor4_view& r, const Rtensor4_view& x, const Rtensor5_view& w){
@@ -41,6 +50,8 @@ namespace cnine{
       int padding2=(r.n2-x.n2+w.n3-1)/2;
 
       if(r.dev==0){
+	auto g=args(r.arr,r.n0,r.n1,r.n2,r.s0,r.s1,r.s2,r.s3,x.arr,x.n0,x.n1,x.n2,x.s0,x.s1,x.s2,x.s3,w,padding0,padding1,padding2);
+	if(fast_cpu(g)) return;
 	for(int i0=0; i0<r.n0; i0++){
 	  for(int i1=0; i1<r.n1; i1++){
 	    for(int i2=0; i2<r.n2; i2++){
@@ -82,6 +93,11 @@ namespace cnine{
       int padding2=(r.n2-x.n2+w.n3-1)/2;
 
       if(r.dev==0){
+	auto g=args(r.arr,r.n0,r.n1,r.n2,r.s0,r.s1,r.s2,r.s3,x.arr,x.n0,x.n1,x.n2,x.s0,x.s1,x.s2,x.s3,w,padding0,padding1,padding2);
+	g.nc=r.n4;
+	g.rs_c=r.s4;
+	g.xs_c=x.s4;
+	if(fast_cpu(g)) return;
 	for(int i0=0; i0<r.n0; i0++){
 	  for(int i1=0; i1<r.n1; i1++){
 	    for(int i2=0; i2<r.n2; i2++){
@@ -133,6 +149,33 @@ namespace cnine{
     }
 
 
+  private: // ---- CPU algorithms ----------------------------------------------------------------------------
+
+
+    convolve_cpu::ConvolveArgs<3> args(float* r, const int rn0, const int rn1, const int rn2, 
+      const int rs0, const int rs1, const int rs2, const int rs_a,
+      const float* x, const int xn0, const int xn1, const int xn2, 
+      const int xs0, const int xs1, const int xs2, const int xs_a,
+      const Rtensor5_view& w, const int padding0, const int padding1, const int padding2) const{
+      convolve_cpu::ConvolveArgs<3> g;
+      g.nout=w.n0; g.nin=w.n4;
+      g.rn[0]=rn0; g.rn[1]=rn1; g.rn[2]=rn2; g.xn[0]=xn0; g.xn[1]=xn1; g.xn[2]=xn2;
+      g.kn[0]=w.n1; g.kn[1]=w.n2; g.kn[2]=w.n3; g.pad[0]=padding0; g.pad[1]=padding1; g.pad[2]=padding2;
+      g.r=r; g.rs[0]=rs0; g.rs[1]=rs1; g.rs[2]=rs2; g.rs_a=rs_a;
+      g.x=x; g.xs[0]=xs0; g.xs[1]=xs1; g.xs[2]=xs2; g.xs_a=xs_a;
+      g.w=w.arr; g.ws_o=w.s0; g.ws[0]=w.s1; g.ws[1]=w.s2; g.ws[2]=w.s3; g.ws_a=w.s4;
+      return g;
+    }
+
+    // There is no 3D Winograd path, so anything but direct evaluation goes to im2col
+    bool fast_cpu(const convolve_cpu::ConvolveArgs<3>& g) const{
+      ConvolveAlgorithm alg=algorithm;
+      if(alg==ConvolveAlgorithm::automatic) alg=convolve_cpu::choose(g);
+      if(alg==ConvolveAlgorithm::direct) return false;
+      CNINE_PROFILE_OPS("RtensorConvolve3d(im2col)",g.n_ops());
+      convolve_cpu::im2col(g);
+      return true;
+    }
 
   };
 
@@ -17,6 +17,8 @@
 
 #include "Rtensor5_view.hpp"
 #include "CSRmatrix.hpp"
+#include "RtensorConvolveSparseCPU.hpp"
+#include "CnineProfiler.hpp"
 
 namespace cnine{
 
@@ -41,26 +43,10 @@ namespace cnine{
       int padding0=(r.n0-x.n0+J0-1)/2;
       int padding1=(r.n1-x.n1+J1-1)/2;
       int padding2=(r.n2-x.n2+J2-1)/2;
-      const int A=x.n3;
-
-      if(r.dev==0){
-	for(int i0=0; i0<r.n0; i0++)
-	  for(int i1=0; i1<r.n1; i1++)
-	    for(int i2=0; i2<r.n2; i2++){
-	      Rtensor1_view R(r.arr+i0*r.s0+i1*r.s1+i2*r.s2, r.n3, r.s3, r.dev);
-	      w.for_each([&](const int aout, const int s, const float v){
-		  int j2=(s/A)%J2;
-		  int sd=s/(J2*A);
-		  int j1=sd%J1;
-		  int j0=sd/J1;
-		  if(i0+j0-padding0<0 || i0+j0-padding0>=x.n0) return;
-		  if(i1+j1-padding1<0 || i1+j1-padding1>=x.n1) return;
-		  if(i2+j2-padding2<0 || i2+j2-padding2>=x.n2) return;
-		  int a=s%A;
-		  R.inc(aout,v*x(i0+j0-padding0,i1+j1-padding1,i2+j2-padding2,a));
-		});
-	  }
-	}
+
+      if(r.dev==0)
+	cpu(Rtensor6_view(r.arr,1,r.n0,r.n1,r.n2,r.n3,1,0,r.s0,r.s1,r.s2,r.s3,0),
+	  Rtensor6_view(x.arr,1,x.n0,x.n1,x.n2,x.n3,1,0,x.s0,x.s1,x.s2,x.s3,0),w,J0,J1,J2);
       if(r.dev==1){
 	//int dev=r.dev; CNINE_CPUONLY();
 	CUDA_STREAM(RtensorConvolve3d_cu(r,x,w,J0,J1,J2,padding0,padding1,padding2,stream));
@@ -76,30 +62,10 @@ namespace cnine{
       int padding0=(r.n0-x.n0+J0-1)/2;
       int padding1=(r.n1-x.n1+J1-1)/2;
       int padding2=(r.n2-x.n2+J2-1)/2;
-      //const int J0=r.n0-x.n0+1-2*padding0;
-      //const int J1=r.n1-x.n1+1-2*padding1;
-      const int A=x.n3;
-      const int C=x.n4;
-
-      if(r.dev==0){
-	for(int i0=0; i0<r.n0; i0++)
-	  for(int i1=0; i1<r.n1; i1++)
-	    for(int i2=0; i2<r.n2; i2++){
-	      Rtensor2_view R(r.arr+i0*r.s0+i1*r.s1+i2*r.s2, r.n3, r.n4, r.s3, r.s4, r.dev);
-	      w.for_each([&](const int aout, const int s, const float v){
-		  int j2=(s/A)%J2;
-		  int sd=s/(J2*A);
-		  int j1=sd%J1;
-		  int j0=sd/J1;
-		  if(i0+j0-padding0<0 || i0+j0-padding0>=x.n0) return;
-		  if(i1+j1-padding1<0 || i1+j1-padding1>=x.n1) return;
-		  if(i2+j2-padding2<0 || i2+j2-padding2>=x.n2) return;
-		  int a=s%A;
-		  for(int c=0; c<C; c++)
-		    R.inc(aout,c,v*x(i0+j0-padding0,i1+j1-padding1,i2+j2-padding2,a,c));
-		});
-	    }
-      }
+
+      if(r.dev==0)
+	cpu(Rtensor6_view(r.arr,1,r.n0,r.n1,r.n2,r.n3,r.n4,0,r.s0,r.s1,r.s2,r.s3,r.s4),
+	  Rtensor6_view(x.arr,1,x.n0,x.n1,x.n2,x.n3,x.n4,0,x.s0,x.s1,x.s2,x.s3,x.s4),w,J0,J1,J2);
       if(r.dev==1){
 	//int dev=r.dev; CNINE_CPUONLY();
 	CUDA_STREAM(RtensorConvolve3d_cu(r,x,w,J0,J1,J2,padding0,padding1,padding2,stream));
@@ -117,16 +83,40 @@ namespace cnine{
       int padding1=(r.n2-x.n2+J1-1)/2;
       int padding2=(r.n3-x.n3+J2-1)/2;
 
-      if(r.dev==0){
-	for(int b=0; b<x.n0; b++)
-	  (*this)(r.slice0(b),x.slice0(b),w,J0,J1,J2);
-      }
+      if(r.dev==0)
+	cpu(r,x,w,J0,J1,J2);
       if(r.dev==1){
 	//int dev=r.dev; CNINE_CPUONLY();
 	CUDA_STREAM(RtensorConvolve3d_cu(r,x,w,J0,J1,J2,padding0,padding1,padding2,stream));
       }
     }
 
+
+  private:
+
+    // r(b,i0,i1,i2,aout,c) += sum_s w(aout,s) x(b,i0+j0-padding0,i1+j1-padding1,i2+j2-padding2,a,c)
+    void cpu(const Rtensor6_view& r, const Rtensor6_view& x, const CSRmatrix<float>& w, 
+      const int J0, const int J1, const int J2){
+      CNINE_ASSRT(r.n0==x.n0);
+      CNINE_ASSRT(r.n5==x.n5);
+      const int J[3]={J0,J1,J2};
+      convolve_cpu::SparseStencil<3> stencil(w,J,x.n4);
+
+      convolve_cpu::SparseConvolveArgs<3> g;
+      g.nb=r.n0; g.nout=r.n4; g.nin=x.n4; g.nc=r.n5;
+      g.rn[0]=r.n1; g.rn[1]=r.n2; g.rn[2]=r.n3;
+      g.xn[0]=x.n1; g.xn[1]=x.n2; g.xn[2]=x.n3;
+      g.J[0]=J0; g.J[1]=J1; g.J[2]=J2;
+      g.pad[0]=(r.n1-x.n1+J0-1)/2;
+      g.pad[1]=(r.n2-x.n2+J1-1)/2;
+      g.pad[2]=(r.n3-x.n3+J2-1)/2;
+      g.r=r.arr; g.rs_b=r.s0; g.rs[0]=r.s1; g.rs[1]=r.s2; g.rs[2]=r.s3; g.rs_a=r.s4; g.rs_c=r.s5;
+      g.x=x.arr; g.xs_b=x.s0; g.xs[0]=x.s1; g.xs[1]=x.s2; g.xs[2]=x.s3; g.xs_a=x.s4; g.xs_c=x.s5;
+
+      CNINE_PROFILE_OPS("RtensorConvolve3dSparse",2ll*stencil.nnz()*g.npositions()*g.nb*g.nc);
+      stencil(g);
+    }
+
   };
     
 
@@ -0,0 +1,304 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineRtensorConvolveCPU
+#define _CnineRtensorConvolveCPU
+
+#include "Cnine_base.hpp"
+#include "CpuGemm.hpp"
+#include "ParallelFor.hpp"
+
+
+// CPU algorithms for RtensorConvolve2d and RtensorConvolve3d. Both compute
+//
+//   r(i,a',c) += sum_{j,a} w(a',j,a) x(i+j-padding,a,c)
+//
+// where i and j range over D spatial dimensions, a and a' are the input and output channels and c is
+// an optional trailing column index, with x taken to be zero outside of its bounds.
+// im2col unrolls the receptive field of a block of output positions into the columns of a matrix, so
+// the whole block is a single (nout x K)*(K x positions) product. Winograd F(2x2,3x3) computes 2x2
+// output tiles from 4x4 input tiles using 16 instead of 36 multiplications per tile and channel pair.
+
+namespace cnine{
+
+  enum class ConvolveAlgorithm{automatic,direct,im2col,winograd};
+
+  inline string ConvolveAlgorithm_str(const ConvolveAlgorithm x){
+    switch(x){
+    case ConvolveAlgorithm::direct: return "direct";
+    case ConvolveAlgorithm::im2col: return "im2col";
+    case ConvolveAlgorithm::winograd: return "winograd";
+    default: return "automatic";
+    }
+  }
+
+
+  namespace convolve_cpu{
+
+    // Pointers, dimensions and strides of one convolution. For views without a trailing column
+    // index nc=1 and the c strides are 0.
+    template<int D>
+    struct ConvolveArgs{
+      int nout, nin, nc=1;
+      int rn[D], xn[D], kn[D], pad[D];
+      float* r; int rs[D]; int rs_a; int rs_c=0;
+      const float* x; int xs[D]; int xs_a; int xs_c=0;
+      const float* w; int ws_o; int ws[D]; int ws_a;
+
+      long long npositions() const{
+	long long t=1;
+	for(int d=0; d<D; d++) t*=rn[d];
+	return t;
+      }
+
+      int kernel_size() const{
+	int t=1;
+	for(int d=0; d<D; d++) t*=kn[d];
+	return t;
+      }
+
+      long long n_ops() const{
+	return 2ll*nout*nin*kernel_size()*npositions()*nc;
+      }
+    };
+
+
+    // Direct evaluation issues one small matrix-vector product per output position and kernel
+    // offset, which only wins when the whole problem is tiny
+    template<int D>
+    ConvolveAlgorithm choose(const ConvolveArgs<D>& g){
+      if(g.n_ops()<(1<<16)) return ConvolveAlgorithm::direct;
+      if(D==2 && g.kn[0]==3 && g.kn[1]==3 && g.nin>=8 && g.nout>=8 && g.rn[0]>=4 && g.rn[1]>=4)
+	return ConvolveAlgorithm::winograd;
+      return ConvolveAlgorithm::im2col;
+    }
+
+
+    // ---- im2col ---------------------------------------------------------------------------------------
+
+
+    template<int D>
+    void im2col(const ConvolveArgs<D>& g){
+      const int nout=g.nout, nin=g.nin, nc=g.nc;
+      const int nk=g.kernel_size();
+      const int K=nk*nin;
+      const long long P=g.npositions();
+
+      // kernel offsets in row major order
+      vector<int> koffs(nk*D);
+      vector<int> kwoffs(nk);
+      for(int k=0; k<nk; k++){
+	int t=k, woffs=0;
+	for(int d=D-1; d>=0; d--){
+	  koffs[k*D+d]=t%g.kn[d];
+	  woffs+=koffs[k*D+d]*g.ws[d];
+	  t/=g.kn[d];
+	}
+	kwoffs[k]=woffs;
+      }
+
+      // weights as a contiguous (nout x K) matrix
+      vector<float> W(((size_t)nout)*K);
+      for(int o=0; o<nout; o++)
+	for(int k=0; k<nk; k++)
+	  for(int a=0; a<nin; a++)
+	    W[((size_t)o)*K+k*nin+a]=g.w[o*g.ws_o+kwoffs[k]+a*g.ws_a];
+
+      // output positions per block, so that the unrolled block stays around 1MB
+      const long long pc=std::max(1ll,std::min(P,(1ll<<18)/std::max(1ll,((long long)K)*nc)));
+      const long long nchunks=(P+pc-1)/pc;
+
+      parallel_for(nchunks,[&](const size_t beg, const size_t end){
+	  vector<float> col;
+	  vector<float> T;
+	  int i[D];
+	  for(size_t chunk=beg; chunk<end; chunk++){
+	    const long long p0=chunk*pc;
+	    const long long p1=std::min(P,p0+pc);
+	    const int N=(p1-p0)*nc;
+
+	    col.assign(((size_t)K)*N,0);
+	    for(long long p=p0; p<p1; p++){
+	      long long t=p;
+	      for(int d=D-1; d>=0; d--){i[d]=t%g.rn[d]; t/=g.rn[d];}
+	      const int colix=(p-p0)*nc;
+	      for(int k=0; k<nk; k++){
+		int xoffs=0;
+		bool inside=true;
+		for(int d=0; d<D; d++){
+		  const int s=i[d]+koffs[k*D+d]-g.pad[d];
+		  if(s<0 || s>=g.xn[d]) {inside=false; break;}
+		  xoffs+=s*g.xs[d];
+		}
+		if(!inside) continue;
+		const float* src=g.x+xoffs;
+		float* dest=col.data()+((size_t)k)*nin*N+colix;
+		for(int a=0; a<nin; a++)
+		  for(int c=0; c<nc; c++)
+		    dest[a*N+c]=src[a*g.xs_a+c*g.xs_c];
+	      }
+	    }
+
+	    T.assign(((size_t)nout)*N,0);
+	    cpu_gemm<float>(nout,N,K,1.0,W.data(),K,1,col.data(),N,1,T.data(),N,1);
+
+	    for(long long p=p0; p<p1; p++){
+	      long long t=p;
+	      int roffs=0;
+	      for(int d=D-1; d>=0; d--){roffs+=(t%g.rn[d])*g.rs[d]; t/=g.rn[d];}
+	      float* dest=g.r+roffs;
+	      const float* src=T.data()+(p-p0)*nc;
+	      for(int o=0; o<nout; o++)
+		for(int c=0; c<nc; c++)
+		  dest[o*g.rs_a+c*g.rs_c]+=src[((size_t)o)*N+c];
+	    }
+	  }
+	},1);
+    }
+
+
+    // ---- Winograd F(2x2,3x3) --------------------------------------------------------------------------
+
+
+    // u=G g G^T for a 3x3 kernel g
+    inline void winograd_kernel_transform(const float* g, float* u){
+      float t[4][3];
+      for(int j=0; j<3; j++){
+	t[0][j]=g[j];
+	t[1][j]=0.5f*(g[j]+g[3+j]+g[6+j]);
+	t[2][j]=0.5f*(g[j]-g[3+j]+g[6+j]);
+	t[3][j]=g[6+j];
+      }
+      for(int i=0; i<4; i++){
+	u[i*4+0]=t[i][0];
+	u[i*4+1]=0.5f*(t[i][0]+t[i][1]+t[i][2]);
+	u[i*4+2]=0.5f*(t[i][0]-t[i][1]+t[i][2]);
+	u[i*4+3]=t[i][2];
+      }
+    }
+
+    // v=B^T d B for a 4x4 input tile d
+    inline void winograd_input_transform(const float* d, float* v){
+      float t[4][4];
+      for(int j=0; j<4; j++){
+	t[0][j]=d[j]-d[8+j];
+	t[1][j]=d[4+j]+d[8+j];
+	t[2][j]=d[8+j]-d[4+j];
+	t[3][j]=d[4+j]-d[12+j];
+      }
+      for(int i=0; i<4; i++){
+	v[i*4+0]=t[i][0]-t[i][2];
+	v[i*4+1]=t[i][1]+t[i][2];
+	v[i*4+2]=t[i][2]-t[i][1];
+	v[i*4+3]=t[i][1]-t[i][3];
+      }
+    }
+
+    // y=A^T m A, giving a 2x2 output tile
+    inline void winograd_output_transform(const float* m, float* y){
+      float t[2][4];
+      for(int j=0; j<4; j++){
+	t[0][j]=m[j]+m[4+j]+m[8+j];
+	t[1][j]=m[4+j]-m[8+j]-m[12+j];
+      }
+      for(int i=0; i<2; i++){
+	y[i*2+0]=t[i][0]+t[i][1]+t[i][2];
+	y[i*2+1]=t[i][1]-t[i][2]-t[i][3];
+      }
+    }
+
+
+    inline void winograd_f2x2_3x3(const ConvolveArgs<2>& g){
+      CNINE_ASSRT(g.kn[0]==3 && g.kn[1]==3);
+      const int nout=g.nout, nin=g.nin, nc=g.nc;
+
+      // transformed kernels: U[xi] is an (nout x nin) matrix for each of the 16 tile positions xi
+      vector<float> U(16*((size_t)nout)*nin);
+      for(int o=0; o<nout; o++)
+	for(int a=0; a<nin; a++){
+	  float k[9], u[16];
+	  for(int j0=0; j0<3; j0++)
+	    for(int j1=0; j1<3; j1++)
+	      k[j0*3+j1]=g.w[o*g.ws_o+j0*g.ws[0]+j1*g.ws[1]+a*g.ws_a];
+	  winograd_kernel_transform(k,u);
+	  for(int xi=0; xi<16; xi++)
+	    U[(((size_t)xi)*nout+o)*nin+a]=u[xi];
+	}
+
+      const int th=(g.rn[0]+1)/2;
+      const int tw=(g.rn[1]+1)/2;
+      const long long ntiles=((long long)th)*tw;
+      const long long tc=std::max(1ll,std::min(ntiles,(1ll<<14)/std::max(1,nin*nc)));
+      const long long nchunks=(ntiles+tc-1)/tc;
+
+      parallel_for(nchunks,[&](const size_t beg, const size_t end){
+	  vector<float> V;
+	  vector<float> M;
+	  for(size_t chunk=beg; chunk<end; chunk++){
+	    const long long t0=chunk*tc;
+	    const long long t1=std::min(ntiles,t0+tc);
+	    const int N=(t1-t0)*nc;
+
+	    V.resize(16*((size_t)nin)*N);
+	    for(long long t=t0; t<t1; t++){
+	      const int y0=2*(t/tw)-g.pad[0];
+	      const int x0=2*(t%tw)-g.pad[1];
+	      for(int a=0; a<nin; a++)
+		for(int c=0; c<nc; c++){
+		  float d[16], v[16];
+		  for(int u=0; u<4; u++)
+		    for(int s=0; s<4; s++){
+		      const int y=y0+u, x=x0+s;
+		      d[u*4+s]=(y>=0 && y<g.xn[0] && x>=0 && x<g.xn[1])?
+			g.x[y*g.xs[0]+x*g.xs[1]+a*g.xs_a+c*g.xs_c]:0;
+		    }
+		  winograd_input_transform(d,v);
+		  const size_t col=(t-t0)*nc+c;
+		  for(int xi=0; xi<16; xi++)
+		    V[(((size_t)xi)*nin+a)*N+col]=v[xi];
+		}
+	    }
+
+	    M.assign(16*((size_t)nout)*N,0);
+	    for(int xi=0; xi<16; xi++)
+	      cpu_gemm<float>(nout,N,nin,1.0,U.data()+((size_t)xi)*nout*nin,nin,1,
+		V.data()+((size_t)xi)*nin*N,N,1,M.data()+((size_t)xi)*nout*N,N,1);
+
+	    for(long long t=t0; t<t1; t++){
+	      const int i0=2*(t/tw);
+	      const int i1=2*(t%tw);
+	      const int h=std::min(2,g.rn[0]-i0);
+	      const int w=std::min(2,g.rn[1]-i1);
+	      for(int o=0; o<nout; o++)
+		for(int c=0; c<nc; c++){
+		  float m[16], y[4];
+		  const size_t col=(t-t0)*nc+c;
+		  for(int xi=0; xi<16; xi++)
+		    m[xi]=M[(((size_t)xi)*nout+o)*N+col];
+		  winograd_output_transform(m,y);
+		  float* dest=g.r+i0*g.rs[0]+i1*g.rs[1]+o*g.rs_a+c*g.rs_c;
+		  for(int u=0; u<h; u++)
+		    for(int s=0; s<w; s++)
+		      dest[u*g.rs[0]+s*g.rs[1]]+=y[u*2+s];
+		}
+	    }
+	  }
+	},1);
+    }
+
+  }
+
+}
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#ifndef _CnineRtensorConvolveSparseCPU
+#define _CnineRtensorConvolveSparseCPU
+
+#include "Cnine_base.hpp"
+#include "CSRmatrix.hpp"
+#include "ParallelFor.hpp"
+
+
+// CPU kernel for RtensorConvolve2dSparse and RtensorConvolve3dSparse. The weight is a CSRmatrix
+// whose row aout holds the nonzeros w(aout,s) with s=(j_0,...,j_{D-1},a) in row major order, and
+//
+//   r(b,d,i,aout,c) += sum_s w(aout,s) x(b,d,i+j-padding,a,c),
+//
+// where b and d are two batch indices with independent strides.
+//
+// A SparseStencil decodes the columns of w once and groups the nonzeros by kernel position j.
+// Output positions whose receptive field lies entirely inside x are processed without any bounds
+// checks; at the border whole groups are skipped when their input position is outside of x.
+
+namespace cnine{
+
+  namespace convolve_cpu{
+
+    template<int D>
+    struct SparseConvolveArgs{
+      int nb=1, nd=1, nout, nin, nc=1;
+      int rn[D], xn[D], J[D], pad[D];
+      float* r; int rs_b=0; int rs_d=0; int rs[D]; int rs_a; int rs_c=0;
+      const float* x; int xs_b=0; int xs_d=0; int xs[D]; int xs_a; int xs_c=0;
+
+      long long npositions() const{
+	long long t=1;
+	for(int d=0; d<D; d++) t*=rn[d];
+	return t;
+      }
+    };
+
+
+    template<int D>
+    class SparseStencil{
+    public:
+
+      int J[D];
+      int nin;
+      vector<int> j;      // kernel position of each group, D entries per group
+      vector<int> gbeg;   // start of each group in the entry arrays
+      vector<int> aout;
+      vector<int> a;
+      vector<float> v;
+
+      SparseStencil(const CSRmatrix<float>& w, const int* _J, const int _nin):
+	nin(_nin){
+	CNINE_ASSRT(w.dev==0);
+	int K=1;
+	for(int d=0; d<D; d++){J[d]=_J[d]; K*=J[d];}
+	CNINE_ASSRT(w.m==0 || w.m==K*nin);
+
+	// counting sort of the nonzeros by kernel position
+	vector<int> count(K+1,0);
+	w.for_each([&](const int i, const int s, const float val){
+	    if(val!=0) count[s/nin+1]++;});
+	for(int k=0; k<K; k++) count[k+1]+=count[k];
+	const int nnz=count[K];
+	aout.resize(nnz);
+	a.resize(nnz);
+	v.resize(nnz);
+	vector<int> fill(count.begin(),count.end()-1);
+	w.for_each([&](const int i, const int s, const float val){
+	    if(val==0) return;
+	    int e=fill[s/nin]++;
+	    aout[e]=i;
+	    a[e]=s%nin;
+	    v[e]=val;
+	  });
+
+	for(int k=0; k<K; k++){
+	  if(count[k+1]==count[k]) continue;
+	  int t=k;
+	  int jk[D];
+	  for(int d=D-1; d>=0; d--){jk[d]=t%J[d]; t/=J[d];}
+	  for(int d=0; d<D; d++) j.push_back(jk[d]);
+	  gbeg.push_back(count[k]);
+	}
+	gbeg.push_back(nnz);
+      }
+
+      int ngroups() const{
+	return gbeg.size()-1;
+      }
+
+      int nnz() const{
+	return v.size();
+      }
+
+
+      void operator()(const SparseConvolveArgs<D>& g) const{
+	for(int d=0; d<D; d++) CNINE_ASSRT(g.J[d]==J[d]);
+	CNINE_ASSRT(g.nin==nin);
+	const int ng=ngroups();
+	const int ne=nnz();
+	const int nc=g.nc;
+
+	// offsets of the entries and groups for these particular strides
+	vector<int> roff(ne), xoff(ne), gxoff(ng);
+	for(int e=0; e<ne; e++){
+	  roff[e]=aout[e]*g.rs_a;
+	  xoff[e]=a[e]*g.xs_a;
+	}
+	for(int k=0; k<ng; k++){
+	  int t=0;
+	  for(int d=0; d<D; d++) t+=j[k*D+d]*g.xs[d];
+	  gxoff[k]=t;
+	}
+	const bool contiguous=(g.rs_c==1 && g.xs_c==1);
+
+	int rest=1; // output positions per row
+	for(int d=1; d<D; d++) rest*=g.rn[d];
+	const size_t nrows=((size_t)g.nb)*g.nd*g.rn[0];
+	const size_t grain=std::max<size_t>(1,(1<<16)/std::max<size_t>(1,2ll*ne*rest*nc));
+
+	parallel_for(nrows,[&](const size_t beg, const size_t end){
+	    int i[D];
+	    for(size_t row=beg; row<end; row++){
+	      const int bd=row/g.rn[0];
+	      const int b=bd/g.nd;
+	      const int d=bd%g.nd;
+	      i[0]=row%g.rn[0];
+	      for(int p=0; p<rest; p++){
+		int t=p;
+		for(int u=D-1; u>0; u--){i[u]=t%g.rn[u]; t/=g.rn[u];}
+
+		bool interior=true;
+		long long xbase=((long long)b)*g.xs_b+((long long)d)*g.xs_d;
+		float* rp=g.r+((size_t)b)*g.rs_b+((size_t)d)*g.rs_d;
+		for(int u=0; u<D; u++){
+		  const int s=i[u]-g.pad[u];
+		  if(s<0 || s+J[u]>g.xn[u]) interior=false;
+		  xbase+=((long long)s)*g.xs[u];
+		  rp+=((size_t)i[u])*g.rs[u];
+		}
+
+		for(int k=0; k<ng; k++){
+		  if(!interior){
+		    bool inside=true;
+		    for(int u=0; u<D; u++){
+		      const int s=i[u]+j[k*D+u]-g.pad[u];
+		      if(s<0 || s>=g.xn[u]) {inside=false; break;}
+		    }
+		    if(!inside) continue;
+		  }
+		  const float* xp=g.x+xbase+gxoff[k];
+		  const int e1=gbeg[k+1];
+		  if(nc==1){
+		    for(int e=gbeg[k]; e<e1; e++)
+		      rp[roff[e]]+=v[e]*xp[xoff[e]];
+		  }else if(contiguous){
+		    for(int e=gbeg[k]; e<e1; e++){
+		      float* __restrict__ dest=rp+roff[e];
+		      const float* __restrict__ src=xp+xoff[e];
+		      const float val=v[e];
+		      for(int c=0; c<nc; c++) dest[c]+=val*src[c];
+		    }
+		  }else{
+		    for(int e=gbeg[k]; e<e1; e++){
+		      float* dest=rp+roff[e];
+		      const float* src=xp+xoff[e];
+		      const float val=v[e];
+		      for(int c=0; c<nc; c++) dest[c*g.rs_c]+=val*src[c*g.xs_c];
+		    }
+		  }
+		}
+	      }
+	    }
+	  },grain);
+      }
+
+    };
+
+  }
+
+}
+
+#endif
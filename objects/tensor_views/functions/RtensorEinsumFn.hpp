@@ -16,6 +16,8 @@
 #define _CnineRtensorEinsumFn
 
 #include "RtensorView.hpp"
+#include "EinsumPlan.hpp"
+#include "CnineProfiler.hpp"
 
 
 namespace cnine{
@@ -25,11 +27,13 @@ namespace cnine{
   class RtensorEinsumFn{
   public:
 
+    string str;
     vector<pair<vector<int>,vector<int> > > sstrides;
     vector<triple<vector<int> > > dstrides;
     vector<vector<int> > bstrides;
 
-    RtensorEinsumFn(const string str){
+    RtensorEinsumFn(const string _str):
+      str(_str){
       auto d0=str.find(",");
       auto d1=str.find("->");
       if(d0==string::npos || d1==string::npos || d0>d1){
@@ -39,9 +43,9 @@ namespace cnine{
       auto xstr=str.substr(0,d0);
       auto ystr=str.substr(d0+1,d1-d0-1);
       auto rstr=str.substr(d1+2,string::npos);
-      cout<<xstr<<endl;
-      cout<<ystr<<endl;
-      cout<<rstr<<endl;
+      //cout<<xstr<<endl;
+      //cout<<ystr<<endl;
+      //cout<<rstr<<endl;
 
       while(true){
 	auto p=rstr.find_first_not_of('x');
@@ -62,6 +66,13 @@ namespace cnine{
 	char c=xstr[p];
 	sstrides.push_back(pair<vector<int>,vector<int> >(find_all(xstr,c),find_all(ystr,c)));
       }
+
+      while(true){ // indices summed over that only appear in y
+	auto p=ystr.find_first_not_of('x');
+	if(p==string::npos) break;
+	char c=ystr[p];
+	sstrides.push_back(pair<vector<int>,vector<int> >(vector<int>(),find_all(ystr,c)));
+      }
       
       if(false){
 	cout<<"Direct:"<<endl;
@@ -99,6 +110,14 @@ namespace cnine{
 
 
     void operator()(const RtensorView& r, const RtensorView& x, const RtensorView& y){
+
+      // contractions with at least one free index of x or y are lowered to GEMM
+      auto plan=einsum_plan_cache()(str,einsum_indices(dstrides,sstrides,bstrides,r,x,y),r.dev==0);
+      if(plan->gemm){
+	CNINE_PROFILE_OPS("RtensorEinsumFn(gemm)",plan->n_ops());
+	(*plan)(r.arr,x.arr,y.arr);
+	return;
+      }
       
       if(dstrides.size()==0){
 	sloops(r,x,y,0,0,0);
@@ -174,9 +193,9 @@ namespace cnine{
       }
 
       if(sstrides.size()==1){
-	int I0=r.dims[sstrides[0].first[0]];
-	int x0=r.strides.combine(sstrides[0].first);
-	int y0=r.strides.combine(sstrides[0].second);
+	int I0=sdim(x,y,0);
+	int x0=x.strides.combine(sstrides[0].first);
+	int y0=y.strides.combine(sstrides[0].second);
 
 	TYPE t=0;
 	for(int i0=0; i0<I0; i0++)
@@ -187,13 +206,13 @@ namespace cnine{
 
 
       if(sstrides.size()==2){
-	int I0=r.dims[sstrides[0].first[0]];
-	int x0=r.strides.combine(sstrides[0].first);
-	int y0=r.strides.combine(sstrides[0].second);
+	int I0=sdim(x,y,0);
+	int x0=x.strides.combine(sstrides[0].first);
+	int y0=y.strides.combine(sstrides[0].second);
 
-	int I1=r.dims[sstrides[1].first[0]];
-	int x1=r.strides.combine(sstrides[1].first);
-	int y1=r.strides.combine(sstrides[1].second);
+	int I1=sdim(x,y,1);
+	int x1=x.strides.combine(sstrides[1].first);
+	int y1=y.strides.combine(sstrides[1].second);
 
 	TYPE t=0;
 	for(int i0=0; i0<I0; i0++)
@@ -204,17 +223,17 @@ namespace cnine{
       }
 
       if(sstrides.size()==3){
-	int I0=r.dims[sstrides[0].first[0]];
-	int x0=r.strides.combine(sstrides[0].first);
-	int y0=r.strides.combine(sstrides[0].second);
+	int I0=sdim(x,y,0);
+	int x0=x.strides.combine(sstrides[0].first);
+	int y0=y.strides.combine(sstrides[0].second);
 
-	int I1=r.dims[sstrides[1].first[0]];
-	int x1=r.strides.combine(sstrides[1].first);
-	int y1=r.strides.combine(sstrides[1].second);
+	int I1=sdim(x,y,1);
+	int x1=x.strides.combine(sstrides[1].first);
+	int y1=y.strides.combine(sstrides[1].second);
 
-	int I2=r.dims[sstrides[2].first[0]];
-	int x2=r.strides.combine(sstrides[2].first);
-	int y2=r.strides.combine(sstrides[2].second);
+	int I2=sdim(x,y,2);
+	int x2=x.strides.combine(sstrides[2].first);
+	int y2=y.strides.combine(sstrides[2].second);
 
 	TYPE t=0;
 	for(int i0=0; i0<I0; i0++)
@@ -229,6 +248,12 @@ namespace cnine{
     }
 
 
+    int sdim(const RtensorView& x, const RtensorView& y, const int i) const{
+      if(sstrides[i].first.size()>0) return x.dims[sstrides[i].first[0]];
+      return y.dims[sstrides[i].second[0]];
+    }
+
+
     inline void bloops(const RtensorView& r, int roffs, TYPE t){
 
       if(bstrides.size()==0){
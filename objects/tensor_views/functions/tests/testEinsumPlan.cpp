@@ -0,0 +1,135 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+
+#include "Cnine_base.cpp"
+#include "CtensorB.hpp"
+#include "RtensorA.hpp"
+#include "CnineSession.hpp"
+#include "RtensorEinsumFn.hpp"
+#include "CtensorEinsumFn.hpp"
+
+using namespace cnine;
+
+typedef RtensorA rtensor;
+typedef CtensorB ctensor;
+
+
+// Brute force r+=x*y by running over every assignment of the index letters
+template<typename FN>
+void brute_force(const string& str, const map<char,int>& extent, FN&& fn){
+  auto d0=str.find(",");
+  auto d1=str.find("->");
+  string xs=str.substr(0,d0), ys=str.substr(d0+1,d1-d0-1), rs=str.substr(d1+2);
+  vector<char> letters;
+  for(auto& p:extent) letters.push_back(p.first);
+  map<char,int> ix;
+  for(auto c:letters) ix[c]=0;
+  auto offset=[&](const string& s, const Gstrides& strides){
+    int t=0;
+    for(int i=0; i<s.size(); i++)
+      if(s[i]!='*') t+=ix[s[i]]*strides[i];
+    return t;};
+  while(true){
+    fn(offset,xs,ys,rs);
+    int i=letters.size()-1;
+    for(; i>=0; i--){
+      if(++ix[letters[i]]<extent.at(letters[i])) break;
+      ix[letters[i]]=0;
+    }
+    if(i<0) break;
+  }
+}
+
+map<char,int> extents(const string& str, const vector<Gdims>& dims){
+  auto d0=str.find(",");
+  auto d1=str.find("->");
+  vector<string> parts({str.substr(0,d0),str.substr(d0+1,d1-d0-1),str.substr(d1+2)});
+  map<char,int> R;
+  for(int j=0; j<3; j++)
+    for(int i=0; i<parts[j].size(); i++)
+      if(parts[j][i]!='*') R[parts[j][i]]=dims[j][i];
+  return R;
+}
+
+
+float test_real(const string& str, const Gdims& xdims, const Gdims& ydims, const Gdims& rdims){
+  rtensor X=rtensor::gaussian(xdims);
+  rtensor Y=rtensor::gaussian(ydims);
+  rtensor R=rtensor::zero(rdims);
+  rtensor R0=rtensor::zero(rdims);
+
+  RtensorEinsumFn<float> fn(str);
+  fn(R.viewx(),X.viewx(),Y.viewx());
+
+  auto r0=R0.viewx(), x=X.viewx(), y=Y.viewx();
+  brute_force(str,extents(str,{xdims,ydims,rdims}),[&](auto& offset, const string& xs, const string& ys, const string& rs){
+      r0.arr[offset(rs,r0.strides)]+=x.arr[offset(xs,x.strides)]*y.arr[offset(ys,y.strides)];});
+  return sqrt(R.diff2(R0));
+}
+
+
+float test_complex(const string& str, const Gdims& xdims, const Gdims& ydims, const Gdims& rdims){
+  ctensor X=ctensor::gaussian(xdims);
+  ctensor Y=ctensor::gaussian(ydims);
+  ctensor R=ctensor::zero(rdims);
+  ctensor R0=ctensor::zero(rdims);
+
+  CtensorEinsumFn<float> fn(str);
+  fn(R.viewx(),X.viewx(),Y.viewx());
+
+  auto r0=R0.viewx(), x=X.viewx(), y=Y.viewx();
+  brute_force(str,extents(str,{xdims,ydims,rdims}),[&](auto& offset, const string& xs, const string& ys, const string& rs){
+      int xo=offset(xs,x.strides), yo=offset(ys,y.strides), ro=offset(rs,r0.strides);
+      complex<float> a(x.arr[xo],x.arrc[xo]);
+      complex<float> b(y.arr[yo],y.arrc[yo]);
+      if(xs.back()=='*') a=std::conj(a);
+      if(ys.back()=='*') b=std::conj(b);
+      complex<float> c=a*b;
+      if(rs.back()=='*') c=std::conj(c);
+      r0.arr[ro]+=std::real(c);
+      r0.arrc[ro]+=std::imag(c);});
+  return sqrt(R.diff2(R0));
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session(4);
+
+  cout<<"ij,jk->ik      "<<test_real("ij,jk->ik",{30,40},{40,50},{30,50})<<endl;
+  cout<<"ij,kj->ik      "<<test_real("ij,kj->ik",{30,40},{50,40},{30,50})<<endl;
+  cout<<"ij,jk->ki      "<<test_real("ij,jk->ki",{30,40},{40,50},{50,30})<<endl;
+  cout<<"ij,j->i        "<<test_real("ij,j->i",{100,64},{64},{100})<<endl;
+  cout<<"i,j->ij        "<<test_real("i,j->ij",{20},{30},{20,30})<<endl;
+  cout<<"bij,bjk->bik   "<<test_real("bij,bjk->bik",{7,20,30},{7,30,10},{7,20,10})<<endl;
+  cout<<"abj,jc->abc    "<<test_real("abj,jc->abc",{5,6,30},{30,10},{5,6,10})<<endl;
+  cout<<"ajb,jc->abc    "<<test_real("ajb,jc->abc",{5,30,6},{30,10},{5,6,10})<<endl;
+  cout<<"ijk,jkl->il    "<<test_real("ijk,jkl->il",{8,9,10},{9,10,11},{8,11})<<endl;
+  cout<<"ikj,jkl->il    "<<test_real("ikj,jkl->il",{8,10,9},{9,10,11},{8,11})<<endl;
+  cout<<"ij,jk->ikm     "<<test_real("ij,jk->ikm",{8,9},{9,10},{8,10,3})<<endl;
+  cout<<"ij,jkl->ik     "<<test_real("ij,jkl->ik",{8,9},{9,10,4},{8,10})<<endl;
+  cout<<"ij,ji->ab      "<<test_real("ij,ji->ab",{4,4},{4,4},{4,4})<<endl;
+  cout<<"bi,bi->b       "<<test_real("bi,bi->b",{10,20},{10,20},{10})<<endl;
+  cout<<endl;
+
+  cout<<"ij,jk->ik      "<<test_complex("ij,jk->ik",{30,40},{40,50},{30,50})<<endl;
+  cout<<"ij*,jk->ik     "<<test_complex("ij*,jk->ik",{30,40},{40,50},{30,50})<<endl;
+  cout<<"ij,kj*->ik     "<<test_complex("ij,kj*->ik",{30,40},{50,40},{30,50})<<endl;
+  cout<<"bij,bjk->bik*  "<<test_complex("bij,bjk->bik*",{3,10,20},{3,20,5},{3,10,5})<<endl;
+  cout<<"ij,ji->ab      "<<test_complex("ij,ji->ab",{4,4},{4,4},{4,4})<<endl;
+  cout<<endl;
+
+  cout<<"Cached plans: "<<einsum_plan_cache().plans.size()<<endl;
+
+}
@@ -0,0 +1,88 @@
+#include "Cnine_base.cpp"
+#include "RtensorA.hpp"
+#include "CnineSession.hpp"
+#include "RtensorConvolve2d.hpp"
+#include "RtensorConvolve3d.hpp"
+
+using namespace cnine;
+
+typedef ConvolveAlgorithm CA;
+
+
+float maxdiff(const RtensorA& a, const RtensorA& b){
+  float t=0;
+  for(int i=0; i<a.asize; i++) t=std::max(t,std::abs(a.arr[i]-b.arr[i]));
+  return t;
+}
+
+// x has spatial dims first, then channels and (if nc>0) columns; p is the padding
+void test2d(const int nb, const int n0, const int n1, const int nin, const int nout, const int k, const int p, const int nc){
+  int m0=n0+2*p-k+1, m1=n1+2*p-k+1;
+  Gdims xd({n0,n1,nin}), rd({m0,m1,nout});
+  if(nc>0){xd=Gdims({n0,n1,nin,nc}); rd=Gdims({m0,m1,nout,nc});}
+  if(nb>0){xd=Gdims({nb,n0,n1,nin,nc}); rd=Gdims({nb,m0,m1,nout,nc});}
+  RtensorA x=RtensorA::gaussian(xd);
+  RtensorA w=RtensorA::gaussian({nout,k,k,nin});
+
+  cout<<"2D x="<<xd<<" k="<<k<<" padding="<<p<<":";
+  RtensorA r0=RtensorA::zero(rd);
+  for(auto alg: {CA::direct,CA::im2col,CA::winograd}){
+    RtensorA r=RtensorA::zero(rd);
+    RtensorConvolve2d conv(alg);
+    if(xd.size()==3) conv(r.view3(),x.view3(),w.view4());
+    if(xd.size()==4) conv(r.view4(),x.view4(),w.view4());
+    if(xd.size()==5) conv(r.view5(),x.view5(),w.view4());
+    if(alg==CA::direct) r0=r;
+    else cout<<" "<<ConvolveAlgorithm_str(alg)<<" error="<<maxdiff(r,r0);
+  }
+  cout<<endl;
+}
+
+void test3d(const int nb, const int n, const int nin, const int nout, const int k, const int p, const int nc){
+  int m=n+2*p-k+1;
+  Gdims xd({n,n,n,nin}), rd({m,m,m,nout});
+  if(nc>0){xd=Gdims({n,n,n,nin,nc}); rd=Gdims({m,m,m,nout,nc});}
+  if(nb>0){xd=Gdims({nb,n,n,n,nin,nc}); rd=Gdims({nb,m,m,m,nout,nc});}
+  RtensorA x=RtensorA::gaussian(xd);
+  RtensorA w=RtensorA::gaussian({nout,k,k,k,nin});
+
+  cout<<"3D x="<<xd<<" k="<<k<<" padding="<<p<<":";
+  RtensorA r0=RtensorA::zero(rd);
+  for(auto alg: {CA::direct,CA::im2col}){
+    RtensorA r=RtensorA::zero(rd);
+    RtensorConvolve3d conv(alg);
+    if(xd.size()==4) conv(r.view4(),x.view4(),w.view5());
+    if(xd.size()==5) conv(r.view5(),x.view5(),w.view5());
+    if(xd.size()==6) conv(r.view6(),x.view6(),w.view5());
+    if(alg==CA::direct) r0=r;
+    else cout<<" "<<ConvolveAlgorithm_str(alg)<<" error="<<maxdiff(r,r0);
+  }
+  cout<<endl;
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  test2d(0,9,8,5,6,3,0,0);
+  test2d(0,9,8,5,6,3,1,0);
+  test2d(0,7,7,3,4,5,2,0);
+  test2d(0,9,8,5,6,3,1,3);
+  test2d(2,9,7,5,6,3,1,2);
+  test3d(0,6,3,4,3,1,0);
+  test3d(0,6,3,4,3,0,2);
+  test3d(2,5,3,4,3,1,2);
+
+  // timing on a mid-sized layer
+  RtensorA x=RtensorA::gaussian({64,64,32});
+  RtensorA w=RtensorA::gaussian({32,3,3,32});
+  for(auto alg: {CA::direct,CA::im2col,CA::winograd}){
+    RtensorA r=RtensorA::zero({64,64,32});
+    RtensorConvolve2d conv(alg);
+    auto t0=chrono::system_clock::now();
+    conv(r.view3(),x.view3(),w.view4());
+    auto t1=chrono::system_clock::now();
+    cout<<ConvolveAlgorithm_str(alg)<<": "<<chrono::duration<double,milli>(t1-t0).count()<<" ms"<<endl;
+  }
+}
@@ -0,0 +1,76 @@
+#include "Cnine_base.cpp"
+#include "RtensorA.hpp"
+#include "CnineSession.hpp"
+#include "RtensorConvolve2d.hpp"
+#include "RtensorConvolve3d.hpp"
+#include "RtensorConvolve2dSparse.hpp"
+#include "RtensorConvolve3dSparse.hpp"
+
+using namespace cnine;
+
+
+// Gaussian weights with roughly 70% of the entries zeroed out
+RtensorA sparse_weights(const Gdims& dims){
+  uniform_real_distribution<float> distr(0,1);
+  RtensorA w=RtensorA::gaussian(dims);
+  for(int i=0; i<w.asize; i++)
+    if(distr(rndGen)<0.7) w.arr[i]=0;
+  return w;
+}
+
+void report(const string& name, const RtensorA& r, const RtensorA& rs){
+  cout<<name<<": dims="<<r.dims<<" error="<<sqrt(r.diff2(rs))<<endl;
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session(4);
+
+  int nb=3;
+  int nx=9;
+  int nw=3;
+  int nc=5;
+  int nd=2;
+  int nin=4;
+  int nout=6;
+
+  for(int padding: {0,1,2}){
+
+    RtensorA w=sparse_weights({nout,nw,nw,nin});
+    CSRmatrix<float> ws(w.view4().fuse23().fuse12());
+
+    RtensorA x3=RtensorA::gaussian({nx,nx,nin});
+    report("2D 3-view padding="+to_string(padding),convolve2D(x3,w,padding,padding),convolve2D(x3,ws,nw,nw,padding,padding));
+
+    RtensorA x4=RtensorA::gaussian({nx,nx,nin,nc});
+    report("2D 4-view padding="+to_string(padding),convolve2D(x4,w,padding,padding),convolve2D(x4,ws,nw,nw,padding,padding));
+
+    RtensorA x5=RtensorA::gaussian({nb,nx,nx,nin,nc});
+    report("2D 5-view padding="+to_string(padding),convolve2D(x5,w,padding,padding),convolve2D(x5,ws,nw,nw,padding,padding));
+
+    RtensorA x6=RtensorA::gaussian({nb,nx,nx,nd,nin,nc});
+    report("2D 6-view padding="+to_string(padding),convolve2D(x6,w,padding,padding),convolve2D(x6,ws,nw,nw,padding,padding));
+  }
+  cout<<endl;
+
+  for(int padding: {0,1}){
+
+    RtensorA w=sparse_weights({nout,nw,nw,nw,nin});
+    CSRmatrix<float> ws(w.view5().fuse34().fuse23().fuse12());
+
+    RtensorA x4=RtensorA::gaussian({nx,nx,nx,nin});
+    report("3D 4-view padding="+to_string(padding),convolve3D(x4,w,padding,padding,padding),
+      convolve3D(x4,ws,nw,nw,nw,padding,padding,padding));
+
+    RtensorA x5=RtensorA::gaussian({nx,nx,nx,nin,nc});
+    report("3D 5-view padding="+to_string(padding),convolve3D(x5,w,padding,padding,padding),
+      convolve3D(x5,ws,nw,nw,nw,padding,padding,padding));
+
+    RtensorA x6=RtensorA::gaussian({nb,nx,nx,nx,nin,nc});
+    report("3D 6-view padding="+to_string(padding),convolve3D(x6,w,padding,padding,padding),
+      convolve3D(x6,ws,nw,nw,nw,padding,padding,padding));
+  }
+  cout<<endl;
+
+}
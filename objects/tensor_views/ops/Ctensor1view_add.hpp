@@ -55,6 +55,13 @@ namespace cnine{
       }
     }
 
+    // Called by AccumulateCmap on the GPU
+    template<typename IMAP>
+    void accumulate(const IMAP& map, const Ctensor2_view& r, const Ctensor2_view& x, const bool add_flag=true) const{
+      Ctensor2_view _r(r);
+      (*this)(map,_r,x,add_flag);
+    }
+
   };
 
 
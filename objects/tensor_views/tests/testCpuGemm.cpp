@@ -0,0 +1,66 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+#include "Tensor.hpp"
+#include "CnineSession.hpp"
+
+using namespace cnine;
+
+
+template<typename TYPE>
+double gemm_error(const int n, const int m, const int k, const bool tx, const bool ty){
+  Tensor<TYPE> x=Tensor<TYPE>::gaussian(tx?dims(k,n):dims(n,k));
+  Tensor<TYPE> y=Tensor<TYPE>::gaussian(ty?dims(m,k):dims(k,m));
+  TensorView<TYPE> xv=tx?x.transp():x;
+  TensorView<TYPE> yv=ty?y.transp():y;
+
+  Tensor<TYPE> r=Tensor<TYPE>::zero({n,m});
+  r.add_mprod(xv,yv);
+
+  double err=0;
+  for(int i=0; i<n; i++)
+    for(int j=0; j<m; j++){
+      TYPE t=0;
+      for(int a=0; a<k; a++)
+	t+=xv(i,a)*yv(a,j);
+      err=std::max(err,(double)std::abs(r(i,j)-t));
+    }
+  return err;
+}
+
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  cout<<"GEMM micro-kernel: "<<gemm_isa_str()<<endl<<endl;
+
+  for(auto tx: {false,true})
+    for(auto ty: {false,true}){
+      cout<<"tx="<<tx<<" ty="<<ty<<endl;
+      cout<<"  float:          "<<gemm_error<float>(37,53,129,tx,ty)<<endl;
+      cout<<"  double:         "<<gemm_error<double>(37,53,129,tx,ty)<<endl;
+      cout<<"  complex<float>: "<<gemm_error<complex<float> >(37,53,129,tx,ty)<<endl;
+    }
+  cout<<endl;
+
+  Tensor<float> A=Tensor<float>::gaussian({200,300});
+  Tensor<float> B=Tensor<float>::gaussian({300,100});
+  Tensor<float> C=Tensor<float>::zero({200,100});
+  auto Cv=C.view2();
+  Cv.add_matmul_AA(A.view2(),B.view2());
+  Tensor<float> D=A*B;
+  cout<<"Rtensor2_view::add_matmul_AA: "<<C.diff2(D)<<endl;
+
+}
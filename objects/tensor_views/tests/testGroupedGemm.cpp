@@ -0,0 +1,66 @@
+/*
+ * This file is part of cnine, a lightweight C++ tensor library.
+ *
+ * Copyright (c) 2024, Imre Risi Kondor
+ *
+ * This source code file is subject to the terms of the noncommercial
+ * license distributed with cnine in the file LICENSE.TXT. Commercial
+ * use is prohibited. All redistributed versions of this file (in
+ * original or modified form) must retain this copyright notice and
+ * must be accompanied by a verbatim copy of the license.
+ *
+ */
+
+#include "Cnine_base.cpp"
+#include "Tensor.hpp"
+#include "GroupedGemm.hpp"
+#include "CnineSession.hpp"
+
+using namespace cnine;
+
+
+int main(int argc, char** argv){
+
+  cnine_session session;
+
+  // Tiny, medium and large products, with transposed operands mixed in
+  vector<Tensor<double> > X, Y, R;
+  vector<TensorView<double> > Xv, Yv;
+  vector<GemmProblem<double> > problems;
+  X.reserve(200); Y.reserve(200); R.reserve(200); // the problems point into these
+  for(int i=0; i<200; i++){
+    int n=1+i%9, m=1+(i*7)%13, k=1+(i*5)%11;
+    if(i%50==0){n=300; m=70; k=150;}
+    if(i%50==1){n=40; m=90; k=60;}
+    const bool tx=(i%3==1), ty=(i%4==2);
+    X.push_back(Tensor<double>::gaussian(tx?dims(k,n):dims(n,k)));
+    Y.push_back(Tensor<double>::gaussian(ty?dims(m,k):dims(k,m)));
+    R.push_back(Tensor<double>::zero({n,m}));
+    Xv.push_back(tx?X.back().transp():X.back());
+    Yv.push_back(ty?Y.back().transp():Y.back());
+    const TensorView<double>& x=Xv.back();
+    const TensorView<double>& y=Yv.back();
+    const TensorView<double>& r=R.back();
+    problems.push_back(GemmProblem<double>(n,m,k,x.mem(),x.stride(0),x.stride(1),
+	y.mem(),y.stride(0),y.stride(1),r.mem(),r.stride(0),r.stride(1)));
+  }
+
+  GroupedGemm<double> gemm(problems);
+  cout<<"Tasks: "<<gemm.tasks.size()<<", chunks: "<<gemm.nchunks()<<endl;
+
+  for(int n: {1,3}){
+    nthreads=n;
+    for(auto& r:R) r.set_zero();
+    gemm(2.0);
+
+    double err=0;
+    for(int i=0; i<problems.size(); i++){
+      Tensor<double> T=Tensor<double>::zero(R[i].get_dims());
+      T.add_mprod(Xv[i],Yv[i]);
+      T.inplace_times(2.0);
+      err=std::max(err,T.diff2(R[i]));
+    }
+    cout<<"nthreads="<<n<<": error="<<err<<endl;
+  }
+
+}
@@ -30,13 +30,13 @@ extern cnine::CnineLog cnine_log;
   public:
 
     string name;
-    chrono::time_point<chrono::system_clock> t0;
+    chrono::time_point<chrono::steady_clock> t0;
 
     ftimer(const string _name):
-      name(_name), t0(chrono::system_clock::now()){}
+      name(_name), t0(chrono::steady_clock::now()){}
 
     ~ftimer(){
-      auto elapsed=chrono::duration<double,std::milli>(chrono::system_clock::now()-t0).count();
+      auto elapsed=chrono::duration<double,std::milli>(chrono::steady_clock::now()-t0).count();
       cnine::cnine_log.log_call(name,elapsed);
     }
 
@@ -47,13 +47,13 @@ extern cnine::CnineLog cnine_log;
   public:
 
     string name;
-    chrono::time_point<chrono::system_clock> t0;
+    chrono::time_point<chrono::steady_clock> t0;
 
     flog(const string _name):
-      name(_name), t0(chrono::system_clock::now()){}
+      name(_name), t0(chrono::steady_clock::now()){}
 
     ~flog(){
-      auto elapsed=chrono::duration<double,std::milli>(chrono::system_clock::now()-t0).count();
+      auto elapsed=chrono::duration<double,std::milli>(chrono::steady_clock::now()-t0).count();
       cnine::cnine_log.log_call(name,elapsed);
     }
 
@@ -19,9 +19,15 @@
 #include <chrono>
 #include <ctime>
 #include "CnineLog.hpp"
+#include "CnineProfiler.hpp"
 
 
 
+#define CNINE_FNLOG(var,name)						\
+  static const cnine::ProfileSite CNINE_PROFILE_CAT(_cnine_fnlog_site_,__LINE__)(name); \
+  cnine::fnlog var(CNINE_PROFILE_CAT(_cnine_fnlog_site_,__LINE__))
+
+
 namespace cnine{
 
 extern cnine::CnineLog cnine_log;
@@ -44,19 +50,45 @@ extern cnine::CnineLog cnine_log;
   };
   */
 
+  // Function timer reporting to the profiler. Fixed names should be interned once in a static
+  // ProfileSite (CNINE_FNLOG does this), which makes the timer as cheap as CNINE_PROFILE. Timers
+  // constructed from a string look the name up in a per-thread cache of site ids, so that path is
+  // only for names that are known at run time.
+  //
+  //   CNINE_FNLOG(timer,"f");
+  //   fnlog timer2(name+"("+to_string(n)+")");
+
   class fnlog{
   public:
 
-    string name;
-    chrono::time_point<chrono::system_clock> t0;
+#ifndef CNINE_NO_PROFILING
+    int id;
+    long long n_ops=0;
+    uint64_t t0;
 
-    fnlog(const string _name):
-      name(_name), t0(chrono::system_clock::now()){}
+    fnlog(const ProfileSite& site, const long long _n_ops=0):
+      id(site.id), n_ops(_n_ops), t0(profiler_ticks()){}
+
+    fnlog(const string& name):
+      id(cached_site_id(name)), t0(profiler_ticks()){}
+
+    // With an operation count the report also gives throughput
+    fnlog(const string& name, const long long _n_ops):
+      id(cached_site_id(name)), n_ops(_n_ops), t0(profiler_ticks()){}
 
     ~fnlog(){
-      auto elapsed=chrono::duration<double,std::milli>(chrono::system_clock::now()-t0).count();
-      cnine::cnine_log.log_call(name,elapsed);
+      uint64_t t1=profiler_ticks();
+      profiler_buffer.add(id,t1-t0,n_ops);
+      if(cnine_profiler.tracing.load(std::memory_order_relaxed))
+	profiler_buffer.add_event(id,t0,t1,n_ops);
     }
+#else
+    fnlog(const ProfileSite& site, const long long _n_ops=0){}
+    fnlog(const string& name){}
+    fnlog(const string& name, const long long _n_ops){}
+#endif
+
+    fnlog(const fnlog& x)=delete;
 
   };
 
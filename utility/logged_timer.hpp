@@ -20,6 +20,7 @@
 #include <ctime>
 
 #include "CnineSession.hpp"
+#include "CnineProfiler.hpp"
 
 extern cnine::CnineLog cnine_log;
 
@@ -30,13 +31,22 @@ namespace cnine{
   public:
 
     string task;
+    string name;
     long long n_ops=0;
     chrono::time_point<chrono::system_clock> t0;
+    uint64_t start_ticks=profiler_ticks();
 
+    // When the profiler is tracing, the call also goes on the timeline, with the full task
+    // string (including the argument reprs) attached to the event. The name is only interned
+    // then, through the thread's own cache.
     ~logged_timer(){
       auto elapsed=chrono::duration<double,std::milli>(chrono::system_clock::now()-t0).count();
       if(n_ops>0) cnine_log(task+" "+to_string(elapsed)+" ms"+" ["+to_string((int)(((float)n_ops)/elapsed/1000.0))+" Mflops]");
       else cnine_log(task+" "+to_string(elapsed)+" ms");
+      #ifndef CNINE_NO_PROFILING
+      if(cnine_profiler.tracing.load(std::memory_order_relaxed))
+	profiler_buffer.add_event(cached_site_id(name),start_ticks,profiler_ticks(),n_ops,task);
+      #endif
     }
 
 
@@ -44,26 +54,26 @@ namespace cnine{
 
 
     logged_timer(string _task=""):
-      task(_task){
+      task(_task), name(_task){
       t0=chrono::system_clock::now();
     }
 
     logged_timer(string _task, const long long _ops):
-      task(_task){
+      task(_task), name(_task){
       t0=chrono::system_clock::now();
       n_ops=_ops;
     }
 
-    template<typename OBJ0, typename OBJ1>
+    template<typename OBJ0>
     logged_timer(string _task, const OBJ0& obj0, const long long _ops):
-      task(_task+obj0.repr()){
+      task(_task+obj0.repr()), name(_task){
       t0=chrono::system_clock::now();
       n_ops=_ops;
     }
 
     template<typename OBJ0, typename OBJ1>
     logged_timer(string _task, const OBJ0& obj0, const OBJ1& obj1, const long long _ops):
-      task(_task+obj0.repr()+obj1.repr()){
+      task(_task+obj0.repr()+obj1.repr()), name(_task){
       t0=chrono::system_clock::now();
       n_ops=_ops;
     }
@@ -72,56 +82,56 @@ namespace cnine{
 
     template<typename OBJ>
     logged_timer(string _task, const OBJ& obj):
-      task(_task+obj.repr()){
+      task(_task+obj.repr()), name(_task){
       t0=chrono::system_clock::now();
     }
 
     template<typename OBJ>
     logged_timer(string _task, const OBJ& obj, const string s1):
-      task(_task+obj.repr()+s1){
+      task(_task+obj.repr()+s1), name(_task){
       t0=chrono::system_clock::now();
     }
 
     template<typename OBJ0, typename OBJ1>
     logged_timer(string _task, const OBJ0& obj0, const string s1, const OBJ1& obj1):
-      task(_task+obj0.repr()+s1+obj1.repr()){
+      task(_task+obj0.repr()+s1+obj1.repr()), name(_task){
       t0=chrono::system_clock::now();
     }
 
     template<typename OBJ0, typename OBJ1>
     logged_timer(string _task, const OBJ0& obj0, const string s1, const OBJ1& obj1, const string s2):
-      task(_task+obj0.repr()+s1+obj1.repr()+s2){
+      task(_task+obj0.repr()+s1+obj1.repr()+s2), name(_task){
       t0=chrono::system_clock::now();
     }
 
 
     template<typename OBJ0>
     logged_timer(const OBJ0& obj0, string _task):
-      task(obj0.repr()+_task){
+      task(obj0.repr()+_task), name(_task){
       t0=chrono::system_clock::now();
     }
 
     template<typename OBJ0, typename OBJ1>
     logged_timer(const OBJ0& obj0, string _task, const OBJ1& obj1):
-      task(obj0.repr()+_task+obj1.repr()){
+      task(obj0.repr()+_task+obj1.repr()), name(_task){
       t0=chrono::system_clock::now();
     }
 
     template<typename OBJ0, typename OBJ1>
     logged_timer(const OBJ0& obj0, string _task, const OBJ1& obj1, const string s1):
-      task(obj0.repr()+_task+obj1.repr()+s1){
+      task(obj0.repr()+_task+obj1.repr()+s1), name(_task){
       t0=chrono::system_clock::now();
     }
 
     template<typename OBJ0, typename OBJ1, typename OBJ2>
     logged_timer(const OBJ0& obj0, string _task, const OBJ1& obj1, const string s1, const OBJ2& obj2):
-      task(obj0.repr()+_task+obj1.repr()+s1+obj2.repr()){
+      task(obj0.repr()+_task+obj1.repr()+s1+obj2.repr()), name(_task){
       t0=chrono::system_clock::now();
     }
 
     template<typename OBJ0, typename OBJ1, typename OBJ2>
     logged_timer(const OBJ0& obj0, string _task, const OBJ1& obj1, const string s1, const OBJ2& obj2, const string s2):
-      task(obj0.repr()+_task+obj1.repr()+s1+obj2.repr()+s2){
+      task(obj0.repr()+_task+obj1.repr()+s1+obj2.repr()+s2), name(_task){
       t0=chrono::system_clock::now();
     }
 